@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lib_opencl.h"
+#include "lib_image.h"
+
+/* Benchmark of imageApplyFilter on synthetic images. Every image size of the sweep
+ * and every filter is timed over BENCH_COLD_RUNS cold runs (first call after a fresh
+ * imageInit, so buffer creation and work-group tuning are included) and
+ * BENCH_WARM_RUNS warm runs (after one untimed call on the same component).
+ * --copy turns zero-copy buffers off to compare against explicit transfers.
+ *
+ * Usage: bench_image [--warm N] [--cold N] [--max-size N] [--host] [--copy] [--csv FILE]
+ */
+#define BENCH_WARM_RUNS   20
+#define BENCH_COLD_RUNS   3
+#define BENCH_MIN_SIZE    128
+#define BENCH_MAX_SIZE    2048
+#define BENCH_MAX_RUNS    1000
+#define BENCH_MAX_RESULTS 128
+#define BENCH_NUM_FILTERS 3
+#define BENCH_MAX_FILTER  9
+#define BENCH_THRESHOLD   100.0f
+
+typedef struct {
+    const char *name;
+    cl_int     size;
+    cl_float   weight[BENCH_MAX_FILTER * BENCH_MAX_FILTER];
+}bench_filter_t;
+
+typedef struct {
+    const char *filter_name;
+    cl_int     size;
+    const char *mode;
+    cl_int     runs;
+    double     median_ms;
+    double     p95_ms;
+    double     mpixel_per_s;
+}bench_result_t;
+
+static double getWallTimeMs(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0);
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    
+    return ((da > db) - (da < db));
+}
+
+/* Median and nearest-rank 95th percentile, sorts ms in place. */
+static void getRunStats(double *ms, int runs, double *ret_median, double *ret_p95)
+{
+    int p95_index;
+    
+    qsort(ms, runs, sizeof(double), compareDouble);
+    
+    p95_index = ((95 * runs) + 99) / 100 - 1;
+    
+    *ret_median = ((runs % 2) != 0) ? ms[runs / 2] : (0.5 * (ms[runs / 2 - 1] + ms[runs / 2]));
+    *ret_p95    = ms[(p95_index > 0) ? p95_index : 0];
+}
+
+/* Deterministic test pattern: gradients, a checkerboard and pseudo-random noise, so
+ * the threshold keeps both outputs and every filter has edges to respond to.
+ */
+static void fillImage(opencl_image_t * const image, cl_uint seed)
+{
+    for (int y = 0; y < image->y; y += 1)
+    {
+        for (int x = 0; x < image->x; x += 1)
+        {
+            opencl_pixel_t *pixel = &image->pixel[y * image->x + x];
+            cl_float       check  = ((((x / 16) + (y / 16)) % 2) != 0) ? 64.0f : 0.0f;
+            
+            seed = seed * 1664525u + 1013904223u;
+            
+            pixel->red   = (cl_float)((x * 255) / image->x);
+            pixel->green = (cl_float)((y * 255) / image->y) * 0.75f + check;
+            pixel->blue  = (cl_float)(seed >> 24);
+            pixel->alpha = 0;
+        }
+    }
+}
+
+static void createFilters(bench_filter_t filter[BENCH_NUM_FILTERS])
+{
+    cl_float sobel[9] = {-1, -2, -1,
+                          0,  0,  0,
+                          1,  2,  1};
+    cl_uint  seed     = 12345u;
+    
+    memset(filter, 0, sizeof(bench_filter_t) * BENCH_NUM_FILTERS);
+    
+    /* Small non-separable filter: the plain kernel. */
+    filter[0].name = "sobel3";
+    filter[0].size = 3;
+    memcpy(filter[0].weight, sobel, sizeof(sobel));
+    
+    /* Rank-1 box filter: the separable row and column kernels. */
+    filter[1].name = "box9";
+    filter[1].size = 9;
+    
+    for (int i = 0; i < (9 * 9); i += 1)
+    {
+        filter[1].weight[i] = 1.0f / 81.0f;
+    }
+    
+    /* Large non-separable filter: the tiled kernel. */
+    filter[2].name = "random9";
+    filter[2].size = 9;
+    
+    for (int i = 0; i < (9 * 9); i += 1)
+    {
+        seed                = seed * 1664525u + 1013904223u;
+        filter[2].weight[i] = ((cl_float)(seed >> 16) / 65536.0f - 0.5f) / 20.0f;
+    }
+}
+
+/* Times one call on a freshly initialised component per run. */
+static cl_int runCold(cl_device_id          * const device_list,
+                      cl_uint                       num_dev,
+                      cl_int                        force_host,
+                      bench_filter_t        * const filter,
+                      opencl_image_t        * const input_image,
+                      opencl_image_t        * const output_image,
+                      int                           runs,
+                      double                * const ret_ms)
+{
+    cl_int err = CL_SUCCESS;
+    
+    for (int run = 0; (run < runs) && (err == CL_SUCCESS); run += 1)
+    {
+        double start_ms;
+        cl_int deinit_err;
+        
+        imageInit(device_list, num_dev, &err);
+        
+        if (force_host != 0)
+        {
+            imageSetBackend(IMAGE_BACKEND_HOST);
+        }
+        
+        start_ms = getWallTimeMs();
+        imageApplyFilter(filter->weight, BENCH_THRESHOLD, filter->size, input_image, output_image, &err);
+        ret_ms[run] = getWallTimeMs() - start_ms;
+        
+        imageDeinit(&deinit_err);
+    }
+    
+    return (err);
+}
+
+static cl_int runWarm(bench_filter_t        * const filter,
+                      opencl_image_t        * const input_image,
+                      opencl_image_t        * const output_image,
+                      int                           runs,
+                      double                * const ret_ms)
+{
+    cl_int err;
+    
+    /* Untimed first call creates the pooled buffers and tunes the work-group size. */
+    imageApplyFilter(filter->weight, BENCH_THRESHOLD, filter->size, input_image, output_image, &err);
+    
+    for (int run = 0; (run < runs) && (err == CL_SUCCESS); run += 1)
+    {
+        double start_ms = getWallTimeMs();
+        
+        imageApplyFilter(filter->weight, BENCH_THRESHOLD, filter->size, input_image, output_image, &err);
+        ret_ms[run] = getWallTimeMs() - start_ms;
+    }
+    
+    return (err);
+}
+
+int main(int argc, const char *argv[])
+{
+    cl_device_id   my_dev_list[10];
+    cl_uint        num_dev;
+    cl_int         err;
+    bench_filter_t filter[BENCH_NUM_FILTERS];
+    bench_result_t result[BENCH_MAX_RESULTS];
+    double         ms[BENCH_MAX_RUNS];
+    int            num_result = 0;
+    int            warm_runs  = BENCH_WARM_RUNS;
+    int            cold_runs  = BENCH_COLD_RUNS;
+    int            max_size   = BENCH_MAX_SIZE;
+    cl_int         force_host = 0;
+    const char     *csv_filename = NULL;
+    
+    /* Parse options.
+     */
+    {
+        for (int i = 1; i < argc; i += 1)
+        {
+            if ((strcmp(argv[i], "--warm") == 0) && ((i + 1) < argc))
+            {
+                warm_runs = atoi(argv[++i]);
+            }
+            else if ((strcmp(argv[i], "--cold") == 0) && ((i + 1) < argc))
+            {
+                cold_runs = atoi(argv[++i]);
+            }
+            else if ((strcmp(argv[i], "--max-size") == 0) && ((i + 1) < argc))
+            {
+                max_size = atoi(argv[++i]);
+            }
+            else if ((strcmp(argv[i], "--csv") == 0) && ((i + 1) < argc))
+            {
+                csv_filename = argv[++i];
+            }
+            else if (strcmp(argv[i], "--host") == 0)
+            {
+                force_host = 1;
+            }
+            else if (strcmp(argv[i], "--copy") == 0)
+            {
+                imageSetZeroCopy(IMAGE_ZERO_COPY_OFF);
+            }
+            else
+            {
+                printf("Usage: %s [--warm N] [--cold N] [--max-size N] [--host] [--copy] [--csv FILE]\n", argv[0]);
+                return 1;
+            }
+        }
+        
+        if ((warm_runs < 1) || (warm_runs > BENCH_MAX_RUNS) || (cold_runs < 1) || (cold_runs > BENCH_MAX_RUNS))
+        {
+            printf("Bench Error: run counts must be between 1 and %d.\n", BENCH_MAX_RUNS);
+            return 1;
+        }
+    }
+    
+    /* Get device information, without a device the host implementation is timed.
+     */
+    {
+        clGetAllDeviceIDs(CL_DEVICE_TYPE_ALL, 10, my_dev_list, &num_dev);
+        clPrintAllAvaliableDevicesInfo(my_dev_list, num_dev);
+        createFilters(filter);
+    }
+    
+    /* Size sweep.
+     */
+    for (int size = BENCH_MIN_SIZE; (size <= max_size) && (num_result < BENCH_MAX_RESULTS); size *= 2)
+    {
+        opencl_image_t input_image;
+        opencl_image_t output_image;
+        
+        input_image.x      = size;
+        input_image.y      = size;
+        input_image.pixel  = (opencl_pixel_t *)clAllocHostMemory(size * size * sizeof(opencl_pixel_t));
+        output_image.x     = size;
+        output_image.y     = size;
+        output_image.pixel = (opencl_pixel_t *)clAllocHostMemory(size * size * sizeof(opencl_pixel_t));
+        
+        if ((input_image.pixel == NULL) || (output_image.pixel == NULL))
+        {
+            printf("Bench Error: cannot allocate a %dx%d image.\n", size, size);
+            free(input_image.pixel);
+            free(output_image.pixel);
+            break;
+        }
+        
+        fillImage(&input_image, (cl_uint)size);
+        
+        for (int f = 0; (f < BENCH_NUM_FILTERS) && ((num_result + 2) <= BENCH_MAX_RESULTS); f += 1)
+        {
+            /* Cold runs, then warm runs on one component. */
+            err = runCold(my_dev_list, num_dev, force_host, &filter[f], &input_image, &output_image, cold_runs, ms);
+            
+            if (err == CL_SUCCESS)
+            {
+                result[num_result].filter_name = filter[f].name;
+                result[num_result].size        = size;
+                result[num_result].mode        = "cold";
+                result[num_result].runs        = cold_runs;
+                getRunStats(ms, cold_runs, &result[num_result].median_ms, &result[num_result].p95_ms);
+                num_result += 1;
+                
+                imageInit(my_dev_list, num_dev, &err);
+                
+                if (force_host != 0)
+                {
+                    imageSetBackend(IMAGE_BACKEND_HOST);
+                }
+                
+                err = runWarm(&filter[f], &input_image, &output_image, warm_runs, ms);
+                
+                if (err == CL_SUCCESS)
+                {
+                    result[num_result].filter_name = filter[f].name;
+                    result[num_result].size        = size;
+                    result[num_result].mode        = "warm";
+                    result[num_result].runs        = warm_runs;
+                    getRunStats(ms, warm_runs, &result[num_result].median_ms, &result[num_result].p95_ms);
+                    num_result += 1;
+                }
+                
+                {
+                    cl_int deinit_err;
+                    
+                    imageDeinit(&deinit_err);
+                }
+            }
+            
+            if (err != CL_SUCCESS)
+            {
+                printf("Bench Error: %s on %dx%d failed: %d.\n", filter[f].name, size, size, err);
+            }
+        }
+        
+        free(input_image.pixel);
+        free(output_image.pixel);
+    }
+    
+    /* Print results, throughput from the median.
+     */
+    {
+        FILE *csv_file = NULL;
+        
+        if (csv_filename != NULL)
+        {
+            csv_file = fopen(csv_filename, "w");
+            
+            if (csv_file == NULL)
+            {
+                printf("Bench Error: cannot write %s.\n", csv_filename);
+            }
+            else
+            {
+                fprintf(csv_file, "component,operation,size,mode,runs,median_ms,p95_ms,throughput,unit\n");
+            }
+        }
+        
+        printf("\n%-10s %-11s %-5s %5s %12s %12s %14s\n", "filter", "size", "mode", "runs", "median ms", "p95 ms", "Mpixel/s");
+        
+        for (int i = 0; i < num_result; i += 1)
+        {
+            char size_name[32];
+            
+            result[i].mpixel_per_s = (result[i].median_ms > 0)
+                                   ? (((double)result[i].size * result[i].size) / (result[i].median_ms * 1000.0))
+                                   : 0;
+            
+            snprintf(size_name, sizeof(size_name), "%dx%d", result[i].size, result[i].size);
+            
+            printf("%-10s %-11s %-5s %5d %12.3f %12.3f %14.2f\n",
+                   result[i].filter_name,
+                   size_name,
+                   result[i].mode,
+                   result[i].runs,
+                   result[i].median_ms,
+                   result[i].p95_ms,
+                   result[i].mpixel_per_s);
+            
+            if (csv_file != NULL)
+            {
+                fprintf(csv_file, "image,%s,%s,%s,%d,%.6f,%.6f,%.4f,Mpixel/s\n",
+                        result[i].filter_name,
+                        size_name,
+                        result[i].mode,
+                        result[i].runs,
+                        result[i].median_ms,
+                        result[i].p95_ms,
+                        result[i].mpixel_per_s);
+            }
+        }
+        
+        if (csv_file != NULL)
+        {
+            fclose(csv_file);
+        }
+    }
+    
+    return 0;
+}
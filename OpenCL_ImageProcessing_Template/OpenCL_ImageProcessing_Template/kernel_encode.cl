@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/* Block DCT encoder kernels: packed RGB -> level shifted YCbCr planes -> 8x8 DCT,
+ * quantization and zig-zag ordering. Only the int16 coefficients leave the device.
+ */
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BLOCK_SIZE 8
+
+/* Orthonormal 8-point DCT-II basis, dct_basis[u * 8 + x] = c(u)/2 * cos((2x+1)*u*pi/16)
+ * with c(0) = 1/sqrt(2) and c(u) = 1 otherwise.
+ */
+__constant float dct_basis[BLOCK_SIZE * BLOCK_SIZE] =
+{
+    +0.353553391f, +0.353553391f, +0.353553391f, +0.353553391f, +0.353553391f, +0.353553391f, +0.353553391f, +0.353553391f,
+    +0.490392640f, +0.415734806f, +0.277785117f, +0.097545161f, -0.097545161f, -0.277785117f, -0.415734806f, -0.490392640f,
+    +0.461939766f, +0.191341716f, -0.191341716f, -0.461939766f, -0.461939766f, -0.191341716f, +0.191341716f, +0.461939766f,
+    +0.415734806f, -0.097545161f, -0.490392640f, -0.277785117f, +0.277785117f, +0.490392640f, +0.097545161f, -0.415734806f,
+    +0.353553391f, -0.353553391f, -0.353553391f, +0.353553391f, +0.353553391f, -0.353553391f, -0.353553391f, +0.353553391f,
+    +0.277785117f, -0.490392640f, +0.097545161f, +0.415734806f, -0.415734806f, -0.097545161f, +0.490392640f, -0.277785117f,
+    +0.191341716f, -0.461939766f, +0.461939766f, -0.191341716f, -0.191341716f, +0.461939766f, -0.461939766f, +0.191341716f,
+    +0.097545161f, -0.277785117f, +0.415734806f, -0.490392640f, +0.490392640f, -0.415734806f, +0.277785117f, -0.097545161f
+};
+
+/* Zig-zag position of every coefficient, indexed by v * 8 + u.
+ */
+__constant int zigzag_position[BLOCK_SIZE * BLOCK_SIZE] =
+{
+     0,  1,  5,  6, 14, 15, 27, 28,
+     2,  4,  7, 13, 16, 26, 29, 42,
+     3,  8, 12, 17, 25, 30, 41, 43,
+     9, 11, 18, 24, 31, 40, 44, 53,
+    10, 19, 23, 32, 39, 45, 52, 54,
+    20, 22, 33, 38, 46, 51, 55, 60,
+    21, 34, 37, 47, 50, 56, 59, 61,
+    35, 36, 48, 49, 57, 58, 62, 63
+};
+
+/* JFIF RGB to YCbCr, shifted by -128 so all planes are centered on zero. Pixels of
+ * the padded area repeat the last row and column of the image.
+ */
+__kernel void ConvertToYCbCr(__global const uchar * input_image,
+                             __global float * ret_planes,
+                             int width,
+                             int height,
+                             int padded_width,
+                             int padded_height)
+{
+    int    x;
+    int    y;
+    int    plane_size;
+    int    index;
+    float3 rgb;
+    
+    x = get_global_id(0);
+    y = get_global_id(1);
+    
+    plane_size = padded_width * padded_height;
+    index      = min(y, height - 1) * width + min(x, width - 1);
+    rgb        = convert_float3(vload3(index, input_image));
+    
+    ret_planes[y * padded_width + x]                  =  0.299f    * rgb.x + 0.587f    * rgb.y + 0.114f    * rgb.z - 128.0f;
+    ret_planes[y * padded_width + x + plane_size]     = -0.168736f * rgb.x - 0.331264f * rgb.y + 0.5f      * rgb.z;
+    ret_planes[y * padded_width + x + 2 * plane_size] =  0.5f      * rgb.x - 0.418688f * rgb.y - 0.081312f * rgb.z;
+}
+
+/* One 8x8 work group per block, dimension 2 selects the plane. The block is transformed
+ * with a row and a column pass in local memory, divided by the quantization table of
+ * the plane (luma for Y, chroma for Cb and Cr), rounded and stored in zig-zag order:
+ * ret_coefficients[((plane * blocks_y + block_y) * blocks_x + block_x) * 64 + zigzag].
+ */
+__kernel __attribute__((reqd_work_group_size(BLOCK_SIZE, BLOCK_SIZE, 1)))
+void BlockDCTQuantize(__global const float * planes,
+                      __global short * ret_coefficients,
+                      __global const float * quant_tables,
+                      int padded_width,
+                      int padded_height)
+{
+    __local float block[BLOCK_SIZE][BLOCK_SIZE];
+    __local float rows[BLOCK_SIZE][BLOCK_SIZE];
+    int   lx;
+    int   ly;
+    int   plane;
+    int   blocks_x;
+    int   blocks_y;
+    int   block_index;
+    float z;
+    
+    lx    = get_local_id(0);
+    ly    = get_local_id(1);
+    plane = get_global_id(2);
+    
+    blocks_x    = padded_width / BLOCK_SIZE;
+    blocks_y    = padded_height / BLOCK_SIZE;
+    block_index = (plane * blocks_y + get_group_id(1)) * blocks_x + get_group_id(0);
+    
+    block[ly][lx] = planes[plane * padded_width * padded_height + get_global_id(1) * padded_width + get_global_id(0)];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    /* Row pass: rows[y][u] = sum_x block[y][x] * basis[u][x].
+     */
+    z = 0.0f;
+    for (int x = 0; x < BLOCK_SIZE; x += 1)
+    {
+        z += block[ly][x] * dct_basis[lx * BLOCK_SIZE + x];
+    }
+    rows[ly][lx] = z;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    /* Column pass: coefficient[v][u] = sum_y rows[y][u] * basis[v][y], with v = ly, u = lx.
+     */
+    z = 0.0f;
+    for (int y = 0; y < BLOCK_SIZE; y += 1)
+    {
+        z += rows[y][lx] * dct_basis[ly * BLOCK_SIZE + y];
+    }
+    
+    z /= quant_tables[((plane == 0) ? 0 : (BLOCK_SIZE * BLOCK_SIZE)) + ly * BLOCK_SIZE + lx];
+    
+    ret_coefficients[block_index * BLOCK_SIZE * BLOCK_SIZE + zigzag_position[ly * BLOCK_SIZE + lx]] = convert_short_sat_rte(z);
+}
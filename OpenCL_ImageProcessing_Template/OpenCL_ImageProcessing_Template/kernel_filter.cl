@@ -1,3 +1,18 @@
+/* Packed pixels are the 3-byte RGB triplets of a PPM image, they are expanded to
+ * float4 (alpha = 0) on load and written back as 0/255 bytes.
+ */
+float4 loadPackedPixel(__global const uchar *input, int index)
+{
+    return (float4)(convert_float3(vload3(index, input)), 0.0f);
+}
+
+void storePackedPixel(__global uchar *output, int index, float4 response, float threshold)
+{
+    float3 value = (response.xyz > (float3)threshold) ? (float3)255.0f : (float3)0.0f;
+    
+    vstore3(convert_uchar3(value), index, output);
+}
+
 __kernel void Filter(__global    float4  *input,
                      __global    float4  *output,
                      __constant  float   *filter_ws,
@@ -13,14 +28,13 @@ __kernel void Filter(__global    float4  *input,
     int filter_i = 0;
     float4 response = (float4)0.0f;
     
-    /* Filter can overlap with image boundary when index is between the following ranges:
-     *  a. index % get_global_size(0) == 0.
-     *  b. index ??
+    /* The filter window has to lie inside the image, pixels closer than half the
+     * filter size to the image boundary keep a zero response.
      */
-    if(   (0 != (index % g_size.x))                 /* First vertical line.    */
-       && (index >= g_size.x)                       /* First horizontal line.  */
-       && (index <= (g_size.x*g_size.y - g_size.x)) /* Second horizontal line. */
-       && (index < (pos.y*g_size.x + g_size.x - 1)) /* Second horizontal line. */
+    if(   (pos.x >= half_filter_size)                /* Left vertical band.     */
+       && (pos.x <  (g_size.x - half_filter_size))   /* Right vertical band.    */
+       && (pos.y >= half_filter_size)                /* Top horizontal band.    */
+       && (pos.y <  (g_size.y - half_filter_size))   /* Bottom horizontal band. */
        )
     {
         /* Apply filter weights if the filter is not boundary of the image. */
@@ -35,12 +49,345 @@ __kernel void Filter(__global    float4  *input,
         }
         
     }
-    else
+    
+    /* Check compare threshold. */
+    output[index] = (response > (float4)threshold) ? (float4)255 : (float4)0;
+}
+
+/* Same filter as Filter, but every work-group first copies its tile of the image
+ * plus a halo of half the filter size into local memory, so each input pixel is
+ * read from global memory once per work-group instead of filter_size^2 times.
+ * tile must hold (local_size_x + filter_size - 1) * (local_size_y + filter_size - 1)
+ * pixels; the global size may be rounded up to a multiple of the local size.
+ */
+__kernel void FilterTiled(__global    float4  *input,
+                          __global    float4  *output,
+                          __constant  float   *filter_ws,
+                                      float   threshold,
+                                      int     filter_size,
+                                      int     width,
+                                      int     height,
+                          __local     float4  *tile)
+{
+    int2 pos    = {get_global_id(0), get_global_id(1)};
+    int2 l_pos  = {get_local_id(0), get_local_id(1)};
+    int2 l_size = {get_local_size(0), get_local_size(1)};
+    
+    int half_filter_size = filter_size/2;
+    int tile_width       = l_size.x + 2 * half_filter_size;
+    int tile_height      = l_size.y + 2 * half_filter_size;
+    int2 origin          = {get_group_id(0) * l_size.x - half_filter_size,
+                            get_group_id(1) * l_size.y - half_filter_size};
+    int filter_i = 0;
+    float4 response = (float4)0.0f;
+    
+    /* Load tile and halo, pixels outside the image are never used by the filter. */
+    for(int ty = l_pos.y; ty < tile_height; ty += l_size.y)
+    {
+        int iy = origin.y + ty;
+        for(int tx = l_pos.x; tx < tile_width; tx += l_size.x)
+        {
+            int ix = origin.x + tx;
+            tile[ty * tile_width + tx] = ((ix >= 0) && (ix < width) && (iy >= 0) && (iy < height))
+                                         ? input[iy * width + ix]
+                                         : (float4)0.0f;
+        }
+    }
+    
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    /* Work-items of the rounded up global size only helped loading the tile. */
+    if((pos.x >= width) || (pos.y >= height))
+    {
+        return;
+    }
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (width - half_filter_size))
+       && (pos.y >= half_filter_size)
+       && (pos.y <  (height - half_filter_size))
+       )
     {
-        /* Start padding the filter but we need to know which corner are we in ? */
-        output[index] = 0;
+        /* Same summation order as Filter, so both kernels give the same output. */
+        for(int r = 0; r < filter_size; r += 1)
+        {
+            int current_row = (l_pos.y + r) * tile_width + l_pos.x;
+            for(int c = 0; c < filter_size; c += 1)
+            {
+                response += tile[current_row + c] * (float4)filter_ws[filter_i];
+                filter_i += 1;
+            }
+        }
+    }
+    
+    /* Check compare threshold. */
+    output[pos.y * width + pos.x] = (response > (float4)threshold) ? (float4)255 : (float4)0;
+}
+
+/* First pass of a separable filter: convolve every row with the row weights held
+ * in filter_ws[0 .. filter_size-1]. Pixels whose window crosses the left or right
+ * boundary keep a zero response.
+ */
+__kernel void FilterRow(__global    float4  *input,
+                        __global    float4  *output,
+                        __constant  float   *filter_ws,
+                                    int     filter_size)
+{
+    int2 pos = {get_global_id(0), get_global_id(1)};
+    int2 g_size = {get_global_size(0), get_global_size(1)};
+    int index = pos.y * g_size.x + pos.x;
+    
+    int half_filter_size = filter_size/2;
+    float4 response = (float4)0.0f;
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (g_size.x - half_filter_size))
+       )
+    {
+        for(int c = -half_filter_size; c <= half_filter_size; c += 1)
+        {
+            response += input[index + c] * (float4)filter_ws[c + half_filter_size];
+        }
+    }
+    
+    output[index] = response;
+}
+
+/* Second pass of a separable filter: convolve the row pass output along columns
+ * with the column weights held in filter_ws[filter_size .. 2*filter_size-1] and
+ * apply the threshold. Same boundary band as Filter.
+ */
+__kernel void FilterColumn(__global    float4  *input,
+                           __global    float4  *output,
+                           __constant  float   *filter_ws,
+                                       float   threshold,
+                                       int     filter_size)
+{
+    int2 pos = {get_global_id(0), get_global_id(1)};
+    int2 g_size = {get_global_size(0), get_global_size(1)};
+    int index = pos.y * g_size.x + pos.x;
+    
+    int half_filter_size = filter_size/2;
+    float4 response = (float4)0.0f;
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (g_size.x - half_filter_size))
+       && (pos.y >= half_filter_size)
+       && (pos.y <  (g_size.y - half_filter_size))
+       )
+    {
+        for(int r = -half_filter_size; r <= half_filter_size; r += 1)
+        {
+            response += input[index + r * g_size.x] * (float4)filter_ws[filter_size + r + half_filter_size];
+        }
     }
     
     /* Check compare threshold. */
     output[index] = (response > (float4)threshold) ? (float4)255 : (float4)0;
 }
+
+/* Filter on packed RGB bytes. */
+__kernel void FilterPacked(__global const uchar  *input,
+                           __global       uchar  *output,
+                           __constant     float  *filter_ws,
+                                          float  threshold,
+                                          int    filter_size)
+{
+    int2 pos = {get_global_id(0), get_global_id(1)};
+    int2 g_size = {get_global_size(0), get_global_size(1)};
+    int index = pos.y * g_size.x + pos.x;
+    
+    int half_filter_size = filter_size/2;
+    int filter_i = 0;
+    float4 response = (float4)0.0f;
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (g_size.x - half_filter_size))
+       && (pos.y >= half_filter_size)
+       && (pos.y <  (g_size.y - half_filter_size))
+       )
+    {
+        for(int r = -half_filter_size; r <= half_filter_size; r += 1)
+        {
+            int current_row = index + r * g_size.x;
+            for(int c = -half_filter_size; c <= half_filter_size; c += 1)
+            {
+                response += loadPackedPixel(input, current_row + c) * (float4)filter_ws[filter_i];
+                filter_i += 1;
+            }
+        }
+    }
+    
+    storePackedPixel(output, index, response, threshold);
+}
+
+/* FilterTiled on packed RGB bytes, the tile is expanded to float4 while loading. */
+__kernel void FilterTiledPacked(__global const uchar  *input,
+                                __global       uchar  *output,
+                                __constant     float  *filter_ws,
+                                               float  threshold,
+                                               int    filter_size,
+                                               int    width,
+                                               int    height,
+                                __local        float4 *tile)
+{
+    int2 pos    = {get_global_id(0), get_global_id(1)};
+    int2 l_pos  = {get_local_id(0), get_local_id(1)};
+    int2 l_size = {get_local_size(0), get_local_size(1)};
+    
+    int half_filter_size = filter_size/2;
+    int tile_width       = l_size.x + 2 * half_filter_size;
+    int tile_height      = l_size.y + 2 * half_filter_size;
+    int2 origin          = {get_group_id(0) * l_size.x - half_filter_size,
+                            get_group_id(1) * l_size.y - half_filter_size};
+    int filter_i = 0;
+    float4 response = (float4)0.0f;
+    
+    for(int ty = l_pos.y; ty < tile_height; ty += l_size.y)
+    {
+        int iy = origin.y + ty;
+        for(int tx = l_pos.x; tx < tile_width; tx += l_size.x)
+        {
+            int ix = origin.x + tx;
+            tile[ty * tile_width + tx] = ((ix >= 0) && (ix < width) && (iy >= 0) && (iy < height))
+                                         ? loadPackedPixel(input, iy * width + ix)
+                                         : (float4)0.0f;
+        }
+    }
+    
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    if((pos.x >= width) || (pos.y >= height))
+    {
+        return;
+    }
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (width - half_filter_size))
+       && (pos.y >= half_filter_size)
+       && (pos.y <  (height - half_filter_size))
+       )
+    {
+        for(int r = 0; r < filter_size; r += 1)
+        {
+            int current_row = (l_pos.y + r) * tile_width + l_pos.x;
+            for(int c = 0; c < filter_size; c += 1)
+            {
+                response += tile[current_row + c] * (float4)filter_ws[filter_i];
+                filter_i += 1;
+            }
+        }
+    }
+    
+    storePackedPixel(output, pos.y * width + pos.x, response, threshold);
+}
+
+/* FilterRow reading packed RGB bytes, the intermediate image stays float4. */
+__kernel void FilterRowPacked(__global const uchar  *input,
+                              __global       float4 *output,
+                              __constant     float  *filter_ws,
+                                             int    filter_size)
+{
+    int2 pos = {get_global_id(0), get_global_id(1)};
+    int2 g_size = {get_global_size(0), get_global_size(1)};
+    int index = pos.y * g_size.x + pos.x;
+    
+    int half_filter_size = filter_size/2;
+    float4 response = (float4)0.0f;
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (g_size.x - half_filter_size))
+       )
+    {
+        for(int c = -half_filter_size; c <= half_filter_size; c += 1)
+        {
+            response += loadPackedPixel(input, index + c) * (float4)filter_ws[c + half_filter_size];
+        }
+    }
+    
+    output[index] = response;
+}
+
+/* FilterColumn writing packed RGB bytes. */
+__kernel void FilterColumnPacked(__global const float4 *input,
+                                 __global       uchar  *output,
+                                 __constant     float  *filter_ws,
+                                                float  threshold,
+                                                int    filter_size)
+{
+    int2 pos = {get_global_id(0), get_global_id(1)};
+    int2 g_size = {get_global_size(0), get_global_size(1)};
+    int index = pos.y * g_size.x + pos.x;
+    
+    int half_filter_size = filter_size/2;
+    float4 response = (float4)0.0f;
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (g_size.x - half_filter_size))
+       && (pos.y >= half_filter_size)
+       && (pos.y <  (g_size.y - half_filter_size))
+       )
+    {
+        for(int r = -half_filter_size; r <= half_filter_size; r += 1)
+        {
+            response += input[index + r * g_size.x] * (float4)filter_ws[filter_size + r + half_filter_size];
+        }
+    }
+    
+    storePackedPixel(output, index, response, threshold);
+}
+
+#ifdef __IMAGE_SUPPORT__
+/* Image backend: pixels live in an RGBA CL_UNORM_INT8 image and neighbours are
+ * fetched through the texture path with a clamp-to-edge sampler, so no window can
+ * read outside the image.
+ */
+__constant sampler_t filter_sampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+/* Expand packed RGB bytes into the RGBA image used by FilterImage. */
+__kernel void PackedToImage(__global const uchar     *input,
+                            __write_only   image2d_t output)
+{
+    int2 pos = {get_global_id(0), get_global_id(1)};
+    int index = pos.y * get_global_size(0) + pos.x;
+    
+    write_imagef(output, pos, loadPackedPixel(input, index) / 255.0f);
+}
+
+/* Filter reading an RGBA image and writing packed RGB bytes. The boundary band is
+ * kept identical to Filter, so both backends give the same output.
+ */
+__kernel void FilterImage(__read_only    image2d_t input,
+                          __global       uchar     *output,
+                          __constant     float     *filter_ws,
+                                         float     threshold,
+                                         int       filter_size)
+{
+    int2 pos = {get_global_id(0), get_global_id(1)};
+    int2 g_size = {get_global_size(0), get_global_size(1)};
+    int index = pos.y * g_size.x + pos.x;
+    
+    int half_filter_size = filter_size/2;
+    int filter_i = 0;
+    float4 response = (float4)0.0f;
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (g_size.x - half_filter_size))
+       && (pos.y >= half_filter_size)
+       && (pos.y <  (g_size.y - half_filter_size))
+       )
+    {
+        for(int r = -half_filter_size; r <= half_filter_size; r += 1)
+        {
+            for(int c = -half_filter_size; c <= half_filter_size; c += 1)
+            {
+                response += read_imagef(input, filter_sampler, pos + (int2)(c, r)) * (float4)filter_ws[filter_i];
+                filter_i += 1;
+            }
+        }
+    }
+    
+    /* Back from normalized [0, 1] to the [0, 255] range of the threshold. */
+    storePackedPixel(output, index, response * 255.0f, threshold);
+}
+#endif /* __IMAGE_SUPPORT__ */
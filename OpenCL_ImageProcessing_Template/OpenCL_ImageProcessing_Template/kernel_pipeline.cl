@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/* Image pipeline stage kernels. Every stage reads and writes float4 images of
+ * get_global_size(0) x get_global_size(1) pixels that stay on the device between
+ * stages, only packed RGB bytes or float4 pixels of the first input and the last
+ * output cross the bus.
+ */
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Keep in sync with IMAGE_ARITH_* of lib_image.h. */
+#define ARITH_ADD            0
+#define ARITH_SUBTRACT       1
+#define ARITH_MULTIPLY       2
+#define ARITH_ABS_DIFFERENCE 3
+
+/* Packed RGB bytes to float4 (alpha = 0), as loadPackedPixel of the filters.
+ */
+__kernel void UnpackPixels(__global const uchar  *input,
+                           __global       float4 *output)
+{
+    int index = get_global_id(1) * get_global_size(0) + get_global_id(0);
+    
+    output[index] = (float4)(convert_float3(vload3(index, input)), 0.0f);
+}
+
+/* float4 back to packed RGB bytes, rounded to nearest and saturated to 0..255.
+ */
+__kernel void PackPixels(__global const float4 *input,
+                         __global       uchar  *output)
+{
+    int index = get_global_id(1) * get_global_size(0) + get_global_id(0);
+    
+    vstore3(convert_uchar3_sat_rte(input[index].xyz), index, output);
+}
+
+/* Filter without the threshold: same summation order and zero boundary band, so a
+ * convolution followed by a threshold stage gives the output of Filter.
+ */
+__kernel void Convolve(__global const float4 *input,
+                       __global       float4 *output,
+                       __constant     float  *filter_ws,
+                                      int    filter_size)
+{
+    int2 pos = {get_global_id(0), get_global_id(1)};
+    int2 g_size = {get_global_size(0), get_global_size(1)};
+    int index = pos.y * g_size.x + pos.x;
+    
+    int half_filter_size = filter_size/2;
+    int filter_i = 0;
+    float4 response = (float4)0.0f;
+    
+    if(   (pos.x >= half_filter_size)
+       && (pos.x <  (g_size.x - half_filter_size))
+       && (pos.y >= half_filter_size)
+       && (pos.y <  (g_size.y - half_filter_size))
+       )
+    {
+        for(int r = -half_filter_size; r <= half_filter_size; r += 1)
+        {
+            int current_row = index + r * g_size.x;
+            for(int c = -half_filter_size; c <= half_filter_size; c += 1)
+            {
+                response += input[current_row + c] * (float4)filter_ws[filter_i];
+                filter_i += 1;
+            }
+        }
+    }
+    
+    output[index] = response;
+}
+
+/* 255 for every component above the threshold, 0 otherwise.
+ */
+__kernel void Threshold(__global const float4 *input,
+                        __global       float4 *output,
+                                       float  threshold)
+{
+    int index = get_global_id(1) * get_global_size(0) + get_global_id(0);
+    
+    output[index] = (input[index] > (float4)threshold) ? (float4)255 : (float4)0;
+}
+
+/* Affine colour conversion, each row holds the RGB weights of one output channel
+ * followed by its offset. Alpha is passed through.
+ */
+__kernel void ConvertColor(__global const float4 *input,
+                           __global       float4 *output,
+                                          float4 row_r,
+                                          float4 row_g,
+                                          float4 row_b)
+{
+    int    index = get_global_id(1) * get_global_size(0) + get_global_id(0);
+    float4 pixel = input[index];
+    
+    output[index] = (float4)(dot(row_r.xyz, pixel.xyz) + row_r.w,
+                             dot(row_g.xyz, pixel.xyz) + row_g.w,
+                             dot(row_b.xyz, pixel.xyz) + row_b.w,
+                             pixel.w);
+}
+
+/* Per component operation with a constant or with the pipeline input image. The
+ * operand buffer is only read when with_input is set.
+ */
+__kernel void Arithmetic(__global const float4 *input,
+                         __global const float4 *operand,
+                         __global       float4 *output,
+                                        int    operation,
+                                        float  value,
+                                        int    with_input)
+{
+    int    index = get_global_id(1) * get_global_size(0) + get_global_id(0);
+    float4 a     = input[index];
+    float4 b     = (with_input != 0) ? operand[index] : (float4)value;
+    float4 result;
+    
+    switch (operation)
+    {
+        case ARITH_ADD:
+            result = a + b;
+            break;
+        case ARITH_SUBTRACT:
+            result = a - b;
+            break;
+        case ARITH_MULTIPLY:
+            result = a * b;
+            break;
+        default:
+            result = fabs(a - b);
+            break;
+    }
+    
+    output[index] = result;
+}
@@ -1,17 +1,57 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <sys/stat.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
 
 #include "lib_opencl.h"
 #include "lib_image.h"
+#include "lib_image_host.h"
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-#define KERNEL_PRG_CNT 1
-#define IMAGE_KERNEL_LIST_NAMES {"Filter"}
+#define KERNEL_PRG_CNT 8
+#define IMAGE_KERNEL_LIST_NAMES {"Filter",       "FilterTiled",       "FilterRow",       "FilterColumn", \
+                                 "FilterPacked", "FilterTiledPacked", "FilterRowPacked", "FilterColumnPacked"}
+/* Kernel sources, the CMake build points them at the source tree. */
+#ifndef IMAGE_KERNEL_FILE_NAME
 #define IMAGE_KERNEL_FILE_NAME "/Users/marwanfaisal/Desktop/OpenCL-Templates/OpenCL_ImageProcessing_Template/OpenCL_ImageProcessing_Template/kernel_filter.cl"
+#endif
+
+/* Block DCT encoder kernels. */
+#define IMAGE_ENCODE_KERNEL_PRG_CNT     2
+#define IMAGE_ENCODE_KERNEL_LIST_NAMES  {"ConvertToYCbCr", "BlockDCTQuantize"}
+#ifndef IMAGE_ENCODE_KERNEL_FILE_NAME
+#define IMAGE_ENCODE_KERNEL_FILE_NAME "/Users/marwanfaisal/Desktop/OpenCL-Templates/OpenCL_ImageProcessing_Template/OpenCL_ImageProcessing_Template/kernel_encode.cl"
+#endif
+#define IMAGE_KERNEL_CONVERT_YCBCR      0
+#define IMAGE_KERNEL_BLOCK_DCT          1
+#define IMAGE_DCT_BLOCK_SIZE            8
+
+/* Image pipeline stage kernels. */
+#define IMAGE_PIPELINE_KERNEL_PRG_CNT    6
+#define IMAGE_PIPELINE_KERNEL_LIST_NAMES {"UnpackPixels", "PackPixels", "Convolve", "Threshold", "ConvertColor", "Arithmetic"}
+#ifndef IMAGE_PIPELINE_KERNEL_FILE_NAME
+#define IMAGE_PIPELINE_KERNEL_FILE_NAME "/Users/marwanfaisal/Desktop/OpenCL-Templates/OpenCL_ImageProcessing_Template/OpenCL_ImageProcessing_Template/kernel_pipeline.cl"
+#endif
+#define IMAGE_KERNEL_UNPACK_PIXELS       0
+#define IMAGE_KERNEL_PACK_PIXELS         1
+#define IMAGE_KERNEL_CONVOLVE            2
+#define IMAGE_KERNEL_THRESHOLD           3
+#define IMAGE_KERNEL_CONVERT_COLOR       4
+#define IMAGE_KERNEL_ARITHMETIC          5
+
+/* Specialised pipeline kernels generated at runtime: filters up to
+ * IMAGE_JIT_UNROLL_MAX_SIZE are fully unrolled, larger ones loop over a constant
+ * weight table. IMAGE_JIT_CACHE_SIZE specialisations stay built.
+ */
+#define IMAGE_JIT_CACHE_SIZE      16
+#define IMAGE_JIT_UNROLL_MAX_SIZE 7
+#define IMAGE_JIT_SOURCE_CHUNK    4096
 
 #define ERR_DEVICE_CONTEXT_CREATION_NOK 0
 #define ERR_KERNEL_OBJS_CREATION_NOK    1
@@ -20,11 +60,139 @@
 #define ERR_WRITE_BUFFER_NOK            4
 #define ERR_SETTING_ARGUMENTS_NOK       5
 #define ERR_READ_BUFFER_NOK             6
+#define ERR_COMMAND_QUEUE_CREATION_NOK  7
+#define ERR_ENQUEUE_KERNEL_NOK          8
+#define ERR_WAIT_FRAME_NOK              9
+#define ERR_PIPELINE_STAGE_NOK          10
 
 #define INFO_DEVICE_CONTEXT_CREATION_OK (ERR_DEVICE_CONTEXT_CREATION_NOK)
 #define INFO_KERNEL_OBJS_CREATION_NOK   (ERR_KERNEL_OBJS_CREATION_NOK)
 
-#define IMAGE_KERNEL_FILTER 0
+#define IMAGE_KERNEL_FILTER       0
+#define IMAGE_KERNEL_FILTER_TILED 1
+#define IMAGE_KERNEL_FILTER_ROW    2
+#define IMAGE_KERNEL_FILTER_COLUMN 3
+
+/* Packed RGB variants follow the float4 kernels in the same order. */
+#define IMAGE_KERNEL_PACKED_OFFSET 4
+
+/* Image backend kernels, only built when the device supports images. */
+#define IMAGE_BACKEND_KERNEL_PRG_CNT      2
+#define IMAGE_BACKEND_KERNEL_LIST_NAMES   {"PackedToImage", "FilterImage"}
+#define IMAGE_KERNEL_PACKED_TO_IMAGE      0
+#define IMAGE_KERNEL_FILTER_IMAGE         1
+
+/* Smallest filter for which the local memory tiled kernel is used, and its
+ * preferred work-group edge (halved until the device accepts it).
+ */
+#define IMAGE_TILED_FILTER_MIN_SIZE 5
+#define IMAGE_TILED_WORK_GROUP_EDGE 16
+
+/* Rank-1 filters from this size up run as a row pass and a column pass. For 3x3
+ * filters the extra intermediate image costs more than the 9 to 6 saving.
+ */
+#define IMAGE_SEPARABLE_FILTER_MIN_SIZE 5
+#define IMAGE_SEPARABLE_FILTER_MAX_SIZE 31
+#define IMAGE_SEPARABLE_TOLERANCE       1e-5f
+
+#define IMAGE_BUFFER_POOL_SIZE   16
+#define IMAGE_BUFFER_MIN_BUCKET  4096
+
+#define IMAGE_FRAMES_IN_FLIGHT   2
+
+/* Blocking filter calls split frames into row bands across devices when every
+ * device gets at least IMAGE_SPLIT_MIN_ROWS rows.
+ */
+#define IMAGE_MAX_DEVICES        8
+#define IMAGE_SPLIT_MIN_ROWS     64
+#define IMAGE_BAND_BUFFER_CNT    4
+
+/* Device auto-selection times IMAGE_CALIBRATION_RUNS launches of the plain filter
+ * on an IMAGE_CALIBRATION_EDGE square image.
+ */
+#define IMAGE_CALIBRATION_EDGE        512
+#define IMAGE_CALIBRATION_FILTER_SIZE 5
+#define IMAGE_CALIBRATION_RUNS        5
+
+/* Frames with at most IMAGE_HOST_FILTER_MAX_OPS multiply-adds are filtered on the
+ * host, the transfers would cost more than the filter.
+ */
+#define IMAGE_HOST_FILTER_MAX_OPS     (1 << 20)
+
+typedef struct {
+    cl_mem       buffer;
+    size_t       size;
+    cl_mem_flags flags;
+    cl_int       in_use;
+}image_pool_entry_t;
+
+typedef struct {
+    cl_mem   input_image_buffer;
+    cl_mem   output_image_buffer;
+    cl_mem   temp_image_buffer;
+    cl_mem   filter_w_buffer;
+    cl_float separable_ws[2 * IMAGE_SEPARABLE_FILTER_MAX_SIZE];
+    cl_mem   rgba_image;
+    cl_int   rgba_width;
+    cl_int   rgba_height;
+    cl_event write_event[2];
+    cl_event pre_kernel_event;  /* First pass of two pass filters, only when profiling. */
+    cl_event kernel_event;
+    cl_event read_event;
+    size_t   image_bytes;       /* Sizes and pixel counts reported with the events. */
+    size_t   temp_bytes;
+    size_t   filter_bytes;
+    size_t   output_bytes;
+    size_t   num_pixels;
+    size_t   output_pixels;
+    void     *mapped_output;    /* Mapped output of a zero-copy frame. */
+    cl_int   zero_copy;
+    cl_uint  sequence;
+    cl_int   busy;
+}image_frame_slot_t;
+
+typedef struct {
+    cl_device_id     device;
+    cl_context       context;
+    cl_command_queue split_queue;
+    cl_kernel        kernel_list[KERNEL_PRG_CNT];
+    cl_ulong         local_mem_size;
+    size_t           tiled_work_group_size;
+    double           throughput_prior;
+    double           rows_per_ms;
+    cl_mem           band_buffer[IMAGE_BAND_BUFFER_CNT];
+    size_t           band_buffer_size[IMAGE_BAND_BUFFER_CNT];
+}image_device_t;
+
+struct image_pipeline_s {
+    image_stage_t          stage[IMAGE_PIPELINE_MAX_STAGES];
+    cl_mem                 filter_buffer[IMAGE_PIPELINE_MAX_STAGES];  /* Convolution weights, created on the first device run. */
+    cl_int                 num_stages;
+    cl_command_queue       queue;                                     /* Profiling queue for the stage timings.               */
+    image_pipeline_stats_t stats;
+    cl_int                 jit;                                       /* Run specialised kernels, see imagePipelineSetJIT.    */
+    char                   *jit_source;                               /* Generated source, dropped when a stage is added.     */
+    cl_int                 num_groups;                                /* Stages fused into one kernel each:                   */
+    cl_int                 group_first[IMAGE_PIPELINE_MAX_STAGES];    /* first stage,                                          */
+    cl_int                 group_last[IMAGE_PIPELINE_MAX_STAGES];     /* last stage,                                           */
+    cl_int                 group_conv[IMAGE_PIPELINE_MAX_STAGES];     /* convolution stage or -1.                              */
+};
+
+/* Built specialisation, found by its source. */
+typedef struct {
+    char      *source;
+    cl_kernel kernel_list[IMAGE_PIPELINE_MAX_STAGES];
+    cl_int    num_kernels;
+    cl_uint   last_use;
+}image_jit_entry_t;
+
+/* Growing source text, err is set once an allocation failed. */
+typedef struct {
+    char   *text;
+    size_t length;
+    size_t capacity;
+    cl_int err;
+}image_source_t;
 
 
 static volatile cl_device_id * dev_list = NULL;
@@ -32,14 +200,193 @@ static cl_int     dev_cnt = 0;
 
 static cl_context       image_context;
 static cl_command_queue image_cmd_queue;
+static cl_command_queue image_upload_queue;
+static cl_command_queue image_download_queue;
 static cl_kernel        image_kernel_list[KERNEL_PRG_CNT];
 
 static char * kernel_name_list[KERNEL_PRG_CNT] = IMAGE_KERNEL_LIST_NAMES;
+
+static cl_kernel image_backend_kernel_list[IMAGE_BACKEND_KERNEL_PRG_CNT];
+static char *    image_backend_kernel_name_list[IMAGE_BACKEND_KERNEL_PRG_CNT] = IMAGE_BACKEND_KERNEL_LIST_NAMES;
+static cl_bool   image_support = CL_FALSE;
+static cl_int    image_backend = IMAGE_BACKEND_AUTO;
+static cl_int    image_zero_copy_mode = IMAGE_ZERO_COPY_AUTO;
+static cl_int    image_zero_copy = 0;
+
+static image_pool_entry_t        image_buffer_pool[IMAGE_BUFFER_POOL_SIZE];
+static image_buffer_pool_stats_t image_buffer_pool_stats;
+
+static cl_kernel image_encode_kernel_list[IMAGE_ENCODE_KERNEL_PRG_CNT];
+static char *    image_encode_kernel_name_list[IMAGE_ENCODE_KERNEL_PRG_CNT] = IMAGE_ENCODE_KERNEL_LIST_NAMES;
+
+static cl_kernel    image_pipeline_kernel_list[IMAGE_PIPELINE_KERNEL_PRG_CNT];
+static char *       image_pipeline_kernel_name_list[IMAGE_PIPELINE_KERNEL_PRG_CNT] = IMAGE_PIPELINE_KERNEL_LIST_NAMES;
+static const char * image_pipeline_stage_name_list[4] = {"convolution", "threshold", "color conversion", "arithmetic"};
+
+static image_jit_entry_t       image_jit_cache[IMAGE_JIT_CACHE_SIZE];
+static image_jit_cache_stats_t image_jit_cache_stats;
+static cl_uint                 image_jit_clock = 0;
+
+/* JPEG Annex K quantization tables (quality 50), row major. */
+static const cl_int image_luma_quant_table[IMAGE_DCT_BLOCK_SIZE * IMAGE_DCT_BLOCK_SIZE] =
+{
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99
+};
+
+static const cl_int image_chroma_quant_table[IMAGE_DCT_BLOCK_SIZE * IMAGE_DCT_BLOCK_SIZE] =
+{
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+/* image_device[0] is the component device, it shares image_context and image_kernel_list. */
+static image_device_t image_device[IMAGE_MAX_DEVICES];
+static cl_int         image_num_devices = 0;
+static cl_int         image_auto_select = 0;
+static cl_int         image_device_ready = 0;
+
+static image_frame_slot_t image_frame_slot[IMAGE_FRAMES_IN_FLIGHT];
+static cl_int             image_next_slot = 0;
+static cl_uint            image_sequence  = 0;
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 static void printImageInfoMsg(int msg_id);
 static void printImageErrorMsg(int err_id);
+static size_t getBufferBucketSize(size_t size);
+static cl_mem imageAcquireBuffer(size_t size, cl_mem_flags flags, cl_int * const err);
+static void imageReleaseBuffer(cl_mem buffer);
+static void imageDrainBufferPool(void);
+static void imageProfileFrameSlot(const char * const component, image_frame_slot_t * const slot);
+static void imageReleaseFrameSlot(image_frame_slot_t * const slot);
+static void imageCompleteFrameSlot(image_frame_slot_t * const slot, cl_int * const err);
+static cl_int imageGetFilterLaunch(const image_device_t * const device,
+                                   cl_int         size,
+                                   cl_int         width,
+                                   cl_int         height,
+                                   size_t * const ret_global,
+                                   size_t * const ret_local,
+                                   size_t * const ret_tile_bytes);
+static cl_int imageGetSeparableFilter(const cl_float filter[],
+                                      cl_int         size,
+                                      cl_float       * const ret_ws);
+static void imageEnqueueFilterKernels(const image_device_t * const device,
+                                      cl_command_queue queue,
+                                      image_frame_slot_t * const slot,
+                                      cl_float       cmp_threshold,
+                                      cl_int         size,
+                                      cl_int         separable,
+                                      cl_int         packed,
+                                      cl_int         width,
+                                      cl_int         height,
+                                      cl_int         * const err);
+static void imageEnqueueImageFilterKernels(image_frame_slot_t * const slot,
+                                           cl_float       cmp_threshold,
+                                           cl_int         size,
+                                           cl_int         width,
+                                           cl_int         height,
+                                           cl_int         * const err);
+static void imageGetQuantTables(cl_int quality, cl_float * const ret_tables);
+static void imageGetDeviceLimits(image_device_t * const device);
+static double imageCalibrateDevice(cl_context       context,
+                                   cl_command_queue cmd_queue,
+                                   cl_device_id     device);
+static void imageReserveBandBuffer(image_device_t * const device,
+                                   cl_int         index,
+                                   size_t         size,
+                                   cl_int         * const err);
+static cl_int imageCanSplitFrame(const cl_float filter[],
+                                 cl_int         size,
+                                 cl_int         width,
+                                 cl_int         height,
+                                 cl_int         packed);
+static cl_int imageUseHostFilter(cl_int size, cl_int width, cl_int height);
+static void imageSplitFrame(cl_float      filter[],
+                            cl_float      cmp_threshold,
+                            cl_int        size,
+                            cl_int        width,
+                            cl_int        height,
+                            cl_int        packed,
+                            const void    * const input_pixels,
+                            void          * const ret_pixels,
+                            cl_int         * const err);
+static void imageSubmitFrame(cl_float      filter[],
+                             cl_float      cmp_threshold,
+                             cl_int        size,
+                             cl_int        width,
+                             cl_int        height,
+                             cl_int        packed,
+                             const void    * const input_pixels,
+                             void          * const ret_pixels,
+                             image_filter_ticket_t * const ret_ticket,
+                             cl_int         * const err);
+static double imageGetWallTimeMs(void);
+static void imageAddPipelineStage(image_pipeline_t    * const pipeline,
+                                  const image_stage_t * const stage,
+                                  cl_int              * const err);
+static void imageGetColorMatrix(cl_int conversion, cl_float * const ret_matrix);
+static void imageEnqueuePipelineStage(image_pipeline_t * const pipeline,
+                                      cl_int           index,
+                                      cl_mem           input_buffer,
+                                      cl_mem           pipeline_input_buffer,
+                                      cl_mem           output_buffer,
+                                      const size_t     * const global,
+                                      cl_event         wait_event,
+                                      cl_event         * const ret_event,
+                                      cl_int           * const err);
+static void imageAppendSource(image_source_t * const source,
+                              const char     * const format,
+                              ...);
+static void imageAppendStageSource(image_source_t      * const source,
+                                   const image_stage_t * const stage);
+static cl_int imageCanSpecialiseStage(const image_stage_t * const stage);
+static char * imageGeneratePipelineSource(image_pipeline_t * const pipeline);
+static cl_kernel * imageGetPipelineKernels(image_pipeline_t * const pipeline,
+                                           cl_int           * const err);
+static void imageEnqueueFusedKernel(image_pipeline_t * const pipeline,
+                                    cl_kernel        kernel,
+                                    cl_mem           input_buffer,
+                                    cl_mem           pipeline_input_buffer,
+                                    cl_mem           output_buffer,
+                                    const size_t     * const global,
+                                    cl_event         wait_event,
+                                    cl_event         * const ret_event,
+                                    cl_int           * const err);
+static void imageReleaseJITCache(void);
+static void imageRunPipelineDevice(image_pipeline_t * const pipeline,
+                                   cl_int           width,
+                                   cl_int           height,
+                                   cl_int           packed,
+                                   const void       * const input_pixels,
+                                   void             * const ret_pixels,
+                                   cl_int           * const err);
+static void imageRunPipelineHost(image_pipeline_t * const pipeline,
+                                 cl_int           width,
+                                 cl_int           height,
+                                 cl_int           packed,
+                                 const void       * const input_pixels,
+                                 void             * const ret_pixels,
+                                 cl_int           * const err);
+static void imageRunPipeline(image_pipeline_t * const pipeline,
+                             cl_int           width,
+                             cl_int           height,
+                             cl_int           packed,
+                             const void       * const input_pixels,
+                             void             * const ret_pixels,
+                             cl_int           * const err);
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -96,362 +443,3249 @@ static void printImageErrorMsg(int err_id)
             printf("Error Image processing component: Reading from buffer ... NOK.\n");
             break;
         }
+        case ERR_COMMAND_QUEUE_CREATION_NOK:
+        {
+            printf("Error Image processing component: Create transfer command queues ... NOK.\n");
+            break;
+        }
+        case ERR_ENQUEUE_KERNEL_NOK:
+        {
+            printf("Error Image processing component: Enqueue filter kernel ... NOK.\n");
+            break;
+        }
+        case ERR_WAIT_FRAME_NOK:
+        {
+            printf("Error Image processing component: Waiting for filtered frame ... NOK.\n");
+            break;
+        }
+        case ERR_PIPELINE_STAGE_NOK:
+        {
+            printf("Error Image processing component: Add pipeline stage ... NOK.\n");
+            break;
+        }
         default:
             break;
     }
 }
-//////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////////////////////////////
 
-void imageInit(const cl_device_id * const device_list,
-               cl_int               num_dev,
-               cl_int       * const ret_err)
+static size_t getBufferBucketSize(size_t size)
 {
-    /* Initialize dev_list value and device count.
-     */
-    dev_list = (volatile cl_device_id *)device_list;
-    dev_cnt  = num_dev;
-    
-    /* Get device list and if there is no avaliable device list then
-     * return CPU device and print a warning.
-     * Then create Context and Command queue for selected devices.
-     */
-    clCreateDeviceAndContext((cl_device_id * const )dev_list,
-                             dev_cnt,
-                             &image_context,
-                             &image_cmd_queue,
-                             ret_err);
+    size_t octave;
+    size_t step;
     
-    if (*ret_err != CL_SUCCESS)
+    if (size <= IMAGE_BUFFER_MIN_BUCKET)
     {
-        printImageInfoMsg(ERR_DEVICE_CONTEXT_CREATION_NOK);
-        return;
-    }
-    else
-    {
-        printImageInfoMsg(INFO_DEVICE_CONTEXT_CREATION_OK);
+        return (IMAGE_BUFFER_MIN_BUCKET);
     }
     
-    /* Create program and kernel objects.
-     */
-    clCreateKernelObjsForContext(&image_context,
-                                 (IMAGE_KERNEL_FILE_NAME),
-                                 (const char **)kernel_name_list,
-                                 (KERNEL_PRG_CNT),
-                                 image_kernel_list,
-                                 ret_err);
-    if (*ret_err != CL_SUCCESS)
+    /* Four buckets per power of two, so a recycled buffer wastes at most 25%. */
+    octave = IMAGE_BUFFER_MIN_BUCKET;
+    while ((octave << 1) <= size)
     {
-        printImageErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+        octave <<= 1;
     }
+    step = octave / 4;
+    
+    return (((size + step - 1) / step) * step);
 }
 
-void imageApplyFilter(cl_float      filter[],
-                      cl_float      cmp_threshold,
-                      cl_int        size,
-                      opencl_image_t * const input_image,
-                      opencl_image_t * const ret_image,
-                      cl_int         * const err)
+static cl_mem imageAcquireBuffer(size_t size, cl_mem_flags flags, cl_int * const err)
 {
-    cl_mem input_image_buffer;
-    cl_mem output_image_buffer;
-    cl_mem filter_w_buffer;
-    size_t global[3];
+    image_pool_entry_t *slot;
+    size_t             bucket;
+    cl_mem             buffer;
+    cl_int             i;
     
-    /* Setup image description. */
-    input_image_buffer = clCreateBuffer(image_context,
-                                        (CL_MEM_READ_WRITE),
-                                        (sizeof(opencl_pixel_t) * input_image->x * input_image->y),
-                                        NULL,
-                                        err);
+    bucket = getBufferBucketSize(size);
+    slot   = NULL;
     
-    if (*err != CL_SUCCESS)
+    image_buffer_pool_stats.acquire_count += 1;
+    
+    /* Look for an idle buffer of the same bucket and access flags. */
+    for (i = 0; i < IMAGE_BUFFER_POOL_SIZE; i += 1)
     {
-        free(input_image_buffer);
-        printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
-        return;
+        if (   (image_buffer_pool[i].buffer != NULL)
+            && (image_buffer_pool[i].in_use == 0)
+            && (image_buffer_pool[i].size   == bucket)
+            && (image_buffer_pool[i].flags  == flags))
+        {
+            image_buffer_pool[i].in_use = 1;
+            image_buffer_pool_stats.reuse_count += 1;
+            
+            *err = CL_SUCCESS;
+            return (image_buffer_pool[i].buffer);
+        }
     }
     
-    output_image_buffer = clCreateBuffer(image_context,
-                                         (CL_MEM_READ_WRITE),
-                                         (sizeof(opencl_pixel_t) * input_image->x * input_image->y),
-                                         NULL,
-                                         err);
-    
-    if (*err != CL_SUCCESS)
+    /* Take an empty slot, otherwise evict an idle buffer of another bucket. */
+    for (i = 0; (i < IMAGE_BUFFER_POOL_SIZE) && (slot == NULL); i += 1)
     {
-        free(output_image_buffer);
-        printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
-        return;
+        if (image_buffer_pool[i].buffer == NULL)
+        {
+            slot = &image_buffer_pool[i];
+        }
     }
     
-    filter_w_buffer = clCreateBuffer(image_context,
-                                     (CL_MEM_READ_ONLY),
-                                      sizeof(cl_float) * (size*size),
-                                     NULL,
-                                     err);
-    
-    if (*err != CL_SUCCESS)
+    for (i = 0; (i < IMAGE_BUFFER_POOL_SIZE) && (slot == NULL); i += 1)
     {
-        free(filter_w_buffer);
-        printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
-        return;
+        if (image_buffer_pool[i].in_use == 0)
+        {
+            slot = &image_buffer_pool[i];
+            
+            clReleaseMemObject(slot->buffer);
+            image_buffer_pool_stats.live_buffers    -= 1;
+            image_buffer_pool_stats.bytes_allocated -= slot->size;
+            slot->buffer = NULL;
+        }
     }
-    /* Write input buffers to kernel. */
-    *err = 0;
-
-    /* Write image to kernel buffer. */
-    *err = clEnqueueWriteBuffer(image_cmd_queue,
-                                input_image_buffer,
-                                CL_TRUE,
-                                0,
-                                (input_image->x * input_image->y * sizeof(opencl_pixel_t)),
-                                (const void *)input_image->pixel,
-                                0,
-                                NULL,
-                                NULL);
-
-    /* Wait until copy is complete. */
-    clFinish(image_cmd_queue);
-    
-    /* Write filter weights to kernel buffer. */
-    *err |= clEnqueueWriteBuffer(image_cmd_queue,
-                                 filter_w_buffer,
-                                 CL_TRUE,
-                                 0,
-                                 (size * size * sizeof(cl_float)),
-                                 (const void *)filter,
-                                 0,
-                                 NULL,
-                                 NULL);
     
-    /* Wait until copy is complete. */
-    clFinish(image_cmd_queue);
+    buffer = clCreateBuffer(image_context,
+                            flags,
+                            bucket,
+                            NULL,
+                            err);
     
     if (*err != CL_SUCCESS)
     {
-        free(input_image_buffer);
-        free(output_image_buffer);
-        free(filter_w_buffer);
-        
-        printImageErrorMsg(ERR_WRITE_BUFFER_NOK);
-        return;
+        return (NULL);
     }
     
-    *err = 0;
-    
-    /* Setup the kernel arguments. */
-    *err |= clSetKernelArg(image_kernel_list[0], 0, sizeof (cl_mem),  &input_image_buffer);
-    *err |= clSetKernelArg(image_kernel_list[0], 1, sizeof (cl_mem),  &output_image_buffer);
-    *err |= clSetKernelArg(image_kernel_list[0], 2, sizeof (cl_mem),  &filter_w_buffer);
-    *err |= clSetKernelArg(image_kernel_list[0], 3, sizeof(cl_float), &cmp_threshold);
-    *err |= clSetKernelArg(image_kernel_list[0], 4, sizeof(cl_int),   &size);
+    image_buffer_pool_stats.create_count += 1;
     
-    if (*err != CL_SUCCESS)
+    /* Every slot is busy, hand out an unpooled buffer released on return. */
+    if (slot != NULL)
     {
-        free(input_image_buffer);
-        free(output_image_buffer);
-        free(filter_w_buffer);
+        slot->buffer = buffer;
+        slot->size   = bucket;
+        slot->flags  = flags;
+        slot->in_use = 1;
         
-        printImageErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
-        return;
+        image_buffer_pool_stats.live_buffers    += 1;
+        image_buffer_pool_stats.bytes_allocated += bucket;
+        
+        if (image_buffer_pool_stats.bytes_allocated > image_buffer_pool_stats.bytes_high_water_mark)
+        {
+            image_buffer_pool_stats.bytes_high_water_mark = image_buffer_pool_stats.bytes_allocated;
+        }
     }
     
-    /* Set global parameters. */
-    global[0] = input_image->x;
-    global[1] = input_image->y;
-    global[2] = 1;
-    
-    /* Execute command queue. */
-    *err = clEnqueueNDRangeKernel(image_cmd_queue,
-                                  image_kernel_list[IMAGE_KERNEL_FILTER],
-                                  2, /* 2-Dim. */
-                                  NULL,
-                                  global,
-                                  NULL,
-                                  0,
-                                  NULL,
-                                  NULL);
-    
-    /* Wait for command queue to finish. */
-    clFinish(image_cmd_queue);
-    
-    /* Read output buffer. */
-    *err |= clEnqueueReadBuffer(image_cmd_queue,
-                               output_image_buffer,
-                               CL_TRUE,
-                               0,
-                               (input_image->x * input_image->y * sizeof(opencl_pixel_t)),
-                               (void *)ret_image->pixel,
-                               0,
-                               NULL,
-                               NULL);
-    
-    /* Wait for read to be complete. */
-    clFinish(image_cmd_queue);
+    return (buffer);
+}
 
-    if (*err != CL_SUCCESS)
+static void imageReleaseBuffer(cl_mem buffer)
+{
+    cl_int i;
+    
+    if (buffer == NULL)
     {
-        printImageErrorMsg(ERR_READ_BUFFER_NOK);
         return;
     }
     
-    /* Clean buffers. */
-    clReleaseMemObject(input_image_buffer);
-    clReleaseMemObject(filter_w_buffer);
-    clReleaseMemObject(output_image_buffer);
+    for (i = 0; i < IMAGE_BUFFER_POOL_SIZE; i += 1)
+    {
+        if (image_buffer_pool[i].buffer == buffer)
+        {
+            image_buffer_pool[i].in_use = 0;
+            return;
+        }
+    }
     
-    *err = CL_SUCCESS;
+    clReleaseMemObject(buffer);
 }
 
-void imageGetRGBAFromPPM(opencl_image_t * const ret_image,
-                         ppm_image_t    * const ppm_image)
+static void imageDrainBufferPool(void)
 {
+    cl_int i;
     
-    for(cl_int i = 0; i < (ppm_image->x*ppm_image->y); i += 1)
+    for (i = 0; i < IMAGE_BUFFER_POOL_SIZE; i += 1)
     {
-        ret_image->pixel[i].blue  = (cl_float)ppm_image->pixel[i].blue;
-        ret_image->pixel[i].green = (cl_float)ppm_image->pixel[i].green;
-        ret_image->pixel[i].red   = (cl_float)ppm_image->pixel[i].red;
-        ret_image->pixel[i].alpha = (cl_float)0;
+        if (image_buffer_pool[i].buffer != NULL)
+        {
+            clReleaseMemObject(image_buffer_pool[i].buffer);
+        }
+        
+        image_buffer_pool[i].buffer = NULL;
+        image_buffer_pool[i].size   = 0;
+        image_buffer_pool[i].in_use = 0;
     }
+    
+    image_buffer_pool_stats.live_buffers    = 0;
+    image_buffer_pool_stats.bytes_allocated = 0;
 }
 
-void imageGetPPMFromRGBA(ppm_image_t * const ret_image,
-                         opencl_image_t * const rgba_image)
+static cl_int imageGetFilterLaunch(const image_device_t * const device,
+                                   cl_int         size,
+                                   cl_int         width,
+                                   cl_int         height,
+                                   size_t * const ret_global,
+                                   size_t * const ret_local,
+                                   size_t * const ret_tile_bytes)
 {
+    size_t edge;
     
-    for(cl_int i = 0; i < (rgba_image->x*rgba_image->y); i += 1)
+    ret_global[0] = width;
+    ret_global[1] = height;
+    ret_global[2] = 1;
+    
+    /* Small filters reuse too little data to pay for the tile load. */
+    if (size >= IMAGE_TILED_FILTER_MIN_SIZE)
     {
-        ret_image->pixel[i].blue  = (unsigned char)rgba_image->pixel[i].blue;
-        ret_image->pixel[i].green = (unsigned char)rgba_image->pixel[i].green;
-        ret_image->pixel[i].red   = (unsigned char)rgba_image->pixel[i].red;
+        for (edge = IMAGE_TILED_WORK_GROUP_EDGE; edge >= 4; edge /= 2)
+        {
+            *ret_tile_bytes = (edge + size - 1) * (edge + size - 1) * sizeof(opencl_pixel_t);
+            
+            if (   ((edge * edge) <= device->tiled_work_group_size)
+                && (*ret_tile_bytes <= device->local_mem_size))
+            {
+                /* Round the global size up to whole work-groups. */
+                ret_local[0]  = edge;
+                ret_local[1]  = edge;
+                ret_global[0] = ((width  + edge - 1) / edge) * edge;
+                ret_global[1] = ((height + edge - 1) / edge) * edge;
+                
+                return (IMAGE_KERNEL_FILTER_TILED);
+            }
+        }
     }
+    
+    *ret_tile_bytes = 0;
+    
+    return (IMAGE_KERNEL_FILTER);
 }
 
-void imageSavePPM(ppm_image_t * const input_image,
-                  const char * const output_image_filename)
+static cl_int imageGetSeparableFilter(const cl_float filter[],
+                                      cl_int         size,
+                                      cl_float       * const ret_ws)
 {
-    FILE *image_file_ptr;
+    cl_float max_weight;
+    cl_float tolerance;
+    cl_int   pivot_r;
+    cl_int   pivot_c;
+    cl_int   r;
+    cl_int   c;
     
-    image_file_ptr = fopen(output_image_filename, "wb");
+    /* Pivot on the largest weight: filter = column * row is rank-1 exactly when
+     * every weight equals column[r] * row[c] with row = filter[pivot_r][*] and
+     * column = filter[*][pivot_c] / filter[pivot_r][pivot_c].
+     */
+    max_weight = 0;
+    pivot_r    = 0;
+    pivot_c    = 0;
     
-    /* Open image output file. */
-    if (!image_file_ptr)
+    for (r = 0; r < size; r += 1)
     {
-        fprintf(stderr, "Unable to open file '%s'\n", output_image_filename);
-        exit(1);
+        for (c = 0; c < size; c += 1)
+        {
+            if (fabsf(filter[r * size + c]) > max_weight)
+            {
+                max_weight = fabsf(filter[r * size + c]);
+                pivot_r    = r;
+                pivot_c    = c;
+            }
+        }
     }
     
-    /* Write the header file for output image. */
-    fprintf(image_file_ptr, "P6\n");
+    if (max_weight == 0)
+    {
+        return (0);
+    }
     
-    /* Write comments. */
-    fprintf(image_file_ptr, "# Output image creation.\n");
+    /* ret_ws holds the row weights followed by the column weights. */
+    for (c = 0; c < size; c += 1)
+    {
+        ret_ws[c] = filter[pivot_r * size + c];
+    }
     
-    /* Write image size. */
-    fprintf(image_file_ptr, "%d %d\n", input_image->x, input_image->y);
+    for (r = 0; r < size; r += 1)
+    {
+        ret_ws[size + r] = filter[r * size + pivot_c] / filter[pivot_r * size + pivot_c];
+    }
     
-    /* Write RGB component depth. */
-    fprintf(image_file_ptr, "%d\n", RGB_COMPONENT_COLOR);
+    tolerance = IMAGE_SEPARABLE_TOLERANCE * max_weight;
     
-    /* Write pixels. */
-    fwrite(input_image->pixel, (3*input_image->x), input_image->y, image_file_ptr);
+    for (r = 0; r < size; r += 1)
+    {
+        for (c = 0; c < size; c += 1)
+        {
+            if (fabsf(filter[r * size + c] - (ret_ws[size + r] * ret_ws[c])) > tolerance)
+            {
+                return (0);
+            }
+        }
+    }
     
-    /* Close file. */
-    fclose(image_file_ptr);
+    return (1);
 }
 
-ppm_image_t * imageReadPPM(const char * const image_filename)
+static void imageEnqueueFilterKernels(const image_device_t * const device,
+                                      cl_command_queue queue,
+                                      image_frame_slot_t * const slot,
+                                      cl_float       cmp_threshold,
+                                      cl_int         size,
+                                      cl_int         separable,
+                                      cl_int         packed,
+                                      cl_int         width,
+                                      cl_int         height,
+                                      cl_int         * const err)
 {
-    char buffer[16];
-    FILE *image_file_ptr;
-    ppm_image_t *ret_image;
-    int c;
-    int rgb_cmp_color;
-    
-    /* Open image. */
-    image_file_ptr = fopen(image_filename, "rb");
+    cl_kernel kernel;
+    cl_int    kernel_id;
+    size_t    tile_bytes;
+    size_t    global[3];
+    size_t    local[3];
+    size_t    column_local[3];
+    cl_event  row_event;
+    cl_int    kernel_offset;
     
-    /* Allocate image. */
-    ret_image = (ppm_image_t *)malloc(sizeof(ppm_image_t));
+    kernel_offset = (packed != 0) ? IMAGE_KERNEL_PACKED_OFFSET : 0;
     
-    /* Try to open image. */
-    if (!image_file_ptr)
+    if (separable != 0)
     {
-        fprintf(stderr, "Unable to open file %s", image_filename);
-        exit(1);
-    }
-    /* Check if buffer out of size. */
-    else if(!fgets(buffer, sizeof(buffer), image_file_ptr))
-    {
-        perror(image_filename);
-        exit(1);
+        global[0] = width;
+        global[1] = height;
+        global[2] = 1;
+        
+        slot->temp_bytes = sizeof(opencl_pixel_t) * width * height;
+        
+        *err = 0;
+        
+        /* Row pass into the intermediate image, column pass and threshold into the output. */
+        kernel = device->kernel_list[kernel_offset + IMAGE_KERNEL_FILTER_ROW];
+        *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem), &slot->input_image_buffer);
+        *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem), &slot->temp_image_buffer);
+        *err |= clSetKernelArg(kernel, 2, sizeof (cl_mem), &slot->filter_w_buffer);
+        *err |= clSetKernelArg(kernel, 3, sizeof(cl_int),  &size);
+        
+        kernel = device->kernel_list[kernel_offset + IMAGE_KERNEL_FILTER_COLUMN];
+        *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem),  &slot->temp_image_buffer);
+        *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem),  &slot->output_image_buffer);
+        *err |= clSetKernelArg(kernel, 2, sizeof (cl_mem),  &slot->filter_w_buffer);
+        *err |= clSetKernelArg(kernel, 3, sizeof(cl_float), &cmp_threshold);
+        *err |= clSetKernelArg(kernel, 4, sizeof(cl_int),   &size);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+            return;
+        }
+        
+        /* Work-group sizes tuned per kernel, device and frame size. The column
+         * pass is tuned once the row pass filled the intermediate image.
+         */
+        clGetTunedWorkGroupSize(queue,
+                                device->kernel_list[kernel_offset + IMAGE_KERNEL_FILTER_ROW],
+                                2,
+                                global,
+                                2,
+                                slot->write_event,
+                                local);
+        
+        /* Both passes run on the in-order compute queue. */
+        row_event = NULL;
+        *err      = clEnqueueNDRangeKernel(queue,
+                                           device->kernel_list[kernel_offset + IMAGE_KERNEL_FILTER_ROW],
+                                           2, /* 2-Dim. */
+                                           NULL,
+                                           global,
+                                           (local[0] != 0) ? local : NULL,
+                                           2,
+                                           slot->write_event,
+                                           &row_event);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
+            return;
+        }
+        
+        clGetTunedWorkGroupSize(queue,
+                                device->kernel_list[kernel_offset + IMAGE_KERNEL_FILTER_COLUMN],
+                                2,
+                                global,
+                                1,
+                                &row_event,
+                                column_local);
+        
+        /* The row event is kept for profiling only. */
+        if (clGetProfilingEnable() != 0)
+        {
+            slot->pre_kernel_event = row_event;
+        }
+        else
+        {
+            clReleaseEvent(row_event);
+        }
+        
+        *err = clEnqueueNDRangeKernel(queue,
+                                      device->kernel_list[kernel_offset + IMAGE_KERNEL_FILTER_COLUMN],
+                                      2, /* 2-Dim. */
+                                      NULL,
+                                      global,
+                                      (column_local[0] != 0) ? column_local : NULL,
+                                      0,
+                                      NULL,
+                                      &slot->kernel_event);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
+        }
+        
+        return;
     }
-    /* Check if image is allocated. */
-    else if (!ret_image)
+    
+    /* Select plain or tiled filter kernel with its work-group size. */
+    kernel_id = imageGetFilterLaunch(device,
+                                     size,
+                                     width,
+                                     height,
+                                     global,
+                                     local,
+                                     &tile_bytes);
+    kernel    = device->kernel_list[kernel_offset + kernel_id];
+    
+    slot->temp_bytes = 0;
+    
+    *err = 0;
+    
+    /* Setup the kernel arguments, they are captured when the kernel is enqueued. */
+    *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem),  &slot->input_image_buffer);
+    *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem),  &slot->output_image_buffer);
+    *err |= clSetKernelArg(kernel, 2, sizeof (cl_mem),  &slot->filter_w_buffer);
+    *err |= clSetKernelArg(kernel, 3, sizeof(cl_float), &cmp_threshold);
+    *err |= clSetKernelArg(kernel, 4, sizeof(cl_int),   &size);
+    
+    if (kernel_id == IMAGE_KERNEL_FILTER_TILED)
     {
-        fprintf(stderr, "Unable to allocate memory\n");
-        exit(1);
+        *err |= clSetKernelArg(kernel, 5, sizeof(cl_int), &width);
+        *err |= clSetKernelArg(kernel, 6, sizeof(cl_int), &height);
+        *err |= clSetKernelArg(kernel, 7, tile_bytes,     NULL);
     }
-    /* Check image format. */
-    else if((buffer[0] != 'P') || (buffer[1] != '6'))
+    
+    if (*err != CL_SUCCESS)
     {
-        fprintf(stderr, "Invalid image format (must be 'P6')\n");
-        exit(1);
+        printImageErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        return;
     }
-    else
+    
+    /* The tiled kernel needs its tile work group, the plain one is tuned. */
+    if (kernel_id != IMAGE_KERNEL_FILTER_TILED)
     {
-        /* Do nothing. */
+        clGetTunedWorkGroupSize(queue, kernel, 2, global, 2, slot->write_event, local);
     }
     
+    /* Filter once both writes completed. */
+    *err = clEnqueueNDRangeKernel(queue,
+                                  kernel,
+                                  2, /* 2-Dim. */
+                                  NULL,
+                                  global,
+                                  (local[0] != 0) ? local : NULL,
+                                  2,
+                                  slot->write_event,
+                                  &slot->kernel_event);
     
-    /* Check for comments. */
-    c = getc(image_file_ptr);
-    while (c == '#')
+    if (*err != CL_SUCCESS)
     {
-        while (getc(image_file_ptr) != '\n');
-        c = getc(image_file_ptr);
+        printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
     }
-    ungetc(c, image_file_ptr);
+}
+
+static void imageEnqueueImageFilterKernels(image_frame_slot_t * const slot,
+                                           cl_float       cmp_threshold,
+                                           cl_int         size,
+                                           cl_int         width,
+                                           cl_int         height,
+                                           cl_int         * const err)
+{
+    cl_image_format image_format;
+    cl_image_desc   image_desc;
+    cl_kernel       kernel;
+    size_t          global[3];
     
-    /* Check on image size information. */
-    if (fscanf(image_file_ptr, "%d %d", &ret_image->x, &ret_image->y) != 2) {
-        fprintf(stderr, "Invalid image size (error loading '%s')\n", image_filename);
-        exit(1);
+    /* Keep the slot image while frames keep the same size. */
+    if (   (slot->rgba_image  != NULL)
+        && ((slot->rgba_width != width) || (slot->rgba_height != height)))
+    {
+        clReleaseMemObject(slot->rgba_image);
+        slot->rgba_image = NULL;
     }
-    /* Read RGB component. */
-    else if (fscanf(image_file_ptr, "%d", &rgb_cmp_color) != 1) {
-        fprintf(stderr, "Invalid rgb component (error loading '%s')\n", image_filename);
-        exit(1);
+    
+    if (slot->rgba_image == NULL)
+    {
+        image_format.image_channel_order     = CL_RGBA;
+        image_format.image_channel_data_type = CL_UNORM_INT8;
+        
+        memset(&image_desc, 0, sizeof(image_desc));
+        image_desc.image_type   = CL_MEM_OBJECT_IMAGE2D;
+        image_desc.image_width  = width;
+        image_desc.image_height = height;
+        
+        slot->rgba_image = clCreateImage(image_context,
+                                         CL_MEM_READ_WRITE,
+                                         &image_format,
+                                         &image_desc,
+                                         NULL,
+                                         err);
+        if (*err != CL_SUCCESS)
+        {
+            slot->rgba_image = NULL;
+            printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
+            return;
+        }
+        
+        slot->rgba_width  = width;
+        slot->rgba_height = height;
     }
-    else
+    
+    global[0] = width;
+    global[1] = height;
+    global[2] = 1;
+    
+    slot->temp_bytes = 4 * width * height;
+    
+    *err = 0;
+    
+    /* Expand the packed upload into the image, then filter through the sampler. */
+    kernel = image_backend_kernel_list[IMAGE_KERNEL_PACKED_TO_IMAGE];
+    *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem), &slot->input_image_buffer);
+    *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem), &slot->rgba_image);
+    
+    kernel = image_backend_kernel_list[IMAGE_KERNEL_FILTER_IMAGE];
+    *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem),  &slot->rgba_image);
+    *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem),  &slot->output_image_buffer);
+    *err |= clSetKernelArg(kernel, 2, sizeof (cl_mem),  &slot->filter_w_buffer);
+    *err |= clSetKernelArg(kernel, 3, sizeof(cl_float), &cmp_threshold);
+    *err |= clSetKernelArg(kernel, 4, sizeof(cl_int),   &size);
+    
+    if (*err != CL_SUCCESS)
     {
-        /* Do nothing. */
+        printImageErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        return;
     }
     
-    /* Check RBG component depth */
-    if (rgb_cmp_color!= RGB_COMPONENT_COLOR) {
-        fprintf(stderr, "'%s' does not have 8-bits components\n", image_filename);
-        exit(1);
+    *err  = clEnqueueNDRangeKernel(image_cmd_queue,
+                                   image_backend_kernel_list[IMAGE_KERNEL_PACKED_TO_IMAGE],
+                                   2, /* 2-Dim. */
+                                   NULL,
+                                   global,
+                                   NULL,
+                                   2,
+                                   slot->write_event,
+                                   (clGetProfilingEnable() != 0) ? &slot->pre_kernel_event : NULL);
+    
+    *err |= clEnqueueNDRangeKernel(image_cmd_queue,
+                                   image_backend_kernel_list[IMAGE_KERNEL_FILTER_IMAGE],
+                                   2, /* 2-Dim. */
+                                   NULL,
+                                   global,
+                                   NULL,
+                                   0,
+                                   NULL,
+                                   &slot->kernel_event);
+    
+    if (*err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
     }
+}
+
+static double imageCalibrateDevice(cl_context       context,
+                                   cl_command_queue cmd_queue,
+                                   cl_device_id     device)
+{
+    const char     *calibration_name_list[1] = {"Filter"};
+    cl_float       filter_ws[IMAGE_CALIBRATION_FILTER_SIZE * IMAGE_CALIBRATION_FILTER_SIZE];
+    cl_float       threshold = 0;
+    cl_int         filter_size = IMAGE_CALIBRATION_FILTER_SIZE;
+    cl_kernel      kernel;
+    cl_mem         buffer[3];
+    opencl_pixel_t *pixels;
+    size_t         global[2] = {IMAGE_CALIBRATION_EDGE, IMAGE_CALIBRATION_EDGE};
+    size_t         image_size;
+    struct timespec start_time;
+    struct timespec end_time;
+    double         elapsed_ms;
+    cl_int         buffer_err[3];
+    cl_int         err;
+    cl_bool        available = CL_FALSE;
+    cl_bool        compiler  = CL_FALSE;
+    cl_int         i;
     
-    while (fgetc(image_file_ptr) != '\n') ;
+    /* A device without a compiler cannot build Filter, it is not calibrated. */
+    clGetDeviceInfo(device, CL_DEVICE_AVAILABLE, sizeof(cl_bool), &available, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_COMPILER_AVAILABLE, sizeof(cl_bool), &compiler, NULL);
     
-    /* memory allocation for pixel data. */
-    ret_image->pixel = (ppm_pixel_t*)malloc(ret_image->x * ret_image->y * sizeof(ppm_pixel_t));
+    if ((available != CL_TRUE) || (compiler != CL_TRUE))
+    {
+        return (-1);
+    }
     
-    if (!ret_image) {
-        fprintf(stderr, "Unable to allocate memory\n");
-        exit(1);
+    clCreateKernelObjsForContext(&context,
+                                 (IMAGE_KERNEL_FILE_NAME),
+                                 calibration_name_list,
+                                 1,
+                                 &kernel,
+                                 &err);
+    if (err != CL_SUCCESS)
+    {
+        return (-1);
     }
     
-    /* read pixel data from file. */
-    if (fread(ret_image->pixel, (3 * ret_image->x), ret_image->y, image_file_ptr) != ret_image->y) {
-        fprintf(stderr, "Error loading image '%s'\n", image_filename);
-        exit(1);
+    for (i = 0; i < (IMAGE_CALIBRATION_FILTER_SIZE * IMAGE_CALIBRATION_FILTER_SIZE); i += 1)
+    {
+        filter_ws[i] = 1.0f / (IMAGE_CALIBRATION_FILTER_SIZE * IMAGE_CALIBRATION_FILTER_SIZE);
     }
     
-    fclose(image_file_ptr);
-    return (ret_image);
+    image_size = sizeof(opencl_pixel_t) * IMAGE_CALIBRATION_EDGE * IMAGE_CALIBRATION_EDGE;
+    pixels     = (opencl_pixel_t *)calloc(IMAGE_CALIBRATION_EDGE * IMAGE_CALIBRATION_EDGE, sizeof(opencl_pixel_t));
+    
+    if (pixels == NULL)
+    {
+        clReleaseKernel(kernel);
+        return (-1);
+    }
+    
+    buffer[0] = clCreateBuffer(context, (CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR), image_size, pixels, &buffer_err[0]);
+    buffer[1] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, image_size, NULL, &buffer_err[1]);
+    buffer[2] = clCreateBuffer(context, (CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR), sizeof(filter_ws), filter_ws, &buffer_err[2]);
+    
+    err  = buffer_err[0] | buffer_err[1] | buffer_err[2];
+    err |= clSetKernelArg(kernel, 0, sizeof(cl_mem),   &buffer[0]);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem),   &buffer[1]);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_mem),   &buffer[2]);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_float), &threshold);
+    err |= clSetKernelArg(kernel, 4, sizeof(cl_int),   &filter_size);
+    
+    /* One warm-up launch, then the timed launches including the download. */
+    elapsed_ms = -1;
+    
+    if (err == CL_SUCCESS)
+    {
+        err = clEnqueueNDRangeKernel(cmd_queue, kernel, 2, NULL, global, NULL, 0, NULL, NULL);
+        clFinish(cmd_queue);
+        
+        clock_gettime(CLOCK_MONOTONIC, &start_time);
+        
+        for (i = 0; (i < IMAGE_CALIBRATION_RUNS) && (err == CL_SUCCESS); i += 1)
+        {
+            err  = clEnqueueNDRangeKernel(cmd_queue, kernel, 2, NULL, global, NULL, 0, NULL, NULL);
+            err |= clEnqueueReadBuffer(cmd_queue, buffer[1], CL_TRUE, 0, image_size, pixels, 0, NULL, NULL);
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &end_time);
+        
+        if (err == CL_SUCCESS)
+        {
+            elapsed_ms = ((end_time.tv_sec - start_time.tv_sec) * 1000.0)
+                       + ((end_time.tv_nsec - start_time.tv_nsec) / 1000000.0);
+            elapsed_ms = elapsed_ms / IMAGE_CALIBRATION_RUNS;
+        }
+    }
+    
+    for (i = 0; i < 3; i += 1)
+    {
+        if (buffer_err[i] == CL_SUCCESS)
+        {
+            clReleaseMemObject(buffer[i]);
+        }
+    }
+    
+    clReleaseKernel(kernel);
+    free(pixels);
+    
+    return (elapsed_ms);
+}
+
+static void imageGetDeviceLimits(image_device_t * const device)
+{
+    /* Local memory and work-group limits for the tiled filter, and the work
+     * weight used until the first band of this device was timed.
+     */
+    clGetDeviceInfo(device->device,
+                    CL_DEVICE_LOCAL_MEM_SIZE,
+                    sizeof(cl_ulong),
+                    &device->local_mem_size,
+                    NULL);
+    
+    clGetKernelWorkGroupInfo(device->kernel_list[IMAGE_KERNEL_FILTER_TILED],
+                             device->device,
+                             CL_KERNEL_WORK_GROUP_SIZE,
+                             sizeof(size_t),
+                             &device->tiled_work_group_size,
+                             NULL);
+    
+    device->throughput_prior = clGetDeviceThroughputPrior(device->device);
+    device->rows_per_ms      = 0;
+}
+
+static void imageReserveBandBuffer(image_device_t * const device,
+                                   cl_int         index,
+                                   size_t         size,
+                                   cl_int         * const err)
+{
+    /* Band buffers are kept between frames and only grow. */
+    *err = CL_SUCCESS;
+    
+    if (size <= device->band_buffer_size[index])
+    {
+        return;
+    }
+    
+    if (device->band_buffer[index] != NULL)
+    {
+        clReleaseMemObject(device->band_buffer[index]);
+        device->band_buffer[index]      = NULL;
+        device->band_buffer_size[index] = 0;
+    }
+    
+    device->band_buffer[index] = clCreateBuffer(device->context,
+                                                CL_MEM_READ_WRITE,
+                                                size,
+                                                NULL,
+                                                err);
+    if (*err != CL_SUCCESS)
+    {
+        device->band_buffer[index] = NULL;
+        printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
+        return;
+    }
+    
+    device->band_buffer_size[index] = size;
+}
+
+static cl_int imageUseHostFilter(cl_int size, cl_int width, cl_int height)
+{
+    /* Without a device every frame is filtered on the host. */
+    return (   (image_device_ready == 0)
+            || (image_backend == IMAGE_BACKEND_HOST)
+            || (((size_t)width * height * size * size) <= IMAGE_HOST_FILTER_MAX_OPS));
+}
+
+static cl_int imageCanSplitFrame(const cl_float filter[],
+                                 cl_int         size,
+                                 cl_int         width,
+                                 cl_int         height,
+                                 cl_int         packed)
+{
+    /* Only frames the first device would filter with the buffer kernels are
+     * split, so every band runs the same per-pixel arithmetic as a single device.
+     */
+    if (   (imageUseHostFilter(size, width, height) != 0)
+        || (image_num_devices < 2)
+        || (image_device[0].split_queue == NULL)
+        || (height < (IMAGE_SPLIT_MIN_ROWS * image_num_devices)))
+    {
+        return (0);
+    }
+    
+    if (   (packed != 0)
+        && (image_support == CL_TRUE)
+        && (image_backend != IMAGE_BACKEND_BUFFER))
+    {
+        cl_float separable_ws[2 * IMAGE_SEPARABLE_FILTER_MAX_SIZE];
+        
+        return (   (size >= IMAGE_SEPARABLE_FILTER_MIN_SIZE)
+                && (size <= IMAGE_SEPARABLE_FILTER_MAX_SIZE)
+                && (imageGetSeparableFilter(filter, size, separable_ws) != 0));
+    }
+    
+    return (1);
+}
+
+static void imageSplitFrame(cl_float      filter[],
+                            cl_float      cmp_threshold,
+                            cl_int        size,
+                            cl_int        width,
+                            cl_int        height,
+                            cl_int        packed,
+                            const void    * const input_pixels,
+                            void          * const ret_pixels,
+                            cl_int         * const err)
+{
+    image_frame_slot_t band[IMAGE_MAX_DEVICES];
+    cl_float           separable_ws[2 * IMAGE_SEPARABLE_FILTER_MAX_SIZE];
+    const cl_float     *filter_ws;
+    size_t             filter_ws_size;
+    size_t             pixel_bytes;
+    size_t             num_rows[IMAGE_MAX_DEVICES];
+    double             weight[IMAGE_MAX_DEVICES];
+    cl_int             band_start[IMAGE_MAX_DEVICES];
+    cl_int             separable;
+    cl_int             half_filter_size;
+    cl_int             all_timed;
+    cl_int             num_enqueued;
+    cl_int             row;
+    cl_int             i;
+    
+    separable = (   (size >= IMAGE_SEPARABLE_FILTER_MIN_SIZE)
+                 && (size <= IMAGE_SEPARABLE_FILTER_MAX_SIZE)
+                 && (imageGetSeparableFilter(filter, size, separable_ws) != 0));
+    
+    filter_ws        = (separable != 0) ? separable_ws : filter;
+    filter_ws_size   = sizeof(cl_float) * ((separable != 0) ? (2 * size) : (size * size));
+    pixel_bytes      = (packed != 0) ? sizeof(ppm_pixel_t) : sizeof(opencl_pixel_t);
+    half_filter_size = size / 2;
+    
+    /* Weight the bands by measured rows per ms once every device was timed,
+     * by compute units times clock before that.
+     */
+    all_timed = 1;
+    
+    for (i = 0; i < image_num_devices; i += 1)
+    {
+        all_timed &= (image_device[i].rows_per_ms > 0);
+    }
+    
+    for (i = 0; i < image_num_devices; i += 1)
+    {
+        weight[i] = (all_timed != 0) ? image_device[i].rows_per_ms : image_device[i].throughput_prior;
+    }
+    
+    clGetWeightedSplit(weight, image_num_devices, (size_t)height, num_rows);
+    
+    /* Each band uploads half a filter of halo rows above and below, clipped to the
+     * image, so its output rows see exactly the pixels of the whole frame.
+     */
+    memset(band, 0, sizeof(band));
+    
+    *err         = CL_SUCCESS;
+    num_enqueued = 0;
+    row          = 0;
+    
+    for (i = 0; (i < image_num_devices) && (*err == CL_SUCCESS); i += 1)
+    {
+        image_device_t *device = &image_device[i];
+        cl_int          halo_start;
+        cl_int          halo_end;
+        cl_int          band_height;
+        
+        band_start[i] = row;
+        row          += (cl_int)num_rows[i];
+        
+        if (num_rows[i] == 0)
+        {
+            continue;
+        }
+        
+        halo_start  = ((band_start[i] - half_filter_size) > 0) ? (band_start[i] - half_filter_size) : 0;
+        halo_end    = ((row + half_filter_size) < height) ? (row + half_filter_size) : height;
+        band_height = halo_end - halo_start;
+        
+        imageReserveBandBuffer(device, 0, pixel_bytes * width * band_height, err);
+        
+        if (*err == CL_SUCCESS)
+        {
+            imageReserveBandBuffer(device, 1, pixel_bytes * width * band_height, err);
+        }
+        
+        if ((*err == CL_SUCCESS) && (separable != 0))
+        {
+            imageReserveBandBuffer(device, 2, sizeof(opencl_pixel_t) * width * band_height, err);
+        }
+        
+        if (*err == CL_SUCCESS)
+        {
+            imageReserveBandBuffer(device, 3, filter_ws_size, err);
+        }
+        
+        if (*err != CL_SUCCESS)
+        {
+            break;
+        }
+        
+        band[i].input_image_buffer  = device->band_buffer[0];
+        band[i].output_image_buffer = device->band_buffer[1];
+        band[i].temp_image_buffer   = device->band_buffer[2];
+        band[i].filter_w_buffer     = device->band_buffer[3];
+        band[i].image_bytes         = pixel_bytes * width * band_height;
+        band[i].filter_bytes        = filter_ws_size;
+        band[i].output_bytes        = pixel_bytes * width * num_rows[i];
+        band[i].num_pixels          = (size_t)width * band_height;
+        band[i].output_pixels       = (size_t)width * num_rows[i];
+        
+        /* Upload, filter and download the band on the device's in-order queue. The
+         * band counts as enqueued before its first write, so a failing second write
+         * still finishes the queue and releases the first write's event.
+         */
+        num_enqueued = i + 1;
+        
+        *err  = clEnqueueWriteBuffer(device->split_queue,
+                                     band[i].input_image_buffer,
+                                     CL_FALSE,
+                                     0,
+                                     pixel_bytes * width * band_height,
+                                     (const char *)input_pixels + (pixel_bytes * width * halo_start),
+                                     0,
+                                     NULL,
+                                     &band[i].write_event[0]);
+        
+        *err |= clEnqueueWriteBuffer(device->split_queue,
+                                     band[i].filter_w_buffer,
+                                     CL_FALSE,
+                                     0,
+                                     filter_ws_size,
+                                     (const void *)filter_ws,
+                                     0,
+                                     NULL,
+                                     &band[i].write_event[1]);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_WRITE_BUFFER_NOK);
+            break;
+        }
+        
+        imageEnqueueFilterKernels(device,
+                                  device->split_queue,
+                                  &band[i],
+                                  cmp_threshold,
+                                  size,
+                                  separable,
+                                  packed,
+                                  width,
+                                  band_height,
+                                  err);
+        
+        if (*err != CL_SUCCESS)
+        {
+            break;
+        }
+        
+        *err = clEnqueueReadBuffer(device->split_queue,
+                                   band[i].output_image_buffer,
+                                   CL_FALSE,
+                                   pixel_bytes * width * (band_start[i] - halo_start),
+                                   pixel_bytes * width * num_rows[i],
+                                   (char *)ret_pixels + (pixel_bytes * width * band_start[i]),
+                                   0,
+                                   NULL,
+                                   &band[i].read_event);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_READ_BUFFER_NOK);
+            break;
+        }
+        
+        clFlush(device->split_queue);
+    }
+    
+    /* Wait for every band, then update the per-device throughput from the
+     * device time between upload start and download end.
+     */
+    for (i = 0; i < num_enqueued; i += 1)
+    {
+        clFinish(image_device[i].split_queue);
+        
+        if ((*err == CL_SUCCESS) && (band[i].read_event != NULL))
+        {
+            double elapsed_ms = clGetEventElapsedMs(band[i].write_event[0], band[i].read_event);
+            
+            if (elapsed_ms > 0)
+            {
+                image_device[i].rows_per_ms = (image_device[i].rows_per_ms > 0)
+                                            ? (0.5 * image_device[i].rows_per_ms + 0.5 * (num_rows[i] / elapsed_ms))
+                                            : (num_rows[i] / elapsed_ms);
+            }
+        }
+        
+        imageProfileFrameSlot("image split", &band[i]);
+    }
+}
+
+static void imageProfileFrameSlot(const char * const component, image_frame_slot_t * const slot)
+{
+    size_t pass_bytes;
+    cl_int i;
+    
+    /* A first pass reads the upload into the intermediate image, the last pass
+     * reads the intermediate image when there is one.
+     */
+    pass_bytes = (slot->pre_kernel_event != NULL) ? slot->temp_bytes : slot->image_bytes;
+    
+    /* Zero-copy frames wrap the input instead of writing it and map the output. */
+    clProfileEvent(component,
+                   (slot->zero_copy != 0) ? "wrap image" : "write image",
+                   slot->write_event[0],
+                   (slot->zero_copy != 0) ? 0 : slot->image_bytes,
+                   slot->num_pixels);
+    clProfileEvent(component, "write filter", slot->write_event[1], slot->filter_bytes, 0);
+    clProfileEvent(component, "filter pass 1", slot->pre_kernel_event, slot->image_bytes + slot->temp_bytes, slot->num_pixels);
+    clProfileEvent(component, "filter", slot->kernel_event, pass_bytes + slot->output_bytes, slot->num_pixels);
+    clProfileEvent(component,
+                   (slot->zero_copy != 0) ? "map image" : "read image",
+                   slot->read_event,
+                   slot->output_bytes,
+                   slot->output_pixels);
+    
+    for (i = 0; i < 2; i += 1)
+    {
+        slot->write_event[i] = NULL;
+    }
+    
+    slot->pre_kernel_event = NULL;
+    slot->kernel_event     = NULL;
+    slot->read_event       = NULL;
+}
+
+static void imageReleaseFrameSlot(image_frame_slot_t * const slot)
+{
+    /* Events go to the profile, which releases them. */
+    imageProfileFrameSlot("image", slot);
+    
+    if (slot->mapped_output != NULL)
+    {
+        clEnqueueUnmapMemObject(image_download_queue, slot->output_image_buffer, slot->mapped_output, 0, NULL, NULL);
+        slot->mapped_output = NULL;
+    }
+    
+    imageReleaseBuffer(slot->input_image_buffer);
+    imageReleaseBuffer(slot->output_image_buffer);
+    imageReleaseBuffer(slot->temp_image_buffer);
+    imageReleaseBuffer(slot->filter_w_buffer);
+    
+    slot->input_image_buffer  = NULL;
+    slot->output_image_buffer = NULL;
+    slot->temp_image_buffer   = NULL;
+    slot->filter_w_buffer     = NULL;
+    slot->busy                = 0;
+}
+
+static void imageCompleteFrameSlot(image_frame_slot_t * const slot, cl_int * const err)
+{
+    *err = CL_SUCCESS;
+    
+    if (slot->busy == 0)
+    {
+        return;
+    }
+    
+    /* The read depends on the kernel which depends on both writes, so the read
+     * event completes the whole frame.
+     */
+    if (slot->read_event != NULL)
+    {
+        *err = clWaitForEvents(1, &slot->read_event);
+    }
+    
+    imageReleaseFrameSlot(slot);
+    
+    if (*err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_WAIT_FRAME_NOK);
+    }
+}
+
+static double imageGetWallTimeMs(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0);
+}
+
+static void imageAddPipelineStage(image_pipeline_t    * const pipeline,
+                                  const image_stage_t * const stage,
+                                  cl_int              * const err)
+{
+    if (pipeline->num_stages >= IMAGE_PIPELINE_MAX_STAGES)
+    {
+        printImageErrorMsg(ERR_PIPELINE_STAGE_NOK);
+        *err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    pipeline->stage[pipeline->num_stages]         = *stage;
+    pipeline->filter_buffer[pipeline->num_stages] = NULL;
+    pipeline->num_stages                         += 1;
+    
+    /* The generated source is out of date. */
+    free(pipeline->jit_source);
+    pipeline->jit_source = NULL;
+    
+    *err = CL_SUCCESS;
+}
+
+static void imageGetColorMatrix(cl_int conversion, cl_float * const ret_matrix)
+{
+    /* JFIF full range conversions, rows of R, G and B weights followed by the offset. */
+    static const cl_float gray_matrix[12] =
+    {
+        0.299f, 0.587f, 0.114f, 0.0f,
+        0.299f, 0.587f, 0.114f, 0.0f,
+        0.299f, 0.587f, 0.114f, 0.0f
+    };
+    static const cl_float ycbcr_matrix[12] =
+    {
+         0.299f,     0.587f,     0.114f,    0.0f,
+        -0.168736f, -0.331264f,  0.5f,      128.0f,
+         0.5f,      -0.418688f, -0.081312f, 128.0f
+    };
+    static const cl_float rgb_matrix[12] =
+    {
+        1.0f,  0.0f,       1.402f,    -179.456f,
+        1.0f, -0.344136f, -0.714136f,  135.458816f,
+        1.0f,  1.772f,     0.0f,      -226.816f
+    };
+    
+    switch (conversion)
+    {
+        case IMAGE_COLOR_RGB_TO_GRAY:
+        {
+            memcpy(ret_matrix, gray_matrix, sizeof(gray_matrix));
+            break;
+        }
+        case IMAGE_COLOR_RGB_TO_YCBCR:
+        {
+            memcpy(ret_matrix, ycbcr_matrix, sizeof(ycbcr_matrix));
+            break;
+        }
+        default:
+        {
+            memcpy(ret_matrix, rgb_matrix, sizeof(rgb_matrix));
+            break;
+        }
+    }
+}
+
+static void imageEnqueuePipelineStage(image_pipeline_t * const pipeline,
+                                      cl_int           index,
+                                      cl_mem           input_buffer,
+                                      cl_mem           pipeline_input_buffer,
+                                      cl_mem           output_buffer,
+                                      const size_t     * const global,
+                                      cl_event         wait_event,
+                                      cl_event         * const ret_event,
+                                      cl_int           * const err)
+{
+    const image_stage_t *stage = &pipeline->stage[index];
+    cl_kernel           kernel;
+    size_t              local[3];
+    
+    *err = 0;
+    
+    switch (stage->type)
+    {
+        case IMAGE_STAGE_CONVOLUTION:
+        {
+            kernel = image_pipeline_kernel_list[IMAGE_KERNEL_CONVOLVE];
+            *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem), &input_buffer);
+            *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem), &output_buffer);
+            *err |= clSetKernelArg(kernel, 2, sizeof (cl_mem), &pipeline->filter_buffer[index]);
+            *err |= clSetKernelArg(kernel, 3, sizeof(cl_int),  &stage->size);
+            break;
+        }
+        case IMAGE_STAGE_THRESHOLD:
+        {
+            kernel = image_pipeline_kernel_list[IMAGE_KERNEL_THRESHOLD];
+            *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem),  &input_buffer);
+            *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem),  &output_buffer);
+            *err |= clSetKernelArg(kernel, 2, sizeof(cl_float), &stage->value);
+            break;
+        }
+        case IMAGE_STAGE_COLOR:
+        {
+            kernel = image_pipeline_kernel_list[IMAGE_KERNEL_CONVERT_COLOR];
+            *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem),     &input_buffer);
+            *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem),     &output_buffer);
+            *err |= clSetKernelArg(kernel, 2, 4 * sizeof(cl_float), &stage->matrix[0]);
+            *err |= clSetKernelArg(kernel, 3, 4 * sizeof(cl_float), &stage->matrix[4]);
+            *err |= clSetKernelArg(kernel, 4, 4 * sizeof(cl_float), &stage->matrix[8]);
+            break;
+        }
+        default:
+        {
+            kernel = image_pipeline_kernel_list[IMAGE_KERNEL_ARITHMETIC];
+            *err |= clSetKernelArg(kernel, 0, sizeof (cl_mem),  &input_buffer);
+            *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem),  &pipeline_input_buffer);
+            *err |= clSetKernelArg(kernel, 2, sizeof (cl_mem),  &output_buffer);
+            *err |= clSetKernelArg(kernel, 3, sizeof(cl_int),   &stage->operation);
+            *err |= clSetKernelArg(kernel, 4, sizeof(cl_float), &stage->value);
+            *err |= clSetKernelArg(kernel, 5, sizeof(cl_int),   &stage->with_input);
+            break;
+        }
+    }
+    
+    if (*err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        return;
+    }
+    
+    clGetTunedWorkGroupSize(pipeline->queue, kernel, 2, global, 1, &wait_event, local);
+    
+    *err = clEnqueueNDRangeKernel(pipeline->queue,
+                                  kernel,
+                                  2, /* 2-Dim. */
+                                  NULL,
+                                  global,
+                                  (local[0] != 0) ? local : NULL,
+                                  0,
+                                  NULL,
+                                  ret_event);
+    
+    if (*err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
+    }
+}
+
+static void imageAppendSource(image_source_t * const source,
+                              const char     * const format,
+                              ...)
+{
+    va_list args;
+    int     length;
+    
+    if (source->err != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    va_start(args, format);
+    length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    
+    /* Grow by whole chunks, the text stays terminated. */
+    if ((source->length + length + 1) > source->capacity)
+    {
+        size_t capacity = source->capacity + ((length / IMAGE_JIT_SOURCE_CHUNK) + 1) * IMAGE_JIT_SOURCE_CHUNK;
+        char   *text    = (char *)realloc(source->text, capacity);
+        
+        if (text == NULL)
+        {
+            source->err = CL_OUT_OF_HOST_MEMORY;
+            return;
+        }
+        
+        source->text     = text;
+        source->capacity = capacity;
+    }
+    
+    va_start(args, format);
+    vsnprintf(&source->text[source->length], source->capacity - source->length, format, args);
+    va_end(args);
+    
+    source->length += length;
+}
+
+static void imageAppendStageSource(image_source_t      * const source,
+                                   const image_stage_t * const stage)
+{
+    const cl_float *m = stage->matrix;
+    
+    /* Point-wise stage on value at index, constants as exact hexadecimal literals. */
+    switch (stage->type)
+    {
+        case IMAGE_STAGE_THRESHOLD:
+        {
+            imageAppendSource(source, "    value = (value > (float4)(%af)) ? (float4)255.0f : (float4)0.0f;\n", (double)stage->value);
+            break;
+        }
+        case IMAGE_STAGE_COLOR:
+        {
+            imageAppendSource(source,
+                              "    value = (float4)(dot((float3)(%af, %af, %af), value.xyz) + %af,\n"
+                              "                     dot((float3)(%af, %af, %af), value.xyz) + %af,\n"
+                              "                     dot((float3)(%af, %af, %af), value.xyz) + %af,\n"
+                              "                     value.w);\n",
+                              (double)m[0], (double)m[1], (double)m[2],  (double)m[3],
+                              (double)m[4], (double)m[5], (double)m[6],  (double)m[7],
+                              (double)m[8], (double)m[9], (double)m[10], (double)m[11]);
+            break;
+        }
+        case IMAGE_STAGE_ARITHMETIC:
+        {
+            static const char * const format_list[4] =
+            {
+                "    value = value + %s;\n",
+                "    value = value - %s;\n",
+                "    value = value * %s;\n",
+                "    value = fabs(value - %s);\n"
+            };
+            char operand[64];
+            
+            if (stage->with_input != 0)
+            {
+                snprintf(operand, sizeof(operand), "pipeline_input[index]");
+            }
+            else
+            {
+                snprintf(operand, sizeof(operand), "(float4)(%af)", (double)stage->value);
+            }
+            
+            imageAppendSource(source, format_list[stage->operation], operand);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static cl_int imageCanSpecialiseStage(const image_stage_t * const stage)
+{
+    cl_int i;
+    
+    /* Infinities and NaNs have no literal, such pipelines keep the generic kernels. */
+    for (i = 0; (stage->type == IMAGE_STAGE_CONVOLUTION) && (i < (stage->size * stage->size)); i += 1)
+    {
+        if (isfinite(stage->filter[i]) == 0)
+        {
+            return (0);
+        }
+    }
+    
+    for (i = 0; i < 12; i += 1)
+    {
+        if (isfinite(stage->matrix[i]) == 0)
+        {
+            return (0);
+        }
+    }
+    
+    return (isfinite(stage->value) != 0);
+}
+
+static char * imageGeneratePipelineSource(image_pipeline_t * const pipeline)
+{
+    image_source_t source;
+    cl_int         g;
+    cl_int         i;
+    
+    for (i = 0; i < pipeline->num_stages; i += 1)
+    {
+        if (imageCanSpecialiseStage(&pipeline->stage[i]) == 0)
+        {
+            return (NULL);
+        }
+    }
+    
+    /* A kernel takes the point-wise stages up to a convolution, the convolution and
+     * the point-wise stages after it, the next convolution starts the next kernel.
+     * The stages before the convolution run on every tap it loads, which reads each
+     * pixel's value exactly as the separate stage would have written it.
+     */
+    pipeline->num_groups = 0;
+    
+    for (i = 0; i < pipeline->num_stages; )
+    {
+        g = pipeline->num_groups;
+        
+        pipeline->group_first[g] = i;
+        pipeline->group_conv[g]  = -1;
+        
+        for (; i < pipeline->num_stages; i += 1)
+        {
+            if (pipeline->stage[i].type == IMAGE_STAGE_CONVOLUTION)
+            {
+                if (pipeline->group_conv[g] >= 0)
+                {
+                    break;
+                }
+                
+                pipeline->group_conv[g] = i;
+            }
+        }
+        
+        pipeline->group_last[g] = i - 1;
+        pipeline->num_groups   += 1;
+    }
+    
+    memset(&source, 0, sizeof(source));
+    
+    imageAppendSource(&source, "/* Generated by the image component, %d stage(s) in %d kernel(s). */\n", pipeline->num_stages, pipeline->num_groups);
+    
+    for (g = 0; g < pipeline->num_groups; g += 1)
+    {
+        cl_int conv = pipeline->group_conv[g];
+        cl_int last = (conv >= 0) ? conv : (pipeline->group_last[g] + 1);
+        
+        /* Load with the stages before the convolution applied. */
+        imageAppendSource(&source,
+                          "\nfloat4 LoadFused%d(__global const float4 *input, __global const float4 *pipeline_input, int index)\n"
+                          "{\n"
+                          "    float4 value = input[index];\n",
+                          g);
+            
+        for (i = pipeline->group_first[g]; i < last; i += 1)
+        {
+            imageAppendSource(&source, "    /* Stage %d. */\n", i);
+            imageAppendStageSource(&source, &pipeline->stage[i]);
+        }
+            
+        imageAppendSource(&source, "    return (value);\n}\n");
+        
+        if ((conv >= 0) && (pipeline->stage[conv].size > IMAGE_JIT_UNROLL_MAX_SIZE))
+        {
+            const image_stage_t *stage = &pipeline->stage[conv];
+            
+            imageAppendSource(&source, "\n__constant float weights_fused%d[%d] =\n{", g, stage->size * stage->size);
+                
+            for (i = 0; i < (stage->size * stage->size); i += 1)
+            {
+                imageAppendSource(&source, "%s%s%af", (i > 0) ? "," : "", ((i % stage->size) == 0) ? "\n    " : " ", (double)stage->filter[i]);
+            }
+                
+            imageAppendSource(&source, "\n};\n");
+        }
+        
+        imageAppendSource(&source,
+                          "\n__kernel void Fused%d(__global const float4 *input,\n"
+                          "                     __global const float4 *pipeline_input,\n"
+                          "                     __global       float4 *output)\n"
+                          "{\n"
+                          "    int    width  = get_global_size(0);\n"
+                          "    int    height = get_global_size(1);\n"
+                          "    int    x      = get_global_id(0);\n"
+                          "    int    y      = get_global_id(1);\n"
+                          "    int    index  = y * width + x;\n",
+                          g);
+            
+        if (conv < 0)
+        {
+            imageAppendSource(&source, "    float4 value  = LoadFused%d(input, pipeline_input, index);\n", g);
+        }
+        else
+        {
+            const image_stage_t *stage = &pipeline->stage[conv];
+            cl_int               half  = stage->size / 2;
+                
+            /* Stage conv: same boundary band and r, c summation order as Convolve. */
+            imageAppendSource(&source,
+                              "    float4 value  = (float4)0.0f;\n"
+                              "    /* Stage %d. */\n"
+                              "    if ((x >= %d) && (x < (width - %d)) && (y >= %d) && (y < (height - %d)))\n"
+                              "    {\n",
+                              conv, half, half, half, half);
+                    
+            if (stage->size > IMAGE_JIT_UNROLL_MAX_SIZE)
+            {
+                imageAppendSource(&source,
+                                  "        for (int r = 0; r < %d; r += 1)\n"
+                                  "        {\n"
+                                  "            for (int c = 0; c < %d; c += 1)\n"
+                                  "            {\n"
+                                  "                value += LoadFused%d(input, pipeline_input, index + (r - %d) * width + (c - %d)) * (float4)weights_fused%d[r * %d + c];\n"
+                                  "            }\n"
+                                  "        }\n",
+                                  stage->size, stage->size, g, half, half, g, stage->size);
+            }
+            else
+            {
+                /* Zero weights add nothing to a finite response and are dropped. */
+                for (i = 0; i < (stage->size * stage->size); i += 1)
+                {
+                    if (stage->filter[i] != 0)
+                    {
+                        imageAppendSource(&source,
+                                          "        value += LoadFused%d(input, pipeline_input, index + (%d) * width + (%d)) * (float4)(%af);\n",
+                                          g,
+                                          (i / stage->size) - half,
+                                          (i % stage->size) - half,
+                                          (double)stage->filter[i]);
+                    }
+                }
+            }
+                    
+            imageAppendSource(&source, "    }\n");
+                
+            for (i = conv + 1; i <= pipeline->group_last[g]; i += 1)
+            {
+                imageAppendSource(&source, "    /* Stage %d. */\n", i);
+                imageAppendStageSource(&source, &pipeline->stage[i]);
+            }
+        }
+            
+        imageAppendSource(&source, "    output[index] = value;\n}\n");
+    }
+    
+    if (source.err != CL_SUCCESS)
+    {
+        free(source.text);
+        return (NULL);
+    }
+    
+    return (source.text);
+}
+
+static cl_kernel * imageGetPipelineKernels(image_pipeline_t * const pipeline,
+                                           cl_int           * const err)
+{
+    image_jit_entry_t *entry;
+    char              *kernel_name_list[IMAGE_PIPELINE_MAX_STAGES];
+    char              kernel_name[IMAGE_PIPELINE_MAX_STAGES][16];
+    cl_int            i;
+    
+    if (pipeline->jit_source == NULL)
+    {
+        pipeline->jit_source = imageGeneratePipelineSource(pipeline);
+        
+        if (pipeline->jit_source == NULL)
+        {
+            *err = CL_INVALID_VALUE;
+            return (NULL);
+        }
+    }
+    
+    image_jit_clock += 1;
+    
+    /* The source holds every stage parameter, so equal sources share kernels. */
+    for (i = 0; i < IMAGE_JIT_CACHE_SIZE; i += 1)
+    {
+        entry = &image_jit_cache[i];
+        
+        if ((entry->source != NULL) && (strcmp(entry->source, pipeline->jit_source) == 0))
+        {
+            entry->last_use = image_jit_clock;
+            image_jit_cache_stats.hit_count += 1;
+            
+            *err = CL_SUCCESS;
+            return (entry->kernel_list);
+        }
+    }
+    
+    /* Take an empty entry, otherwise evict the least recently used one. */
+    entry = &image_jit_cache[0];
+    
+    for (i = 0; i < IMAGE_JIT_CACHE_SIZE; i += 1)
+    {
+        if (image_jit_cache[i].source == NULL)
+        {
+            entry = &image_jit_cache[i];
+            break;
+        }
+        
+        if (image_jit_cache[i].last_use < entry->last_use)
+        {
+            entry = &image_jit_cache[i];
+        }
+    }
+    
+    if (entry->source != NULL)
+    {
+        for (i = 0; i < entry->num_kernels; i += 1)
+        {
+            clReleaseKernel(entry->kernel_list[i]);
+        }
+        
+        free(entry->source);
+        entry->source = NULL;
+        image_jit_cache_stats.live_entries -= 1;
+    }
+    
+    for (i = 0; i < pipeline->num_groups; i += 1)
+    {
+        snprintf(kernel_name[i], sizeof(kernel_name[i]), "Fused%d", i);
+        kernel_name_list[i] = kernel_name[i];
+    }
+    
+    /* Built like the file based kernels, the binary cache covers later processes. */
+    clCreateKernelObjsFromSource(&image_context,
+                                 pipeline->jit_source,
+                                 NULL,
+                                 (const char **)kernel_name_list,
+                                 pipeline->num_groups,
+                                 entry->kernel_list,
+                                 err);
+    
+    if (*err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+        return (NULL);
+    }
+    
+    entry->source = (char *)malloc(strlen(pipeline->jit_source) + 1);
+    
+    if (entry->source == NULL)
+    {
+        for (i = 0; i < pipeline->num_groups; i += 1)
+        {
+            clReleaseKernel(entry->kernel_list[i]);
+        }
+        
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    strcpy(entry->source, pipeline->jit_source);
+    
+    entry->num_kernels = pipeline->num_groups;
+    entry->last_use    = image_jit_clock;
+    
+    image_jit_cache_stats.miss_count   += 1;
+    image_jit_cache_stats.live_entries += 1;
+    
+    *err = CL_SUCCESS;
+    return (entry->kernel_list);
+}
+
+static void imageEnqueueFusedKernel(image_pipeline_t * const pipeline,
+                                    cl_kernel        kernel,
+                                    cl_mem           input_buffer,
+                                    cl_mem           pipeline_input_buffer,
+                                    cl_mem           output_buffer,
+                                    const size_t     * const global,
+                                    cl_event         wait_event,
+                                    cl_event         * const ret_event,
+                                    cl_int           * const err)
+{
+    size_t local[3];
+    
+    *err  = clSetKernelArg(kernel, 0, sizeof (cl_mem), &input_buffer);
+    *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem), &pipeline_input_buffer);
+    *err |= clSetKernelArg(kernel, 2, sizeof (cl_mem), &output_buffer);
+    
+    if (*err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        return;
+    }
+    
+    clGetTunedWorkGroupSize(pipeline->queue, kernel, 2, global, 1, &wait_event, local);
+    
+    *err = clEnqueueNDRangeKernel(pipeline->queue,
+                                  kernel,
+                                  2, /* 2-Dim. */
+                                  NULL,
+                                  global,
+                                  (local[0] != 0) ? local : NULL,
+                                  0,
+                                  NULL,
+                                  ret_event);
+    
+    if (*err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
+    }
+}
+
+static void imageReleaseJITCache(void)
+{
+    cl_int i;
+    cl_int j;
+    
+    for (i = 0; i < IMAGE_JIT_CACHE_SIZE; i += 1)
+    {
+        if (image_jit_cache[i].source != NULL)
+        {
+            for (j = 0; j < image_jit_cache[i].num_kernels; j += 1)
+            {
+                clReleaseKernel(image_jit_cache[i].kernel_list[j]);
+            }
+            
+            free(image_jit_cache[i].source);
+        }
+    }
+    
+    memset(image_jit_cache, 0, sizeof(image_jit_cache));
+    image_jit_cache_stats.live_entries = 0;
+}
+
+static void imageRunPipelineDevice(image_pipeline_t * const pipeline,
+                                   cl_int           width,
+                                   cl_int           height,
+                                   cl_int           packed,
+                                   const void       * const input_pixels,
+                                   void             * const ret_pixels,
+                                   cl_int           * const err)
+{
+    image_pipeline_stats_t *stats = &pipeline->stats;
+    cl_event               stage_event[IMAGE_PIPELINE_MAX_STAGES];
+    cl_event               write_event[2] = {NULL, NULL};  /* Upload, unpack.   */
+    cl_event               read_event[2]  = {NULL, NULL};  /* Pack, download.   */
+    cl_event               last_event;
+    cl_mem                 packed_buffer  = NULL;
+    cl_mem                 input_buffer   = NULL;
+    cl_mem                 ping_buffer[2] = {NULL, NULL};
+    cl_mem                 current_buffer;
+    cl_kernel              *fused_kernel_list = NULL;
+    size_t                 image_size;
+    size_t                 packed_size;
+    size_t                 num_pixels;
+    size_t                 global[3];
+    cl_int                 num_kernels;
+    cl_int                 num_enqueued = 0;
+    cl_int                 ret;
+    cl_int                 i;
+    
+    num_pixels  = (size_t)width * height;
+    image_size  = sizeof(opencl_pixel_t) * num_pixels;
+    packed_size = sizeof(ppm_pixel_t) * num_pixels;
+    
+    global[0] = width;
+    global[1] = height;
+    global[2] = 1;
+    
+    /* The pipeline's own in-order queue always profiles, its events give the
+     * stage timings whether or not the component queues profile.
+     */
+    if (pipeline->queue == NULL)
+    {
+        pipeline->queue = clCreateCommandQueue(image_context,
+                                               image_device[0].device,
+                                               CL_QUEUE_PROFILING_ENABLE,
+                                               err);
+        if (*err != CL_SUCCESS)
+        {
+            pipeline->queue = NULL;
+            printImageErrorMsg(ERR_COMMAND_QUEUE_CREATION_NOK);
+            return;
+        }
+    }
+    
+    /* Specialised kernels run one per group of fused stages. A pipeline they cannot
+     * be built for keeps the stage kernels from then on.
+     */
+    if ((pipeline->jit != 0) && (pipeline->num_stages > 0))
+    {
+        fused_kernel_list = imageGetPipelineKernels(pipeline, &ret);
+        
+        if (fused_kernel_list == NULL)
+        {
+            pipeline->jit = 0;
+        }
+    }
+    
+    num_kernels        = (fused_kernel_list != NULL) ? pipeline->num_groups : pipeline->num_stages;
+    stats->num_kernels = num_kernels;
+    
+    /* Weights are uploaded once and stay with the pipeline, fused kernels hold
+     * them as literals.
+     */
+    for (i = 0; (i < pipeline->num_stages) && (fused_kernel_list == NULL); i += 1)
+    {
+        image_stage_t *stage = &pipeline->stage[i];
+        
+        if ((stage->type == IMAGE_STAGE_CONVOLUTION) && (pipeline->filter_buffer[i] == NULL))
+        {
+            pipeline->filter_buffer[i] = clCreateBuffer(image_context,
+                                                        (CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR),
+                                                        sizeof(cl_float) * stage->size * stage->size,
+                                                        stage->filter,
+                                                        err);
+            if (*err != CL_SUCCESS)
+            {
+                pipeline->filter_buffer[i] = NULL;
+                printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
+                return;
+            }
+        }
+    }
+    
+    /* The input image stays untouched for arithmetic stages with_input, stages
+     * alternate between the two ping-pong buffers. Packed frames reuse the packed
+     * upload buffer for the packed output.
+     */
+    ret = CL_SUCCESS;
+    
+    if (packed != 0)
+    {
+        packed_buffer = imageAcquireBuffer(packed_size, CL_MEM_READ_WRITE, err);
+        ret          |= *err;
+    }
+    
+    input_buffer = imageAcquireBuffer(image_size, CL_MEM_READ_WRITE, err);
+    ret         |= *err;
+    
+    for (i = 0; (i < 2) && (i < num_kernels); i += 1)
+    {
+        ping_buffer[i] = imageAcquireBuffer(image_size, CL_MEM_READ_WRITE, err);
+        ret           |= *err;
+    }
+    
+    if (ret != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
+        *err = ret;
+    }
+    else
+    {
+        *err = clEnqueueWriteBuffer(pipeline->queue,
+                                    (packed != 0) ? packed_buffer : input_buffer,
+                                    CL_FALSE,
+                                    0,
+                                    (packed != 0) ? packed_size : image_size,
+                                    input_pixels,
+                                    0,
+                                    NULL,
+                                    &write_event[0]);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_WRITE_BUFFER_NOK);
+        }
+    }
+    
+    last_event = write_event[0];
+    
+    if ((*err == CL_SUCCESS) && (packed != 0))
+    {
+        cl_kernel kernel = image_pipeline_kernel_list[IMAGE_KERNEL_UNPACK_PIXELS];
+        
+        *err  = clSetKernelArg(kernel, 0, sizeof (cl_mem), &packed_buffer);
+        *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem), &input_buffer);
+        *err |= clEnqueueNDRangeKernel(pipeline->queue, kernel, 2, NULL, global, NULL, 0, NULL, &write_event[1]);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
+        }
+        
+        last_event = write_event[1];
+    }
+    
+    /* Every stage reads the output of the previous one on the device. */
+    current_buffer = input_buffer;
+    
+    for (i = 0; (i < num_kernels) && (*err == CL_SUCCESS); i += 1)
+    {
+        if (fused_kernel_list != NULL)
+        {
+            imageEnqueueFusedKernel(pipeline,
+                                    fused_kernel_list[i],
+                                    current_buffer,
+                                    input_buffer,
+                                    ping_buffer[i % 2],
+                                    global,
+                                    last_event,
+                                    &stage_event[i],
+                                    err);
+        }
+        else
+        {
+            imageEnqueuePipelineStage(pipeline,
+                                      i,
+                                      current_buffer,
+                                      input_buffer,
+                                      ping_buffer[i % 2],
+                                      global,
+                                      last_event,
+                                      &stage_event[i],
+                                      err);
+        }
+        
+        if (*err != CL_SUCCESS)
+        {
+            break;
+        }
+        
+        num_enqueued   = i + 1;
+        current_buffer = ping_buffer[i % 2];
+        last_event     = stage_event[i];
+    }
+    
+    if ((*err == CL_SUCCESS) && (packed != 0))
+    {
+        cl_kernel kernel = image_pipeline_kernel_list[IMAGE_KERNEL_PACK_PIXELS];
+        
+        *err  = clSetKernelArg(kernel, 0, sizeof (cl_mem), &current_buffer);
+        *err |= clSetKernelArg(kernel, 1, sizeof (cl_mem), &packed_buffer);
+        *err |= clEnqueueNDRangeKernel(pipeline->queue, kernel, 2, NULL, global, NULL, 0, NULL, &read_event[0]);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
+        }
+        
+        current_buffer = packed_buffer;
+    }
+    
+    if (*err == CL_SUCCESS)
+    {
+        *err = clEnqueueReadBuffer(pipeline->queue,
+                                   current_buffer,
+                                   CL_TRUE,
+                                   0,
+                                   (packed != 0) ? packed_size : image_size,
+                                   ret_pixels,
+                                   0,
+                                   NULL,
+                                   &read_event[1]);
+        
+        if (*err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_READ_BUFFER_NOK);
+        }
+    }
+    
+    /* Wait for the queue before returning the buffers to the pool. */
+    clFinish(pipeline->queue);
+    
+    if (*err == CL_SUCCESS)
+    {
+        stats->write_ms = clGetEventElapsedMs(write_event[0], (packed != 0) ? write_event[1] : write_event[0]);
+        stats->read_ms  = clGetEventElapsedMs((packed != 0) ? read_event[0] : read_event[1], read_event[1]);
+        
+        /* A fused kernel's time goes to the first of its stages. */
+        for (i = 0; i < num_enqueued; i += 1)
+        {
+            stats->stage_ms[(fused_kernel_list != NULL) ? pipeline->group_first[i] : i] = clGetEventElapsedMs(stage_event[i], stage_event[i]);
+        }
+    }
+    
+    /* Events go to the profile, which releases them. */
+    clProfileEvent("image pipeline", "write image", write_event[0], (packed != 0) ? packed_size : image_size, num_pixels);
+    clProfileEvent("image pipeline", "unpack", write_event[1], packed_size + image_size, num_pixels);
+    
+    for (i = 0; i < num_enqueued; i += 1)
+    {
+        if (fused_kernel_list != NULL)
+        {
+            size_t num_bytes = 2 * image_size;
+            cl_int j;
+            
+            for (j = pipeline->group_first[i]; j <= pipeline->group_last[i]; j += 1)
+            {
+                if (pipeline->stage[j].with_input != 0)
+                {
+                    num_bytes = 3 * image_size;
+                }
+            }
+            
+            clProfileEvent("image pipeline", "fused stages", stage_event[i], num_bytes, num_pixels);
+        }
+        else
+        {
+            clProfileEvent("image pipeline",
+                           image_pipeline_stage_name_list[pipeline->stage[i].type],
+                           stage_event[i],
+                           ((pipeline->stage[i].with_input != 0) ? 3 : 2) * image_size,
+                           num_pixels);
+        }
+    }
+    
+    clProfileEvent("image pipeline", "pack", read_event[0], image_size + packed_size, num_pixels);
+    clProfileEvent("image pipeline", "read image", read_event[1], (packed != 0) ? packed_size : image_size, num_pixels);
+    
+    imageReleaseBuffer(packed_buffer);
+    imageReleaseBuffer(input_buffer);
+    imageReleaseBuffer(ping_buffer[0]);
+    imageReleaseBuffer(ping_buffer[1]);
+}
+
+static void imageRunPipelineHost(image_pipeline_t * const pipeline,
+                                 cl_int           width,
+                                 cl_int           height,
+                                 cl_int           packed,
+                                 const void       * const input_pixels,
+                                 void             * const ret_pixels,
+                                 cl_int           * const err)
+{
+    image_pipeline_stats_t *stats = &pipeline->stats;
+    const opencl_pixel_t   *pipeline_input;
+    const opencl_pixel_t   *current;
+    opencl_pixel_t         *expanded       = NULL;
+    opencl_pixel_t         *ping_pixels[2] = {NULL, NULL};
+    size_t                 num_pixels;
+    double                 start_ms;
+    cl_int                 i;
+    
+    num_pixels = (size_t)width * height;
+    start_ms   = imageGetWallTimeMs();
+    
+    /* Same ping-pong scheme as the device, stage timings are wall times. */
+    if (packed != 0)
+    {
+        expanded = (opencl_pixel_t *)malloc(sizeof(opencl_pixel_t) * num_pixels);
+    }
+    
+    for (i = 0; (i < 2) && (i < pipeline->num_stages); i += 1)
+    {
+        ping_pixels[i] = (opencl_pixel_t *)malloc(sizeof(opencl_pixel_t) * num_pixels);
+    }
+    
+    if (   ((packed != 0) && (expanded == NULL))
+        || ((pipeline->num_stages > 0) && (ping_pixels[0] == NULL))
+        || ((pipeline->num_stages > 1) && (ping_pixels[1] == NULL)))
+    {
+        free(expanded);
+        free(ping_pixels[0]);
+        free(ping_pixels[1]);
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return;
+    }
+    
+    if (packed != 0)
+    {
+        imageHostUnpackPixels((const ppm_pixel_t *)input_pixels, expanded, num_pixels);
+    }
+    
+    pipeline_input  = (packed != 0) ? expanded : (const opencl_pixel_t *)input_pixels;
+    current         = pipeline_input;
+    stats->write_ms = imageGetWallTimeMs() - start_ms;
+    
+    *err = CL_SUCCESS;
+    
+    for (i = 0; (i < pipeline->num_stages) && (*err == CL_SUCCESS); i += 1)
+    {
+        double stage_start_ms = imageGetWallTimeMs();
+        
+        imageHostPipelineStage(&pipeline->stage[i],
+                               width,
+                               height,
+                               pipeline_input,
+                               current,
+                               ping_pixels[i % 2],
+                               err);
+        
+        current            = ping_pixels[i % 2];
+        stats->stage_ms[i] = imageGetWallTimeMs() - stage_start_ms;
+    }
+    
+    start_ms = imageGetWallTimeMs();
+    
+    if (*err == CL_SUCCESS)
+    {
+        if (packed != 0)
+        {
+            imageHostPackPixels(current, (ppm_pixel_t *)ret_pixels, num_pixels);
+        }
+        else if (current != ret_pixels)
+        {
+            memmove(ret_pixels, current, sizeof(opencl_pixel_t) * num_pixels);
+        }
+    }
+    
+    stats->read_ms = imageGetWallTimeMs() - start_ms;
+    
+    free(expanded);
+    free(ping_pixels[0]);
+    free(ping_pixels[1]);
+}
+
+static void imageRunPipeline(image_pipeline_t * const pipeline,
+                             cl_int           width,
+                             cl_int           height,
+                             cl_int           packed,
+                             const void       * const input_pixels,
+                             void             * const ret_pixels,
+                             cl_int           * const err)
+{
+    double start_ms;
+    
+    memset(&pipeline->stats, 0, sizeof(pipeline->stats));
+    
+    pipeline->stats.num_stages  = pipeline->num_stages;
+    pipeline->stats.num_kernels = pipeline->num_stages;
+    pipeline->stats.on_device   = ((image_device_ready != 0) && (image_backend != IMAGE_BACKEND_HOST));
+    
+    start_ms = imageGetWallTimeMs();
+    
+    if (pipeline->stats.on_device != 0)
+    {
+        imageRunPipelineDevice(pipeline, width, height, packed, input_pixels, ret_pixels, err);
+    }
+    else
+    {
+        imageRunPipelineHost(pipeline, width, height, packed, input_pixels, ret_pixels, err);
+    }
+    
+    pipeline->stats.total_ms = imageGetWallTimeMs() - start_ms;
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void imageInit(const cl_device_id * const device_list,
+               cl_int               num_dev,
+               cl_int       * const ret_err)
+{
+    cl_int i;
+    
+    /* Initialize dev_list value and device count.
+     */
+    dev_list = (volatile cl_device_id *)device_list;
+    dev_cnt  = num_dev;
+    
+    /* Get device list and if there is no avaliable device list then
+     * return CPU device and print a warning.
+     * Then create Context and Command queue for selected devices.
+     */
+    {
+        cl_device_id selected_device;
+        cl_int       err = !(CL_SUCCESS);
+        
+        /* In auto-selection mode the fastest device of a short filter calibration
+         * is used, falling back to the default choice when no device completes it.
+         */
+        if (image_auto_select != 0)
+        {
+            clSelectFastestDevice("image",
+                                  (cl_device_id * const)dev_list,
+                                  dev_cnt,
+                                  imageCalibrateDevice,
+                                  &selected_device,
+                                  &err);
+        }
+        
+        clCreateDeviceAndContext((err == CL_SUCCESS) ? &selected_device : (cl_device_id * const)dev_list,
+                                 (err == CL_SUCCESS) ? 1 : dev_cnt,
+                                 &image_context,
+                                 &image_cmd_queue,
+                                 ret_err);
+    }
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_DEVICE_CONTEXT_CREATION_NOK);
+        return;
+    }
+    else
+    {
+        printImageInfoMsg(INFO_DEVICE_CONTEXT_CREATION_OK);
+    }
+    
+    /* Create upload and download queues on the same device, so transfers of one
+     * frame can overlap the filter kernel of another.
+     */
+    {
+        cl_command_queue_properties properties;
+        cl_device_id                queue_device;
+        cl_int                      err;
+        
+        clGetCommandQueueInfo(image_cmd_queue,
+                              CL_QUEUE_DEVICE,
+                              sizeof(cl_device_id),
+                              &queue_device,
+                              NULL);
+        
+        properties = (clGetProfilingEnable() != 0) ? CL_QUEUE_PROFILING_ENABLE : 0;
+        
+        image_upload_queue = clCreateCommandQueue(image_context, queue_device, properties, ret_err);
+        image_download_queue = clCreateCommandQueue(image_context, queue_device, properties, &err);
+        
+        *ret_err |= err;
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_COMMAND_QUEUE_CREATION_NOK);
+            return;
+        }
+    }
+    
+    /* Create program and kernel objects.
+     */
+    clCreateKernelObjsForContext(&image_context,
+                                 (IMAGE_KERNEL_FILE_NAME),
+                                 (const char **)kernel_name_list,
+                                 (KERNEL_PRG_CNT),
+                                 image_kernel_list,
+                                 ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+        return;
+    }
+    
+    /* Create block DCT encoder kernel objects. */
+    clCreateKernelObjsForContext(&image_context,
+                                 (IMAGE_ENCODE_KERNEL_FILE_NAME),
+                                 (const char **)image_encode_kernel_name_list,
+                                 (IMAGE_ENCODE_KERNEL_PRG_CNT),
+                                 image_encode_kernel_list,
+                                 ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+        return;
+    }
+    
+    /* Create pipeline stage kernel objects. */
+    clCreateKernelObjsForContext(&image_context,
+                                 (IMAGE_PIPELINE_KERNEL_FILE_NAME),
+                                 (const char **)image_pipeline_kernel_name_list,
+                                 (IMAGE_PIPELINE_KERNEL_PRG_CNT),
+                                 image_pipeline_kernel_list,
+                                 ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+        return;
+    }
+    
+    /* The component device is the first split device. */
+    {
+        memset(image_device, 0, sizeof(image_device));
+        
+        clGetCommandQueueInfo(image_cmd_queue,
+                              CL_QUEUE_DEVICE,
+                              sizeof(cl_device_id),
+                              &image_device[0].device,
+                              NULL);
+        
+        image_device[0].context = image_context;
+        memcpy(image_device[0].kernel_list, image_kernel_list, sizeof(image_kernel_list));
+        
+        imageGetDeviceLimits(&image_device[0]);
+        
+        image_num_devices = 1;
+    }
+    
+    /* Create a context, queue and filter kernels on every other usable device, the
+     * blocking filter calls split frames into row bands across all of them.
+     */
+    {
+        cl_device_id     other_device[IMAGE_MAX_DEVICES];
+        cl_context       other_context[IMAGE_MAX_DEVICES];
+        cl_command_queue other_queue[IMAGE_MAX_DEVICES];
+        cl_int           num_other = 0;
+        cl_int           num_context = 0;
+        cl_int           err;
+        
+        for (i = 0; (i < dev_cnt) && (num_other < (IMAGE_MAX_DEVICES - 1)); i += 1)
+        {
+            if (device_list[i] != image_device[0].device)
+            {
+                other_device[num_other] = device_list[i];
+                num_other              += 1;
+            }
+        }
+        
+        clCreateContextPerDevice(other_device,
+                                 num_other,
+                                 CL_QUEUE_PROFILING_ENABLE,
+                                 other_context,
+                                 other_queue,
+                                 other_device,
+                                 &num_context,
+                                 &err);
+        
+        for (i = 0; i < num_context; i += 1)
+        {
+            image_device_t *device = &image_device[image_num_devices];
+            
+            clCreateKernelObjsForContext(&other_context[i],
+                                         (IMAGE_KERNEL_FILE_NAME),
+                                         (const char **)kernel_name_list,
+                                         (KERNEL_PRG_CNT),
+                                         device->kernel_list,
+                                         &err);
+            if (err != CL_SUCCESS)
+            {
+                /* Frames are simply not split onto a device that cannot build the filters. */
+                printImageErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+                clReleaseCommandQueue(other_queue[i]);
+                clReleaseContext(other_context[i]);
+                continue;
+            }
+            
+            device->device      = other_device[i];
+            device->context     = other_context[i];
+            device->split_queue = other_queue[i];
+            
+            imageGetDeviceLimits(device);
+            
+            image_num_devices += 1;
+        }
+        
+        /* The first device gets its own profiling queue for band timings. */
+        if (image_num_devices > 1)
+        {
+            image_device[0].split_queue = clCreateCommandQueue(image_context,
+                                                               image_device[0].device,
+                                                               CL_QUEUE_PROFILING_ENABLE,
+                                                               &err);
+            if (err != CL_SUCCESS)
+            {
+                printImageErrorMsg(ERR_COMMAND_QUEUE_CREATION_NOK);
+                image_device[0].split_queue = NULL;
+            }
+        }
+        
+        printf("Info Image processing component: Filter work split across %d device(s).\n",
+               (image_device[0].split_queue != NULL) ? image_num_devices : 1);
+    }
+    
+    /* Create image backend kernels when the device supports images. */
+    {
+        cl_device_id queue_device;
+        
+        clGetCommandQueueInfo(image_cmd_queue,
+                              CL_QUEUE_DEVICE,
+                              sizeof(cl_device_id),
+                              &queue_device,
+                              NULL);
+        
+        clGetDeviceInfo(queue_device,
+                        CL_DEVICE_IMAGE_SUPPORT,
+                        sizeof(cl_bool),
+                        &image_support,
+                        NULL);
+        
+        if (image_support == CL_TRUE)
+        {
+            clCreateKernelObjsForContext(&image_context,
+                                         (IMAGE_KERNEL_FILE_NAME),
+                                         (const char **)image_backend_kernel_name_list,
+                                         (IMAGE_BACKEND_KERNEL_PRG_CNT),
+                                         image_backend_kernel_list,
+                                         ret_err);
+            
+            /* The buffer backend still works without these kernels. */
+            if (*ret_err != CL_SUCCESS)
+            {
+                printImageErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+                image_support = CL_FALSE;
+                *ret_err      = CL_SUCCESS;
+            }
+        }
+    }
+    
+    /* Zero-copy is worth it when the device works on host memory directly. */
+    {
+        image_zero_copy = (   (image_zero_copy_mode == IMAGE_ZERO_COPY_ON)
+                           || (   (image_zero_copy_mode == IMAGE_ZERO_COPY_AUTO)
+                               && (clGetDeviceUnifiedMemory(image_device[0].device) == CL_TRUE)));
+        
+        printf("Info Image processing component: Zero-copy host buffers %s.\n", (image_zero_copy != 0) ? "enabled" : "disabled");
+    }
+    
+    image_device_ready = 1;
+}
+
+void imageDeinit(cl_int * const ret_err)
+{
+    cl_int i;
+    
+    if (image_device_ready == 0)
+    {
+        *ret_err = CL_SUCCESS;
+        return;
+    }
+    
+    image_device_ready = 0;
+    
+    /* Complete frames still in flight, then release pooled buffers, kernels,
+     * command queues and context.
+     */
+    for (i = 0; i < IMAGE_FRAMES_IN_FLIGHT; i += 1)
+    {
+        imageCompleteFrameSlot(&image_frame_slot[i], ret_err);
+    }
+    
+    imageDrainBufferPool();
+    
+    /* Release split devices, the first one shares the component context and kernels. */
+    for (i = 0; i < image_num_devices; i += 1)
+    {
+        image_device_t *device = &image_device[i];
+        cl_int          j;
+        
+        for (j = 0; j < IMAGE_BAND_BUFFER_CNT; j += 1)
+        {
+            if (device->band_buffer[j] != NULL)
+            {
+                clReleaseMemObject(device->band_buffer[j]);
+                device->band_buffer[j]      = NULL;
+                device->band_buffer_size[j] = 0;
+            }
+        }
+        
+        if (i > 0)
+        {
+            clCleanEnvironment(&device->context,
+                               &device->split_queue,
+                               device->kernel_list,
+                               KERNEL_PRG_CNT);
+        }
+        else if (device->split_queue != NULL)
+        {
+            clReleaseCommandQueue(device->split_queue);
+        }
+        
+        device->split_queue = NULL;
+    }
+    
+    image_num_devices = 0;
+    
+    for (i = 0; i < IMAGE_FRAMES_IN_FLIGHT; i += 1)
+    {
+        if (image_frame_slot[i].rgba_image != NULL)
+        {
+            clReleaseMemObject(image_frame_slot[i].rgba_image);
+            image_frame_slot[i].rgba_image = NULL;
+        }
+    }
+    
+    if (image_support == CL_TRUE)
+    {
+        for (i = 0; i < IMAGE_BACKEND_KERNEL_PRG_CNT; i += 1)
+        {
+            clReleaseKernel(image_backend_kernel_list[i]);
+        }
+    }
+    
+    for (i = 0; i < IMAGE_ENCODE_KERNEL_PRG_CNT; i += 1)
+    {
+        clReleaseKernel(image_encode_kernel_list[i]);
+    }
+    
+    for (i = 0; i < IMAGE_PIPELINE_KERNEL_PRG_CNT; i += 1)
+    {
+        clReleaseKernel(image_pipeline_kernel_list[i]);
+    }
+    
+    imageReleaseJITCache();
+    
+    clReleaseCommandQueue(image_upload_queue);
+    clReleaseCommandQueue(image_download_queue);
+    
+    clCleanEnvironment(&image_context,
+                       &image_cmd_queue,
+                       image_kernel_list,
+                       KERNEL_PRG_CNT);
+    
+    *ret_err = CL_SUCCESS;
+}
+
+void imageSetDeviceAutoSelect(cl_int enable)
+{
+    image_auto_select = enable;
+}
+
+void imageSetBackend(cl_int backend)
+{
+    image_backend = backend;
+}
+
+cl_int imageGetFilterBackend(const cl_float filter[],
+                             cl_int         size,
+                             cl_int         width,
+                             cl_int         height)
+{
+    cl_float separable_ws[2 * IMAGE_SEPARABLE_FILTER_MAX_SIZE];
+    
+    if (imageUseHostFilter(size, width, height) != 0)
+    {
+        return (IMAGE_BACKEND_HOST);
+    }
+    
+    /* Same choice as imageSubmitFrame, rank-1 filters always use buffers. */
+    if (   (image_support == CL_TRUE)
+        && (image_backend != IMAGE_BACKEND_BUFFER)
+        && (   (size < IMAGE_SEPARABLE_FILTER_MIN_SIZE)
+            || (size > IMAGE_SEPARABLE_FILTER_MAX_SIZE)
+            || (imageGetSeparableFilter(filter, size, separable_ws) == 0)))
+    {
+        return (IMAGE_BACKEND_IMAGE2D);
+    }
+    
+    return (IMAGE_BACKEND_BUFFER);
+}
+
+void imageSetZeroCopy(cl_int mode)
+{
+    image_zero_copy_mode = mode;
+}
+
+void imageGetBufferPoolStats(image_buffer_pool_stats_t * const ret_stats)
+{
+    *ret_stats = image_buffer_pool_stats;
+}
+
+void imageApplyFilter(cl_float      filter[],
+                      cl_float      cmp_threshold,
+                      cl_int        size,
+                      opencl_image_t * const input_image,
+                      opencl_image_t * const ret_image,
+                      cl_int         * const err)
+{
+    image_filter_ticket_t ticket;
+    
+    if (imageCanSplitFrame(filter, size, input_image->x, input_image->y, 0) != 0)
+    {
+        imageSplitFrame(filter,
+                        cmp_threshold,
+                        size,
+                        input_image->x,
+                        input_image->y,
+                        0,
+                        input_image->pixel,
+                        ret_image->pixel,
+                        err);
+        return;
+    }
+    
+    /* Synchronous filtering is one submitted frame waited on straight away. */
+    imageSubmitFilter(filter,
+                      cmp_threshold,
+                      size,
+                      input_image,
+                      ret_image,
+                      &ticket,
+                      err);
+    
+    if (*err != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    imageWaitFilter(&ticket, err);
+}
+
+void imageApplyFilterPPM(cl_float      filter[],
+                         cl_float      cmp_threshold,
+                         cl_int        size,
+                         ppm_image_t   * const input_image,
+                         ppm_image_t   * const ret_image,
+                         cl_int         * const err)
+{
+    image_filter_ticket_t ticket;
+    
+    if (imageCanSplitFrame(filter, size, input_image->x, input_image->y, 1) != 0)
+    {
+        imageSplitFrame(filter,
+                        cmp_threshold,
+                        size,
+                        input_image->x,
+                        input_image->y,
+                        1,
+                        input_image->pixel,
+                        ret_image->pixel,
+                        err);
+        return;
+    }
+    
+    imageSubmitFilterPPM(filter,
+                         cmp_threshold,
+                         size,
+                         input_image,
+                         ret_image,
+                         &ticket,
+                         err);
+    
+    if (*err != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    imageWaitFilter(&ticket, err);
+}
+
+void imageSubmitFilter(cl_float      filter[],
+                       cl_float      cmp_threshold,
+                       cl_int        size,
+                       opencl_image_t * const input_image,
+                       opencl_image_t * const ret_image,
+                       image_filter_ticket_t * const ret_ticket,
+                       cl_int         * const err)
+{
+    imageSubmitFrame(filter,
+                     cmp_threshold,
+                     size,
+                     input_image->x,
+                     input_image->y,
+                     0,
+                     input_image->pixel,
+                     ret_image->pixel,
+                     ret_ticket,
+                     err);
+}
+
+void imageSubmitFilterPPM(cl_float      filter[],
+                          cl_float      cmp_threshold,
+                          cl_int        size,
+                          ppm_image_t   * const input_image,
+                          ppm_image_t   * const ret_image,
+                          image_filter_ticket_t * const ret_ticket,
+                          cl_int         * const err)
+{
+    imageSubmitFrame(filter,
+                     cmp_threshold,
+                     size,
+                     input_image->x,
+                     input_image->y,
+                     1,
+                     input_image->pixel,
+                     ret_image->pixel,
+                     ret_ticket,
+                     err);
+}
+
+static void imageSubmitFrame(cl_float      filter[],
+                             cl_float      cmp_threshold,
+                             cl_int        size,
+                             cl_int        width,
+                             cl_int        height,
+                             cl_int        packed,
+                             const void    * const input_pixels,
+                             void          * const ret_pixels,
+                             image_filter_ticket_t * const ret_ticket,
+                             cl_int         * const err)
+{
+    image_frame_slot_t *slot;
+    const cl_float     *filter_ws;
+    size_t             filter_ws_size;
+    size_t             image_size;
+    size_t             temp_image_size;
+    cl_int             separable;
+    cl_mem_flags       host_flags;
+    
+    /* Packed frames move 3 bytes per pixel over the bus, the separable
+     * intermediate image stays float4 on the device.
+     */
+    temp_image_size = sizeof(opencl_pixel_t) * width * height;
+    image_size      = (packed != 0) ? (sizeof(ppm_pixel_t) * width * height) : temp_image_size;
+    
+    /* Small frames, or every frame without a device, are filtered on the host right
+     * away. The ticket's sequence 0 never matches a busy slot, so waiting on it
+     * returns immediately.
+     */
+    if (imageUseHostFilter(size, width, height) != 0)
+    {
+        imageHostFilter(filter,
+                        cmp_threshold,
+                        size,
+                        width,
+                        height,
+                        packed,
+                        input_pixels,
+                        ret_pixels,
+                        err);
+        
+        ret_ticket->slot     = 0;
+        ret_ticket->sequence = 0;
+        return;
+    }
+    
+    /* Take the next slot, completing the frame that still occupies it. */
+    slot = &image_frame_slot[image_next_slot];
+    
+    imageCompleteFrameSlot(slot, err);
+    
+    if (*err != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    /* Rank-1 filters run as two 1D passes, the slot keeps their weights alive
+     * until the upload completes.
+     */
+    separable = (   (size >= IMAGE_SEPARABLE_FILTER_MIN_SIZE)
+                 && (size <= IMAGE_SEPARABLE_FILTER_MAX_SIZE)
+                 && (imageGetSeparableFilter(filter, size, slot->separable_ws) != 0));
+    
+    filter_ws      = (separable != 0) ? slot->separable_ws : filter;
+    filter_ws_size = sizeof(cl_float) * ((separable != 0) ? (2 * size) : (size * size));
+    
+    slot->image_bytes   = image_size;
+    slot->filter_bytes  = filter_ws_size;
+    slot->output_bytes  = image_size;
+    slot->num_pixels    = (size_t)width * height;
+    slot->output_pixels = (size_t)width * height;
+    slot->zero_copy     = (   (image_zero_copy != 0)
+                           && (input_pixels != ret_pixels)
+                           && (clIsHostMemoryAligned(input_pixels) == CL_TRUE)
+                           && (clIsHostMemoryAligned(ret_pixels) == CL_TRUE));
+    
+    /* Setup image description. Zero-copy frames wrap the caller's pixels in
+     * unpooled buffers released with the frame, other buffers are taken from the
+     * image buffer pool and handed back to it once the frame completes.
+     */
+    host_flags = (image_zero_copy != 0) ? CL_MEM_ALLOC_HOST_PTR : 0;
+    
+    if (slot->zero_copy != 0)
+    {
+        slot->input_image_buffer = clCreateBuffer(image_context,
+                                                  (CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR),
+                                                  image_size,
+                                                  (void *)input_pixels,
+                                                  err);
+        
+        if (*err == CL_SUCCESS)
+        {
+            slot->output_image_buffer = clCreateBuffer(image_context,
+                                                       (CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR),
+                                                       image_size,
+                                                       ret_pixels,
+                                                       err);
+        }
+    }
+    else
+    {
+        slot->input_image_buffer = imageAcquireBuffer(image_size, (CL_MEM_READ_WRITE | host_flags), err);
+        
+        if (*err == CL_SUCCESS)
+        {
+            slot->output_image_buffer = imageAcquireBuffer(image_size, (CL_MEM_READ_WRITE | host_flags), err);
+        }
+    }
+    
+    if ((*err == CL_SUCCESS) && (separable != 0))
+    {
+        slot->temp_image_buffer = imageAcquireBuffer(temp_image_size, (CL_MEM_READ_WRITE), err);
+    }
+    
+    if (*err == CL_SUCCESS)
+    {
+        slot->filter_w_buffer = imageAcquireBuffer(filter_ws_size, (CL_MEM_READ_ONLY), err);
+    }
+    
+    if (*err != CL_SUCCESS)
+    {
+        imageReleaseFrameSlot(slot);
+        printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
+        return;
+    }
+    
+    /* Write image and filter weights on the upload queue without blocking. A
+     * wrapped input needs no write, a marker stands in for it.
+     */
+    if (slot->zero_copy != 0)
+    {
+        *err = clEnqueueMarkerWithWaitList(image_upload_queue, 0, NULL, &slot->write_event[0]);
+    }
+    else
+    {
+        *err = clEnqueueWriteBuffer(image_upload_queue,
+                                    slot->input_image_buffer,
+                                    CL_FALSE,
+                                    0,
+                                    image_size,
+                                    input_pixels,
+                                    0,
+                                    NULL,
+                                    &slot->write_event[0]);
+    }
+    
+    *err |= clEnqueueWriteBuffer(image_upload_queue,
+                                 slot->filter_w_buffer,
+                                 CL_FALSE,
+                                 0,
+                                 filter_ws_size,
+                                 (const void *)filter_ws,
+                                 0,
+                                 NULL,
+                                 &slot->write_event[1]);
+    
+    if (*err != CL_SUCCESS)
+    {
+        clFinish(image_upload_queue);
+        imageReleaseFrameSlot(slot);
+        printImageErrorMsg(ERR_WRITE_BUFFER_NOK);
+        return;
+    }
+    
+    /* Enqueue the filter kernels behind both writes. Packed 2D filters go through
+     * the image backend when the device supports it.
+     */
+    if (   (packed != 0)
+        && (separable == 0)
+        && (image_support == CL_TRUE)
+        && (image_backend != IMAGE_BACKEND_BUFFER))
+    {
+        imageEnqueueImageFilterKernels(slot,
+                                       cmp_threshold,
+                                       size,
+                                       width,
+                                       height,
+                                       err);
+    }
+    else
+    {
+        imageEnqueueFilterKernels(&image_device[0],
+                                  image_cmd_queue,
+                                  slot,
+                                  cmp_threshold,
+                                  size,
+                                  separable,
+                                  packed,
+                                  width,
+                                  height,
+                                  err);
+    }
+    
+    if (*err != CL_SUCCESS)
+    {
+        clFinish(image_upload_queue);
+        clFinish(image_cmd_queue);
+        imageReleaseFrameSlot(slot);
+        return;
+    }
+    
+    /* Read output buffer on the download queue once the kernel completed. Mapping
+     * a wrapped output makes the kernel results visible in ret_pixels.
+     */
+    if (slot->zero_copy != 0)
+    {
+        slot->mapped_output = clEnqueueMapBuffer(image_download_queue,
+                                                 slot->output_image_buffer,
+                                                 CL_FALSE,
+                                                 CL_MAP_READ,
+                                                 0,
+                                                 image_size,
+                                                 1,
+                                                 &slot->kernel_event,
+                                                 &slot->read_event,
+                                                 err);
+    }
+    else
+    {
+        *err = clEnqueueReadBuffer(image_download_queue,
+                                   slot->output_image_buffer,
+                                   CL_FALSE,
+                                   0,
+                                   image_size,
+                                   ret_pixels,
+                                   1,
+                                   &slot->kernel_event,
+                                   &slot->read_event);
+    }
+    
+    if (*err != CL_SUCCESS)
+    {
+        clFinish(image_cmd_queue);
+        imageReleaseFrameSlot(slot);
+        printImageErrorMsg(ERR_READ_BUFFER_NOK);
+        return;
+    }
+    
+    /* Submit all three stages to the device. */
+    clFlush(image_upload_queue);
+    clFlush(image_cmd_queue);
+    clFlush(image_download_queue);
+    
+    image_sequence += 1;
+    slot->sequence  = image_sequence;
+    slot->busy      = 1;
+    
+    ret_ticket->slot     = image_next_slot;
+    ret_ticket->sequence = image_sequence;
+    
+    image_next_slot = (image_next_slot + 1) % IMAGE_FRAMES_IN_FLIGHT;
+    
+    *err = CL_SUCCESS;
+}
+
+void imageWaitFilter(image_filter_ticket_t * const ticket,
+                     cl_int                * const err)
+{
+    image_frame_slot_t *slot;
+    
+    slot = &image_frame_slot[ticket->slot];
+    
+    /* A slot holding another sequence means this frame was already completed
+     * when its slot was reused.
+     */
+    if ((slot->busy == 0) || (slot->sequence != ticket->sequence))
+    {
+        *err = CL_SUCCESS;
+        return;
+    }
+    
+    imageCompleteFrameSlot(slot, err);
+}
+
+static void imageGetQuantTables(cl_int quality, cl_float * const ret_tables)
+{
+    cl_int scale;
+    cl_int value;
+    
+    /* IJG quality scaling of the JPEG Annex K tables, luma followed by chroma. */
+    quality = (quality < 1) ? 1 : ((quality > 100) ? 100 : quality);
+    scale   = (quality < 50) ? (5000 / quality) : (200 - 2 * quality);
+    
+    for (cl_int i = 0; i < IMAGE_DCT_BLOCK_SIZE * IMAGE_DCT_BLOCK_SIZE; i += 1)
+    {
+        value = (image_luma_quant_table[i] * scale + 50) / 100;
+        ret_tables[i] = (cl_float)((value < 1) ? 1 : ((value > 255) ? 255 : value));
+        
+        value = (image_chroma_quant_table[i] * scale + 50) / 100;
+        ret_tables[IMAGE_DCT_BLOCK_SIZE * IMAGE_DCT_BLOCK_SIZE + i] = (cl_float)((value < 1) ? 1 : ((value > 255) ? 255 : value));
+    }
+}
+
+image_block_dct_t * imageEncodeBlockDCT(ppm_image_t * const input_image,
+                                        cl_int        quality,
+                                        cl_int      * const err)
+{
+    image_block_dct_t *ret_block_dct;
+    cl_float          quant_tables[2 * IMAGE_DCT_BLOCK_SIZE * IMAGE_DCT_BLOCK_SIZE];
+    cl_mem            input_buffer;
+    cl_mem            planes_buffer;
+    cl_mem            quant_buffer;
+    cl_mem            coefficient_buffer;
+    cl_int            width;
+    cl_int            height;
+    cl_int            padded_width;
+    cl_int            padded_height;
+    size_t            input_size;
+    size_t            planes_size;
+    size_t            coefficient_size;
+    size_t            global[3];
+    size_t            local[3];
+    cl_event          event[5] = {NULL, NULL, NULL, NULL, NULL};
+    cl_int            profile;
+    cl_int            ret;
+    
+    /* The encoder has no host implementation. */
+    if (image_device_ready == 0)
+    {
+        *err = CL_DEVICE_NOT_AVAILABLE;
+        return (NULL);
+    }
+    
+    width         = input_image->x;
+    height        = input_image->y;
+    padded_width  = ((width  + IMAGE_DCT_BLOCK_SIZE - 1) / IMAGE_DCT_BLOCK_SIZE) * IMAGE_DCT_BLOCK_SIZE;
+    padded_height = ((height + IMAGE_DCT_BLOCK_SIZE - 1) / IMAGE_DCT_BLOCK_SIZE) * IMAGE_DCT_BLOCK_SIZE;
+    
+    input_size       = width * height * sizeof(ppm_pixel_t);
+    planes_size      = 3 * padded_width * padded_height * sizeof(cl_float);
+    coefficient_size = 3 * padded_width * padded_height * sizeof(cl_short);
+    
+    ret_block_dct = (image_block_dct_t *)malloc(sizeof(image_block_dct_t));
+    
+    if (ret_block_dct == NULL)
+    {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    ret_block_dct->blocks_x    = padded_width  / IMAGE_DCT_BLOCK_SIZE;
+    ret_block_dct->blocks_y    = padded_height / IMAGE_DCT_BLOCK_SIZE;
+    ret_block_dct->quality     = quality;
+    ret_block_dct->coefficient = (cl_short *)malloc(coefficient_size);
+    
+    if (ret_block_dct->coefficient == NULL)
+    {
+        free(ret_block_dct);
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    imageGetQuantTables(quality, quant_tables);
+    
+    profile = clGetProfilingEnable();
+    
+    /* The YCbCr planes stay on the device, only the packed RGB pixels go up and the
+     * int16 coefficients come back.
+     */
+    input_buffer       = imageAcquireBuffer(input_size, CL_MEM_READ_ONLY, err);
+    ret                = *err;
+    planes_buffer      = imageAcquireBuffer(planes_size, CL_MEM_READ_WRITE, err);
+    ret               |= *err;
+    quant_buffer       = imageAcquireBuffer(sizeof(quant_tables), CL_MEM_READ_ONLY, err);
+    ret               |= *err;
+    coefficient_buffer = imageAcquireBuffer(coefficient_size, CL_MEM_WRITE_ONLY, err);
+    ret               |= *err;
+    
+    if (ret != CL_SUCCESS)
+    {
+        printImageErrorMsg(ERR_BUFFER_CREATION_NOK);
+        *err = ret;
+    }
+    else
+    {
+        ret  = clEnqueueWriteBuffer(image_cmd_queue, input_buffer, CL_FALSE, 0, input_size,
+                                    (const void *)input_image->pixel, 0, NULL, (profile != 0) ? &event[0] : NULL);
+        ret |= clEnqueueWriteBuffer(image_cmd_queue, quant_buffer, CL_FALSE, 0, sizeof(quant_tables),
+                                    (const void *)quant_tables, 0, NULL, (profile != 0) ? &event[1] : NULL);
+        
+        if (ret != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_WRITE_BUFFER_NOK);
+            *err = ret;
+        }
+    }
+    
+    if (ret == CL_SUCCESS)
+    {
+        cl_kernel convert_kernel = image_encode_kernel_list[IMAGE_KERNEL_CONVERT_YCBCR];
+        cl_kernel dct_kernel     = image_encode_kernel_list[IMAGE_KERNEL_BLOCK_DCT];
+        
+        ret  = clSetKernelArg(convert_kernel, 0, sizeof(cl_mem), &input_buffer);
+        ret |= clSetKernelArg(convert_kernel, 1, sizeof(cl_mem), &planes_buffer);
+        ret |= clSetKernelArg(convert_kernel, 2, sizeof(cl_int), &width);
+        ret |= clSetKernelArg(convert_kernel, 3, sizeof(cl_int), &height);
+        ret |= clSetKernelArg(convert_kernel, 4, sizeof(cl_int), &padded_width);
+        ret |= clSetKernelArg(convert_kernel, 5, sizeof(cl_int), &padded_height);
+        
+        ret |= clSetKernelArg(dct_kernel, 0, sizeof(cl_mem), &planes_buffer);
+        ret |= clSetKernelArg(dct_kernel, 1, sizeof(cl_mem), &coefficient_buffer);
+        ret |= clSetKernelArg(dct_kernel, 2, sizeof(cl_mem), &quant_buffer);
+        ret |= clSetKernelArg(dct_kernel, 3, sizeof(cl_int), &padded_width);
+        ret |= clSetKernelArg(dct_kernel, 4, sizeof(cl_int), &padded_height);
+        
+        if (ret != CL_SUCCESS)
+        {
+            printImageErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+            *err = ret;
+        }
+        else
+        {
+            global[0] = padded_width;
+            global[1] = padded_height;
+            global[2] = 3;
+            local[0]  = IMAGE_DCT_BLOCK_SIZE;
+            local[1]  = IMAGE_DCT_BLOCK_SIZE;
+            local[2]  = 1;
+            
+            ret  = clEnqueueNDRangeKernel(image_cmd_queue, convert_kernel, 2, NULL, global, NULL,
+                                          0, NULL, (profile != 0) ? &event[2] : NULL);
+            ret |= clEnqueueNDRangeKernel(image_cmd_queue, dct_kernel, 3, NULL, global, local,
+                                          0, NULL, (profile != 0) ? &event[3] : NULL);
+            
+            if (ret != CL_SUCCESS)
+            {
+                printImageErrorMsg(ERR_ENQUEUE_KERNEL_NOK);
+                *err = ret;
+            }
+            else
+            {
+                ret = clEnqueueReadBuffer(image_cmd_queue, coefficient_buffer, CL_TRUE, 0, coefficient_size,
+                                          (void *)ret_block_dct->coefficient, 0, NULL, (profile != 0) ? &event[4] : NULL);
+                if (ret != CL_SUCCESS)
+                {
+                    printImageErrorMsg(ERR_READ_BUFFER_NOK);
+                    *err = ret;
+                }
+            }
+        }
+    }
+    
+    /* Wait for the queue before returning the buffers to the pool. */
+    clFinish(image_cmd_queue);
+    
+    clProfileEvent("image encode", "write image", event[0], input_size, (size_t)width * height);
+    clProfileEvent("image encode", "write quant", event[1], sizeof(quant_tables), 0);
+    clProfileEvent("image encode", "to YCbCr", event[2], input_size + planes_size, (size_t)width * height);
+    clProfileEvent("image encode", "block DCT", event[3], planes_size + coefficient_size, (size_t)padded_width * padded_height);
+    clProfileEvent("image encode", "read coefficients", event[4], coefficient_size, (size_t)padded_width * padded_height);
+    
+    imageReleaseBuffer(input_buffer);
+    imageReleaseBuffer(planes_buffer);
+    imageReleaseBuffer(quant_buffer);
+    imageReleaseBuffer(coefficient_buffer);
+    
+    if (ret != CL_SUCCESS)
+    {
+        imageFreeBlockDCT(ret_block_dct);
+        return (NULL);
+    }
+    
+    *err = CL_SUCCESS;
+    return (ret_block_dct);
+}
+
+void imageFreeBlockDCT(image_block_dct_t * const block_dct)
+{
+    if (block_dct == NULL)
+    {
+        return;
+    }
+    
+    free(block_dct->coefficient);
+    free(block_dct);
+}
+
+image_pipeline_t * imagePipelineCreate(cl_int * const err)
+{
+    image_pipeline_t *pipeline;
+    
+    pipeline = (image_pipeline_t *)calloc(1, sizeof(image_pipeline_t));
+    
+    if (pipeline != NULL)
+    {
+        pipeline->jit = 1;
+    }
+    
+    *err = (pipeline != NULL) ? CL_SUCCESS : CL_OUT_OF_HOST_MEMORY;
+    
+    return (pipeline);
+}
+
+void imagePipelineAddConvolution(image_pipeline_t * const pipeline,
+                                 const cl_float   filter[],
+                                 cl_int           size,
+                                 cl_int           * const err)
+{
+    image_stage_t stage;
+    
+    if ((size <= 0) || ((size % 2) == 0))
+    {
+        printImageErrorMsg(ERR_PIPELINE_STAGE_NOK);
+        *err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    memset(&stage, 0, sizeof(stage));
+    
+    stage.type   = IMAGE_STAGE_CONVOLUTION;
+    stage.size   = size;
+    stage.filter = (cl_float *)malloc(sizeof(cl_float) * size * size);
+    
+    if (stage.filter == NULL)
+    {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return;
+    }
+    
+    memcpy(stage.filter, filter, sizeof(cl_float) * size * size);
+    
+    imageAddPipelineStage(pipeline, &stage, err);
+    
+    if (*err != CL_SUCCESS)
+    {
+        free(stage.filter);
+    }
+}
+
+void imagePipelineAddThreshold(image_pipeline_t * const pipeline,
+                               cl_float         threshold,
+                               cl_int           * const err)
+{
+    image_stage_t stage;
+    
+    memset(&stage, 0, sizeof(stage));
+    
+    stage.type  = IMAGE_STAGE_THRESHOLD;
+    stage.value = threshold;
+    
+    imageAddPipelineStage(pipeline, &stage, err);
+}
+
+void imagePipelineAddColorConversion(image_pipeline_t * const pipeline,
+                                     cl_int           conversion,
+                                     cl_int           * const err)
+{
+    image_stage_t stage;
+    
+    if ((conversion < IMAGE_COLOR_RGB_TO_GRAY) || (conversion > IMAGE_COLOR_YCBCR_TO_RGB))
+    {
+        printImageErrorMsg(ERR_PIPELINE_STAGE_NOK);
+        *err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    memset(&stage, 0, sizeof(stage));
+    
+    stage.type = IMAGE_STAGE_COLOR;
+    imageGetColorMatrix(conversion, stage.matrix);
+    
+    imageAddPipelineStage(pipeline, &stage, err);
+}
+
+void imagePipelineAddArithmetic(image_pipeline_t * const pipeline,
+                                cl_int           operation,
+                                cl_int           with_input,
+                                cl_float         value,
+                                cl_int           * const err)
+{
+    image_stage_t stage;
+    
+    if ((operation < IMAGE_ARITH_ADD) || (operation > IMAGE_ARITH_ABS_DIFFERENCE))
+    {
+        printImageErrorMsg(ERR_PIPELINE_STAGE_NOK);
+        *err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    memset(&stage, 0, sizeof(stage));
+    
+    stage.type       = IMAGE_STAGE_ARITHMETIC;
+    stage.operation  = operation;
+    stage.with_input = (with_input != 0);
+    stage.value      = value;
+    
+    imageAddPipelineStage(pipeline, &stage, err);
+}
+
+void imagePipelineSetJIT(image_pipeline_t * const pipeline,
+                         cl_int                   enable)
+{
+    pipeline->jit = (enable != 0);
+}
+
+void imageGetJITCacheStats(image_jit_cache_stats_t * const ret_stats)
+{
+    *ret_stats = image_jit_cache_stats;
+}
+
+void imagePipelineRun(image_pipeline_t * const pipeline,
+                      opencl_image_t   * const input_image,
+                      opencl_image_t   * const ret_image,
+                      cl_int           * const err)
+{
+    imageRunPipeline(pipeline,
+                     input_image->x,
+                     input_image->y,
+                     0,
+                     input_image->pixel,
+                     ret_image->pixel,
+                     err);
+}
+
+void imagePipelineRunPPM(image_pipeline_t * const pipeline,
+                         ppm_image_t      * const input_image,
+                         ppm_image_t      * const ret_image,
+                         cl_int           * const err)
+{
+    imageRunPipeline(pipeline,
+                     input_image->x,
+                     input_image->y,
+                     1,
+                     input_image->pixel,
+                     ret_image->pixel,
+                     err);
+}
+
+void imagePipelineGetStats(const image_pipeline_t * const pipeline,
+                           image_pipeline_stats_t * const ret_stats)
+{
+    *ret_stats = pipeline->stats;
+}
+
+void imagePipelineDestroy(image_pipeline_t * const pipeline)
+{
+    cl_int i;
+    
+    if (pipeline == NULL)
+    {
+        return;
+    }
+    
+    for (i = 0; i < pipeline->num_stages; i += 1)
+    {
+        free(pipeline->stage[i].filter);
+        
+        if (pipeline->filter_buffer[i] != NULL)
+        {
+            clReleaseMemObject(pipeline->filter_buffer[i]);
+        }
+    }
+    
+    if (pipeline->queue != NULL)
+    {
+        clReleaseCommandQueue(pipeline->queue);
+    }
+    
+    free(pipeline->jit_source);
+    free(pipeline);
+}
+
+void imageGetRGBAFromPPM(opencl_image_t * const ret_image,
+                         ppm_image_t    * const ppm_image)
+{
+    
+    for(cl_int i = 0; i < (ppm_image->x*ppm_image->y); i += 1)
+    {
+        ret_image->pixel[i].blue  = (cl_float)ppm_image->pixel[i].blue;
+        ret_image->pixel[i].green = (cl_float)ppm_image->pixel[i].green;
+        ret_image->pixel[i].red   = (cl_float)ppm_image->pixel[i].red;
+        ret_image->pixel[i].alpha = (cl_float)0;
+    }
+}
+
+void imageGetPPMFromRGBA(ppm_image_t * const ret_image,
+                         opencl_image_t * const rgba_image)
+{
+    
+    for(cl_int i = 0; i < (rgba_image->x*rgba_image->y); i += 1)
+    {
+        ret_image->pixel[i].blue  = (unsigned char)rgba_image->pixel[i].blue;
+        ret_image->pixel[i].green = (unsigned char)rgba_image->pixel[i].green;
+        ret_image->pixel[i].red   = (unsigned char)rgba_image->pixel[i].red;
+    }
 }
@@ -1,10 +1,37 @@
 #ifndef _LIB_IMAGE_H_
 #define _LIB_IMAGE_H_
 
+#ifdef __APPLE__
 #include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
 
 #define RGB_COMPONENT_COLOR 255
 
+/* Backends for the packed PPM filter path, see imageSetBackend. */
+#define IMAGE_BACKEND_AUTO    0
+#define IMAGE_BACKEND_BUFFER  1
+#define IMAGE_BACKEND_IMAGE2D 2
+#define IMAGE_BACKEND_HOST    3
+
+/* Zero-copy modes of the filter calls, see imageSetZeroCopy. */
+#define IMAGE_ZERO_COPY_AUTO  0
+#define IMAGE_ZERO_COPY_OFF   1
+#define IMAGE_ZERO_COPY_ON    2
+
+/* Image pipelines, see imagePipelineCreate. */
+#define IMAGE_PIPELINE_MAX_STAGES 16
+
+#define IMAGE_COLOR_RGB_TO_GRAY   0
+#define IMAGE_COLOR_RGB_TO_YCBCR  1
+#define IMAGE_COLOR_YCBCR_TO_RGB  2
+
+#define IMAGE_ARITH_ADD            0
+#define IMAGE_ARITH_SUBTRACT       1
+#define IMAGE_ARITH_MULTIPLY       2
+#define IMAGE_ARITH_ABS_DIFFERENCE 3
+
 typedef struct {
     unsigned char red;
     unsigned char green;
@@ -30,11 +57,96 @@ typedef struct {
     opencl_pixel_t *pixel;
 }opencl_image_t;
 
+typedef struct {
+    cl_uint acquire_count;          /* Buffers requested from the pool.            */
+    cl_uint reuse_count;            /* Requests served by a recycled buffer.       */
+    cl_uint create_count;           /* Requests that had to call clCreateBuffer.   */
+    cl_uint live_buffers;           /* Buffers currently held by the pool.         */
+    size_t  bytes_allocated;        /* Device memory currently held by the pool.   */
+    size_t  bytes_high_water_mark;  /* Peak device memory held by the pool.        */
+}image_buffer_pool_stats_t;
+
+/* Quantized 8x8 block DCT coefficients of an image, see imageEncodeBlockDCT.
+ * coefficient holds 3 planes (Y, Cb, Cr) of blocks_y * blocks_x blocks with 64
+ * zig-zag ordered values each: [((plane * blocks_y + by) * blocks_x + bx) * 64 + i].
+ */
+typedef struct {
+    cl_int   blocks_x;
+    cl_int   blocks_y;
+    cl_int   quality;
+    cl_short *coefficient;
+}image_block_dct_t;
+
+/* Handle of a frame submitted with imageSubmitFilter. */
+typedef struct {
+    cl_int  slot;
+    cl_uint sequence;
+}image_filter_ticket_t;
+
+typedef struct image_pipeline_s image_pipeline_t;
+
+typedef struct {
+    cl_uint hit_count;      /* Pipeline runs that found their specialised kernels. */
+    cl_uint miss_count;     /* Specialisations generated and built.                */
+    cl_uint live_entries;   /* Specialisations currently held by the cache.        */
+}image_jit_cache_stats_t;
+
+/* Timings of the last imagePipelineRun, device times when it ran on the device and
+ * host times otherwise.
+ */
+typedef struct {
+    cl_int num_stages;
+    cl_int num_kernels;                         /* Kernels launched, fewer when fused.  */
+    cl_int on_device;
+    double write_ms;                            /* Upload (and unpacking) of the input. */
+    double stage_ms[IMAGE_PIPELINE_MAX_STAGES]; /* Every stage in order, stages fused
+                                                 * into one kernel report its time on
+                                                 * the first of them and 0 on the rest. */
+    double read_ms;                             /* (Packing and) download of the output. */
+    double total_ms;                            /* Wall time of the whole run.          */
+}image_pipeline_stats_t;
+
 extern void imageInit(const cl_device_id * const device_list,
                             cl_int               num_dev,
                             cl_int       * const ret_err);
 
 
+extern void imageDeinit(cl_int * const ret_err);
+
+/* When enabled before imageInit, the component runs on the device with the fastest
+ * filter calibration instead of the first GPU. The choice is cached on disk, see
+ * clSelectFastestDevice.
+ */
+extern void imageSetDeviceAutoSelect(cl_int enable);
+
+/* IMAGE_BACKEND_AUTO (default) filters packed PPM images through an RGBA
+ * CL_UNORM_INT8 image2d_t when the device supports images, IMAGE_BACKEND_BUFFER
+ * and IMAGE_BACKEND_IMAGE2D force one backend. Separable filters always use buffers.
+ * Small frames, and all frames when imageInit found no device, are filtered by the
+ * multithreaded host implementation, IMAGE_BACKEND_HOST forces it for every frame.
+ */
+extern void imageSetBackend(cl_int backend);
+
+/* Returns the backend (IMAGE_BACKEND_HOST, IMAGE_BACKEND_BUFFER or
+ * IMAGE_BACKEND_IMAGE2D) that filters a packed width x height frame with the
+ * current device and backend setting. IMAGE_BACKEND_IMAGE2D is only returned for
+ * non-separable filters on devices with image support.
+ */
+extern cl_int imageGetFilterBackend(const cl_float filter[],
+                                    cl_int         size,
+                                    cl_int         width,
+                                    cl_int         height);
+
+/* In zero-copy mode, frames whose input and output pixels are aligned (allocate
+ * them with clAllocHostMemory) are wrapped with CL_MEM_USE_HOST_PTR instead of
+ * being written and read, the output is made visible by mapping it. Other frames
+ * use CL_MEM_ALLOC_HOST_PTR pool buffers. IMAGE_ZERO_COPY_AUTO (default) enables it
+ * when the device shares memory with the host. Takes effect at imageInit.
+ */
+extern void imageSetZeroCopy(cl_int mode);
+
+extern void imageGetBufferPoolStats(image_buffer_pool_stats_t * const ret_stats);
+
 extern void imageApplyFilter(cl_float      filter[],
                              cl_float      cmp_threshold,
                              cl_int        size,
@@ -42,15 +154,119 @@ extern void imageApplyFilter(cl_float      filter[],
                              opencl_image_t * const ret_image,
                              cl_int         * const err);
 
+/* Same filter on packed 8-bit RGB pixels: only 3 bytes per pixel cross the bus and
+ * the conversion to float and back runs inside the kernels. ret_image receives
+ * 0/255 per channel, as imageGetPPMFromRGBA would produce from imageApplyFilter.
+ */
+extern void imageApplyFilterPPM(cl_float      filter[],
+                                cl_float      cmp_threshold,
+                                cl_int        size,
+                                ppm_image_t   * const input_image,
+                                ppm_image_t   * const ret_image,
+                                cl_int         * const err);
+
+/* Asynchronous filtering: up to IMAGE_FRAMES_IN_FLIGHT frames are queued at once, so
+ * the upload of a frame overlaps the filtering and download of the previous one.
+ * filter, input_image and ret_image must stay valid until imageWaitFilter returns.
+ */
+extern void imageSubmitFilter(cl_float      filter[],
+                              cl_float      cmp_threshold,
+                              cl_int        size,
+                              opencl_image_t * const input_image,
+                              opencl_image_t * const ret_image,
+                              image_filter_ticket_t * const ret_ticket,
+                              cl_int         * const err);
+
+extern void imageSubmitFilterPPM(cl_float      filter[],
+                                 cl_float      cmp_threshold,
+                                 cl_int        size,
+                                 ppm_image_t   * const input_image,
+                                 ppm_image_t   * const ret_image,
+                                 image_filter_ticket_t * const ret_ticket,
+                                 cl_int         * const err);
+
+extern void imageWaitFilter(image_filter_ticket_t * const ticket,
+                            cl_int                * const err);
+
+/* JPEG style encoder front end: RGB to YCbCr, 8x8 block DCT, quantization with the
+ * quality scaled (1..100) JPEG tables and zig-zag ordering run on the device, only
+ * the int16 coefficients are downloaded for host side entropy coding. Images are
+ * padded to whole blocks by repeating the last row and column. Release the result
+ * with imageFreeBlockDCT.
+ */
+extern image_block_dct_t * imageEncodeBlockDCT(ppm_image_t * const input_image,
+                                               cl_int        quality,
+                                               cl_int      * const err);
+
+extern void imageFreeBlockDCT(image_block_dct_t * const block_dct);
+
+/* Multi-stage pipelines: stages run in the order they were added on float4 images
+ * that stay on the device in two ping-pong buffers, only the input is uploaded and
+ * only the output of the last stage is downloaded. Convolutions keep the zero
+ * boundary band of the filters and do not threshold, so a convolution followed by
+ * a threshold stage gives the imageApplyFilter output. Without a device, or with
+ * IMAGE_BACKEND_HOST, pipelines run on the host. Destroy pipelines before
+ * imageDeinit.
+ */
+extern image_pipeline_t * imagePipelineCreate(cl_int * const err);
+
+extern void imagePipelineAddConvolution(image_pipeline_t * const pipeline,
+                                        const cl_float   filter[],
+                                        cl_int           size,
+                                        cl_int           * const err);
+
+/* 255 for every component above threshold, 0 otherwise. */
+extern void imagePipelineAddThreshold(image_pipeline_t * const pipeline,
+                                      cl_float         threshold,
+                                      cl_int           * const err);
+
+/* IMAGE_COLOR_*, JFIF full range YCbCr with Cb and Cr centered on 128. */
+extern void imagePipelineAddColorConversion(image_pipeline_t * const pipeline,
+                                            cl_int           conversion,
+                                            cl_int           * const err);
+
+/* IMAGE_ARITH_* of the current image with value, or with the pipeline input image
+ * when with_input is set (current - input for IMAGE_ARITH_SUBTRACT).
+ */
+extern void imagePipelineAddArithmetic(image_pipeline_t * const pipeline,
+                                       cl_int           operation,
+                                       cl_int           with_input,
+                                       cl_float         value,
+                                       cl_int           * const err);
+
+/* On the device pipelines run specialised kernels generated for their stages
+ * (default): sizes, weights, thresholds and operands become literal constants,
+ * small filters are fully unrolled with their zero weights dropped, and every
+ * convolution is fused with the point-wise stages before and after it into one
+ * kernel (point-wise stages only, into one kernel as well). The specialisations
+ * are cached by their source, which encodes every stage parameter. Disabled, every
+ * stage launches its generic kernel.
+ */
+extern void imagePipelineSetJIT(image_pipeline_t * const pipeline,
+                                cl_int                   enable);
+
+extern void imageGetJITCacheStats(image_jit_cache_stats_t * const ret_stats);
+
+extern void imagePipelineRun(image_pipeline_t * const pipeline,
+                             opencl_image_t   * const input_image,
+                             opencl_image_t   * const ret_image,
+                             cl_int           * const err);
+
+/* Same on packed RGB pixels, the output is rounded and saturated to 0..255. */
+extern void imagePipelineRunPPM(image_pipeline_t * const pipeline,
+                                ppm_image_t      * const input_image,
+                                ppm_image_t      * const ret_image,
+                                cl_int           * const err);
+
+extern void imagePipelineGetStats(const image_pipeline_t * const pipeline,
+                                  image_pipeline_stats_t * const ret_stats);
+
+extern void imagePipelineDestroy(image_pipeline_t * const pipeline);
+
 extern void imageGetRGBAFromPPM(opencl_image_t * const ret_image,
                                 ppm_image_t    * const ppm_image);
 
 extern void imageGetPPMFromRGBA(ppm_image_t * const ret_image,
                                 opencl_image_t * const rgba_image);
 
-extern void imageSavePPM(ppm_image_t * const input_image,
-                         const char * const output_image_filename);
-
-extern ppm_image_t * imageReadPPM(const char * const image_filename);
-
 #endif /* _LIB_IMAGE_H_ */
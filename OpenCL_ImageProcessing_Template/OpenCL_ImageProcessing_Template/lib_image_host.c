@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "lib_image_host.h"
+
+/* Rows per thread below which the band is not worth a thread. */
+#define IMAGE_HOST_MIN_ROWS_PER_THREAD 16
+
+typedef struct {
+    const cl_float       *filter;
+    cl_float             threshold;
+    cl_int               size;
+    cl_int               width;
+    cl_int               height;
+    cl_int               packed;
+    cl_int               store_response;  /* Pipeline convolution, no threshold. */
+    const opencl_pixel_t *input;
+    void                 *output;
+    cl_int               row_start;
+    cl_int               row_end;
+}image_host_band_t;
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void imageHostFilterRow(const image_host_band_t * const band,
+                               cl_int                          y,
+                               cl_float                * const ret_response);
+static void imageHostStoreRow(const image_host_band_t * const band,
+                              cl_int                          y,
+                              const cl_float          * const response);
+static void * imageHostFilterBand(void * arg);
+static cl_int imageHostGetThreadCount(cl_int height);
+static void imageHostRunBands(const image_host_band_t * const config,
+                              cl_int                  * const err);
+static unsigned char imageHostSaturate(cl_float value);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void imageHostFilterRow(const image_host_band_t * const band,
+                               cl_int                          y,
+                               cl_float                * const ret_response)
+{
+    const cl_float *input;
+    cl_int         half_filter_size;
+    cl_int         width;
+    cl_int         x;
+    cl_int         r;
+    cl_int         c;
+    
+    input            = (const cl_float *)band->input;
+    width            = band->width;
+    half_filter_size = band->size / 2;
+    
+    /* Pixels closer than half the filter size to the border keep a zero response. */
+    memset(ret_response, 0, sizeof(cl_float) * 4 * width);
+    
+    if ((y < half_filter_size) || (y >= (band->height - half_filter_size)))
+    {
+        return;
+    }
+    
+    x = half_filter_size;
+    
+#if defined(__AVX2__)
+    /* Two float4 pixels per register, every pixel accumulates its products in the
+     * same r, c order as the kernel.
+     */
+    for (; (x + 1) < (width - half_filter_size); x += 2)
+    {
+        __m256 response = _mm256_setzero_ps();
+        cl_int filter_i = 0;
+        
+        for (r = -half_filter_size; r <= half_filter_size; r += 1)
+        {
+            const cl_float *row = &input[4 * ((y + r) * width + x)];
+            
+            for (c = -half_filter_size; c <= half_filter_size; c += 1)
+            {
+                response = _mm256_add_ps(response,
+                                         _mm256_mul_ps(_mm256_loadu_ps(&row[4 * c]),
+                                                       _mm256_set1_ps(band->filter[filter_i])));
+                filter_i += 1;
+            }
+        }
+        
+        _mm256_storeu_ps(&ret_response[4 * x], response);
+    }
+#endif
+    
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; x < (width - half_filter_size); x += 1)
+    {
+        __m128 response = _mm_setzero_ps();
+        cl_int filter_i = 0;
+        
+        for (r = -half_filter_size; r <= half_filter_size; r += 1)
+        {
+            const cl_float *row = &input[4 * ((y + r) * width + x)];
+            
+            for (c = -half_filter_size; c <= half_filter_size; c += 1)
+            {
+                response = _mm_add_ps(response,
+                                      _mm_mul_ps(_mm_loadu_ps(&row[4 * c]),
+                                                 _mm_set1_ps(band->filter[filter_i])));
+                filter_i += 1;
+            }
+        }
+        
+        _mm_storeu_ps(&ret_response[4 * x], response);
+    }
+#else
+    for (; x < (width - half_filter_size); x += 1)
+    {
+        cl_float response[4] = {0, 0, 0, 0};
+        cl_int   filter_i    = 0;
+        
+        for (r = -half_filter_size; r <= half_filter_size; r += 1)
+        {
+            const cl_float *row = &input[4 * ((y + r) * width + x)];
+            
+            for (c = -half_filter_size; c <= half_filter_size; c += 1)
+            {
+                cl_float weight = band->filter[filter_i];
+                
+                response[0] += row[4 * c + 0] * weight;
+                response[1] += row[4 * c + 1] * weight;
+                response[2] += row[4 * c + 2] * weight;
+                response[3] += row[4 * c + 3] * weight;
+                filter_i    += 1;
+            }
+        }
+        
+        memcpy(&ret_response[4 * x], response, sizeof(response));
+    }
+#endif
+}
+
+static void imageHostStoreRow(const image_host_band_t * const band,
+                              cl_int                          y,
+                              const cl_float          * const response)
+{
+    cl_int x;
+    cl_int i;
+    
+    /* Every component is compared with the threshold, packed pixels drop alpha. */
+    if (band->store_response != 0)
+    {
+        memcpy(&((opencl_pixel_t *)band->output)[y * band->width], response, sizeof(cl_float) * 4 * band->width);
+    }
+    else if (band->packed != 0)
+    {
+        ppm_pixel_t *output = &((ppm_pixel_t *)band->output)[y * band->width];
+        
+        for (x = 0; x < band->width; x += 1)
+        {
+            output[x].red   = (response[4 * x + 0] > band->threshold) ? 255 : 0;
+            output[x].green = (response[4 * x + 1] > band->threshold) ? 255 : 0;
+            output[x].blue  = (response[4 * x + 2] > band->threshold) ? 255 : 0;
+        }
+    }
+    else
+    {
+        cl_float *output = (cl_float *)&((opencl_pixel_t *)band->output)[y * band->width];
+        
+        for (i = 0; i < (4 * band->width); i += 1)
+        {
+            output[i] = (response[i] > band->threshold) ? 255.0f : 0.0f;
+        }
+    }
+}
+
+static void * imageHostFilterBand(void * arg)
+{
+    const image_host_band_t *band = (const image_host_band_t *)arg;
+    cl_float                *response;
+    cl_int                  y;
+    
+    response = (cl_float *)malloc(sizeof(cl_float) * 4 * band->width);
+    
+    if (response == NULL)
+    {
+        return (arg);
+    }
+    
+    for (y = band->row_start; y < band->row_end; y += 1)
+    {
+        imageHostFilterRow(band, y, response);
+        imageHostStoreRow(band, y, response);
+    }
+    
+    free(response);
+    
+    return (NULL);
+}
+
+static cl_int imageHostGetThreadCount(cl_int height)
+{
+    long   num_cpu;
+    cl_int num_thread;
+    
+    num_cpu    = sysconf(_SC_NPROCESSORS_ONLN);
+    num_thread = (num_cpu > 0) ? (cl_int)num_cpu : 1;
+    num_thread = (num_thread < IMAGE_HOST_MAX_THREADS) ? num_thread : IMAGE_HOST_MAX_THREADS;
+    
+    if ((height / IMAGE_HOST_MIN_ROWS_PER_THREAD) < num_thread)
+    {
+        num_thread = height / IMAGE_HOST_MIN_ROWS_PER_THREAD;
+    }
+    
+    return ((num_thread > 0) ? num_thread : 1);
+}
+
+static void imageHostRunBands(const image_host_band_t * const config,
+                              cl_int                  * const err)
+{
+    image_host_band_t band[IMAGE_HOST_MAX_THREADS];
+    pthread_t         thread[IMAGE_HOST_MAX_THREADS];
+    cl_int            thread_started[IMAGE_HOST_MAX_THREADS];
+    cl_int            num_thread;
+    cl_int            i;
+    
+    *err = CL_SUCCESS;
+    
+    /* Row bands, the first band runs on the calling thread. */
+    num_thread = imageHostGetThreadCount(config->height);
+    
+    for (i = 0; i < num_thread; i += 1)
+    {
+        band[i]           = *config;
+        band[i].row_start = (cl_int)(((long)config->height * i) / num_thread);
+        band[i].row_end   = (cl_int)(((long)config->height * (i + 1)) / num_thread);
+        
+        thread_started[i] = (i > 0) && (pthread_create(&thread[i], NULL, imageHostFilterBand, &band[i]) == 0);
+    }
+    
+    /* A band whose thread could not be started runs here. */
+    for (i = 0; i < num_thread; i += 1)
+    {
+        if ((thread_started[i] == 0) && (imageHostFilterBand(&band[i]) != NULL))
+        {
+            *err = CL_OUT_OF_HOST_MEMORY;
+        }
+    }
+    
+    for (i = 1; i < num_thread; i += 1)
+    {
+        void *thread_ret = NULL;
+        
+        if (thread_started[i] != 0)
+        {
+            pthread_join(thread[i], &thread_ret);
+            
+            if (thread_ret != NULL)
+            {
+                *err = CL_OUT_OF_HOST_MEMORY;
+            }
+        }
+    }
+}
+
+static unsigned char imageHostSaturate(cl_float value)
+{
+    /* convert_uchar_sat_rte: NaN and negative values give 0, lrintf rounds half to even. */
+    if (!(value > 0))
+    {
+        return (0);
+    }
+    
+    return ((value >= 255) ? 255 : (unsigned char)lrintf(value));
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+void imageHostFilter(const cl_float filter[],
+                     cl_float       cmp_threshold,
+                     cl_int         size,
+                     cl_int         width,
+                     cl_int         height,
+                     cl_int         packed,
+                     const void     * const input_pixels,
+                     void           * const ret_pixels,
+                     cl_int         * const err)
+{
+    image_host_band_t config;
+    opencl_pixel_t    *expanded;
+    
+    *err     = CL_SUCCESS;
+    expanded = NULL;
+    
+    /* Packed pixels are expanded to float4 (alpha = 0) once, like loadPackedPixel. */
+    if (packed != 0)
+    {
+        expanded = (opencl_pixel_t *)malloc(sizeof(opencl_pixel_t) * width * height);
+        
+        if (expanded == NULL)
+        {
+            *err = CL_OUT_OF_HOST_MEMORY;
+            return;
+        }
+        
+        imageHostUnpackPixels((const ppm_pixel_t *)input_pixels, expanded, (size_t)width * height);
+    }
+    
+    memset(&config, 0, sizeof(config));
+    
+    config.filter    = filter;
+    config.threshold = cmp_threshold;
+    config.size      = size;
+    config.width     = width;
+    config.height    = height;
+    config.packed    = packed;
+    config.input     = (packed != 0) ? expanded : (const opencl_pixel_t *)input_pixels;
+    config.output    = ret_pixels;
+    
+    imageHostRunBands(&config, err);
+    
+    free(expanded);
+}
+
+void imageHostPipelineStage(const image_stage_t  * const stage,
+                            cl_int                       width,
+                            cl_int                       height,
+                            const opencl_pixel_t * const pipeline_input,
+                            const opencl_pixel_t * const input_pixels,
+                            opencl_pixel_t       * const ret_pixels,
+                            cl_int               * const err)
+{
+    const cl_float *input;
+    const cl_float *operand;
+    cl_float       *output;
+    size_t         num_values;
+    size_t         i;
+    
+    *err = CL_SUCCESS;
+    
+    /* Convolutions share the banded filter rows, the point-wise stages are bound by
+     * memory and run on the calling thread.
+     */
+    if (stage->type == IMAGE_STAGE_CONVOLUTION)
+    {
+        image_host_band_t config;
+        
+        memset(&config, 0, sizeof(config));
+        
+        config.filter         = stage->filter;
+        config.size           = stage->size;
+        config.width          = width;
+        config.height         = height;
+        config.store_response = 1;
+        config.input          = input_pixels;
+        config.output         = ret_pixels;
+        
+        imageHostRunBands(&config, err);
+        return;
+    }
+    
+    input      = (const cl_float *)input_pixels;
+    operand    = (const cl_float *)pipeline_input;
+    output     = (cl_float *)ret_pixels;
+    num_values = (size_t)4 * width * height;
+    
+    switch (stage->type)
+    {
+        case IMAGE_STAGE_THRESHOLD:
+        {
+            for (i = 0; i < num_values; i += 1)
+            {
+                output[i] = (input[i] > stage->value) ? 255.0f : 0.0f;
+            }
+            break;
+        }
+        case IMAGE_STAGE_COLOR:
+        {
+            const cl_float *m = stage->matrix;
+            
+            for (i = 0; i < num_values; i += 4)
+            {
+                cl_float r = input[i + 0];
+                cl_float g = input[i + 1];
+                cl_float b = input[i + 2];
+                
+                output[i + 0] = m[0] * r + m[1] * g + m[2]  * b + m[3];
+                output[i + 1] = m[4] * r + m[5] * g + m[6]  * b + m[7];
+                output[i + 2] = m[8] * r + m[9] * g + m[10] * b + m[11];
+                output[i + 3] = input[i + 3];
+            }
+            break;
+        }
+        default:
+        {
+            for (i = 0; i < num_values; i += 1)
+            {
+                cl_float b = (stage->with_input != 0) ? operand[i] : stage->value;
+                
+                switch (stage->operation)
+                {
+                    case IMAGE_ARITH_ADD:
+                    {
+                        output[i] = input[i] + b;
+                        break;
+                    }
+                    case IMAGE_ARITH_SUBTRACT:
+                    {
+                        output[i] = input[i] - b;
+                        break;
+                    }
+                    case IMAGE_ARITH_MULTIPLY:
+                    {
+                        output[i] = input[i] * b;
+                        break;
+                    }
+                    default:
+                    {
+                        output[i] = fabsf(input[i] - b);
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+    }
+}
+
+void imageHostUnpackPixels(const ppm_pixel_t * const input_pixels,
+                           opencl_pixel_t    * const ret_pixels,
+                           size_t                    num_pixels)
+{
+    for (size_t i = 0; i < num_pixels; i += 1)
+    {
+        ret_pixels[i].red   = input_pixels[i].red;
+        ret_pixels[i].green = input_pixels[i].green;
+        ret_pixels[i].blue  = input_pixels[i].blue;
+        ret_pixels[i].alpha = 0;
+    }
+}
+
+void imageHostPackPixels(const opencl_pixel_t * const input_pixels,
+                         ppm_pixel_t          * const ret_pixels,
+                         size_t                       num_pixels)
+{
+    for (size_t i = 0; i < num_pixels; i += 1)
+    {
+        ret_pixels[i].red   = imageHostSaturate(input_pixels[i].red);
+        ret_pixels[i].green = imageHostSaturate(input_pixels[i].green);
+        ret_pixels[i].blue  = imageHostSaturate(input_pixels[i].blue);
+    }
+}
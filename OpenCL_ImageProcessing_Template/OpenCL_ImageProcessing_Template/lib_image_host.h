@@ -0,0 +1,61 @@
+#ifndef _LIB_IMAGE_HOST_H_
+#define _LIB_IMAGE_HOST_H_
+
+#include "lib_image.h"
+
+/* Host implementation of the Filter kernels: same weights order, boundary band and
+ * threshold semantics, vectorised with AVX2 or SSE when the compiler targets them
+ * and split into row bands over IMAGE_HOST_MAX_THREADS threads.
+ * packed selects 3-byte ppm_pixel_t input/output instead of opencl_pixel_t.
+ */
+#ifndef IMAGE_HOST_MAX_THREADS
+#define IMAGE_HOST_MAX_THREADS 16
+#endif
+
+/* Stage of an image pipeline, see imagePipelineCreate. */
+#define IMAGE_STAGE_CONVOLUTION 0
+#define IMAGE_STAGE_THRESHOLD   1
+#define IMAGE_STAGE_COLOR       2
+#define IMAGE_STAGE_ARITHMETIC  3
+
+typedef struct {
+    cl_int   type;
+    cl_int   size;          /* Convolution filter size.                         */
+    cl_float *filter;       /* Convolution weights, size * size.                */
+    cl_int   operation;     /* IMAGE_ARITH_*.                                   */
+    cl_int   with_input;    /* Arithmetic operand is the pipeline input image.  */
+    cl_float value;         /* Threshold or constant arithmetic operand.        */
+    cl_float matrix[12];    /* Colour conversion rows: R, G, B weights, offset. */
+}image_stage_t;
+
+extern void imageHostFilter(const cl_float filter[],
+                            cl_float       cmp_threshold,
+                            cl_int         size,
+                            cl_int         width,
+                            cl_int         height,
+                            cl_int         packed,
+                            const void     * const input_pixels,
+                            void           * const ret_pixels,
+                            cl_int         * const err);
+
+/* One pipeline stage on float4 pixels, same arithmetic as the kernels of
+ * kernel_pipeline.cl. pipeline_input is the operand of arithmetic stages with_input.
+ */
+extern void imageHostPipelineStage(const image_stage_t  * const stage,
+                                   cl_int                       width,
+                                   cl_int                       height,
+                                   const opencl_pixel_t * const pipeline_input,
+                                   const opencl_pixel_t * const input_pixels,
+                                   opencl_pixel_t       * const ret_pixels,
+                                   cl_int               * const err);
+
+/* Packed RGB to float4 (alpha = 0) and back, rounded to nearest and saturated. */
+extern void imageHostUnpackPixels(const ppm_pixel_t * const input_pixels,
+                                  opencl_pixel_t    * const ret_pixels,
+                                  size_t                    num_pixels);
+
+extern void imageHostPackPixels(const opencl_pixel_t * const input_pixels,
+                                ppm_pixel_t          * const ret_pixels,
+                                size_t                       num_pixels);
+
+#endif /* _LIB_IMAGE_HOST_H_ */
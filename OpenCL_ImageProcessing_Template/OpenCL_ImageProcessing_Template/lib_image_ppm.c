@@ -0,0 +1,679 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lib_opencl.h"
+#include "lib_image_ppm.h"
+
+/* Largest width or height accepted from a header. */
+#define IMAGE_PPM_MAX_DIM 0x3FFFFFFF
+
+struct ppm_stream_s {
+    int         fd;
+    cl_int      writable;
+    cl_int      x;
+    cl_int      y;
+    size_t      header_size;
+    cl_int      next_row;
+    cl_int      rows_per_strip;
+    cl_int      halo_rows;
+    ppm_pixel_t *strip_pixels;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void printPPMErrorMsg(const char * const action, const char * const filename);
+static const unsigned char * skipPPMSpace(const unsigned char *data, const unsigned char * const end);
+static cl_int parsePPMNumber(const unsigned char ** const data,
+                             const unsigned char  * const end,
+                             cl_int               * const ret_value);
+static cl_int parsePPMHeader(const unsigned char * const data,
+                             size_t                      length,
+                             cl_int              * const ret_x,
+                             cl_int              * const ret_y,
+                             size_t              * const ret_header_size);
+static int openPPMFile(const char * const filename,
+                       cl_int     * const ret_x,
+                       cl_int     * const ret_y,
+                       size_t     * const ret_header_size,
+                       size_t     * const ret_file_size,
+                       cl_int     * const err);
+static int createPPMFile(const char * const filename,
+                         cl_int             x,
+                         cl_int             y,
+                         int                flags,
+                         size_t     * const ret_header_size,
+                         cl_int     * const err);
+static cl_int readFileRange(int fd, void * const data, size_t size, off_t offset);
+static cl_int writeFileRange(int fd, const void * const data, size_t size, off_t offset);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void printPPMErrorMsg(const char * const action, const char * const filename)
+{
+    printf("Error Image processing component: %s '%s' ... NOK.\n", action, filename);
+}
+
+static const unsigned char * skipPPMSpace(const unsigned char *data, const unsigned char * const end)
+{
+    /* Whitespace and comments up to the end of their line separate header fields. */
+    while (data < end)
+    {
+        if (*data == '#')
+        {
+            while ((data < end) && (*data != '\n'))
+            {
+                data += 1;
+            }
+        }
+        else if ((*data == ' ') || (*data == '\t') || (*data == '\n') || (*data == '\r'))
+        {
+            data += 1;
+        }
+        else
+        {
+            break;
+        }
+    }
+    
+    return (data);
+}
+
+static cl_int parsePPMNumber(const unsigned char ** const data,
+                             const unsigned char  * const end,
+                             cl_int               * const ret_value)
+{
+    const unsigned char *digit = skipPPMSpace(*data, end);
+    long                value  = 0;
+    
+    if ((digit == end) || (*digit < '0') || (*digit > '9'))
+    {
+        return (CL_INVALID_VALUE);
+    }
+    
+    while ((digit < end) && (*digit >= '0') && (*digit <= '9'))
+    {
+        value  = 10 * value + (*digit - '0');
+        digit += 1;
+        
+        if (value > IMAGE_PPM_MAX_DIM)
+        {
+            return (CL_INVALID_VALUE);
+        }
+    }
+    
+    *data      = digit;
+    *ret_value = (cl_int)value;
+    
+    return (CL_SUCCESS);
+}
+
+static cl_int parsePPMHeader(const unsigned char * const data,
+                             size_t                      length,
+                             cl_int              * const ret_x,
+                             cl_int              * const ret_y,
+                             size_t              * const ret_header_size)
+{
+    const unsigned char *end    = data + length;
+    const unsigned char *cursor = data + 2;
+    cl_int              max_value;
+    
+    if ((length < 2) || (data[0] != 'P') || (data[1] != '6'))
+    {
+        return (CL_INVALID_VALUE);
+    }
+    
+    if (   (parsePPMNumber(&cursor, end, ret_x) != CL_SUCCESS)
+        || (parsePPMNumber(&cursor, end, ret_y) != CL_SUCCESS)
+        || (parsePPMNumber(&cursor, end, &max_value) != CL_SUCCESS))
+    {
+        return (CL_INVALID_VALUE);
+    }
+    
+    /* A single whitespace character separates the header from the pixels. */
+    if (   (cursor == end)
+        || ((*cursor != ' ') && (*cursor != '\t') && (*cursor != '\n') && (*cursor != '\r'))
+        || (max_value != RGB_COMPONENT_COLOR)
+        || (*ret_x <= 0)
+        || (*ret_y <= 0))
+    {
+        return (CL_INVALID_VALUE);
+    }
+    
+    *ret_header_size = (size_t)(cursor - data) + 1;
+    
+    return (CL_SUCCESS);
+}
+
+static int openPPMFile(const char * const filename,
+                       cl_int     * const ret_x,
+                       cl_int     * const ret_y,
+                       size_t     * const ret_header_size,
+                       size_t     * const ret_file_size,
+                       cl_int     * const err)
+{
+    unsigned char header[IMAGE_PPM_MAX_HEADER_SIZE];
+    struct stat   file_stat;
+    ssize_t       header_length;
+    int           fd;
+    
+    fd = open(filename, O_RDONLY);
+    
+    if (fd < 0)
+    {
+        *err = CL_INVALID_VALUE;
+        printPPMErrorMsg("Open PPM file", filename);
+        return (-1);
+    }
+    
+    /* The header must fit IMAGE_PPM_MAX_HEADER_SIZE bytes and the file must hold
+     * every pixel it announces.
+     */
+    header_length = pread(fd, header, sizeof(header), 0);
+    
+    if (   (header_length <= 0)
+        || (parsePPMHeader(header, (size_t)header_length, ret_x, ret_y, ret_header_size) != CL_SUCCESS)
+        || (fstat(fd, &file_stat) != 0)
+        || ((size_t)file_stat.st_size < (*ret_header_size + sizeof(ppm_pixel_t) * (size_t)*ret_x * (size_t)*ret_y)))
+    {
+        close(fd);
+        *err = CL_INVALID_VALUE;
+        printPPMErrorMsg("Parse P6 PPM file", filename);
+        return (-1);
+    }
+    
+    *ret_file_size = (size_t)file_stat.st_size;
+    *err           = CL_SUCCESS;
+    
+    return (fd);
+}
+
+static int createPPMFile(const char * const filename,
+                         cl_int             x,
+                         cl_int             y,
+                         int                flags,
+                         size_t     * const ret_header_size,
+                         cl_int     * const err)
+{
+    char header[64];
+    int  header_length;
+    int  fd;
+    
+    if ((x <= 0) || (y <= 0) || (x > IMAGE_PPM_MAX_DIM) || (y > IMAGE_PPM_MAX_DIM))
+    {
+        *err = CL_INVALID_VALUE;
+        printPPMErrorMsg("Create PPM file", filename);
+        return (-1);
+    }
+    
+    header_length = snprintf(header, sizeof(header), "P6\n# Output image creation.\n%d %d\n%d\n", x, y, RGB_COMPONENT_COLOR);
+    
+    fd = open(filename, flags | O_CREAT | O_TRUNC, 0644);
+    
+    if ((fd < 0) || (writeFileRange(fd, header, (size_t)header_length, 0) != CL_SUCCESS))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        
+        *err = CL_INVALID_VALUE;
+        printPPMErrorMsg("Create PPM file", filename);
+        return (-1);
+    }
+    
+    *ret_header_size = (size_t)header_length;
+    *err             = CL_SUCCESS;
+    
+    return (fd);
+}
+
+static cl_int readFileRange(int fd, void * const data, size_t size, off_t offset)
+{
+    size_t done = 0;
+    
+    /* pread may return less than asked for, e.g. above 2 GB on some systems. */
+    while (done < size)
+    {
+        ssize_t length = pread(fd, (char *)data + done, size - done, offset + (off_t)done);
+        
+        if ((length < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        
+        if (length <= 0)
+        {
+            return (CL_INVALID_VALUE);
+        }
+        
+        done += (size_t)length;
+    }
+    
+    return (CL_SUCCESS);
+}
+
+static cl_int writeFileRange(int fd, const void * const data, size_t size, off_t offset)
+{
+    size_t done = 0;
+    
+    while (done < size)
+    {
+        ssize_t length = pwrite(fd, (const char *)data + done, size - done, offset + (off_t)done);
+        
+        if ((length < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        
+        if (length <= 0)
+        {
+            return (CL_INVALID_VALUE);
+        }
+        
+        done += (size_t)length;
+    }
+    
+    return (CL_SUCCESS);
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+ppm_image_t * imageReadPPM(const char * const image_filename,
+                           cl_int     * const err)
+{
+    ppm_image_t *ret_image;
+    size_t      header_size;
+    size_t      file_size;
+    int         fd;
+    
+    ret_image = (ppm_image_t *)malloc(sizeof(ppm_image_t));
+    
+    if (ret_image == NULL)
+    {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    fd = openPPMFile(image_filename, &ret_image->x, &ret_image->y, &header_size, &file_size, err);
+    
+    if (fd < 0)
+    {
+        free(ret_image);
+        return (NULL);
+    }
+    
+    /* Aligned pixels let the filters wrap the image instead of copying it. */
+    ret_image->pixel = (ppm_pixel_t *)clAllocHostMemory(sizeof(ppm_pixel_t) * (size_t)ret_image->x * (size_t)ret_image->y);
+    
+    if (ret_image->pixel == NULL)
+    {
+        *err = CL_OUT_OF_HOST_MEMORY;
+    }
+    else if (readFileRange(fd,
+                           ret_image->pixel,
+                           sizeof(ppm_pixel_t) * (size_t)ret_image->x * (size_t)ret_image->y,
+                           (off_t)header_size) != CL_SUCCESS)
+    {
+        *err = CL_INVALID_VALUE;
+        printPPMErrorMsg("Read PPM file", image_filename);
+    }
+    
+    close(fd);
+    
+    if (*err != CL_SUCCESS)
+    {
+        imageFreePPM(ret_image);
+        return (NULL);
+    }
+    
+    return (ret_image);
+}
+
+void imageSavePPM(ppm_image_t * const input_image,
+                  const char  * const output_image_filename,
+                  cl_int      * const err)
+{
+    size_t header_size;
+    int    fd;
+    
+    fd = createPPMFile(output_image_filename, input_image->x, input_image->y, O_WRONLY, &header_size, err);
+    
+    if (fd < 0)
+    {
+        return;
+    }
+    
+    *err = writeFileRange(fd,
+                          input_image->pixel,
+                          sizeof(ppm_pixel_t) * (size_t)input_image->x * (size_t)input_image->y,
+                          (off_t)header_size);
+    
+    if ((close(fd) != 0) || (*err != CL_SUCCESS))
+    {
+        *err = CL_INVALID_VALUE;
+        printPPMErrorMsg("Write PPM file", output_image_filename);
+    }
+}
+
+void imageFreePPM(ppm_image_t * const image)
+{
+    if (image == NULL)
+    {
+        return;
+    }
+    
+    free(image->pixel);
+    free(image);
+}
+
+ppm_map_t * imageMapPPM(const char * const image_filename,
+                        cl_int     * const err)
+{
+    ppm_map_t *ret_map;
+    size_t    header_size;
+    size_t    file_size;
+    int       fd;
+    
+    ret_map = (ppm_map_t *)malloc(sizeof(ppm_map_t));
+    
+    if (ret_map == NULL)
+    {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    fd = openPPMFile(image_filename, &ret_map->image.x, &ret_map->image.y, &header_size, &file_size, err);
+    
+    if (fd < 0)
+    {
+        free(ret_map);
+        return (NULL);
+    }
+    
+    /* The mapping keeps the file open, pixels are read in order by the filters. */
+    ret_map->base     = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    ret_map->length   = file_size;
+    ret_map->writable = 0;
+    
+    close(fd);
+    
+    if (ret_map->base == MAP_FAILED)
+    {
+        free(ret_map);
+        *err = CL_OUT_OF_HOST_MEMORY;
+        printPPMErrorMsg("Map PPM file", image_filename);
+        return (NULL);
+    }
+    
+    madvise(ret_map->base, ret_map->length, MADV_SEQUENTIAL);
+    
+    ret_map->image.pixel = (ppm_pixel_t *)((unsigned char *)ret_map->base + header_size);
+    
+    return (ret_map);
+}
+
+ppm_map_t * imageCreateMappedPPM(const char * const image_filename,
+                                 cl_int             x,
+                                 cl_int             y,
+                                 cl_int     * const err)
+{
+    ppm_map_t *ret_map;
+    size_t    header_size;
+    int       fd;
+    
+    ret_map = (ppm_map_t *)malloc(sizeof(ppm_map_t));
+    
+    if (ret_map == NULL)
+    {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    fd = createPPMFile(image_filename, x, y, O_RDWR, &header_size, err);
+    
+    if (fd < 0)
+    {
+        free(ret_map);
+        return (NULL);
+    }
+    
+    /* Size the file first, the mapping cannot grow it. */
+    ret_map->length   = header_size + sizeof(ppm_pixel_t) * (size_t)x * (size_t)y;
+    ret_map->base     = MAP_FAILED;
+    ret_map->writable = 1;
+    
+    if (ftruncate(fd, (off_t)ret_map->length) == 0)
+    {
+        ret_map->base = mmap(NULL, ret_map->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    
+    close(fd);
+    
+    if (ret_map->base == MAP_FAILED)
+    {
+        free(ret_map);
+        *err = CL_OUT_OF_HOST_MEMORY;
+        printPPMErrorMsg("Map PPM file", image_filename);
+        return (NULL);
+    }
+    
+    ret_map->image.x     = x;
+    ret_map->image.y     = y;
+    ret_map->image.pixel = (ppm_pixel_t *)((unsigned char *)ret_map->base + header_size);
+    
+    return (ret_map);
+}
+
+void imageUnmapPPM(ppm_map_t * const map,
+                   cl_int    * const err)
+{
+    *err = CL_SUCCESS;
+    
+    if (map == NULL)
+    {
+        return;
+    }
+    
+    if ((map->writable != 0) && (msync(map->base, map->length, MS_SYNC) != 0))
+    {
+        *err = CL_INVALID_VALUE;
+        printf("Error Image processing component: Flush mapped PPM file ... NOK.\n");
+    }
+    
+    munmap(map->base, map->length);
+    free(map);
+}
+
+ppm_stream_t * imageOpenPPMStream(const char * const image_filename,
+                                  cl_int             rows_per_strip,
+                                  cl_int             halo_rows,
+                                  cl_int     * const ret_x,
+                                  cl_int     * const ret_y,
+                                  cl_int     * const err)
+{
+    ppm_stream_t *ret_stream;
+    size_t       file_size;
+    
+    if ((rows_per_strip <= 0) || (halo_rows < 0))
+    {
+        *err = CL_INVALID_VALUE;
+        return (NULL);
+    }
+    
+    ret_stream = (ppm_stream_t *)calloc(1, sizeof(ppm_stream_t));
+    
+    if (ret_stream == NULL)
+    {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    ret_stream->fd = openPPMFile(image_filename, &ret_stream->x, &ret_stream->y, &ret_stream->header_size, &file_size, err);
+    
+    if (ret_stream->fd < 0)
+    {
+        free(ret_stream);
+        return (NULL);
+    }
+    
+    /* One strip buffer, large enough for a strip with both halos. */
+    ret_stream->rows_per_strip = (rows_per_strip < ret_stream->y) ? rows_per_strip : ret_stream->y;
+    ret_stream->halo_rows      = (halo_rows < ret_stream->y) ? halo_rows : ret_stream->y;
+    ret_stream->strip_pixels   = (ppm_pixel_t *)clAllocHostMemory(sizeof(ppm_pixel_t)
+                                                                  * (size_t)ret_stream->x
+                                                                  * (size_t)(ret_stream->rows_per_strip + 2 * ret_stream->halo_rows));
+    
+    if (ret_stream->strip_pixels == NULL)
+    {
+        close(ret_stream->fd);
+        free(ret_stream);
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    *ret_x = ret_stream->x;
+    *ret_y = ret_stream->y;
+    
+    return (ret_stream);
+}
+
+cl_int imageReadPPMStrip(ppm_stream_t * const stream,
+                         ppm_strip_t  * const ret_strip,
+                         cl_int       * const err)
+{
+    cl_int num_rows;
+    cl_int halo_top;
+    cl_int halo_bottom;
+    size_t row_size;
+    
+    *err = CL_SUCCESS;
+    
+    if ((stream->writable != 0) || (stream->next_row >= stream->y))
+    {
+        *err = (stream->writable != 0) ? CL_INVALID_VALUE : CL_SUCCESS;
+        return (0);
+    }
+    
+    /* Halo rows are read again with the neighbouring strip, the strip is read with
+     * a single call.
+     */
+    num_rows    = stream->y - stream->next_row;
+    num_rows    = (num_rows < stream->rows_per_strip) ? num_rows : stream->rows_per_strip;
+    halo_top    = (stream->next_row < stream->halo_rows) ? stream->next_row : stream->halo_rows;
+    halo_bottom = stream->y - (stream->next_row + num_rows);
+    halo_bottom = (halo_bottom < stream->halo_rows) ? halo_bottom : stream->halo_rows;
+    row_size    = sizeof(ppm_pixel_t) * (size_t)stream->x;
+    
+    if (readFileRange(stream->fd,
+                      stream->strip_pixels,
+                      row_size * (size_t)(halo_top + num_rows + halo_bottom),
+                      (off_t)(stream->header_size + row_size * (size_t)(stream->next_row - halo_top))) != CL_SUCCESS)
+    {
+        *err = CL_INVALID_VALUE;
+        printf("Error Image processing component: Read PPM strip ... NOK.\n");
+        return (0);
+    }
+    
+    ret_strip->rows.x     = stream->x;
+    ret_strip->rows.y     = halo_top + num_rows + halo_bottom;
+    ret_strip->rows.pixel = stream->strip_pixels;
+    ret_strip->first_row  = stream->next_row - halo_top;
+    ret_strip->halo_top   = halo_top;
+    ret_strip->num_rows   = num_rows;
+    
+    stream->next_row += num_rows;
+    
+    return (num_rows);
+}
+
+ppm_stream_t * imageCreatePPMStream(const char * const image_filename,
+                                    cl_int             x,
+                                    cl_int             y,
+                                    cl_int     * const err)
+{
+    ppm_stream_t *ret_stream;
+    
+    ret_stream = (ppm_stream_t *)calloc(1, sizeof(ppm_stream_t));
+    
+    if (ret_stream == NULL)
+    {
+        *err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    ret_stream->fd = createPPMFile(image_filename, x, y, O_WRONLY, &ret_stream->header_size, err);
+    
+    if (ret_stream->fd < 0)
+    {
+        free(ret_stream);
+        return (NULL);
+    }
+    
+    ret_stream->writable = 1;
+    ret_stream->x        = x;
+    ret_stream->y        = y;
+    
+    return (ret_stream);
+}
+
+void imageWritePPMRows(ppm_stream_t      * const stream,
+                       const ppm_pixel_t * const pixels,
+                       cl_int                    num_rows,
+                       cl_int            * const err)
+{
+    size_t row_size;
+    
+    if ((stream->writable == 0) || (num_rows < 0) || (num_rows > (stream->y - stream->next_row)))
+    {
+        *err = CL_INVALID_VALUE;
+        printf("Error Image processing component: Write PPM rows ... NOK.\n");
+        return;
+    }
+    
+    row_size = sizeof(ppm_pixel_t) * (size_t)stream->x;
+    
+    *err = writeFileRange(stream->fd,
+                          pixels,
+                          row_size * (size_t)num_rows,
+                          (off_t)(stream->header_size + row_size * (size_t)stream->next_row));
+    
+    if (*err != CL_SUCCESS)
+    {
+        printf("Error Image processing component: Write PPM rows ... NOK.\n");
+        return;
+    }
+    
+    stream->next_row += num_rows;
+}
+
+void imageClosePPMStream(ppm_stream_t * const stream,
+                         cl_int       * const err)
+{
+    cl_int closed;
+    
+    *err = CL_SUCCESS;
+    
+    if (stream == NULL)
+    {
+        return;
+    }
+    
+    /* The file is closed in every case, incomplete write streams included. */
+    closed = (close(stream->fd) == 0);
+    
+    if (   ((stream->writable != 0) && (stream->next_row != stream->y))
+        || (closed == 0))
+    {
+        *err = CL_INVALID_VALUE;
+        printf("Error Image processing component: Complete PPM stream ... NOK.\n");
+    }
+    
+    free(stream->strip_pixels);
+    free(stream);
+}
@@ -0,0 +1,94 @@
+#ifndef _LIB_IMAGE_PPM_H_
+#define _LIB_IMAGE_PPM_H_
+
+#include "lib_image.h"
+
+/* Binary (P6) PPM files with 8-bit components. Every function reports problems
+ * through err: CL_INVALID_VALUE for bad arguments, unreadable or malformed files
+ * and I/O errors, CL_OUT_OF_HOST_MEMORY when memory or a mapping is not available.
+ */
+
+/* Header comments are skipped, a header longer than this is rejected. */
+#define IMAGE_PPM_MAX_HEADER_SIZE 4096
+
+/* A PPM file mapped into memory, image.pixel points into the mapping. */
+typedef struct {
+    ppm_image_t image;
+    void        *base;
+    size_t      length;
+    cl_int      writable;
+}ppm_map_t;
+
+/* Rows of a PPM file read by imageReadPPMStrip. rows.pixel holds rows.y rows of
+ * the image from first_row on: halo_top rows above the strip, its num_rows rows
+ * and the rows below it, clipped to the image.
+ */
+typedef struct {
+    ppm_image_t rows;
+    cl_int      first_row;
+    cl_int      halo_top;
+    cl_int      num_rows;
+}ppm_strip_t;
+
+typedef struct ppm_stream_s ppm_stream_t;
+
+/* Reads the whole image into memory, release it with imageFreePPM. */
+extern ppm_image_t * imageReadPPM(const char * const image_filename,
+                                  cl_int     * const err);
+
+extern void imageSavePPM(ppm_image_t * const input_image,
+                         const char  * const output_image_filename,
+                         cl_int      * const err);
+
+extern void imageFreePPM(ppm_image_t * const image);
+
+/* Zero-copy read-only view of a PPM file, pages are loaded as the pixels are read. */
+extern ppm_map_t * imageMapPPM(const char * const image_filename,
+                               cl_int     * const err);
+
+/* Creates a PPM file of x by y pixels and maps it, pixels written to image.pixel
+ * reach the file without another copy. The content is flushed by imageUnmapPPM.
+ */
+extern ppm_map_t * imageCreateMappedPPM(const char * const image_filename,
+                                        cl_int             x,
+                                        cl_int             y,
+                                        cl_int     * const err);
+
+extern void imageUnmapPPM(ppm_map_t * const map,
+                          cl_int    * const err);
+
+/* Streams a PPM file in strips of rows_per_strip rows with halo_rows extra rows
+ * above and below each strip, e.g. half a filter size so the strip rows filter as
+ * in the whole image. Only one strip is resident at a time.
+ */
+extern ppm_stream_t * imageOpenPPMStream(const char * const image_filename,
+                                         cl_int             rows_per_strip,
+                                         cl_int             halo_rows,
+                                         cl_int     * const ret_x,
+                                         cl_int     * const ret_y,
+                                         cl_int     * const err);
+
+/* Reads the next strip into ret_strip, its pixels stay valid until the next call.
+ * Returns 0 once every row was read.
+ */
+extern cl_int imageReadPPMStrip(ppm_stream_t * const stream,
+                                ppm_strip_t  * const ret_strip,
+                                cl_int       * const err);
+
+/* Creates a PPM file of x by y pixels written row band by row band. */
+extern ppm_stream_t * imageCreatePPMStream(const char * const image_filename,
+                                           cl_int             x,
+                                           cl_int             y,
+                                           cl_int     * const err);
+
+/* Appends num_rows rows of x pixels after the rows already written. */
+extern void imageWritePPMRows(ppm_stream_t      * const stream,
+                              const ppm_pixel_t * const pixels,
+                              cl_int                    num_rows,
+                              cl_int            * const err);
+
+/* Closes a read or write stream, a write stream fails when rows are missing. */
+extern void imageClosePPMStream(ppm_stream_t * const stream,
+                                cl_int       * const err);
+
+#endif /* _LIB_IMAGE_PPM_H_ */
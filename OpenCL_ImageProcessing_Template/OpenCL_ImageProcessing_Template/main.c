@@ -1,11 +1,27 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "lib_opencl.h"
 #include "lib_image.h"
+#include "lib_image_ppm.h"
 
+#ifndef IMAGE_INPUT_FILENAME
 #define IMAGE_INPUT_FILENAME "/Users/marwanfaisal/Desktop/OpenCL-Templates/OpenCL_ImageProcessing_Template/OpenCL_ImageProcessing_Template/test.ppm"
+#endif
 
+#ifndef IMAGE_OUTPUT_FILENAME
 #define IMAGE_OUTPUT_FILENAME "/Users/marwanfaisal/Desktop/OpenCL-Templates/OpenCL_ImageProcessing_Template/OpenCL_ImageProcessing_Template/test_filter.ppm"
+#endif
+
+#ifndef IMAGE_STRIP_OUTPUT_FILENAME
+#define IMAGE_STRIP_OUTPUT_FILENAME "/Users/marwanfaisal/Desktop/OpenCL-Templates/OpenCL_ImageProcessing_Template/OpenCL_ImageProcessing_Template/test_filter_strip.ppm"
+#endif
+
+/* Rows per strip of the streamed filter. */
+#define IMAGE_STRIP_ROWS 64
+
+#define PROFILE_OUTPUT_FILENAME "profile_image.json"
 
 int main(int argc, const char *argv[])
 {
@@ -17,20 +33,58 @@ int main(int argc, const char *argv[])
     opencl_image_t *filtered_opencl_image;
     
     ppm_image_t *read_image; // for now.
+    ppm_image_t *output_image;
     
-    /* Get and Print device information.
+    /* Parse options, --retune sweeps the work-group sizes again instead of using
+     * the stored ones, --profile times every device command.
      */
     {
-        clGetDeviceIDs(NULL, CL_DEVICE_TYPE_ALL, 10, my_dev_list, &num_dev);
-        clPrintAllAvaliableDevicesInfo(my_dev_list, num_dev);
+        for (int i = 1; i < argc; i += 1)
+        {
+            if (strcmp(argv[i], "--retune") == 0)
+            {
+                clSetWorkGroupRetune(CL_TRUE);
+            }
+            else if (strcmp(argv[i], "--profile") == 0)
+            {
+                clSetProfilingEnable(CL_TRUE);
+            }
+        }
     }
-
+    
+    /* Get device information.
+     */
+    {
+        clGetAllDeviceIDs(CL_DEVICE_TYPE_ALL, 10, my_dev_list, &num_dev);
+    }
+    
     /* Initialize Image Component.
+     * The component runs on the device with the fastest calibration.
      */
     {
+        imageSetDeviceAutoSelect(CL_TRUE);
         imageInit(my_dev_list, num_dev, &err);
     }
     
+    /* Print device information with the calibration timings.
+     */
+    {
+        clPrintAllAvaliableDevicesInfo(my_dev_list, num_dev);
+    }
+    
+    /* Print program binary cache statistics.
+     */
+    {
+        program_cache_stats_t cache_stats;
+        
+        clGetProgramCacheStats(&cache_stats);
+        printf("Info: Program cache hits: %u, misses: %u, build time: %.2f ms, saved: %.2f ms.\n",
+               cache_stats.hit_count,
+               cache_stats.miss_count,
+               cache_stats.build_time_ms,
+               cache_stats.saved_time_ms);
+    }
+    
     /* Read input image.                */
     {
         
@@ -38,18 +92,24 @@ int main(int argc, const char *argv[])
         
         input_opencl_image    = (opencl_image_t *)malloc(sizeof(opencl_image_t));
         filtered_opencl_image = (opencl_image_t *)malloc(sizeof(opencl_image_t));
-    
+        
         /* Open input Image. */
-        read_image = imageReadPPM(IMAGE_INPUT_FILENAME);
+        read_image = imageReadPPM(IMAGE_INPUT_FILENAME, &err);
+        
+        if (read_image == NULL)
+        {
+            imageDeinit(&err);
+            return 1;
+        }
         
         /* Allocate pixels for RGBA image. */
         input_opencl_image->x     = read_image->x;
         input_opencl_image->y     = read_image->y;
-        input_opencl_image->pixel = (opencl_pixel_t*)malloc(read_image->x * read_image->y * sizeof(opencl_pixel_t));
+        input_opencl_image->pixel = (opencl_pixel_t*)clAllocHostMemory(read_image->x * read_image->y * sizeof(opencl_pixel_t));
         
         filtered_opencl_image->x     = read_image->x;
         filtered_opencl_image->y     = read_image->y;
-        filtered_opencl_image->pixel = (opencl_pixel_t*)malloc(read_image->x * read_image->y * sizeof(opencl_pixel_t));
+        filtered_opencl_image->pixel = (opencl_pixel_t*)clAllocHostMemory(read_image->x * read_image->y * sizeof(opencl_pixel_t));
         
         imageGetRGBAFromPPM(input_opencl_image, read_image);
     }
@@ -67,31 +127,415 @@ int main(int argc, const char *argv[])
              1, 2,   1
         };
         
-        /* Apply filter on input image. */
+        /* Allocate pixels for output image. */
+        output_image = (ppm_image_t *)malloc(sizeof(ppm_image_t));
+        
+        output_image->x     = read_image->x;
+        output_image->y     = read_image->y;
+        output_image->pixel = (ppm_pixel_t *)clAllocHostMemory(read_image->x * read_image->y * sizeof(ppm_pixel_t));
+        
+        /* Apply filter on the packed input image. */
+        imageApplyFilterPPM(filter, /* filter weights. */
+                            threshold,
+                            3,      /* filter nxn --> will be conculded inside this function. */
+                            read_image, /* input image. */
+                            output_image, /* output image. */
+                            &err);
+        
+        /* Apply filter on the float RGBA image and compare both paths. */
         imageApplyFilter(filter, /* filter weights. */
                          threshold,
                          3,      /* filter nxn --> will be conculded inside this function. */
                          input_opencl_image, /* input image. */
                          filtered_opencl_image, /* output image. */
                          &err);
+        
+        {
+            int mismatch = 0;
+            
+            for (int i = 0; i < (read_image->x * read_image->y); i += 1)
+            {
+                mismatch += (   (output_image->pixel[i].red   != (unsigned char)filtered_opencl_image->pixel[i].red)
+                             || (output_image->pixel[i].green != (unsigned char)filtered_opencl_image->pixel[i].green)
+                             || (output_image->pixel[i].blue  != (unsigned char)filtered_opencl_image->pixel[i].blue));
+            }
+            
+            printf("Info: Packed and RGBA filter paths differ in %d pixels.\n", mismatch);
+        }
+    }
+    
+    /* Benchmark the buffer and image2d backends on the packed path. The image2d
+     * backend only filters packed frames with non-separable filters on a device
+     * with image support, otherwise there is nothing to compare.
+     */
+    {
+        const int       num_frames = 32;
+        const cl_int    backend[2] = {IMAGE_BACKEND_BUFFER, IMAGE_BACKEND_IMAGE2D};
+        const char      *backend_name[2] = {"buffer", "image2d"};
+        cl_float        threshold  = 200.6f;
+        cl_float        filter []  =
+        {
+            -1, -2, -1,
+             0, 0,   0,
+             1, 2,   1
+        };
+        ppm_image_t     bench_image;
+        struct timespec start_time;
+        struct timespec end_time;
+        double          elapsed_ms;
+        cl_int          filter_backend;
+        
+        imageSetBackend(IMAGE_BACKEND_IMAGE2D);
+        filter_backend = imageGetFilterBackend(filter, 3, read_image->x, read_image->y);
+        
+        bench_image.x     = read_image->x;
+        bench_image.y     = read_image->y;
+        bench_image.pixel = (ppm_pixel_t *)clAllocHostMemory(read_image->x * read_image->y * sizeof(ppm_pixel_t));
+        
+        if (filter_backend == IMAGE_BACKEND_HOST)
+        {
+            printf("Info: Backend comparison skipped, the frame is filtered on the host.\n");
+        }
+        else if (filter_backend != IMAGE_BACKEND_IMAGE2D)
+        {
+            printf("Info: Backend comparison skipped, the device has no image support.\n");
+        }
+        
+        for (int b = 0; (b < 2) && (filter_backend == IMAGE_BACKEND_IMAGE2D); b += 1)
+        {
+            imageSetBackend(backend[b]);
+            
+            /* Warm up buffers and images before timing. */
+            imageApplyFilterPPM(filter, threshold, 3, read_image, &bench_image, &err);
+            
+            clock_gettime(CLOCK_MONOTONIC, &start_time);
+            
+            for (int i = 0; (i < num_frames) && (err == CL_SUCCESS); i += 1)
+            {
+                imageApplyFilterPPM(filter, threshold, 3, read_image, &bench_image, &err);
+            }
+            
+            clock_gettime(CLOCK_MONOTONIC, &end_time);
+            
+            elapsed_ms = ((end_time.tv_sec - start_time.tv_sec) * 1000.0) + ((end_time.tv_nsec - start_time.tv_nsec) / 1000000.0);
+            printf("Info: %s backend: %.3f ms/frame (packed, non-separable filter).\n", backend_name[b], elapsed_ms / num_frames);
+        }
+        
+        imageSetBackend(IMAGE_BACKEND_AUTO);
+        free(bench_image.pixel);
+    }
+    
+    /* Filter a stream of frames with two frames in flight.
+     */
+    {
+        const int             num_frames = 32;
+        cl_float              threshold  = 200.6f;
+        cl_float              filter []  =
+        {
+            -1, -2, -1,
+             0, 0,   0,
+             1, 2,   1
+        };
+        opencl_image_t        stream_image[2];
+        image_filter_ticket_t ticket[2];
+        struct timespec       start_time;
+        struct timespec       end_time;
+        double                elapsed_ms;
+        
+        for (int i = 0; i < 2; i += 1)
+        {
+            stream_image[i].x     = input_opencl_image->x;
+            stream_image[i].y     = input_opencl_image->y;
+            stream_image[i].pixel = (opencl_pixel_t *)clAllocHostMemory(input_opencl_image->x * input_opencl_image->y * sizeof(opencl_pixel_t));
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &start_time);
+        
+        for (int i = 0; (i < num_frames) && (err == CL_SUCCESS); i += 1)
+        {
+            /* Frame i-2 used the same output image, make sure it is complete. */
+            if (i >= 2)
+            {
+                imageWaitFilter(&ticket[i % 2], &err);
+            }
+            
+            imageSubmitFilter(filter,
+                              threshold,
+                              3,
+                              input_opencl_image,
+                              &stream_image[i % 2],
+                              &ticket[i % 2],
+                              &err);
+        }
+        
+        for (int i = 0; i < 2; i += 1)
+        {
+            imageWaitFilter(&ticket[i], &err);
+            free(stream_image[i].pixel);
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &end_time);
+        
+        elapsed_ms = ((end_time.tv_sec - start_time.tv_sec) * 1000.0) + ((end_time.tv_nsec - start_time.tv_nsec) / 1000000.0);
+        printf("Info: Asynchronous filter: %d frames in %.2f ms (%.2f frames/s).\n",
+               num_frames,
+               elapsed_ms,
+               (num_frames * 1000.0) / elapsed_ms);
+    }
+    
+    
+    /* Encode the input image into quantized 8x8 block DCT coefficients.
+     */
+    {
+        image_block_dct_t *block_dct;
+        size_t             num_coefficient;
+        size_t             num_nonzero = 0;
+        
+        block_dct = imageEncodeBlockDCT(read_image, 75, &err);
+        
+        if (block_dct != NULL)
+        {
+            num_coefficient = (size_t)3 * block_dct->blocks_x * block_dct->blocks_y * 64;
+            
+            for (size_t i = 0; i < num_coefficient; i += 1)
+            {
+                num_nonzero += (block_dct->coefficient[i] != 0);
+            }
+            
+            printf("Info: Block DCT encode: %d x %d blocks, quality %d, %.1f%% nonzero coefficients, %zu Kbytes downloaded (float image: %zu Kbytes).\n",
+                   block_dct->blocks_x,
+                   block_dct->blocks_y,
+                   block_dct->quality,
+                   (100.0 * num_nonzero) / num_coefficient,
+                   (num_coefficient * sizeof(cl_short)) / 1024,
+                   ((size_t)read_image->x * read_image->y * sizeof(opencl_pixel_t)) / 1024);
+            
+            imageFreeBlockDCT(block_dct);
+        }
+    }
+    
+    /* Filter with a pipeline: a convolution followed by a threshold stage gives the
+     * imageApplyFilterPPM output. Then run gray -> blur -> gradient -> |x| -> threshold
+     * with every intermediate image kept on the device, once fused into specialised
+     * kernels and once with a kernel per stage.
+     */
+    {
+        const char              *stage_name[5] = {"gray", "blur", "gradient", "abs", "threshold"};
+        cl_float                threshold = 200.6f;
+        cl_float                sobel [] = {-1, -2, -1, 0, 0, 0, 1, 2, 1};
+        cl_float                blur []  =
+        {
+            1/16.0f, 2/16.0f, 1/16.0f,
+            2/16.0f, 4/16.0f, 2/16.0f,
+            1/16.0f, 2/16.0f, 1/16.0f
+        };
+        image_pipeline_t        *pipeline;
+        image_pipeline_stats_t  pipeline_stats;
+        image_jit_cache_stats_t jit_stats;
+        ppm_image_t             pipeline_image;
+        ppm_image_t             unfused_image;
+        
+        pipeline_image.x     = read_image->x;
+        pipeline_image.y     = read_image->y;
+        pipeline_image.pixel = (ppm_pixel_t *)clAllocHostMemory(read_image->x * read_image->y * sizeof(ppm_pixel_t));
+        unfused_image        = pipeline_image;
+        unfused_image.pixel  = (ppm_pixel_t *)clAllocHostMemory(read_image->x * read_image->y * sizeof(ppm_pixel_t));
+        
+        pipeline = imagePipelineCreate(&err);
+        
+        if (pipeline != NULL)
+        {
+            imagePipelineAddConvolution(pipeline, sobel, 3, &err);
+            imagePipelineAddThreshold(pipeline, threshold, &err);
+            imagePipelineRunPPM(pipeline, read_image, &pipeline_image, &err);
+            
+            printf("Info: Filter pipeline output %s imageApplyFilterPPM.\n",
+                   (memcmp(pipeline_image.pixel, output_image->pixel, read_image->x * read_image->y * sizeof(ppm_pixel_t)) == 0) ? "matches" : "differs from");
+            
+            imagePipelineDestroy(pipeline);
+        }
+        
+        pipeline = imagePipelineCreate(&err);
+        
+        if (pipeline != NULL)
+        {
+            imagePipelineAddColorConversion(pipeline, IMAGE_COLOR_RGB_TO_GRAY, &err);
+            imagePipelineAddConvolution(pipeline, blur, 3, &err);
+            imagePipelineAddConvolution(pipeline, sobel, 3, &err);
+            imagePipelineAddArithmetic(pipeline, IMAGE_ARITH_ABS_DIFFERENCE, 0, 0.0f, &err);
+            imagePipelineAddThreshold(pipeline, 64.0f, &err);
+            
+            for (int jit = 1; (jit >= 0) && (err == CL_SUCCESS); jit -= 1)
+            {
+                imagePipelineSetJIT(pipeline, jit);
+                imagePipelineRunPPM(pipeline, read_image, (jit != 0) ? &pipeline_image : &unfused_image, &err);
+                imagePipelineGetStats(pipeline, &pipeline_stats);
+                
+                if (err == CL_SUCCESS)
+                {
+                    /* Host runs do not launch kernels, only device runs report a count. */
+                    if (pipeline_stats.on_device != 0)
+                    {
+                        printf("Info: Edge pipeline on the device in %d kernel(s): write %.3f ms,",
+                               pipeline_stats.num_kernels,
+                               pipeline_stats.write_ms);
+                    }
+                    else
+                    {
+                        printf("Info: Edge pipeline on the host: write %.3f ms,", pipeline_stats.write_ms);
+                    }
+                    
+                    for (int i = 0; i < pipeline_stats.num_stages; i += 1)
+                    {
+                        printf(" %s %.3f ms,", stage_name[i], pipeline_stats.stage_ms[i]);
+                    }
+                    
+                    printf(" read %.3f ms, total %.3f ms.\n", pipeline_stats.read_ms, pipeline_stats.total_ms);
+                }
+                
+                /* The host runs every stage in turn, fusing only applies on the device. */
+                if (pipeline_stats.on_device == 0)
+                {
+                    break;
+                }
+            }
+            
+            if ((err == CL_SUCCESS) && (pipeline_stats.on_device == 0))
+            {
+                printf("Info: Fused edge pipeline check skipped, the pipeline ran on the host.\n");
+            }
+            else if (err == CL_SUCCESS)
+            {
+                imageGetJITCacheStats(&jit_stats);
+                
+                printf("Info: Fused edge pipeline output %s the per stage output, JIT cache %u hit(s), %u miss(es), %u live.\n",
+                       (memcmp(pipeline_image.pixel, unfused_image.pixel, read_image->x * read_image->y * sizeof(ppm_pixel_t)) == 0) ? "matches" : "differs from",
+                       jit_stats.hit_count,
+                       jit_stats.miss_count,
+                       jit_stats.live_entries);
+            }
+            
+            imagePipelineDestroy(pipeline);
+        }
+        
+        free(pipeline_image.pixel);
+        free(unfused_image.pixel);
     }
     
-
     /* Save to PPM image.
      */
     {
-        ppm_image_t *output_image;
+        imageSavePPM(output_image, IMAGE_OUTPUT_FILENAME, &err);
+    }
+    
+    /* Filter the input image strip by strip, one row of halo above and below each
+     * strip keeps the 3x3 filter exact, and check the result through a mapping.
+     */
+    {
+        cl_float     threshold = 200.6f;
+        cl_float     filter [] = {-1, -2, -1, 0, 0, 0, 1, 2, 1};
+        ppm_stream_t *input_stream;
+        ppm_stream_t *output_stream = NULL;
+        ppm_strip_t  strip;
+        ppm_image_t  strip_image;
+        ppm_map_t    *strip_map;
+        cl_int       x          = 0;
+        cl_int       y          = 0;
+        cl_int       num_strips = 0;
+        cl_int       close_err;
         
-        /* Allocate pixels for output image. */
-        output_image = (ppm_image_t *)malloc(sizeof(ppm_image_t));
+        input_stream = imageOpenPPMStream(IMAGE_INPUT_FILENAME, IMAGE_STRIP_ROWS, 1, &x, &y, &err);
         
-        output_image->x     = input_opencl_image->x;
-        output_image->y     = input_opencl_image->y;
-        output_image->pixel = (ppm_pixel_t *)malloc(input_opencl_image->x * input_opencl_image->y * sizeof(ppm_pixel_t));
+        strip_image.pixel = (ppm_pixel_t *)clAllocHostMemory(x * (IMAGE_STRIP_ROWS + 2) * sizeof(ppm_pixel_t));
+        
+        if ((input_stream != NULL) && (strip_image.pixel != NULL))
+        {
+            output_stream = imageCreatePPMStream(IMAGE_STRIP_OUTPUT_FILENAME, x, y, &err);
+        }
+        
+        while ((output_stream != NULL) && (imageReadPPMStrip(input_stream, &strip, &err) > 0))
+        {
+            strip_image.x = strip.rows.x;
+            strip_image.y = strip.rows.y;
+            
+            imageApplyFilterPPM(filter, threshold, 3, &strip.rows, &strip_image, &err);
+            
+            if (err == CL_SUCCESS)
+            {
+                imageWritePPMRows(output_stream, strip_image.pixel + (strip.halo_top * x), strip.num_rows, &err);
+            }
+            
+            if (err != CL_SUCCESS)
+            {
+                break;
+            }
+            
+            num_strips += 1;
+        }
         
-        imageGetPPMFromRGBA(output_image, filtered_opencl_image);
-        imageSavePPM(output_image, IMAGE_OUTPUT_FILENAME);
+        imageClosePPMStream(input_stream, &close_err);
+        imageClosePPMStream(output_stream, &close_err);
+        free(strip_image.pixel);
+        
+        strip_map = NULL;
+        
+        if ((output_stream != NULL) && (err == CL_SUCCESS) && (close_err == CL_SUCCESS))
+        {
+            strip_map = imageMapPPM(IMAGE_STRIP_OUTPUT_FILENAME, &err);
+        }
+        
+        if (strip_map != NULL)
+        {
+            printf("Info: Strip filter: %d strips of %d rows, output %s whole image filter.\n",
+                   num_strips,
+                   IMAGE_STRIP_ROWS,
+                   (memcmp(strip_map->image.pixel, output_image->pixel, x * y * sizeof(ppm_pixel_t)) == 0) ? "matches" : "differs from");
+            
+            imageUnmapPPM(strip_map, &err);
+        }
     }
-
+    
+    /* Print buffer pool statistics and release the image component.
+     */
+    {
+        image_buffer_pool_stats_t pool_stats;
+        
+        imageGetBufferPoolStats(&pool_stats);
+        printf("Info: Buffer pool requests: %u, reused: %u, created: %u, high water mark: %zu Kbytes.\n",
+               pool_stats.acquire_count,
+               pool_stats.reuse_count,
+               pool_stats.create_count,
+               (pool_stats.bytes_high_water_mark/1024));
+        
+        imageDeinit(&err);
+    }
+    
+    /* Print the per-stage profile and write every recorded command to a JSON file.
+     */
+    if (clGetProfilingEnable() != 0)
+    {
+        profile_stage_stats_t stats[64];
+        cl_int                num_stats;
+        
+        num_stats = clGetProfileStats(stats, 64);
+        
+        printf("\nProfile:\n");
+        
+        for (int i = 0; i < num_stats; i += 1)
+        {
+            printf("\t%-14s %-22s x%-5u queued %8.3f ms, submit %8.3f ms, run %8.3f ms, %7.2f GB/s, %12.0f items/s\n",
+                   stats[i].component,
+                   stats[i].stage,
+                   stats[i].count,
+                   stats[i].queued_ms,
+                   stats[i].submit_ms,
+                   stats[i].run_ms,
+                   stats[i].gb_per_s,
+                   stats[i].items_per_s);
+        }
+        
+        clDumpProfileJSON(PROFILE_OUTPUT_FILENAME, &err);
+    }
+    
     return 0;
 }
@@ -115,4 +115,474 @@ __kernel void computeIDCT2D(__global float * input_mat,
     if(z < 0)      { z = 0;           }
     
     ret_mat[y + input_mat_dim_y*x] = z;
-}
\ No newline at end of file
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/* Fast DCT-II/DCT-III kernels for power-of-two sizes (Makhoul). The signal is
+ * reordered into a complex vector, transformed with a radix-2 Stockham FFT and
+ * rotated by e^(-i*pi*k/2N). Twiddle tables are precomputed by the host:
+ *   twiddles[j]         = e^(-2*i*pi*j/N),  j < N/2
+ *   quarter_twiddles[k] = e^(+i*pi*k/2N),   k < N
+ */
+//////////////////////////////////////////////////////////////////////////////////////////////////
+float2 complexMul(float2 a, float2 b)
+{
+    return (float2)(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);
+}
+
+__kernel void prepareFastDCT1D(__global float  * input_mat,
+                               __global float2 * ret_mat,
+                               int     input_dim)
+{
+    int   n;
+    float v;
+    
+    n = get_global_id(0);
+    
+    /* v[n] = x[2n] for the first half, v[N-1-n] = x[2n+1] for the second half.
+     */
+    v = (n < (input_dim >> 1)) ? input_mat[2 * n] : input_mat[2 * (input_dim - n) - 1];
+    
+    ret_mat[n] = (float2)(v, 0.0f);
+}
+
+__kernel void finishFastDCT1D(__global float2 * input_mat,
+                              __global float  * ret_mat,
+                              __global float2 * quarter_twiddles,
+                              int     input_dim)
+{
+    int    k;
+    float2 v;
+    float2 w;
+    
+    k = get_global_id(0);
+    v = input_mat[k];
+    w = quarter_twiddles[k];
+    
+    /* X[k] = sqrt(2/N) * Re(e^(-i*pi*k/2N) * V[k]).
+     */
+    ret_mat[k] = sqrt(2.0f/(float)input_dim) * (v.x * w.x + v.y * w.y);
+}
+
+__kernel void prepareFastIDCT1D(__global float  * input_mat,
+                                __global float2 * ret_mat,
+                                __global float2 * quarter_twiddles,
+                                int     input_dim)
+{
+    int   k;
+    float x_nk;
+    
+    k    = get_global_id(0);
+    x_nk = (k == 0) ? 0.0f : input_mat[input_dim - k];
+    
+    /* W[k] = e^(i*pi*k/2N) * (X[k] - i*X[N-k]), with X[N] = 0.
+     */
+    ret_mat[k] = complexMul(quarter_twiddles[k], (float2)(input_mat[k], -x_nk));
+}
+
+__kernel void finishFastIDCT1D(__global float2 * input_mat,
+                               __global float  * ret_mat,
+                               int     input_dim)
+{
+    int   m;
+    int   n;
+    float u;
+    
+    m = get_global_id(0);
+    n = m >> 1;
+    
+    /* Undo the even/odd reordering, the 1/2 matches the X[0]/2 term of computeIDCT1D.
+     */
+    u = (m & 1) ? input_mat[input_dim - 1 - n].x : input_mat[n].x;
+    
+    ret_mat[m] = 0.5f * sqrt(2.0f/(float)input_dim) * u;
+}
+
+/* One radix-2 Stockham pass, one butterfly per work item (global size N/2).
+ * direction is 1 for the forward and -1 for the inverse (unnormalized) FFT.
+ */
+__kernel void computeFFTStage(__global float2 * input_mat,
+                              __global float2 * ret_mat,
+                              __global float2 * twiddles,
+                              int     input_dim,
+                              int     span,
+                              float   direction)
+{
+    int    i;
+    int    k;
+    int    j;
+    int    half;
+    float2 w;
+    float2 u0;
+    float2 u1;
+    
+    i    = get_global_id(0);
+    half = input_dim >> 1;
+    k    = i & (span - 1);
+    j    = (i << 1) - k;
+    
+    w  = twiddles[k * (half / span)];
+    u0 = input_mat[i];
+    u1 = complexMul(input_mat[i + half], (float2)(w.x, direction * w.y));
+    
+    ret_mat[j]        = u0 + u1;
+    ret_mat[j + span] = u0 - u1;
+}
+
+/* Whole FFT inside one work group, all passes ping-pong between two __local
+ * arrays of N elements (local_buffer holds 2*N float2).
+ */
+__kernel void computeFFTLocal(__global float2 * input_mat,
+                              __global float2 * ret_mat,
+                              __global float2 * twiddles,
+                              int     input_dim,
+                              float   direction,
+                              __local  float2 * local_buffer)
+{
+    int    lid;
+    int    lsize;
+    int    half;
+    float2 w;
+    float2 u0;
+    float2 u1;
+    __local float2 * src;
+    __local float2 * dst;
+    __local float2 * tmp;
+    
+    lid   = get_local_id(0);
+    lsize = get_local_size(0);
+    half  = input_dim >> 1;
+    src   = local_buffer;
+    dst   = local_buffer + input_dim;
+    
+    for (int i = lid; i < input_dim; i += lsize)
+    {
+        src[i] = input_mat[i];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    for (int span = 1; span < input_dim; span <<= 1)
+    {
+        for (int i = lid; i < half; i += lsize)
+        {
+            int k = i & (span - 1);
+            int j = (i << 1) - k;
+            
+            w  = twiddles[k * (half / span)];
+            u0 = src[i];
+            u1 = complexMul(src[i + half], (float2)(w.x, direction * w.y));
+            
+            dst[j]        = u0 + u1;
+            dst[j + span] = u0 - u1;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    
+    for (int i = lid; i < input_dim; i += lsize)
+    {
+        ret_mat[i] = src[i];
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/* Batched kernels: one work group per signal, the signal is staged in __local memory
+ * and every work item computes a strided subset of the coefficients. Results and
+ * layouts match the single signal kernels above. 1D angles are reduced modulo the
+ * cosine period on integers before the float conversion, the 2D kernels run the
+ * separable passes below inside the work group.
+ */
+//////////////////////////////////////////////////////////////////////////////////////////////////
+__kernel void computeDCT1DBatch(__global float * input_mat,
+                                __global float * ret_mat,
+                                int     input_dim,
+                                __local  float * local_signal)
+{
+    int   lid;
+    int   lsize;
+    int   offset;
+    float scale;
+    
+    lid    = get_local_id(0);
+    lsize  = get_local_size(0);
+    offset = get_group_id(0) * input_dim;
+    scale  = sqrt(2.0f/(float)input_dim);
+    
+    for (int k = lid; k < input_dim; k += lsize)
+    {
+        local_signal[k] = input_mat[offset + k];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    for (int i = lid; i < input_dim; i += lsize)
+    {
+        float c = 0.0f;
+        
+        for (int k = 0; k < input_dim; k += 1)
+        {
+            int m = (i * (2 * k + 1)) % (4 * input_dim);
+            
+            c += cos((float)PI_ * (float)m / (float)(2 * input_dim)) * local_signal[k];
+        }
+        
+        ret_mat[offset + i] = scale * c;
+    }
+}
+
+__kernel void computeIDCT1DBatch(__global float * input_mat,
+                                 __global float * ret_mat,
+                                 int     input_dim,
+                                 __local  float * local_signal)
+{
+    int   lid;
+    int   lsize;
+    int   offset;
+    float scale;
+    
+    lid    = get_local_id(0);
+    lsize  = get_local_size(0);
+    offset = get_group_id(0) * input_dim;
+    scale  = sqrt(2.0f/(float)input_dim);
+    
+    for (int k = lid; k < input_dim; k += lsize)
+    {
+        local_signal[k] = input_mat[offset + k];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    for (int i = lid; i < input_dim; i += lsize)
+    {
+        float c = local_signal[0] / 2.0f;
+        
+        for (int k = 1; k < input_dim; k += 1)
+        {
+            int m = ((2 * i + 1) * k) % (4 * input_dim);
+            
+            c += cos((float)PI_ * (float)m / (float)(2 * input_dim)) * local_signal[k];
+        }
+        
+        ret_mat[offset + i] = scale * c;
+    }
+}
+
+__kernel void computeDCT2DBatch(__global float * input_mat,
+                                __global float * ret_mat,
+                                int       input_mat_dim_x,
+                                int       input_mat_dim_y,
+                                __local  float * local_signal,
+                                __global float * cos_table,
+                                int       table_dim)
+{
+    int   lid;
+    int   lsize;
+    int   size;
+    int   offset;
+    __local float * local_tmp;
+    
+    lid       = get_local_id(0);
+    lsize     = get_local_size(0);
+    size      = input_mat_dim_x * input_mat_dim_y;
+    offset    = get_group_id(0) * size;
+    local_tmp = local_signal + size;
+    
+    for (int k = lid; k < size; k += lsize)
+    {
+        local_signal[k] = input_mat[offset + k];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    /* Row pass, same as computeDCT2DRows.
+     */
+    for (int idx = lid; idx < size; idx += lsize)
+    {
+        int   v = idx % input_mat_dim_x;
+        int   y = idx / input_mat_dim_x;
+        float z = 0.0f;
+        
+        for (int x = 0; x < input_mat_dim_x; x += 1)
+        {
+            z += local_signal[x + input_mat_dim_y * y] * cos_table[x * table_dim + v];
+        }
+        
+        local_tmp[y + input_mat_dim_y * v] = z;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    /* Column pass, same as computeDCT2DColumns.
+     */
+    for (int idx = lid; idx < size; idx += lsize)
+    {
+        int   u = idx % input_mat_dim_y;
+        int   v = idx / input_mat_dim_y;
+        float z = 0.0f;
+        
+        for (int y = 0; y < input_mat_dim_y; y += 1)
+        {
+            z += local_tmp[y + input_mat_dim_y * v] * cos_table[y * table_dim + u];
+        }
+        
+        ret_mat[offset + u + input_mat_dim_y * v] = 0.25f * z;
+    }
+}
+
+__kernel void computeIDCT2DBatch(__global float * input_mat,
+                                 __global float * ret_mat,
+                                 int       input_mat_dim_x,
+                                 int       input_mat_dim_y,
+                                 __local  float * local_signal,
+                                 __global float * cos_table,
+                                 int       table_dim)
+{
+    int   lid;
+    int   lsize;
+    int   size;
+    int   offset;
+    __local float * local_tmp;
+    
+    lid       = get_local_id(0);
+    lsize     = get_local_size(0);
+    size      = input_mat_dim_x * input_mat_dim_y;
+    offset    = get_group_id(0) * size;
+    local_tmp = local_signal + size;
+    
+    for (int k = lid; k < size; k += lsize)
+    {
+        local_signal[k] = input_mat[offset + k];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    /* Row pass, same as computeIDCT2DRows.
+     */
+    for (int idx = lid; idx < (input_mat_dim_y * input_mat_dim_y); idx += lsize)
+    {
+        int   x = idx % input_mat_dim_y;
+        int   v = idx / input_mat_dim_y;
+        float z = 0.0f;
+        
+        for (int u = 0; u < input_mat_dim_x; u += 1)
+        {
+            z += local_signal[u + input_mat_dim_x * v] * cos_table[x * table_dim + u];
+        }
+        
+        local_tmp[v + input_mat_dim_y * x] = z;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    /* Column pass, same as computeIDCT2DColumns.
+     */
+    for (int idx = lid; idx < size; idx += lsize)
+    {
+        int   y = idx % input_mat_dim_x;
+        int   x = idx / input_mat_dim_x;
+        float z = 0.0f;
+        
+        for (int v = 0; v < input_mat_dim_y; v += 1)
+        {
+            z += local_tmp[v + input_mat_dim_y * x] * cos_table[y * table_dim + v];
+        }
+        
+        ret_mat[offset + y + input_mat_dim_y * x] = clamp(0.25f * z, 0.0f, 255.0f);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/* Separable 2D DCT/IDCT: a row pass and a column pass over a cosine table computed
+ * once per size by the host, with the c(k) factors included:
+ *   cos_table[n * table_dim + k] = c(k) * cos(k*pi*(2n+1)/(2*dim_x)),  c(0) = 1/sqrt(2)
+ * The row pass writes its result transposed, so the column pass also reads rows.
+ * Output layout, 0.25 scale and IDCT clamping match computeDCT2D/computeIDCT2D.
+ */
+//////////////////////////////////////////////////////////////////////////////////////////////////
+__kernel void computeDCT2DRows(__global float * input_mat,
+                               __global float * ret_mat,
+                               __global float * cos_table,
+                               int       input_mat_dim_x,
+                               int       input_mat_dim_y,
+                               int       table_dim)
+{
+    int   v;
+    int   y;
+    float z;
+    
+    v = get_global_id(0);
+    y = get_global_id(1);
+    z = 0.0f;
+    
+    for (int x = 0; x < input_mat_dim_x; x += 1)
+    {
+        z += input_mat[x + input_mat_dim_y * y] * cos_table[x * table_dim + v];
+    }
+    
+    ret_mat[y + input_mat_dim_y * v] = z;
+}
+
+__kernel void computeDCT2DColumns(__global float * input_mat,
+                                  __global float * ret_mat,
+                                  __global float * cos_table,
+                                  int       input_mat_dim_x,
+                                  int       input_mat_dim_y,
+                                  int       table_dim)
+{
+    int   u;
+    int   v;
+    float z;
+    
+    u = get_global_id(0);
+    v = get_global_id(1);
+    z = 0.0f;
+    
+    for (int y = 0; y < input_mat_dim_y; y += 1)
+    {
+        z += input_mat[y + input_mat_dim_y * v] * cos_table[y * table_dim + u];
+    }
+    
+    ret_mat[u + input_mat_dim_y * v] = 0.25f * z;
+}
+
+__kernel void computeIDCT2DRows(__global float * input_mat,
+                                __global float * ret_mat,
+                                __global float * cos_table,
+                                int       input_mat_dim_x,
+                                int       input_mat_dim_y,
+                                int       table_dim)
+{
+    int   x;
+    int   v;
+    float z;
+    
+    x = get_global_id(0);
+    v = get_global_id(1);
+    z = 0.0f;
+    
+    for (int u = 0; u < input_mat_dim_x; u += 1)
+    {
+        z += input_mat[u + input_mat_dim_x * v] * cos_table[x * table_dim + u];
+    }
+    
+    ret_mat[v + input_mat_dim_y * x] = z;
+}
+
+__kernel void computeIDCT2DColumns(__global float * input_mat,
+                                   __global float * ret_mat,
+                                   __global float * cos_table,
+                                   int       input_mat_dim_x,
+                                   int       input_mat_dim_y,
+                                   int       table_dim)
+{
+    int   y;
+    int   x;
+    float z;
+    
+    y = get_global_id(0);
+    x = get_global_id(1);
+    z = 0.0f;
+    
+    for (int v = 0; v < input_mat_dim_y; v += 1)
+    {
+        z += input_mat[v + input_mat_dim_y * x] * cos_table[y * table_dim + v];
+    }
+    
+    ret_mat[y + input_mat_dim_y * x] = clamp(0.25f * z, 0.0f, 255.0f);
+}
@@ -1,8 +1,18 @@
 /*
  * Kernel_Matrix will provide all possible mainpulations for a matrix.
  * It is intended to be used as a library for DCT computation.
+ *
+ * Matrices are row major, C (dim_m x dim_n) = A (dim_m x dim_k) * B (dim_k x dim_n).
  */
 
+/* Tile edge and number of C rows computed per work item, the work group is
+ * MATRIX_TILE_SIZE x (MATRIX_TILE_SIZE / MATRIX_WORK_PER_ITEM). Keep in sync with
+ * SIGNAL_MATRIX_TILE_SIZE and SIGNAL_MATRIX_WORK_PER_ITEM in lib_signal_cfg.h.
+ */
+#define MATRIX_TILE_SIZE     16
+#define MATRIX_WORK_PER_ITEM 4
+#define MATRIX_ROW_STRIDE    (MATRIX_TILE_SIZE / MATRIX_WORK_PER_ITEM)
+
 __kernel void multiplyMatrixAB(__global float * mat_a,
                                __global float * mat_b,
                                __global float * mat_c,
@@ -19,5 +29,115 @@ __kernel void multiplyMatrixAB(__global float * mat_a,
         value += mat_a[ty * dima + k] * mat_b[k * dimb + tx];
     }
     
-    mat_c[ty * dima + tx] = value;
+    mat_c[ty * dimb + tx] = value;
+}
+
+/* Computes one MATRIX_TILE_SIZE x MATRIX_TILE_SIZE tile of C. A and B tiles are
+ * staged in local memory (zero padded at the matrix borders), every work item
+ * keeps MATRIX_WORK_PER_ITEM accumulators and reuses each B value from a register.
+ */
+void multiplyMatrixTile(__global const float * mat_a,
+                        __global const float * mat_b,
+                        __global       float * mat_c,
+                        int       dim_m,
+                        int       dim_n,
+                        int       dim_k,
+                        __local  float * tile_a,
+                        __local  float * tile_b)
+{
+    int   lx;
+    int   ly;
+    int   tile_row;
+    int   col;
+    int   num_tiles;
+    float acc[MATRIX_WORK_PER_ITEM];
+    
+    lx        = get_local_id(0);
+    ly        = get_local_id(1);
+    tile_row  = get_group_id(1) * MATRIX_TILE_SIZE;
+    col       = get_group_id(0) * MATRIX_TILE_SIZE + lx;
+    num_tiles = (dim_k + MATRIX_TILE_SIZE - 1) / MATRIX_TILE_SIZE;
+    
+    for (int w = 0; w < MATRIX_WORK_PER_ITEM; w += 1)
+    {
+        acc[w] = 0.0f;
+    }
+    
+    for (int t = 0; t < num_tiles; t += 1)
+    {
+        for (int w = 0; w < MATRIX_WORK_PER_ITEM; w += 1)
+        {
+            int r     = ly + w * MATRIX_ROW_STRIDE;
+            int a_row = tile_row + r;
+            int a_col = t * MATRIX_TILE_SIZE + lx;
+            int b_row = t * MATRIX_TILE_SIZE + r;
+            
+            tile_a[r * MATRIX_TILE_SIZE + lx] = ((a_row < dim_m) && (a_col < dim_k)) ? mat_a[a_row * dim_k + a_col] : 0.0f;
+            tile_b[r * MATRIX_TILE_SIZE + lx] = ((b_row < dim_k) && (col   < dim_n)) ? mat_b[b_row * dim_n + col]   : 0.0f;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        
+        for (int k = 0; k < MATRIX_TILE_SIZE; k += 1)
+        {
+            float b = tile_b[k * MATRIX_TILE_SIZE + lx];
+            
+            for (int w = 0; w < MATRIX_WORK_PER_ITEM; w += 1)
+            {
+                acc[w] += tile_a[(ly + w * MATRIX_ROW_STRIDE) * MATRIX_TILE_SIZE + k] * b;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    
+    for (int w = 0; w < MATRIX_WORK_PER_ITEM; w += 1)
+    {
+        int row = tile_row + ly + w * MATRIX_ROW_STRIDE;
+        
+        if ((row < dim_m) && (col < dim_n))
+        {
+            mat_c[row * dim_n + col] = acc[w];
+        }
+    }
+}
+
+__kernel __attribute__((reqd_work_group_size(MATRIX_TILE_SIZE, MATRIX_ROW_STRIDE, 1)))
+void multiplyMatrixTiled(__global float * mat_a,
+                         __global float * mat_b,
+                         __global float * mat_c,
+                         int     dim_m,
+                         int     dim_n,
+                         int     dim_k)
+{
+    __local float tile_a[MATRIX_TILE_SIZE * MATRIX_TILE_SIZE];
+    __local float tile_b[MATRIX_TILE_SIZE * MATRIX_TILE_SIZE];
+    
+    multiplyMatrixTile(mat_a, mat_b, mat_c, dim_m, dim_n, dim_k, tile_a, tile_b);
+}
+
+/* Batched variant, dimension 2 of the NDRange selects the matrix. stride_b is 0 when
+ * all products share one B matrix.
+ */
+__kernel __attribute__((reqd_work_group_size(MATRIX_TILE_SIZE, MATRIX_ROW_STRIDE, 1)))
+void multiplyMatrixTiledBatch(__global float * mat_a,
+                              __global float * mat_b,
+                              __global float * mat_c,
+                              int     dim_m,
+                              int     dim_n,
+                              int     dim_k,
+                              int     stride_b)
+{
+    __local float tile_a[MATRIX_TILE_SIZE * MATRIX_TILE_SIZE];
+    __local float tile_b[MATRIX_TILE_SIZE * MATRIX_TILE_SIZE];
+    int batch;
+    
+    batch = get_global_id(2);
+    
+    multiplyMatrixTile(mat_a + batch * (dim_m * dim_k),
+                       mat_b + batch * stride_b,
+                       mat_c + batch * (dim_m * dim_n),
+                       dim_m,
+                       dim_n,
+                       dim_k,
+                       tile_a,
+                       tile_b);
 }
\ No newline at end of file
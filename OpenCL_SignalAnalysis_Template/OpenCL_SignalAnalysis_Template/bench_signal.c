@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "lib_opencl.h"
+#include "lib_signal.h"
+
+/* Benchmark of every signalCompute operation on synthetic signals. 1D transforms
+ * sweep the signal length, 2D transforms square sizes, both up to --max-elements.
+ * Every case is timed over BENCH_COLD_RUNS cold runs (first call after a fresh
+ * signalInit, so plan and cosine table creation are included) and BENCH_WARM_RUNS
+ * warm runs (after one untimed call on the same component). --copy turns zero-copy
+ * buffers off to compare against explicit transfers.
+ *
+ * Usage: bench_signal [--warm N] [--cold N] [--max-elements N] [--host] [--copy] [--csv FILE]
+ */
+#define BENCH_WARM_RUNS      20
+#define BENCH_COLD_RUNS      3
+#define BENCH_MAX_ELEMENTS   (256 * 1024)
+#define BENCH_MAX_RUNS       1000
+#define BENCH_MAX_RESULTS    128
+#define BENCH_1D_MIN_SIZE    256
+#define BENCH_1D_SIZE_STEP   4
+#define BENCH_2D_MIN_SIZE    16
+#define BENCH_2D_SIZE_STEP   2
+
+typedef struct {
+    const char *operation_name;
+    int        dims[2];
+    const char *mode;
+    int        runs;
+    double     median_ms;
+    double     p95_ms;
+    double     melement_per_s;
+}bench_result_t;
+
+static double getWallTimeMs(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0);
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    
+    return ((da > db) - (da < db));
+}
+
+/* Median and nearest-rank 95th percentile, sorts ms in place. */
+static void getRunStats(double *ms, int runs, double *ret_median, double *ret_p95)
+{
+    int p95_index;
+    
+    qsort(ms, runs, sizeof(double), compareDouble);
+    
+    p95_index = ((95 * runs) + 99) / 100 - 1;
+    
+    *ret_median = ((runs % 2) != 0) ? ms[runs / 2] : (0.5 * (ms[runs / 2 - 1] + ms[runs / 2]));
+    *ret_p95    = ms[(p95_index > 0) ? p95_index : 0];
+}
+
+/* Deterministic test signal: two tones plus pseudo-random noise. */
+static void fillSignal(float * const signal, size_t num_elements, unsigned int seed)
+{
+    for (size_t i = 0; i < num_elements; i += 1)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        
+        signal[i] = (float)(sin(0.01 * i) + 0.5 * sin(0.37 * i) + ((seed >> 8) / 16777216.0 - 0.5) * 0.1);
+    }
+}
+
+/* Times one call on a freshly initialised component per run. */
+static int runCold(cl_device_id    * const device_list,
+                   cl_uint                 num_dev,
+                   int                     force_host,
+                   int                     signal_operation,
+                   signal_matrix_t * const input_signal,
+                   signal_matrix_t * const ret_signal,
+                   int                     runs,
+                   double          * const ret_ms)
+{
+    int err = CL_SUCCESS;
+    
+    for (int run = 0; (run < runs) && (err == CL_SUCCESS); run += 1)
+    {
+        double start_ms;
+        cl_int init_err;
+        
+        signalInit(device_list, num_dev, &init_err);
+        
+        if (force_host != 0)
+        {
+            signalSetBackend(SIGNAL_BACKEND_HOST);
+        }
+        
+        start_ms = getWallTimeMs();
+        signalCompute(signal_operation, input_signal, ret_signal, &err);
+        ret_ms[run] = getWallTimeMs() - start_ms;
+        
+        signalDeinit(&init_err);
+    }
+    
+    return (err);
+}
+
+static int runWarm(int                     signal_operation,
+                   signal_matrix_t * const input_signal,
+                   signal_matrix_t * const ret_signal,
+                   int                     runs,
+                   double          * const ret_ms)
+{
+    int err;
+    
+    /* Untimed first call creates the plan, cosine tables and tuned work-group size. */
+    signalCompute(signal_operation, input_signal, ret_signal, &err);
+    
+    for (int run = 0; (run < runs) && (err == CL_SUCCESS); run += 1)
+    {
+        double start_ms = getWallTimeMs();
+        
+        signalCompute(signal_operation, input_signal, ret_signal, &err);
+        ret_ms[run] = getWallTimeMs() - start_ms;
+    }
+    
+    return (err);
+}
+
+int main(int argc, const char * argv[])
+{
+    const char     *operation_name[4] = {"dct1d", "idct1d", "dct2d", "idct2d"};
+    cl_device_id   my_device_list[10];
+    cl_uint        num_dev;
+    bench_result_t result[BENCH_MAX_RESULTS];
+    double         ms[BENCH_MAX_RUNS];
+    int            num_result   = 0;
+    int            warm_runs    = BENCH_WARM_RUNS;
+    int            cold_runs    = BENCH_COLD_RUNS;
+    long           max_elements = BENCH_MAX_ELEMENTS;
+    int            force_host   = 0;
+    const char     *csv_filename = NULL;
+    float          *input;
+    float          *output;
+    
+    /* Parse options.
+     */
+    {
+        for (int i = 1; i < argc; i += 1)
+        {
+            if ((strcmp(argv[i], "--warm") == 0) && ((i + 1) < argc))
+            {
+                warm_runs = atoi(argv[++i]);
+            }
+            else if ((strcmp(argv[i], "--cold") == 0) && ((i + 1) < argc))
+            {
+                cold_runs = atoi(argv[++i]);
+            }
+            else if ((strcmp(argv[i], "--max-elements") == 0) && ((i + 1) < argc))
+            {
+                max_elements = atol(argv[++i]);
+            }
+            else if ((strcmp(argv[i], "--csv") == 0) && ((i + 1) < argc))
+            {
+                csv_filename = argv[++i];
+            }
+            else if (strcmp(argv[i], "--host") == 0)
+            {
+                force_host = 1;
+            }
+            else if (strcmp(argv[i], "--copy") == 0)
+            {
+                signalSetZeroCopy(SIGNAL_ZERO_COPY_OFF);
+            }
+            else
+            {
+                printf("Usage: %s [--warm N] [--cold N] [--max-elements N] [--host] [--copy] [--csv FILE]\n", argv[0]);
+                return 1;
+            }
+        }
+        
+        if ((warm_runs < 1) || (warm_runs > BENCH_MAX_RUNS) || (cold_runs < 1) || (cold_runs > BENCH_MAX_RUNS))
+        {
+            printf("Bench Error: run counts must be between 1 and %d.\n", BENCH_MAX_RUNS);
+            return 1;
+        }
+    }
+    
+    /* Get device information, without a device the host implementation is timed.
+     */
+    {
+        clGetAllDeviceIDs(CL_DEVICE_TYPE_ALL, 10, my_device_list, &num_dev);
+        clPrintAllAvaliableDevicesInfo(my_device_list, num_dev);
+    }
+    
+    input  = (float *)clAllocHostMemory(max_elements * sizeof(float));
+    output = (float *)clAllocHostMemory(max_elements * sizeof(float));
+    
+    if ((input == NULL) || (output == NULL))
+    {
+        printf("Bench Error: cannot allocate %ld elements.\n", max_elements);
+        free(input);
+        free(output);
+        return 1;
+    }
+    
+    /* Operation and size sweep. The inverse transforms take the forward output's
+     * layout, a synthetic signal of the same size serves as well for timing.
+     */
+    for (int op = SIGNAL_1D_DCT; op <= SIGNAL_2D_IDCT; op += 1)
+    {
+        int is_2d     = (op == SIGNAL_2D_DCT) || (op == SIGNAL_2D_IDCT);
+        int min_size  = (is_2d != 0) ? BENCH_2D_MIN_SIZE : BENCH_1D_MIN_SIZE;
+        int size_step = (is_2d != 0) ? BENCH_2D_SIZE_STEP : BENCH_1D_SIZE_STEP;
+        
+        for (long size = min_size;
+             (((is_2d != 0) ? (size * size) : size) <= max_elements) && ((num_result + 2) <= BENCH_MAX_RESULTS);
+             size *= size_step)
+        {
+            signal_matrix_t input_signal;
+            signal_matrix_t ret_signal;
+            size_t          num_elements;
+            int             err;
+            
+            input_signal.signal        = input;
+            input_signal.input_dims[0] = (int)size;
+            input_signal.input_dims[1] = (is_2d != 0) ? (int)size : 0;
+            ret_signal.signal          = output;
+            ret_signal.input_dims[0]   = input_signal.input_dims[0];
+            ret_signal.input_dims[1]   = input_signal.input_dims[1];
+            num_elements               = (is_2d != 0) ? (size_t)(size * size) : (size_t)size;
+            
+            fillSignal(input, num_elements, (unsigned int)size);
+            
+            /* Cold runs, then warm runs on one component. */
+            err = runCold(my_device_list, num_dev, force_host, op, &input_signal, &ret_signal, cold_runs, ms);
+            
+            if (err == CL_SUCCESS)
+            {
+                cl_int init_err;
+                
+                result[num_result].operation_name = operation_name[op];
+                result[num_result].dims[0]        = input_signal.input_dims[0];
+                result[num_result].dims[1]        = input_signal.input_dims[1];
+                result[num_result].mode           = "cold";
+                result[num_result].runs           = cold_runs;
+                getRunStats(ms, cold_runs, &result[num_result].median_ms, &result[num_result].p95_ms);
+                num_result += 1;
+                
+                signalInit(my_device_list, num_dev, &init_err);
+                
+                if (force_host != 0)
+                {
+                    signalSetBackend(SIGNAL_BACKEND_HOST);
+                }
+                
+                err = runWarm(op, &input_signal, &ret_signal, warm_runs, ms);
+                
+                if (err == CL_SUCCESS)
+                {
+                    result[num_result].operation_name = operation_name[op];
+                    result[num_result].dims[0]        = input_signal.input_dims[0];
+                    result[num_result].dims[1]        = input_signal.input_dims[1];
+                    result[num_result].mode           = "warm";
+                    result[num_result].runs           = warm_runs;
+                    getRunStats(ms, warm_runs, &result[num_result].median_ms, &result[num_result].p95_ms);
+                    num_result += 1;
+                }
+                
+                signalDeinit(&init_err);
+            }
+            
+            if (err != CL_SUCCESS)
+            {
+                printf("Bench Error: %s of %ld elements failed: %d.\n", operation_name[op], (long)num_elements, err);
+            }
+        }
+    }
+    
+    free(input);
+    free(output);
+    
+    /* Print results, throughput from the median.
+     */
+    {
+        FILE *csv_file = NULL;
+        
+        if (csv_filename != NULL)
+        {
+            csv_file = fopen(csv_filename, "w");
+            
+            if (csv_file == NULL)
+            {
+                printf("Bench Error: cannot write %s.\n", csv_filename);
+            }
+            else
+            {
+                fprintf(csv_file, "component,operation,size,mode,runs,median_ms,p95_ms,throughput,unit\n");
+            }
+        }
+        
+        printf("\n%-10s %-11s %-5s %5s %12s %12s %14s\n", "operation", "size", "mode", "runs", "median ms", "p95 ms", "Melement/s");
+        
+        for (int i = 0; i < num_result; i += 1)
+        {
+            char   size_name[32];
+            double num_elements;
+            
+            num_elements = (double)result[i].dims[0] * ((result[i].dims[1] != 0) ? result[i].dims[1] : 1);
+            
+            result[i].melement_per_s = (result[i].median_ms > 0) ? (num_elements / (result[i].median_ms * 1000.0)) : 0;
+            
+            if (result[i].dims[1] != 0)
+            {
+                snprintf(size_name, sizeof(size_name), "%dx%d", result[i].dims[0], result[i].dims[1]);
+            }
+            else
+            {
+                snprintf(size_name, sizeof(size_name), "%d", result[i].dims[0]);
+            }
+            
+            printf("%-10s %-11s %-5s %5d %12.3f %12.3f %14.2f\n",
+                   result[i].operation_name,
+                   size_name,
+                   result[i].mode,
+                   result[i].runs,
+                   result[i].median_ms,
+                   result[i].p95_ms,
+                   result[i].melement_per_s);
+            
+            if (csv_file != NULL)
+            {
+                fprintf(csv_file, "signal,%s,%s,%s,%d,%.6f,%.6f,%.4f,Melement/s\n",
+                        result[i].operation_name,
+                        size_name,
+                        result[i].mode,
+                        result[i].runs,
+                        result[i].median_ms,
+                        result[i].p95_ms,
+                        result[i].melement_per_s);
+            }
+        }
+        
+        if (csv_file != NULL)
+        {
+            fclose(csv_file);
+        }
+    }
+    
+    return 0;
+}
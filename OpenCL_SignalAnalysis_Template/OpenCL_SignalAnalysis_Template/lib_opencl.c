@@ -2,7 +2,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <string.h>
+#include <time.h>
 
 #include "lib_opencl.h"
 
@@ -13,6 +16,8 @@
 #define ERR_GET_DEVICE_INFO_NOK    -5
 #define ERR_INVALID_CREATE_CONTEXT -6
 #define ERR_INVALID_CREATE_COMMAND -7
+#define ERR_PROFILE_DUMP_NOK       -8
+#define ERR_CACHE_DIR_NOK          -9
 
 #define INFO_VALID_SOURCE_CODE    (ERR_INVALID_SOURCE_CODE)
 #define INFO_CREATE_KERNEL_OK     (ERR_CREATE_KERNEL_NOK)
@@ -20,11 +25,153 @@
 #define INFO_VALID_CREATE_CONTEXT (ERR_INVALID_CREATE_CONTEXT)
 #define INFO_VALID_CREATE_COMMAND (ERR_INVALID_CREATE_COMMAND)
 
+#define PROGRAM_CACHE_MAGIC       0x43504C43u /* "CLPC" */
+#define PROGRAM_CACHE_VERSION     1u
+#define PROGRAM_CACHE_MAX_DEVICES 16
+#define PROGRAM_CACHE_KEY_SIZE    4096
+
+#define CL_DEVICE_SELECT_LINE_SIZE 1024
+#define CL_DEVICE_SELECT_MAX_LINES 16
+#define CL_CALIBRATION_MAX_DEVICES 16
+#define CL_CALIBRATION_MAX_RECORDS 32
+
+#define CL_TUNING_MAX_ENTRIES    256
+#define CL_TUNING_RUNS           3
+#define CL_TUNING_MIN_GROUP_SIZE 8
+#define CL_TUNING_LOOKUP_ENTRIES 64
+
+#define CL_MAX_PLATFORMS 8
+
+#define CL_PROFILE_MAX_RECORDS 4096
+#define CL_PROFILE_MAX_STAGES  64
+
+typedef struct {
+    char         component[32];
+    cl_device_id device;
+    double       ms;
+    cl_int       selected;
+    cl_int       cached;
+}calibration_record_t;
+
+typedef struct {
+    cl_ulong device_hash;
+    char     kernel_name[64];
+    cl_uint  work_dim;
+    size_t   global[3];   /* Size class, global rounded up to a power of two. */
+    size_t   local[3];    /* 0 selects the driver's choice. */
+    double   ms;
+    cl_int   tuned;       /* Tuned by this run. */
+}work_group_tuning_t;
+
+/* Resolved key of a queue and kernel, a hit needs no runtime queries. Queue and
+ * kernel are retained so their handles cannot be reused while listed.
+ */
+typedef struct {
+    cl_command_queue cmd_queue;
+    cl_kernel        kernel;
+    cl_uint          work_dim;
+    size_t           global[3];   /* Size class. */
+    cl_int           entry;       /* Index in work_group_tuning, -1 for the driver's choice. */
+}work_group_lookup_t;
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 static char * LoadProgramSrc(const char * filename);
 static void printOpenCLErrorMsg(int err);
 static void printOpenCLInfoMsg(int msg);
+static double getTimeMs(void);
+static cl_ulong hashBytes(cl_ulong hash, const void * data, size_t len);
+static void getProgramCacheKey(const cl_context * const device_context,
+                               const char  *src_code,
+                               const char  *options,
+                               char        *ret_key,
+                               cl_device_id *ret_devices,
+                               cl_uint     *ret_num_devices);
+static cl_int getCacheDir(char * const ret_dir, size_t len);
+static cl_int getCacheFileName(const char * const name, char * const ret_filename, size_t len);
+static FILE * openCacheFile(const char * const filename, const char * const mode);
+static FILE * createCacheFile(const char * const filename,
+                              char       * const ret_tmp_filename,
+                              size_t             len,
+                              const char * const mode);
+static void commitCacheFile(FILE       *       file_ptr,
+                            const char * const tmp_filename,
+                            const char * const filename);
+static cl_int getProgramCacheFileName(const char *key, char *ret_filename, size_t len);
+static cl_program loadCachedProgram(const cl_context * const device_context,
+                                    const char   *key,
+                                    cl_device_id *devices,
+                                    cl_uint       num_devices,
+                                    const char   *options,
+                                    double       *ret_build_time_ms);
+static void storeCachedProgram(cl_program   usr_prg,
+                               const char  *key,
+                               cl_uint      num_devices,
+                               double       build_time_ms);
+static cl_program buildProgramWithCache(const cl_context * const device_context,
+                                        const char  *src_code,
+                                        const char  *options,
+                                        cl_int      * const ret_err);
+
+static cl_ulong getDeviceSetHash(const char * const component,
+                                 cl_device_id * const device_list,
+                                 cl_int               device_num);
+static cl_int loadDeviceSelection(const char * const component,
+                                  cl_ulong             set_hash,
+                                  cl_int               device_num,
+                                  double       * const ret_ms);
+static void storeDeviceSelection(const char   * const component,
+                                 cl_ulong             set_hash,
+                                 cl_int               selected,
+                                 cl_int               device_num,
+                                 const double * const ms);
+static void addCalibrationRecord(const char * const component,
+                                 cl_device_id         device,
+                                 double               ms,
+                                 cl_int               selected,
+                                 cl_int               cached);
+static void loadWorkGroupTuning(void);
+static void storeWorkGroupTuning(void);
+static size_t getWorkGroupSizeClass(size_t size);
+static void addWorkGroupLookup(cl_command_queue     cmd_queue,
+                               cl_kernel            kernel,
+                               cl_uint              work_dim,
+                               const size_t * const global_key,
+                               cl_int               entry);
+static void releaseWorkGroupLookups(void);
+static void fitTunedWorkGroupSize(const work_group_tuning_t * const entry,
+                                  const size_t              * const global,
+                                  size_t                    * const ret_local);
+static double timeWorkGroupSize(cl_command_queue     cmd_queue,
+                                cl_kernel            kernel,
+                                cl_uint              work_dim,
+                                const size_t * const global,
+                                const size_t * const local,
+                                cl_int               use_events);
+static void resolveProfileEvents(void);
+static cl_int getProfileStats(profile_stage_stats_t * const ret_stats,
+                              cl_int                        max_stats);
+
+static program_cache_stats_t program_cache_stats = {0, 0, 0.0, 0.0};
+
+static calibration_record_t calibration_records[CL_CALIBRATION_MAX_RECORDS];
+static cl_int               num_calibration_records = 0;
+
+static work_group_tuning_t work_group_tuning[CL_TUNING_MAX_ENTRIES];
+static cl_int              num_work_group_tuning    = 0;
+static cl_int              work_group_tuning_loaded = 0;
+static cl_int              work_group_retune        = 0;
+
+static work_group_lookup_t work_group_lookup[CL_TUNING_LOOKUP_ENTRIES];
+static cl_int              num_work_group_lookup  = 0;
+static cl_int              next_work_group_lookup = 0;
+
+static profile_record_t profile_records[CL_PROFILE_MAX_RECORDS];
+static cl_event         profile_events[CL_PROFILE_MAX_RECORDS];
+static cl_int           num_profile_records  = 0;   /* Recorded, pending included. */
+static cl_int           num_profile_resolved = 0;   /* Records with their timestamps. */
+static cl_uint          num_profile_dropped  = 0;
+static cl_int           profiling_enable     = 0;
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -98,11 +245,21 @@ static void printOpenCLErrorMsg(int err)
             printf("Error OpenCL: Create command queue ... NOK.\n");
             break;
         }
+        case ERR_PROFILE_DUMP_NOK:
+        {
+            printf("Error OpenCL: Write profile ... NOK.\n");
+            break;
+        }
+        case ERR_CACHE_DIR_NOK:
+        {
+            printf("Error OpenCL: Private cache directory, caches disabled ... NOK.\n");
+            break;
+        }
         default:
         {
             break;
         }
-            
+        
     }
 }
 
@@ -140,283 +297,2131 @@ static void printOpenCLInfoMsg(int msg)
         }
     }
 }
-//////////////////////////////////////////////////////////////////////////////////////////////////
-
-
-//////////////////////////////////////////////////////////////////////////////////////////////////
-
-void clPrintAllAvaliableDevicesInfo(cl_device_id * usr_device_list,
-                                    cl_uint num_devices)
+static double getTimeMs(void)
 {
-    cl_device_type device_type;
+    struct timespec now;
     
-    cl_int         i;
-    cl_bool        ret_bool;
-    char ret_string[1024];
-    size_t ret_count;
+    clock_gettime(CLOCK_MONOTONIC, &now);
     
-    printf("Info: Number of devices: %d.\n", num_devices);
+    return ((double)now.tv_sec * 1000.0) + ((double)now.tv_nsec / 1000000.0);
+}
+
+static cl_ulong hashBytes(cl_ulong hash, const void * data, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t i;
     
-    for (i = 0;  i < num_devices; i += 1)
+    /* FNV-1a, 64 bits. */
+    for (i = 0; i < len; i += 1)
     {
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_NAME,
-                        sizeof(ret_string),
-                        ret_string,
-                        NULL);
-        printf("Device Name: %s.\n",ret_string);
-        
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_VENDOR,
-                        sizeof(ret_string),
-                        ret_string,
-                        NULL);
-        printf("\tInfo: Device Vendor: %s.\n", ret_string);
-        
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_TYPE,
-                        sizeof(device_type),
-                        &device_type,
-                        NULL);
-        switch (device_type)
-        {
-            case CL_DEVICE_TYPE_CPU:         {strcpy(ret_string, "CPU");         break;}
-            case CL_DEVICE_TYPE_GPU:         {strcpy(ret_string, "GPU");         break;}
-            case CL_DEVICE_TYPE_ACCELERATOR: {strcpy(ret_string, "ACCELERATOR"); break;}
-            case CL_DEVICE_TYPE_DEFAULT:     {strcpy(ret_string, "DEFAULT");     break;}
-            default:                         {break;}
-        }
-        printf("\tInfo: Device Type: %s.\n", ret_string);
-        
-        ret_count = 0;
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_MAX_COMPUTE_UNITS,
-                        sizeof(ret_count),
-                        &ret_count,
-                        NULL);
-        printf("\tInfo: Device Max Compute Units: %zu.\n", (ret_count));
-        
-        ret_count = 0;
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_MAX_WORK_GROUP_SIZE,
-                        sizeof(ret_count),
-                        &ret_count,
-                        NULL);
-        printf("\tInfo: Device Max Work Group Size: %zu. \n", (ret_count));
-        
-        ret_count = 0;
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS,
-                        sizeof(ret_count),
-                        &ret_count,
-                        NULL);
-        printf("\tInfo: Device Max Work Item Dimensions: %zu.\n", (ret_count));
-        
-        ret_count = 0;
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE,
-                        sizeof(ret_count),
-                        &ret_count,
-                        NULL);
-        printf("\tInfo: Device Max Constant Buffer Size: %zu Kbytes.\n", (ret_count/1024));
-        
-        ret_count = 0;
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_GLOBAL_MEM_SIZE,
-                        sizeof(ret_count),
-                        &ret_count,
-                        NULL);
-        printf("\tInfo: Device Global Memory Size: %zu Mbytes.\n",(ret_count/(2*1024)));
-        
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_IMAGE_SUPPORT,
-                        sizeof(ret_bool),
-                        &ret_bool,
-                        NULL);
-        
-        printf("\tInfo: Device Support Image: %s.\n", (ret_bool == CL_TRUE) ? "YES" : "NO");
-        
-        ret_count = 0;
-        clGetDeviceInfo(usr_device_list[i],
-                        CL_DEVICE_MAX_SAMPLERS,
-                        sizeof(ret_count),
-                        &ret_count,
-                        NULL);
-        printf("\tInfo: Device Maximum Samplers: %zu.\n",ret_count);
+        hash ^= (cl_ulong)bytes[i];
+        hash *= 0x100000001B3ull;
     }
+    
+    return (hash);
 }
 
-void clCreateKernelObjsForContext(const cl_context * const device_context,
-                                  const char  *filename,
-                                  const char  *prg_name[],
-                                  cl_int      num_kernel,
-                                  cl_kernel   * const ret_kernel,
-                                  cl_int      * const ret_err)
+static void getProgramCacheKey(const cl_context * const device_context,
+                               const char  *src_code,
+                               const char  *options,
+                               char        *ret_key,
+                               cl_device_id *ret_devices,
+                               cl_uint     *ret_num_devices)
 {
-    cl_int       err;
-    cl_program   usr_prg;
-    cl_uint      i;
-    char         *src_code;
+    char    dev_name[256];
+    char    dev_version[256];
+    char    drv_version[256];
+    size_t  key_len;
+    cl_uint i;
     
-    /* Load source code.
+    /* The key is built from the source hash, the build options and the name/driver
+     * of every device in the context, so any change forces a rebuild.
      */
-    src_code = LoadProgramSrc(filename);
+    *ret_num_devices = 0;
+    clGetContextInfo(*device_context,
+                     CL_CONTEXT_NUM_DEVICES,
+                     sizeof(cl_uint),
+                     ret_num_devices,
+                     NULL);
     
-    if (src_code == 0)
+    if (*ret_num_devices > PROGRAM_CACHE_MAX_DEVICES)
     {
-        *ret_err = ERR_INVALID_SOURCE_CODE;
-        printOpenCLErrorMsg(ERR_INVALID_SOURCE_CODE);
+        *ret_num_devices = 0;
+        ret_key[0] = '\0';
         return;
     }
-    else
-    {
-        printOpenCLInfoMsg(INFO_VALID_SOURCE_CODE);
-    }
     
+    clGetContextInfo(*device_context,
+                     CL_CONTEXT_DEVICES,
+                     (*ret_num_devices) * sizeof(cl_device_id),
+                     ret_devices,
+                     NULL);
     
-    /* Create program with source object.
-     */
-    usr_prg = clCreateProgramWithSource((*device_context),
-                                        1,
-                                        (const char ** )&src_code,
-                                        NULL,
-                                        &err);
+    key_len = snprintf(ret_key,
+                       PROGRAM_CACHE_KEY_SIZE,
+                       "src=%016llx;opt=%s;",
+                       (unsigned long long)hashBytes(0xCBF29CE484222325ull, src_code, strlen(src_code)),
+                       (options != NULL) ? options : "");
     
-    if ((0 == usr_prg) || (err != CL_SUCCESS))
+    for (i = 0; (i < *ret_num_devices) && (key_len < PROGRAM_CACHE_KEY_SIZE); i += 1)
     {
-        *ret_err = ERR_SRC_CODE_NOK;
-        return;
+        dev_name[0] = dev_version[0] = drv_version[0] = '\0';
+        clGetDeviceInfo(ret_devices[i], CL_DEVICE_NAME,    sizeof(dev_name),    dev_name,    NULL);
+        clGetDeviceInfo(ret_devices[i], CL_DEVICE_VERSION, sizeof(dev_version), dev_version, NULL);
+        clGetDeviceInfo(ret_devices[i], CL_DRIVER_VERSION, sizeof(drv_version), drv_version, NULL);
+        
+        key_len += snprintf(&ret_key[key_len],
+                            PROGRAM_CACHE_KEY_SIZE - key_len,
+                            "dev=%s/%s/%s;",
+                            dev_name,
+                            dev_version,
+                            drv_version);
     }
+}
+
+static cl_int getCacheDir(char * const ret_dir, size_t len)
+{
+    static char   cache_dir[1024];
+    static cl_int cache_dir_state = 0;   /* 0 unresolved, 1 usable, -1 disabled. */
+    struct stat   info;
+    const char    *base;
+    char          base_dir[1024];
     
-    /* Build program for all devices.
-     */
-    err = clBuildProgram(usr_prg,
-                         0,
-                         NULL,
-                         NULL,
-                         NULL,
-                         NULL);
-    if (err != CL_SUCCESS)
+    if (cache_dir_state == 0)
     {
-        char   error_log[2048];
-        size_t len;
+        cache_dir_state = -1;
+        cache_dir[0]    = '\0';
         
-        printOpenCLErrorMsg(ERR_SRC_BUILD_FAILED);
+        /* Relative names live in $XDG_CACHE_HOME, or ~/.cache without it. */
+        if (CL_PROGRAM_CACHE_DIR[0] == '/')
+        {
+            snprintf(cache_dir, sizeof(cache_dir), "%s", CL_PROGRAM_CACHE_DIR);
+        }
+        else if (CL_PROGRAM_CACHE_DIR[0] != '\0')
+        {
+            base = getenv("XDG_CACHE_HOME");
+            
+            if ((base != NULL) && (base[0] == '/'))
+            {
+                snprintf(base_dir, sizeof(base_dir), "%s", base);
+            }
+            else if (((base = getenv("HOME")) != NULL) && (base[0] == '/'))
+            {
+                snprintf(base_dir, sizeof(base_dir), "%s/.cache", base);
+            }
+            else
+            {
+                base_dir[0] = '\0';
+            }
+            
+            if (base_dir[0] != '\0')
+            {
+                mkdir(base_dir, 0700);
+                snprintf(cache_dir, sizeof(cache_dir), "%s/%s", base_dir, CL_PROGRAM_CACHE_DIR);
+            }
+        }
         
-        /* Print build log in case of failure in compilation.
+        /* Only a directory of this user that nobody else can write is trusted, the
+         * program binaries in it run on the device.
          */
-        clGetProgramBuildInfo(usr_prg,
-                              NULL,
-                              CL_PROGRAM_BUILD_LOG,
-                              sizeof(error_log),
-                              error_log,
-                              &len);
-        printf("\tError log: %s", error_log);
-        
-        *ret_err = err;
-        return;
+        if (cache_dir[0] != '\0')
+        {
+            mkdir(cache_dir, 0700);
+            
+            if (   (lstat(cache_dir, &info) == 0)
+                && (S_ISDIR(info.st_mode))
+                && (info.st_uid == getuid())
+                && ((info.st_mode & (S_IRWXG | S_IRWXO)) == 0))
+            {
+                cache_dir_state = 1;
+            }
+            else
+            {
+                printOpenCLErrorMsg(ERR_CACHE_DIR_NOK);
+            }
+        }
     }
     
-    for (i = 0; i < num_kernel; i += 1)
+    if (cache_dir_state < 0)
     {
-        /* Create kernel objects for all functions found in user cl file.
-         */
-        ret_kernel[i] = clCreateKernel(usr_prg,
-                                       prg_name[i],
-                                       &err);
-        if (err != CL_SUCCESS)
-        {
-            printOpenCLErrorMsg(ERR_CREATE_KERNEL_NOK);
-            *ret_err = err;
-            return;
-        }
+        return (0);
     }
     
-    printOpenCLInfoMsg(INFO_CREATE_KERNEL_OK);
+    snprintf(ret_dir, len, "%s", cache_dir);
     
-    /* Tear down usr_prg.
-     */
-    clReleaseProgram(usr_prg);
-    free(src_code);
+    return (1);
+}
+
+static cl_int getCacheFileName(const char * const name, char * const ret_filename, size_t len)
+{
+    char dir[1024];
     
-    *ret_err = CL_SUCCESS;
+    if (getCacheDir(dir, sizeof(dir)) == 0)
+    {
+        return (0);
+    }
+    
+    return (snprintf(ret_filename, len, "%s/%s", dir, name) < (int)len);
 }
 
-void clCreateDeviceAndContext(cl_device_id     * const device_list,
-                              cl_int                   device_num,
-                              cl_context       * const device_context,
-                              cl_command_queue * const device_cmd_queue,
-                              cl_int           * const ret_err)
+static FILE * openCacheFile(const char * const filename, const char * const mode)
 {
-    cl_int err;
-    cl_int i;
+    struct stat info;
+    FILE        *file_ptr;
+    int         fd;
     
-    err = 0;
+    fd = open(filename, O_RDONLY | O_NOFOLLOW);
     
-    for (i = 0; i < device_num; i += 1)
+    if (fd < 0)
     {
-        /* Get device information for index i.
-         */
-        err |= clGetDeviceIDs(NULL,
-                              CL_DEVICE_TYPE_ALL,
-                              1,
-                              &device_list[i],
-                              NULL);
+        return (NULL);
     }
     
-    if (err != CL_SUCCESS)
+    /* Same ownership rule as the directory, for entries put there by other means. */
+    if (   (fstat(fd, &info) != 0)
+        || (!S_ISREG(info.st_mode))
+        || (info.st_uid != getuid())
+        || ((info.st_mode & (S_IWGRP | S_IWOTH)) != 0))
     {
-        *ret_err = err;
-        printOpenCLErrorMsg(ERR_GET_DEVICE_INFO_NOK);
-        return;
+        close(fd);
+        return (NULL);
     }
-    else
+    
+    file_ptr = fdopen(fd, mode);
+    
+    if (file_ptr == NULL)
     {
-        printOpenCLInfoMsg(INFO_GET_DEVICE_INFO_OK);
+        close(fd);
     }
     
-    /* Create context for GPU.
-     * ToDo: Update the method for creating context.
-     */
-    *device_context = clCreateContext(0,
-                                      1,
-                                      &device_list[1],
-                                      NULL,
-                                      NULL,
-                                      &err);
+    return (file_ptr);
+}
+
+static FILE * createCacheFile(const char * const filename,
+                              char       * const ret_tmp_filename,
+                              size_t             len,
+                              const char * const mode)
+{
+    FILE *file_ptr;
+    int  fd;
     
-    /* Create command for GPU.
-     * ToDo: Update the method for creating context.
-     */
-    if (err != CL_SUCCESS)
+    /* A unique file per writer, concurrent processes never share one. */
+    if (snprintf(ret_tmp_filename, len, "%s.XXXXXX", filename) >= (int)len)
     {
-        *ret_err = err;
-        printOpenCLErrorMsg(ERR_INVALID_CREATE_CONTEXT);
-        return;
+        return (NULL);
     }
-    else
+    
+    fd = mkstemp(ret_tmp_filename);
+    
+    if (fd < 0)
     {
-        printOpenCLInfoMsg(INFO_VALID_CREATE_CONTEXT);
+        return (NULL);
     }
     
-    *device_cmd_queue = clCreateCommandQueue(*device_context,
-                                             device_list[1],
-                                             0,
-                                             &err);
-    if (err != CL_SUCCESS)
+    file_ptr = fdopen(fd, mode);
+    
+    if (file_ptr == NULL)
     {
-        *ret_err = err;
-        printOpenCLErrorMsg(ERR_INVALID_CREATE_COMMAND);
-        return;
+        close(fd);
+        remove(ret_tmp_filename);
     }
-    else
-    {
-        printOpenCLInfoMsg(INFO_VALID_CREATE_COMMAND);
+    
+    return (file_ptr);
+}
+
+static void commitCacheFile(FILE       *       file_ptr,
+                            const char * const tmp_filename,
+                            const char * const filename)
+{
+    cl_int complete = (ferror(file_ptr) == 0);
+    
+    complete &= (fclose(file_ptr) == 0);
+    
+    /* Rename once complete so a concurrent reader never sees a partial file. */
+    if ((complete == 0) || (rename(tmp_filename, filename) != 0))
+    {
+        remove(tmp_filename);
+    }
+}
+
+static cl_int getProgramCacheFileName(const char *key, char *ret_filename, size_t len)
+{
+    char name[64];
+    
+    snprintf(name,
+             sizeof(name),
+             "clprg_%016llx.bin",
+             (unsigned long long)hashBytes(0xCBF29CE484222325ull, key, strlen(key)));
+    
+    return (getCacheFileName(name, ret_filename, len));
+}
+
+static cl_program loadCachedProgram(const cl_context * const device_context,
+                                    const char   *key,
+                                    cl_device_id *devices,
+                                    cl_uint       num_devices,
+                                    const char   *options,
+                                    double       *ret_build_time_ms)
+{
+    char           filename[1024];
+    char           *file_key;
+    FILE           *file_ptr;
+    cl_uint        header[3];
+    cl_ulong       file_sizes[PROGRAM_CACHE_MAX_DEVICES];
+    size_t         bin_sizes[PROGRAM_CACHE_MAX_DEVICES];
+    unsigned char  *bins[PROGRAM_CACHE_MAX_DEVICES];
+    cl_int         bin_status[PROGRAM_CACHE_MAX_DEVICES];
+    cl_program     usr_prg;
+    cl_uint        file_num_devices;
+    cl_uint        i;
+    cl_int         err;
+    
+    if (getProgramCacheFileName(key, filename, sizeof(filename)) == 0)
+    {
+        return (NULL);
+    }
+    
+    file_ptr = openCacheFile(filename, "rb");
+    if (file_ptr == NULL)
+    {
+        return (NULL);
+    }
+    
+    usr_prg  = NULL;
+    file_key = NULL;
+    memset(bins, 0, sizeof(bins));
+    
+    /* Header: magic, version, key length; then key, build time, device count,
+     * binary sizes and binaries.
+     */
+    if (   (fread(header, sizeof(header), 1, file_ptr) != 1)
+        || (header[0] != PROGRAM_CACHE_MAGIC)
+        || (header[1] != PROGRAM_CACHE_VERSION)
+        || (header[2] != strlen(key)))
+    {
+        fclose(file_ptr);
+        return (NULL);
+    }
+    
+    file_key = (char *)malloc(header[2] + 1);
+    
+    if (   (file_key == NULL)
+        || (fread(file_key, header[2], 1, file_ptr) != 1)
+        || (fread(ret_build_time_ms, sizeof(double), 1, file_ptr) != 1)
+        || (fread(&file_num_devices, sizeof(cl_uint), 1, file_ptr) != 1)
+        || (file_num_devices != num_devices)
+        || (fread(file_sizes, sizeof(cl_ulong), num_devices, file_ptr) != num_devices))
+    {
+        free(file_key);
+        fclose(file_ptr);
+        return (NULL);
+    }
+    
+    file_key[header[2]] = '\0';
+    
+    /* Hash collision or stale file, rebuild from source. */
+    if (strcmp(file_key, key) != 0)
+    {
+        free(file_key);
+        fclose(file_ptr);
+        return (NULL);
+    }
+    free(file_key);
+    
+    for (i = 0; i < num_devices; i += 1)
+    {
+        bin_sizes[i] = (size_t)file_sizes[i];
+        bins[i]      = (unsigned char *)malloc(bin_sizes[i]);
+        
+        if ((bins[i] == NULL) || (fread(bins[i], bin_sizes[i], 1, file_ptr) != 1))
+        {
+            break;
+        }
+    }
+    fclose(file_ptr);
+    
+    if (i == num_devices)
+    {
+        usr_prg = clCreateProgramWithBinary((*device_context),
+                                            num_devices,
+                                            devices,
+                                            bin_sizes,
+                                            (const unsigned char **)bins,
+                                            bin_status,
+                                            &err);
+        
+        if ((usr_prg != NULL) && (err == CL_SUCCESS))
+        {
+            err = clBuildProgram(usr_prg, 0, NULL, options, NULL, NULL);
+        }
+        
+        if ((usr_prg != NULL) && (err != CL_SUCCESS))
+        {
+            clReleaseProgram(usr_prg);
+            usr_prg = NULL;
+        }
+    }
+    
+    for (i = 0; i < num_devices; i += 1)
+    {
+        free(bins[i]);
+    }
+    
+    return (usr_prg);
+}
+
+static void storeCachedProgram(cl_program   usr_prg,
+                               const char  *key,
+                               cl_uint      num_devices,
+                               double       build_time_ms)
+{
+    char           filename[1024];
+    char           tmp_filename[1040];
+    FILE           *file_ptr;
+    cl_uint        header[3];
+    cl_ulong       file_sizes[PROGRAM_CACHE_MAX_DEVICES];
+    size_t         bin_sizes[PROGRAM_CACHE_MAX_DEVICES];
+    unsigned char  *bins[PROGRAM_CACHE_MAX_DEVICES];
+    cl_int         err;
+    cl_uint        i;
+    
+    err = clGetProgramInfo(usr_prg,
+                           CL_PROGRAM_BINARY_SIZES,
+                           num_devices * sizeof(size_t),
+                           bin_sizes,
+                           NULL);
+    if (err != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    memset(bins, 0, sizeof(bins));
+    
+    for (i = 0; i < num_devices; i += 1)
+    {
+        bins[i]       = (unsigned char *)malloc(bin_sizes[i]);
+        file_sizes[i] = (cl_ulong)bin_sizes[i];
+        
+        if (bins[i] == NULL)
+        {
+            err = CL_OUT_OF_HOST_MEMORY;
+        }
+    }
+    
+    if (err == CL_SUCCESS)
+    {
+        err = clGetProgramInfo(usr_prg,
+                               CL_PROGRAM_BINARIES,
+                               num_devices * sizeof(unsigned char *),
+                               bins,
+                               NULL);
+    }
+    
+    file_ptr = NULL;
+    
+    if ((err == CL_SUCCESS) && (getProgramCacheFileName(key, filename, sizeof(filename)) != 0))
+    {
+        file_ptr = createCacheFile(filename, tmp_filename, sizeof(tmp_filename), "wb");
+    }
+    
+    if (file_ptr != NULL)
+    {
+        header[0] = PROGRAM_CACHE_MAGIC;
+        header[1] = PROGRAM_CACHE_VERSION;
+        header[2] = (cl_uint)strlen(key);
+        
+        fwrite(header, sizeof(header), 1, file_ptr);
+        fwrite(key, header[2], 1, file_ptr);
+        fwrite(&build_time_ms, sizeof(double), 1, file_ptr);
+        fwrite(&num_devices, sizeof(cl_uint), 1, file_ptr);
+        fwrite(file_sizes, sizeof(cl_ulong), num_devices, file_ptr);
+        
+        for (i = 0; i < num_devices; i += 1)
+        {
+            fwrite(bins[i], bin_sizes[i], 1, file_ptr);
+        }
+        
+        commitCacheFile(file_ptr, tmp_filename, filename);
+    }
+    
+    for (i = 0; i < num_devices; i += 1)
+    {
+        free(bins[i]);
+    }
+}
+
+static cl_program buildProgramWithCache(const cl_context * const device_context,
+                                        const char  *src_code,
+                                        const char  *options,
+                                        cl_int      * const ret_err)
+{
+    char         *key;
+    cl_device_id devices[PROGRAM_CACHE_MAX_DEVICES];
+    cl_uint      num_devices;
+    cl_program   usr_prg;
+    cl_int       err;
+    double       start_time_ms;
+    double       build_time_ms;
+    double       load_time_ms;
+    
+    key         = NULL;
+    num_devices = 0;
+    
+    if (CL_PROGRAM_CACHE_DIR[0] != '\0')
+    {
+        key = (char *)malloc(PROGRAM_CACHE_KEY_SIZE);
+        
+        if (key != NULL)
+        {
+            getProgramCacheKey(device_context, src_code, options, key, devices, &num_devices);
+        }
+    }
+    
+    /* Try the cached binary first. */
+    if (num_devices > 0)
+    {
+        start_time_ms = getTimeMs();
+        usr_prg       = loadCachedProgram(device_context, key, devices, num_devices, options, &build_time_ms);
+        load_time_ms  = getTimeMs() - start_time_ms;
+        
+        if (usr_prg != NULL)
+        {
+            program_cache_stats.hit_count     += 1;
+            program_cache_stats.saved_time_ms += (build_time_ms - load_time_ms);
+            
+            printf("Info OpenCL: Program cache hit ... OK (load %.2f ms, saved %.2f ms).\n",
+                   load_time_ms,
+                   (build_time_ms - load_time_ms));
+            
+            free(key);
+            *ret_err = CL_SUCCESS;
+            return (usr_prg);
+        }
+    }
+    
+    /* Create program with source object.
+     */
+    start_time_ms = getTimeMs();
+    usr_prg = clCreateProgramWithSource((*device_context),
+                                        1,
+                                        (const char ** )&src_code,
+                                        NULL,
+                                        &err);
+    
+    if ((0 == usr_prg) || (err != CL_SUCCESS))
+    {
+        free(key);
+        *ret_err = ERR_SRC_CODE_NOK;
+        return (NULL);
+    }
+    
+    /* Build program for all devices.
+     */
+    err = clBuildProgram(usr_prg,
+                         0,
+                         NULL,
+                         options,
+                         NULL,
+                         NULL);
+    if (err != CL_SUCCESS)
+    {
+        char   error_log[2048];
+        size_t len;
+        
+        printOpenCLErrorMsg(ERR_SRC_BUILD_FAILED);
+        
+        /* Print build log in case of failure in compilation.
+         */
+        clGetProgramBuildInfo(usr_prg,
+                              (num_devices > 0) ? devices[0] : NULL,
+                              CL_PROGRAM_BUILD_LOG,
+                              sizeof(error_log),
+                              error_log,
+                              &len);
+        printf("\tError log: %s", error_log);
+        
+        clReleaseProgram(usr_prg);
+        free(key);
+        *ret_err = err;
+        return (NULL);
+    }
+    build_time_ms = getTimeMs() - start_time_ms;
+    
+    program_cache_stats.miss_count    += 1;
+    program_cache_stats.build_time_ms += build_time_ms;
+    
+    if (num_devices > 0)
+    {
+        printf("Info OpenCL: Program cache miss ... built in %.2f ms.\n", build_time_ms);
+        storeCachedProgram(usr_prg, key, num_devices, build_time_ms);
+    }
+    
+    free(key);
+    *ret_err = CL_SUCCESS;
+    return (usr_prg);
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cl_ulong getDeviceSetHash(const char * const component,
+                                 cl_device_id * const device_list,
+                                 cl_int               device_num)
+{
+    char     info[256];
+    cl_ulong hash;
+    cl_int   i;
+    
+    /* Any change of the candidate devices or their drivers invalidates the choice. */
+    hash = hashBytes(0xCBF29CE484222325ull, component, strlen(component));
+    
+    for (i = 0; i < device_num; i += 1)
+    {
+        info[0] = '\0';
+        clGetDeviceInfo(device_list[i], CL_DEVICE_NAME, sizeof(info), info, NULL);
+        hash = hashBytes(hash, info, strlen(info));
+        
+        info[0] = '\0';
+        clGetDeviceInfo(device_list[i], CL_DRIVER_VERSION, sizeof(info), info, NULL);
+        hash = hashBytes(hash, info, strlen(info));
+    }
+    
+    return (hash);
+}
+
+static cl_int loadDeviceSelection(const char * const component,
+                                  cl_ulong             set_hash,
+                                  cl_int               device_num,
+                                  double       * const ret_ms)
+{
+    char     filename[1024];
+    char     line[CL_DEVICE_SELECT_LINE_SIZE];
+    char     name[64];
+    unsigned long long hash;
+    FILE     *file_ptr;
+    cl_int   selected;
+    cl_int   num;
+    cl_int   offset;
+    cl_int   i;
+    
+    if (getCacheFileName(CL_DEVICE_SELECT_CACHE_FILE, filename, sizeof(filename)) == 0)
+    {
+        return (-1);
+    }
+    
+    file_ptr = openCacheFile(filename, "r");
+    
+    if (file_ptr == NULL)
+    {
+        return (-1);
+    }
+    
+    /* One line per component: name, device set hash, selected index, device count
+     * and the calibration time of every device.
+     */
+    selected = -1;
+    
+    while ((selected < 0) && (fgets(line, sizeof(line), file_ptr) != NULL))
+    {
+        if (   (sscanf(line, "%63s %llx %d %d%n", name, &hash, &selected, &num, &offset) != 4)
+            || (strcmp(name, component) != 0)
+            || ((cl_ulong)hash != set_hash)
+            || (num != device_num)
+            || (selected < 0)
+            || (selected >= device_num))
+        {
+            selected = -1;
+            continue;
+        }
+        
+        for (i = 0; i < num; i += 1)
+        {
+            cl_int consumed = 0;
+            
+            if (sscanf(&line[offset], "%lf%n", &ret_ms[i], &consumed) != 1)
+            {
+                selected = -1;
+                break;
+            }
+            
+            offset += consumed;
+        }
+    }
+    
+    fclose(file_ptr);
+    
+    return (selected);
+}
+
+static void storeDeviceSelection(const char   * const component,
+                                 cl_ulong             set_hash,
+                                 cl_int               selected,
+                                 cl_int               device_num,
+                                 const double * const ms)
+{
+    char   filename[1024];
+    char   tmp_filename[1040];
+    char   line[CL_DEVICE_SELECT_LINE_SIZE];
+    char   name[64];
+    char   *kept;
+    size_t kept_len;
+    size_t kept_size;
+    FILE   *file_ptr;
+    cl_int i;
+    
+    if (getCacheFileName(CL_DEVICE_SELECT_CACHE_FILE, filename, sizeof(filename)) == 0)
+    {
+        return;
+    }
+    
+    /* Keep the lines of the other components, replace this one. */
+    kept_size = CL_DEVICE_SELECT_MAX_LINES * CL_DEVICE_SELECT_LINE_SIZE;
+    kept      = (char *)malloc(kept_size);
+    kept_len  = 0;
+    
+    if (kept == NULL)
+    {
+        return;
+    }
+    
+    kept[0]  = '\0';
+    file_ptr = openCacheFile(filename, "r");
+    
+    /* Whole lines only, the last one in the buffer stays free for this component. */
+    if (file_ptr != NULL)
+    {
+        for (i = 0; (i < (CL_DEVICE_SELECT_MAX_LINES - 1)) && (fgets(line, sizeof(line), file_ptr) != NULL); i += 1)
+        {
+            size_t line_len = strlen(line);
+            
+            if (   (sscanf(line, "%63s", name) == 1)
+                && (strcmp(name, component) != 0)
+                && ((kept_len + line_len) < kept_size))
+            {
+                memcpy(&kept[kept_len], line, line_len + 1);
+                kept_len += line_len;
+            }
+        }
+        
+        fclose(file_ptr);
+    }
+    
+    /* Replaced by rename, a concurrent reader sees the old or the new file. */
+    file_ptr = createCacheFile(filename, tmp_filename, sizeof(tmp_filename), "w");
+    
+    if (file_ptr != NULL)
+    {
+        fputs(kept, file_ptr);
+        fprintf(file_ptr, "%s %016llx %d %d", component, (unsigned long long)set_hash, selected, device_num);
+        
+        for (i = 0; i < device_num; i += 1)
+        {
+            fprintf(file_ptr, " %.6f", ms[i]);
+        }
+        
+        fprintf(file_ptr, "\n");
+        commitCacheFile(file_ptr, tmp_filename, filename);
+    }
+    
+    free(kept);
+}
+
+static void addCalibrationRecord(const char * const component,
+                                 cl_device_id         device,
+                                 double               ms,
+                                 cl_int               selected,
+                                 cl_int               cached)
+{
+    calibration_record_t *record;
+    cl_int                i;
+    
+    /* Recalibrating a component replaces its records for the same device. */
+    for (i = 0; i < num_calibration_records; i += 1)
+    {
+        if (   (calibration_records[i].device == device)
+            && (strcmp(calibration_records[i].component, component) == 0))
+        {
+            break;
+        }
+    }
+    
+    if (i >= CL_CALIBRATION_MAX_RECORDS)
+    {
+        return;
+    }
+    
+    record = &calibration_records[i];
+    
+    snprintf(record->component, sizeof(record->component), "%s", component);
+    record->device   = device;
+    record->ms       = ms;
+    record->selected = selected;
+    record->cached   = cached;
+    
+    if (i == num_calibration_records)
+    {
+        num_calibration_records += 1;
+    }
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void loadWorkGroupTuning(void)
+{
+    char                filename[1024];
+    char                line[CL_DEVICE_SELECT_LINE_SIZE];
+    unsigned long long  hash;
+    unsigned long long  global[3];
+    unsigned long long  local[3];
+    work_group_tuning_t *entry;
+    FILE                *file_ptr;
+    
+    work_group_tuning_loaded = 1;
+    
+    if (getCacheFileName(CL_WORK_GROUP_TUNING_FILE, filename, sizeof(filename)) == 0)
+    {
+        return;
+    }
+    
+    file_ptr = openCacheFile(filename, "r");
+    
+    if (file_ptr == NULL)
+    {
+        return;
+    }
+    
+    /* One line per key: device hash, kernel name, dimensions, global size, best
+     * local size (0 for the driver's choice) and its time.
+     */
+    while (   (num_work_group_tuning < CL_TUNING_MAX_ENTRIES)
+           && (fgets(line, sizeof(line), file_ptr) != NULL))
+    {
+        entry = &work_group_tuning[num_work_group_tuning];
+        
+        if (sscanf(line, "%llx %63s %u %llu %llu %llu %llu %llu %llu %lf",
+                   &hash,
+                   entry->kernel_name,
+                   &entry->work_dim,
+                   &global[0], &global[1], &global[2],
+                   &local[0], &local[1], &local[2],
+                   &entry->ms) != 10)
+        {
+            continue;
+        }
+        
+        entry->device_hash = (cl_ulong)hash;
+        entry->tuned       = 0;
+        
+        for (int i = 0; i < 3; i += 1)
+        {
+            entry->global[i] = (size_t)global[i];
+            entry->local[i]  = (size_t)local[i];
+        }
+        
+        num_work_group_tuning += 1;
+    }
+    
+    fclose(file_ptr);
+}
+
+static void storeWorkGroupTuning(void)
+{
+    char   filename[1024];
+    char   tmp_filename[1040];
+    FILE   *file_ptr;
+    cl_int i;
+    
+    if (getCacheFileName(CL_WORK_GROUP_TUNING_FILE, filename, sizeof(filename)) == 0)
+    {
+        return;
+    }
+    
+    /* Every process writes its own file and renames it into place, concurrent
+     * tuners replace each other's table but never interleave their lines.
+     */
+    file_ptr = createCacheFile(filename, tmp_filename, sizeof(tmp_filename), "w");
+    
+    if (file_ptr == NULL)
+    {
+        return;
+    }
+    
+    for (i = 0; i < num_work_group_tuning; i += 1)
+    {
+        const work_group_tuning_t *entry = &work_group_tuning[i];
+        
+        fprintf(file_ptr, "%016llx %s %u %llu %llu %llu %llu %llu %llu %.6f\n",
+                (unsigned long long)entry->device_hash,
+                entry->kernel_name,
+                entry->work_dim,
+                (unsigned long long)entry->global[0],
+                (unsigned long long)entry->global[1],
+                (unsigned long long)entry->global[2],
+                (unsigned long long)entry->local[0],
+                (unsigned long long)entry->local[1],
+                (unsigned long long)entry->local[2],
+                entry->ms);
+    }
+    
+    commitCacheFile(file_ptr, tmp_filename, filename);
+}
+
+static size_t getWorkGroupSizeClass(size_t size)
+{
+    size_t size_class = 1;
+    
+    while (size_class < size)
+    {
+        size_class *= 2;
+    }
+    
+    return (size_class);
+}
+
+static void addWorkGroupLookup(cl_command_queue     cmd_queue,
+                               cl_kernel            kernel,
+                               cl_uint              work_dim,
+                               const size_t * const global_key,
+                               cl_int               entry)
+{
+    work_group_lookup_t *lookup;
+    
+    /* Replace the oldest lookup once the list is full. */
+    if (num_work_group_lookup < CL_TUNING_LOOKUP_ENTRIES)
+    {
+        lookup = &work_group_lookup[num_work_group_lookup];
+        num_work_group_lookup += 1;
+    }
+    else
+    {
+        lookup = &work_group_lookup[next_work_group_lookup];
+        next_work_group_lookup = (next_work_group_lookup + 1) % CL_TUNING_LOOKUP_ENTRIES;
+        
+        clReleaseKernel(lookup->kernel);
+        clReleaseCommandQueue(lookup->cmd_queue);
+    }
+    
+    clRetainCommandQueue(cmd_queue);
+    clRetainKernel(kernel);
+    
+    lookup->cmd_queue = cmd_queue;
+    lookup->kernel    = kernel;
+    lookup->work_dim  = work_dim;
+    lookup->global[0] = global_key[0];
+    lookup->global[1] = global_key[1];
+    lookup->global[2] = global_key[2];
+    lookup->entry     = entry;
+}
+
+static void releaseWorkGroupLookups(void)
+{
+    cl_int i;
+    
+    for (i = 0; i < num_work_group_lookup; i += 1)
+    {
+        clReleaseKernel(work_group_lookup[i].kernel);
+        clReleaseCommandQueue(work_group_lookup[i].cmd_queue);
+    }
+    
+    num_work_group_lookup  = 0;
+    next_work_group_lookup = 0;
+}
+
+static void fitTunedWorkGroupSize(const work_group_tuning_t * const entry,
+                                  const size_t              * const global,
+                                  size_t                    * const ret_local)
+{
+    size_t group_size = 1;
+    size_t tuned_size = 1;
+    cl_int i;
+    
+    if (entry->local[0] == 0)
+    {
+        return;
+    }
+    
+    /* The stored sizes divide the global size the class was tuned with, halve them
+     * until they divide this one. Groups left below CL_TUNING_MIN_GROUP_SIZE fall
+     * back to the driver's choice.
+     */
+    for (i = 0; i < (cl_int)entry->work_dim; i += 1)
+    {
+        ret_local[i] = entry->local[i];
+        
+        while ((ret_local[i] > 1) && ((global[i] % ret_local[i]) != 0))
+        {
+            ret_local[i] /= 2;
+        }
+        
+        group_size *= ret_local[i];
+        tuned_size *= entry->local[i];
+    }
+    
+    if ((group_size < CL_TUNING_MIN_GROUP_SIZE) && (group_size < tuned_size))
+    {
+        ret_local[0] = 0;
+        ret_local[1] = 0;
+        ret_local[2] = 0;
+    }
+}
+
+static double timeWorkGroupSize(cl_command_queue     cmd_queue,
+                                cl_kernel            kernel,
+                                cl_uint              work_dim,
+                                const size_t * const global,
+                                const size_t * const local,
+                                cl_int               use_events)
+{
+    double   best_ms = -1;
+    cl_event event;
+    cl_int   err;
+    cl_int   run;
+    
+    /* First launch warms up, the best of the next CL_TUNING_RUNS is kept. */
+    for (run = 0; run <= CL_TUNING_RUNS; run += 1)
+    {
+        double start_ms = getTimeMs();
+        double ms;
+        
+        event = NULL;
+        err   = clEnqueueNDRangeKernel(cmd_queue, kernel, work_dim, NULL, global, local, 0, NULL, &event);
+        
+        if (err == CL_SUCCESS)
+        {
+            err = clFinish(cmd_queue);
+        }
+        
+        ms = getTimeMs() - start_ms;
+        
+        if ((err == CL_SUCCESS) && (use_events != 0))
+        {
+            ms = clGetEventElapsedMs(event, event);
+        }
+        
+        if (event != NULL)
+        {
+            clReleaseEvent(event);
+        }
+        
+        if (err != CL_SUCCESS)
+        {
+            return (-1);
+        }
+        
+        if ((run > 0) && ((best_ms < 0) || (ms < best_ms)))
+        {
+            best_ms = ms;
+        }
+    }
+    
+    return (best_ms);
+}
+
+static void resolveProfileEvents(void)
+{
+    cl_int i;
+    
+    /* Completed records are compacted in place, commands whose timestamps cannot
+     * be read (queue without profiling, failed command) are dropped.
+     */
+    for (i = num_profile_resolved; i < num_profile_records; i += 1)
+    {
+        profile_record_t *record = &profile_records[i];
+        cl_int           err;
+        
+        err  = clWaitForEvents(1, &profile_events[i]);
+        err |= clGetEventProfilingInfo(profile_events[i], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &record->queued_ns, NULL);
+        err |= clGetEventProfilingInfo(profile_events[i], CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &record->submit_ns, NULL);
+        err |= clGetEventProfilingInfo(profile_events[i], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &record->start_ns, NULL);
+        err |= clGetEventProfilingInfo(profile_events[i], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &record->end_ns, NULL);
+        
+        clReleaseEvent(profile_events[i]);
+        profile_events[i] = NULL;
+        
+        if (err != CL_SUCCESS)
+        {
+            num_profile_dropped += 1;
+            continue;
+        }
+        
+        profile_records[num_profile_resolved] = *record;
+        num_profile_resolved                 += 1;
+    }
+    
+    num_profile_records = num_profile_resolved;
+}
+
+static cl_int getProfileStats(profile_stage_stats_t * const ret_stats,
+                              cl_int                        max_stats)
+{
+    double run_s[CL_PROFILE_MAX_STAGES];
+    double bytes[CL_PROFILE_MAX_STAGES];
+    double items[CL_PROFILE_MAX_STAGES];
+    cl_int num_stats;
+    cl_int i;
+    cl_int j;
+    
+    num_stats = 0;
+    max_stats = (max_stats < CL_PROFILE_MAX_STAGES) ? max_stats : CL_PROFILE_MAX_STAGES;
+    
+    /* Sum per stage first, averages and rates once every record was seen. */
+    for (i = 0; i < num_profile_resolved; i += 1)
+    {
+        const profile_record_t *record = &profile_records[i];
+        profile_stage_stats_t  *stats;
+        
+        for (j = 0; j < num_stats; j += 1)
+        {
+            if (   (strcmp(ret_stats[j].component, record->component) == 0)
+                && (strcmp(ret_stats[j].stage, record->stage) == 0))
+            {
+                break;
+            }
+        }
+        
+        if (j == num_stats)
+        {
+            if (num_stats == max_stats)
+            {
+                continue;
+            }
+            
+            memset(&ret_stats[j], 0, sizeof(profile_stage_stats_t));
+            memcpy(ret_stats[j].component, record->component, sizeof(record->component));
+            memcpy(ret_stats[j].stage, record->stage, sizeof(record->stage));
+            
+            run_s[j]   = 0;
+            bytes[j]   = 0;
+            items[j]   = 0;
+            num_stats += 1;
+        }
+        
+        stats = &ret_stats[j];
+        
+        stats->count     += 1;
+        stats->queued_ms += (record->submit_ns > record->queued_ns) ? ((record->submit_ns - record->queued_ns) / 1000000.0) : 0;
+        stats->submit_ms += (record->start_ns > record->submit_ns) ? ((record->start_ns - record->submit_ns) / 1000000.0) : 0;
+        stats->run_ms    += (record->end_ns > record->start_ns) ? ((record->end_ns - record->start_ns) / 1000000.0) : 0;
+        
+        run_s[j] += (record->end_ns > record->start_ns) ? ((record->end_ns - record->start_ns) / 1e9) : 0;
+        bytes[j] += (double)record->bytes;
+        items[j] += (double)record->items;
+    }
+    
+    for (j = 0; j < num_stats; j += 1)
+    {
+        ret_stats[j].queued_ms   /= ret_stats[j].count;
+        ret_stats[j].submit_ms   /= ret_stats[j].count;
+        ret_stats[j].run_ms      /= ret_stats[j].count;
+        ret_stats[j].gb_per_s     = (run_s[j] > 0) ? (bytes[j] / run_s[j] / 1e9) : 0;
+        ret_stats[j].items_per_s  = (run_s[j] > 0) ? (items[j] / run_s[j]) : 0;
+    }
+    
+    return (num_stats);
+}
+
+void clPrintAllAvaliableDevicesInfo(cl_device_id * usr_device_list,
+                                    cl_uint num_devices)
+{
+    cl_device_type device_type;
+    
+    cl_int         i;
+    cl_bool        ret_bool;
+    char ret_string[1024];
+    size_t ret_count;
+    
+    printf("Info: Number of devices: %d.\n", num_devices);
+    
+    for (i = 0;  i < num_devices; i += 1)
+    {
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_NAME,
+                        sizeof(ret_string),
+                        ret_string,
+                        NULL);
+        printf("Device Name: %s.\n",ret_string);
+        
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_VENDOR,
+                        sizeof(ret_string),
+                        ret_string,
+                        NULL);
+        printf("\tInfo: Device Vendor: %s.\n", ret_string);
+        
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_TYPE,
+                        sizeof(device_type),
+                        &device_type,
+                        NULL);
+        switch (device_type)
+        {
+            case CL_DEVICE_TYPE_CPU:         {strcpy(ret_string, "CPU");         break;}
+            case CL_DEVICE_TYPE_GPU:         {strcpy(ret_string, "GPU");         break;}
+            case CL_DEVICE_TYPE_ACCELERATOR: {strcpy(ret_string, "ACCELERATOR"); break;}
+            case CL_DEVICE_TYPE_DEFAULT:     {strcpy(ret_string, "DEFAULT");     break;}
+            default:                         {break;}
+        }
+        printf("\tInfo: Device Type: %s.\n", ret_string);
+        
+        ret_count = 0;
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_MAX_COMPUTE_UNITS,
+                        sizeof(ret_count),
+                        &ret_count,
+                        NULL);
+        printf("\tInfo: Device Max Compute Units: %zu.\n", (ret_count));
+        
+        ret_count = 0;
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_MAX_WORK_GROUP_SIZE,
+                        sizeof(ret_count),
+                        &ret_count,
+                        NULL);
+        printf("\tInfo: Device Max Work Group Size: %zu. \n", (ret_count));
+        
+        ret_count = 0;
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS,
+                        sizeof(ret_count),
+                        &ret_count,
+                        NULL);
+        printf("\tInfo: Device Max Work Item Dimensions: %zu.\n", (ret_count));
+        
+        ret_count = 0;
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE,
+                        sizeof(ret_count),
+                        &ret_count,
+                        NULL);
+        printf("\tInfo: Device Max Constant Buffer Size: %zu Kbytes.\n", (ret_count/1024));
+        
+        ret_count = 0;
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_GLOBAL_MEM_SIZE,
+                        sizeof(ret_count),
+                        &ret_count,
+                        NULL);
+        printf("\tInfo: Device Global Memory Size: %zu Mbytes.\n",(ret_count/(2*1024)));
+        
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_IMAGE_SUPPORT,
+                        sizeof(ret_bool),
+                        &ret_bool,
+                        NULL);
+        
+        printf("\tInfo: Device Support Image: %s.\n", (ret_bool == CL_TRUE) ? "YES" : "NO");
+        
+        ret_count = 0;
+        clGetDeviceInfo(usr_device_list[i],
+                        CL_DEVICE_MAX_SAMPLERS,
+                        sizeof(ret_count),
+                        &ret_count,
+                        NULL);
+        printf("\tInfo: Device Maximum Samplers: %zu.\n",ret_count);
+        
+        /* Calibration timings of components that auto-selected their device. */
+        for (cl_int j = 0; j < num_calibration_records; j += 1)
+        {
+            if (calibration_records[j].device != usr_device_list[i])
+            {
+                continue;
+            }
+            
+            if (calibration_records[j].ms > 0)
+            {
+                printf("\tInfo: Calibration %s: %.3f ms%s%s.\n",
+                       calibration_records[j].component,
+                       calibration_records[j].ms,
+                       (calibration_records[j].cached   != 0) ? " (cached)"   : "",
+                       (calibration_records[j].selected != 0) ? " (selected)" : "");
+            }
+            else
+            {
+                printf("\tInfo: Calibration %s: failed.\n", calibration_records[j].component);
+            }
+        }
+    }
+}
+
+void clCreateKernelObjsForContext(const cl_context * const device_context,
+                                  const char  *filename,
+                                  const char  *prg_name[],
+                                  cl_int      num_kernel,
+                                  cl_kernel   * const ret_kernel,
+                                  cl_int      * const ret_err)
+{
+    char         *src_code;
+    
+    /* Load source code.
+     */
+    src_code = LoadProgramSrc(filename);
+    
+    if (src_code == 0)
+    {
+        *ret_err = ERR_INVALID_SOURCE_CODE;
+        printOpenCLErrorMsg(ERR_INVALID_SOURCE_CODE);
+        return;
+    }
+    else
+    {
+        printOpenCLInfoMsg(INFO_VALID_SOURCE_CODE);
+    }
+    
+    clCreateKernelObjsFromSource(device_context,
+                                 src_code,
+                                 NULL,
+                                 prg_name,
+                                 num_kernel,
+                                 ret_kernel,
+                                 ret_err);
+    free(src_code);
+}
+
+void clCreateKernelObjsFromSource(const cl_context * const device_context,
+                                  const char  *src_code,
+                                  const char  *options,
+                                  const char  *prg_name[],
+                                  cl_int      num_kernel,
+                                  cl_kernel   * const ret_kernel,
+                                  cl_int      * const ret_err)
+{
+    cl_program   usr_prg;
+    
+    /* Load program from the binary cache or build it from source.
+     */
+    usr_prg = buildProgramWithCache(device_context,
+                                    src_code,
+                                    options,
+                                    ret_err);
+    
+    if (usr_prg == NULL)
+    {
+        return;
+    }
+    
+    clCreateKernelObjsFromProgram(usr_prg,
+                                  prg_name,
+                                  num_kernel,
+                                  ret_kernel,
+                                  ret_err);
+    
+    /* Tear down usr_prg, the kernels keep their own reference.
+     */
+    clReleaseProgram(usr_prg);
+}
+
+cl_program clCreateProgramForContext(const cl_context * const device_context,
+                                     const char  *filename,
+                                     cl_int      * const ret_err)
+{
+    char         *src_code;
+    cl_program   usr_prg;
+    
+    src_code = LoadProgramSrc(filename);
+    
+    if (src_code == 0)
+    {
+        *ret_err = ERR_INVALID_SOURCE_CODE;
+        printOpenCLErrorMsg(ERR_INVALID_SOURCE_CODE);
+        return (NULL);
+    }
+    
+    printOpenCLInfoMsg(INFO_VALID_SOURCE_CODE);
+    
+    usr_prg = buildProgramWithCache(device_context,
+                                    src_code,
+                                    NULL,
+                                    ret_err);
+    free(src_code);
+    
+    return (usr_prg);
+}
+
+void clCreateKernelObjsFromProgram(cl_program  usr_prg,
+                                   const char  *prg_name[],
+                                   cl_int      num_kernel,
+                                   cl_kernel   * const ret_kernel,
+                                   cl_int      * const ret_err)
+{
+    cl_int       err;
+    cl_int       i;
+    
+    for (i = 0; i < num_kernel; i += 1)
+    {
+        /* Create kernel objects for all functions found in user cl file.
+         */
+        ret_kernel[i] = clCreateKernel(usr_prg,
+                                       prg_name[i],
+                                       &err);
+        if (err != CL_SUCCESS)
+        {
+            printOpenCLErrorMsg(ERR_CREATE_KERNEL_NOK);
+            
+            /* All or nothing, the kernels created so far are released. */
+            while (i > 0)
+            {
+                i -= 1;
+                clReleaseKernel(ret_kernel[i]);
+                ret_kernel[i] = NULL;
+            }
+            
+            *ret_err = err;
+            return;
+        }
+    }
+    
+    printOpenCLInfoMsg(INFO_CREATE_KERNEL_OK);
+    
+    *ret_err = CL_SUCCESS;
+}
+
+void clGetProgramCacheStats(program_cache_stats_t * const ret_stats)
+{
+    *ret_stats = program_cache_stats;
+}
+
+void clGetAllDeviceIDs(cl_device_type         device_type,
+                       cl_uint                max_devices,
+                       cl_device_id   * const ret_devices,
+                       cl_uint        * const ret_num_devices)
+{
+    cl_platform_id platform[CL_MAX_PLATFORMS];
+    cl_uint        num_platforms;
+    cl_uint        num_devices;
+    cl_uint        i;
+    
+    *ret_num_devices = 0;
+    
+    if (clGetPlatformIDs(CL_MAX_PLATFORMS, platform, &num_platforms) != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    num_platforms = (num_platforms < CL_MAX_PLATFORMS) ? num_platforms : CL_MAX_PLATFORMS;
+    
+    for (i = 0; (i < num_platforms) && (*ret_num_devices < max_devices); i += 1)
+    {
+        if (clGetDeviceIDs(platform[i],
+                           device_type,
+                           max_devices - *ret_num_devices,
+                           &ret_devices[*ret_num_devices],
+                           &num_devices) != CL_SUCCESS)
+        {
+            continue;
+        }
+        
+        *ret_num_devices += (num_devices < (max_devices - *ret_num_devices)) ? num_devices : (max_devices - *ret_num_devices);
+    }
+}
+
+void clCreateDeviceAndContext(cl_device_id     * const device_list,
+                              cl_int                   device_num,
+                              cl_context       * const device_context,
+                              cl_command_queue * const device_cmd_queue,
+                              cl_int           * const ret_err)
+{
+    cl_device_id   selected_device;
+    cl_device_type device_type;
+    cl_int         err;
+    cl_int         i;
+    
+    if ((device_list == NULL) || (device_num <= 0))
+    {
+        *ret_err = CL_INVALID_VALUE;
+        printOpenCLErrorMsg(ERR_GET_DEVICE_INFO_NOK);
+        return;
+    }
+    
+    /* Use the first GPU of the caller's list, or its first device when there is
+     * no GPU, so passing a single device creates the context on exactly that device.
+     */
+    selected_device = device_list[0];
+    err             = CL_SUCCESS;
+    
+    for (i = 0; i < device_num; i += 1)
+    {
+        err = clGetDeviceInfo(device_list[i],
+                              CL_DEVICE_TYPE,
+                              sizeof(cl_device_type),
+                              &device_type,
+                              NULL);
+        if (err != CL_SUCCESS)
+        {
+            break;
+        }
+        
+        if ((device_type & CL_DEVICE_TYPE_GPU) != 0)
+        {
+            selected_device = device_list[i];
+            break;
+        }
+    }
+    
+    if (err != CL_SUCCESS)
+    {
+        *ret_err = err;
+        printOpenCLErrorMsg(ERR_GET_DEVICE_INFO_NOK);
+        return;
+    }
+    else
+    {
+        printOpenCLInfoMsg(INFO_GET_DEVICE_INFO_OK);
+    }
+    
+    /* Create context for the selected device.
+     */
+    *device_context = clCreateContext(0,
+                                      1,
+                                      &selected_device,
+                                      NULL,
+                                      NULL,
+                                      &err);
+    
+    /* Create command queue for the selected device.
+     */
+    if (err != CL_SUCCESS)
+    {
+        *ret_err = err;
+        printOpenCLErrorMsg(ERR_INVALID_CREATE_CONTEXT);
+        return;
+    }
+    else
+    {
+        printOpenCLInfoMsg(INFO_VALID_CREATE_CONTEXT);
+    }
+    
+    *device_cmd_queue = clCreateCommandQueue(*device_context,
+                                             selected_device,
+                                             (profiling_enable != 0) ? CL_QUEUE_PROFILING_ENABLE : 0,
+                                             &err);
+    if (err != CL_SUCCESS)
+    {
+        *ret_err = err;
+        printOpenCLErrorMsg(ERR_INVALID_CREATE_COMMAND);
+        return;
+    }
+    else
+    {
+        printOpenCLInfoMsg(INFO_VALID_CREATE_COMMAND);
     }
     
     *ret_err = CL_SUCCESS;
 }
 
+void clCreateContextPerDevice(cl_device_id     * const device_list,
+                              cl_int                   device_num,
+                              cl_command_queue_properties properties,
+                              cl_context       * const ret_context,
+                              cl_command_queue * const ret_cmd_queue,
+                              cl_device_id     * const ret_device,
+                              cl_int           * const ret_num_context,
+                              cl_int           * const ret_err)
+{
+    cl_bool available;
+    cl_int  err;
+    cl_int  i;
+    
+    *ret_num_context = 0;
+    *ret_err         = CL_SUCCESS;
+    
+    /* Devices from different platforms cannot share a context, so each device
+     * (or sub-device) gets its own context and queue. Devices that are not
+     * available or fail to create one are skipped.
+     */
+    for (i = 0; i < device_num; i += 1)
+    {
+        available = CL_FALSE;
+        clGetDeviceInfo(device_list[i],
+                        CL_DEVICE_AVAILABLE,
+                        sizeof(cl_bool),
+                        &available,
+                        NULL);
+        
+        if (available != CL_TRUE)
+        {
+            continue;
+        }
+        
+        ret_context[*ret_num_context] = clCreateContext(0,
+                                                        1,
+                                                        &device_list[i],
+                                                        NULL,
+                                                        NULL,
+                                                        &err);
+        if (err != CL_SUCCESS)
+        {
+            printOpenCLErrorMsg(ERR_INVALID_CREATE_CONTEXT);
+            continue;
+        }
+        
+        ret_cmd_queue[*ret_num_context] = clCreateCommandQueue(ret_context[*ret_num_context],
+                                                               device_list[i],
+                                                               properties,
+                                                               &err);
+        if (err != CL_SUCCESS)
+        {
+            printOpenCLErrorMsg(ERR_INVALID_CREATE_COMMAND);
+            clReleaseContext(ret_context[*ret_num_context]);
+            continue;
+        }
+        
+        ret_device[*ret_num_context] = device_list[i];
+        *ret_num_context            += 1;
+    }
+    
+    if (*ret_num_context < device_num)
+    {
+        printf("Info OpenCL: %d of %d devices usable for work splitting.\n", *ret_num_context, device_num);
+    }
+}
+
+double clGetDeviceThroughputPrior(cl_device_id device)
+{
+    cl_uint compute_units = 1;
+    cl_uint clock_mhz     = 1;
+    
+    clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &compute_units, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(cl_uint), &clock_mhz, NULL);
+    
+    return ((double)((compute_units > 0) ? compute_units : 1) * ((clock_mhz > 0) ? clock_mhz : 1));
+}
+
+double clGetEventElapsedMs(cl_event start_event, cl_event end_event)
+{
+    cl_ulong start_ns = 0;
+    cl_ulong end_ns   = 0;
+    
+    /* Both events must come from the same profiling enabled queue. */
+    if (   (clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start_ns, NULL) != CL_SUCCESS)
+        || (clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end_ns, NULL) != CL_SUCCESS)
+        || (end_ns <= start_ns))
+    {
+        return (0);
+    }
+    
+    return ((end_ns - start_ns) / 1000000.0);
+}
+
+cl_bool clGetDeviceUnifiedMemory(cl_device_id device)
+{
+    cl_device_type device_type    = 0;
+    cl_bool        unified_memory = CL_FALSE;
+    
+    clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(cl_device_type), &device_type, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified_memory, NULL);
+    
+    return (((device_type & CL_DEVICE_TYPE_CPU) != 0) || (unified_memory == CL_TRUE)) ? CL_TRUE : CL_FALSE;
+}
+
+void * clAllocHostMemory(size_t size)
+{
+    void *ptr = NULL;
+    
+    size = ((size + CL_HOST_MEMORY_SIZE_MULTIPLE - 1) / CL_HOST_MEMORY_SIZE_MULTIPLE) * CL_HOST_MEMORY_SIZE_MULTIPLE;
+    
+    if (posix_memalign(&ptr, CL_HOST_MEMORY_ALIGNMENT, (size > 0) ? size : CL_HOST_MEMORY_SIZE_MULTIPLE) != 0)
+    {
+        return (NULL);
+    }
+    
+    return (ptr);
+}
+
+cl_bool clIsHostMemoryAligned(const void * const ptr)
+{
+    return ((ptr != NULL) && (((size_t)ptr % CL_HOST_MEMORY_ALIGNMENT) == 0)) ? CL_TRUE : CL_FALSE;
+}
+
+void clGetWeightedSplit(const double * const weight,
+                        cl_int               num_parts,
+                        size_t               total,
+                        size_t       * const ret_count)
+{
+    double weight_sum;
+    double acc;
+    size_t assigned;
+    size_t end;
+    cl_int i;
+    
+    weight_sum = 0;
+    
+    for (i = 0; i < num_parts; i += 1)
+    {
+        weight_sum += (weight[i] > 0) ? weight[i] : 0;
+    }
+    
+    /* Split at the rounded cumulative weight, so the counts always add up to total. */
+    acc      = 0;
+    assigned = 0;
+    
+    for (i = 0; i < num_parts; i += 1)
+    {
+        acc += (weight[i] > 0) ? weight[i] : 0;
+        end  = (weight_sum > 0) ? (size_t)((acc / weight_sum) * total + 0.5) : (((i + 1) * total) / num_parts);
+        end  = (end > total) ? total : end;
+        end  = (i == (num_parts - 1)) ? total : end;
+        end  = (end < assigned) ? assigned : end;
+        
+        ret_count[i] = end - assigned;
+        assigned     = end;
+    }
+}
+
+void clSelectFastestDevice(const char       * const component,
+                           cl_device_id     * const device_list,
+                           cl_int                   device_num,
+                           calibration_fn_t         calibrate,
+                           cl_device_id     * const ret_device,
+                           cl_int           * const ret_err)
+{
+    double           ms[CL_CALIBRATION_MAX_DEVICES];
+    cl_ulong         set_hash;
+    cl_context       context;
+    cl_command_queue cmd_queue;
+    cl_device_id     device;
+    cl_int           num_context;
+    cl_int           selected;
+    cl_int           cached;
+    cl_int           i;
+    
+    if ((device_num <= 0) || (device_num > CL_CALIBRATION_MAX_DEVICES))
+    {
+        *ret_err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    /* Reuse the choice of an earlier run on the same devices, otherwise time the
+     * component's calibration on each device in its own context.
+     */
+    set_hash = getDeviceSetHash(component, device_list, device_num);
+    selected = loadDeviceSelection(component, set_hash, device_num, ms);
+    cached   = (selected >= 0);
+    
+    if (cached == 0)
+    {
+        for (i = 0; i < device_num; i += 1)
+        {
+            ms[i] = -1;
+            
+            clCreateContextPerDevice(&device_list[i],
+                                     1,
+                                     0,
+                                     &context,
+                                     &cmd_queue,
+                                     &device,
+                                     &num_context,
+                                     ret_err);
+            
+            if (num_context == 1)
+            {
+                ms[i] = calibrate(context, cmd_queue, device);
+                
+                clReleaseCommandQueue(cmd_queue);
+                clReleaseContext(context);
+            }
+            
+            if ((ms[i] > 0) && ((selected < 0) || (ms[i] < ms[selected])))
+            {
+                selected = i;
+            }
+        }
+        
+        if (selected >= 0)
+        {
+            storeDeviceSelection(component, set_hash, selected, device_num, ms);
+        }
+    }
+    
+    for (i = 0; i < device_num; i += 1)
+    {
+        addCalibrationRecord(component, device_list[i], ms[i], (i == selected), cached);
+    }
+    
+    if (selected < 0)
+    {
+        *ret_err = CL_DEVICE_NOT_AVAILABLE;
+        return;
+    }
+    
+    *ret_device = device_list[selected];
+    *ret_err    = CL_SUCCESS;
+}
+
+void clGetTunedWorkGroupSize(cl_command_queue       cmd_queue,
+                             cl_kernel              kernel,
+                             cl_uint                work_dim,
+                             const size_t   * const global,
+                             cl_uint                num_wait_events,
+                             const cl_event * const wait_list,
+                             size_t         * const ret_local)
+{
+    work_group_tuning_t         *entry;
+    cl_device_id                device;
+    cl_command_queue_properties properties;
+    cl_ulong                    device_hash;
+    char                        kernel_name[64];
+    char                        device_name[128];
+    size_t                      global_key[3];
+    size_t                      max_work_group_size;
+    size_t                      kernel_work_group_size;
+    size_t                      max_item_size[3];
+    size_t                      local[3];
+    size_t                      limit;
+    double                      driver_ms;
+    double                      ms;
+    cl_int                      use_events;
+    cl_int                      i;
+    
+    ret_local[0] = 0;
+    ret_local[1] = 0;
+    ret_local[2] = 0;
+    
+    if ((work_dim < 1) || (work_dim > 3))
+    {
+        return;
+    }
+    
+    /* Keys are size classes, frames whose size changes every call (bands of a
+     * split frame) share one tuning instead of sweeping each size.
+     */
+    for (i = 0; i < 3; i += 1)
+    {
+        global_key[i] = (i < (cl_int)work_dim) ? getWorkGroupSizeClass(global[i]) : 1;
+    }
+    
+    /* Keys resolved before for this queue and kernel skip the queries below. */
+    for (i = 0; i < num_work_group_lookup; i += 1)
+    {
+        const work_group_lookup_t *lookup = &work_group_lookup[i];
+        
+        if (   (lookup->cmd_queue == cmd_queue)
+            && (lookup->kernel == kernel)
+            && (lookup->work_dim == work_dim)
+            && (lookup->global[0] == global_key[0])
+            && (lookup->global[1] == global_key[1])
+            && (lookup->global[2] == global_key[2]))
+        {
+            if (lookup->entry >= 0)
+            {
+                fitTunedWorkGroupSize(&work_group_tuning[lookup->entry], global, ret_local);
+            }
+            
+            return;
+        }
+    }
+    
+    if (work_group_tuning_loaded == 0)
+    {
+        loadWorkGroupTuning();
+    }
+    
+    device         = NULL;
+    properties     = 0;
+    kernel_name[0] = '\0';
+    
+    clGetCommandQueueInfo(cmd_queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &device, NULL);
+    clGetCommandQueueInfo(cmd_queue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, NULL);
+    clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(kernel_name), kernel_name, NULL);
+    
+    device_hash = getDeviceSetHash("tuning", &device, 1);
+    
+    /* Stored results apply unless a retune was requested and this run did not
+     * tune the key yet.
+     */
+    entry = NULL;
+    
+    for (i = 0; i < num_work_group_tuning; i += 1)
+    {
+        if (   (work_group_tuning[i].device_hash == device_hash)
+            && (work_group_tuning[i].work_dim == work_dim)
+            && (work_group_tuning[i].global[0] == global_key[0])
+            && (work_group_tuning[i].global[1] == global_key[1])
+            && (work_group_tuning[i].global[2] == global_key[2])
+            && (strcmp(work_group_tuning[i].kernel_name, kernel_name) == 0))
+        {
+            entry = &work_group_tuning[i];
+            break;
+        }
+    }
+    
+    if ((entry != NULL) && ((work_group_retune == 0) || (entry->tuned != 0)))
+    {
+        addWorkGroupLookup(cmd_queue, kernel, work_dim, global_key, (cl_int)(entry - work_group_tuning));
+        fitTunedWorkGroupSize(entry, global, ret_local);
+        return;
+    }
+    
+    /* With a full table new keys keep the driver's choice. */
+    if ((entry == NULL) && (num_work_group_tuning >= CL_TUNING_MAX_ENTRIES))
+    {
+        addWorkGroupLookup(cmd_queue, kernel, work_dim, global_key, -1);
+        return;
+    }
+    
+    /* Candidates are powers of two dividing the global size within the device,
+     * work item and kernel limits.
+     */
+    max_work_group_size    = 1;
+    kernel_work_group_size = 1;
+    max_item_size[0]       = 1;
+    max_item_size[1]       = 1;
+    max_item_size[2]       = 1;
+    
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &max_work_group_size, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(max_item_size), max_item_size, NULL);
+    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernel_work_group_size, NULL);
+    
+    limit = (max_work_group_size < kernel_work_group_size) ? max_work_group_size : kernel_work_group_size;
+    
+    /* The kernel runs with the caller's arguments, its inputs must be ready. */
+    if (num_wait_events > 0)
+    {
+        clWaitForEvents(num_wait_events, wait_list);
+    }
+    
+    use_events = ((properties & CL_QUEUE_PROFILING_ENABLE) != 0);
+    driver_ms  = timeWorkGroupSize(cmd_queue, kernel, work_dim, global, NULL, use_events);
+    ms         = driver_ms;
+    local[0]   = 0;
+    local[1]   = 0;
+    local[2]   = 0;
+    
+    for (size_t x = 1; (x <= limit) && (x <= max_item_size[0]); x *= 2)
+    {
+        for (size_t y = 1; (y <= (limit / x)) && ((work_dim > 1) ? (y <= max_item_size[1]) : (y == 1)); y *= 2)
+        {
+            size_t candidate[3] = {x, y, 1};
+            double candidate_ms;
+            
+            if (   ((global[0] % x) != 0)
+                || ((((work_dim > 1) ? global[1] : 1) % y) != 0)
+                || ((work_dim > 1) && ((x * y) < CL_TUNING_MIN_GROUP_SIZE) && ((x * y) < limit)))
+            {
+                continue;
+            }
+            
+            candidate_ms = timeWorkGroupSize(cmd_queue, kernel, work_dim, global, candidate, use_events);
+            
+            if ((candidate_ms >= 0) && ((ms < 0) || (candidate_ms < ms)))
+            {
+                ms       = candidate_ms;
+                local[0] = x;
+                local[1] = (work_dim > 1) ? y : 0;
+                local[2] = (work_dim > 2) ? 1 : 0;
+            }
+        }
+    }
+    
+    if (entry == NULL)
+    {
+        entry = &work_group_tuning[num_work_group_tuning];
+        num_work_group_tuning += 1;
+    }
+    
+    entry->device_hash = device_hash;
+    entry->work_dim    = work_dim;
+    entry->ms          = ms;
+    entry->tuned       = 1;
+    
+    snprintf(entry->kernel_name, sizeof(entry->kernel_name), "%s", kernel_name);
+    
+    for (i = 0; i < 3; i += 1)
+    {
+        entry->global[i] = global_key[i];
+        entry->local[i]  = local[i];
+        ret_local[i]     = local[i];
+    }
+    
+    storeWorkGroupTuning();
+    addWorkGroupLookup(cmd_queue, kernel, work_dim, global_key, (cl_int)(entry - work_group_tuning));
+    
+    device_name[0] = '\0';
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
+    
+    printf("Info: Tuned %s on %s for up to %zux%zux%zu: local %zux%zux%zu, %.3f ms (driver choice %.3f ms).\n",
+           kernel_name,
+           device_name,
+           global_key[0],
+           global_key[1],
+           global_key[2],
+           local[0],
+           local[1],
+           local[2],
+           ms,
+           driver_ms);
+}
+
+void clSetWorkGroupRetune(cl_int enable)
+{
+    work_group_retune = enable;
+}
+
+void clSetProfilingEnable(cl_int enable)
+{
+    profiling_enable = enable;
+}
+
+cl_int clGetProfilingEnable(void)
+{
+    return (profiling_enable);
+}
+
+void clProfileEvent(const char * const component,
+                    const char * const stage,
+                    cl_event           event,
+                    size_t             bytes,
+                    size_t             items)
+{
+    profile_record_t *record;
+    
+    if (event == NULL)
+    {
+        return;
+    }
+    
+    if ((profiling_enable == 0) || (num_profile_records == CL_PROFILE_MAX_RECORDS))
+    {
+        num_profile_dropped += (profiling_enable != 0);
+        clReleaseEvent(event);
+        return;
+    }
+    
+    /* The timestamps are read when the results are asked for, so recording does
+     * not wait for the command.
+     */
+    record = &profile_records[num_profile_records];
+    
+    memset(record, 0, sizeof(profile_record_t));
+    snprintf(record->component, sizeof(record->component), "%s", component);
+    snprintf(record->stage, sizeof(record->stage), "%s", stage);
+    
+    record->bytes = bytes;
+    record->items = items;
+    
+    profile_events[num_profile_records] = event;
+    num_profile_records                += 1;
+}
+
+cl_int clGetProfileRecords(profile_record_t * const ret_records,
+                           cl_int                   max_records)
+{
+    resolveProfileEvents();
+    
+    if ((ret_records != NULL) && (max_records > 0))
+    {
+        memcpy(ret_records,
+               profile_records,
+               sizeof(profile_record_t) * ((num_profile_resolved < max_records) ? num_profile_resolved : max_records));
+    }
+    
+    return (num_profile_resolved);
+}
+
+cl_int clGetProfileStats(profile_stage_stats_t * const ret_stats,
+                         cl_int                        max_stats)
+{
+    profile_stage_stats_t stats[CL_PROFILE_MAX_STAGES];
+    cl_int                num_stats;
+    
+    resolveProfileEvents();
+    
+    num_stats = getProfileStats(stats, CL_PROFILE_MAX_STAGES);
+    
+    if ((ret_stats != NULL) && (max_stats > 0))
+    {
+        memcpy(ret_stats, stats, sizeof(profile_stage_stats_t) * ((num_stats < max_stats) ? num_stats : max_stats));
+    }
+    
+    return (num_stats);
+}
+
+void clDumpProfileJSON(const char * const filename,
+                       cl_int     * const ret_err)
+{
+    profile_stage_stats_t stats[CL_PROFILE_MAX_STAGES];
+    cl_int                num_stats;
+    FILE                  *file_ptr;
+    cl_int                i;
+    
+    resolveProfileEvents();
+    
+    file_ptr = fopen(filename, "w");
+    
+    if (file_ptr == NULL)
+    {
+        *ret_err = CL_INVALID_VALUE;
+        printOpenCLErrorMsg(ERR_PROFILE_DUMP_NOK);
+        return;
+    }
+    
+    num_stats = getProfileStats(stats, CL_PROFILE_MAX_STAGES);
+    
+    /* Component and stage names are identifiers of the library, they need no
+     * escaping.
+     */
+    fprintf(file_ptr, "{\n  \"records\": [");
+        
+    for (i = 0; i < num_profile_resolved; i += 1)
+    {
+        const profile_record_t *record = &profile_records[i];
+            
+        fprintf(file_ptr,
+                "%s\n    {\"component\": \"%s\", \"stage\": \"%s\", \"queued_ns\": %llu, \"submit_ns\": %llu, "
+                "\"start_ns\": %llu, \"end_ns\": %llu, \"bytes\": %llu, \"items\": %llu}",
+                (i > 0) ? "," : "",
+                record->component,
+                record->stage,
+                (unsigned long long)record->queued_ns,
+                (unsigned long long)record->submit_ns,
+                (unsigned long long)record->start_ns,
+                (unsigned long long)record->end_ns,
+                (unsigned long long)record->bytes,
+                (unsigned long long)record->items);
+    }
+        
+    fprintf(file_ptr, "\n  ],\n  \"stages\": [");
+        
+    for (i = 0; i < num_stats; i += 1)
+    {
+        fprintf(file_ptr,
+                "%s\n    {\"component\": \"%s\", \"stage\": \"%s\", \"count\": %u, \"queued_ms\": %.6f, "
+                "\"submit_ms\": %.6f, \"run_ms\": %.6f, \"gb_per_s\": %.6f, \"items_per_s\": %.1f}",
+                (i > 0) ? "," : "",
+                stats[i].component,
+                stats[i].stage,
+                stats[i].count,
+                stats[i].queued_ms,
+                stats[i].submit_ms,
+                stats[i].run_ms,
+                stats[i].gb_per_s,
+                stats[i].items_per_s);
+    }
+        
+    fprintf(file_ptr, "\n  ],\n  \"dropped\": %u\n}\n", num_profile_dropped);
+    
+    *ret_err = (fclose(file_ptr) == 0) ? CL_SUCCESS : CL_INVALID_VALUE;
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        printOpenCLErrorMsg(ERR_PROFILE_DUMP_NOK);
+    }
+}
+
+void clResetProfile(void)
+{
+    cl_int i;
+    
+    for (i = num_profile_resolved; i < num_profile_records; i += 1)
+    {
+        clReleaseEvent(profile_events[i]);
+        profile_events[i] = NULL;
+    }
+    
+    num_profile_records  = 0;
+    num_profile_resolved = 0;
+    num_profile_dropped  = 0;
+}
+
 void clCleanEnvironment(cl_context       * device_context,
                         cl_command_queue * device_cmd_queue,
                         cl_kernel        * kernel_list,
@@ -424,6 +2429,12 @@ void clCleanEnvironment(cl_context       * device_context,
 {
     cl_int i;
     
+    /* Read the timestamps of the component's commands while its queue exists, and
+     * drop the tuning lookups holding references to queues and kernels.
+     */
+    resolveProfileEvents();
+    releaseWorkGroupLookups();
+    
     for (i = 0;  i < num_kernel_list; i += 1)
     {
         clReleaseKernel(kernel_list[i]);
@@ -432,4 +2443,4 @@ void clCleanEnvironment(cl_context       * device_context,
     clReleaseContext(*device_context);
     clReleaseCommandQueue(*device_cmd_queue);
 }
-//////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
+//////////////////////////////////////////////////////////////////////////////////////////////////
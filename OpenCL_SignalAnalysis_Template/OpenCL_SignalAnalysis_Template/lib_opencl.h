@@ -1,8 +1,75 @@
 #ifndef _LIB_OPENCL_H_
 #define _LIB_OPENCL_H_
 
+#ifdef __APPLE__
 #include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
 
+/* Directory used to store compiled program binaries, device selections and tuned
+ * work sizes between runs. A relative name is placed in $XDG_CACHE_HOME, or in
+ * ~/.cache without it. The directory is created with mode 0700 and only used while
+ * it belongs to the current user and nobody else can access it. Define it as ""
+ * to disable these caches.
+ */
+#ifndef CL_PROGRAM_CACHE_DIR
+#define CL_PROGRAM_CACHE_DIR "opencl_templates"
+#endif
+
+/* File in CL_PROGRAM_CACHE_DIR remembering the device each component selected. */
+#ifndef CL_DEVICE_SELECT_CACHE_FILE
+#define CL_DEVICE_SELECT_CACHE_FILE "cl_device_select.txt"
+#endif
+
+/* Alignment and size granularity of host memory wrapped with CL_MEM_USE_HOST_PTR,
+ * the strictest one drivers ask for zero-copy access (a page, a cache line).
+ */
+#define CL_HOST_MEMORY_ALIGNMENT     4096
+#define CL_HOST_MEMORY_SIZE_MULTIPLE 64
+
+/* File in CL_PROGRAM_CACHE_DIR holding the tuned local work sizes. */
+#ifndef CL_WORK_GROUP_TUNING_FILE
+#define CL_WORK_GROUP_TUNING_FILE "cl_work_group_tuning.txt"
+#endif
+
+/* Runs a short workload on the given device and returns its time in ms, or a
+ * negative value when the device cannot run it.
+ */
+typedef double (*calibration_fn_t)(cl_context       context,
+                                   cl_command_queue cmd_queue,
+                                   cl_device_id     device);
+
+/* One profiled command of a profiling enabled queue, timestamps in device ns. */
+typedef struct {
+    char     component[16];
+    char     stage[32];
+    cl_ulong queued_ns;
+    cl_ulong submit_ns;
+    cl_ulong start_ns;
+    cl_ulong end_ns;
+    size_t   bytes;         /* Bytes the command read and wrote. */
+    size_t   items;         /* Pixels or signal elements it processed. */
+}profile_record_t;
+
+/* Records of one component and stage, times are averages per command. */
+typedef struct {
+    char    component[16];
+    char    stage[32];
+    cl_uint count;
+    double  queued_ms;      /* From enqueue to submission.          */
+    double  submit_ms;      /* From submission to start of execution. */
+    double  run_ms;         /* From start to end of execution.      */
+    double  gb_per_s;       /* Bytes per second of run time.        */
+    double  items_per_s;    /* Items per second of run time.        */
+}profile_stage_stats_t;
+
+typedef struct {
+    cl_uint hit_count;      /* Programs loaded from a cached binary.         */
+    cl_uint miss_count;     /* Programs built from source.                   */
+    double  build_time_ms;  /* Total time spent building programs from source. */
+    double  saved_time_ms;  /* Total build time saved by cache hits.         */
+}program_cache_stats_t;
 
 extern void clCreateKernelObjsForContext( const cl_context * const device_context,
                                          const char  *filename,
@@ -11,12 +78,159 @@ extern void clCreateKernelObjsForContext( const cl_context * const device_contex
                                          cl_kernel   * const ret_kernel,
                                          cl_int      * const ret_err);
 
+/* Same for source generated at runtime, built with options (may be NULL). The
+ * program goes through the binary cache like the file based programs.
+ */
+extern void clCreateKernelObjsFromSource(const cl_context * const device_context,
+                                         const char  *src_code,
+                                         const char  *options,
+                                         const char  *prg_name[],
+                                         cl_int      num_kernel,
+                                         cl_kernel   * const ret_kernel,
+                                         cl_int      * const ret_err);
+
+/* Loads filename and builds it for every device of the context, through the binary
+ * cache. Components keep the program to create kernels later without rebuilding it,
+ * the caller releases it.
+ */
+extern cl_program clCreateProgramForContext(const cl_context * const device_context,
+                                            const char  *filename,
+                                            cl_int      * const ret_err);
+
+/* Creates num_kernel kernels of a built program. On failure none is kept. */
+extern void clCreateKernelObjsFromProgram(cl_program  usr_prg,
+                                          const char  *prg_name[],
+                                          cl_int      num_kernel,
+                                          cl_kernel   * const ret_kernel,
+                                          cl_int      * const ret_err);
+
+extern void clGetProgramCacheStats(program_cache_stats_t * const ret_stats);
+
+/* Collects the devices of device_type from every platform, the NULL platform of
+ * clGetDeviceIDs is not portable across ICD loaders. ret_num_devices is 0 when no
+ * platform or device is found.
+ */
+extern void clGetAllDeviceIDs(cl_device_type         device_type,
+                              cl_uint                max_devices,
+                              cl_device_id   * const ret_devices,
+                              cl_uint        * const ret_num_devices);
+
 extern void clCreateDeviceAndContext(cl_device_id     * const device_list,
                                      cl_int                   device_num,
                                      cl_context       * const device_context,
                                      cl_command_queue * const device_cmd_queue,
                                      cl_int           * const ret_err);
 
+/* Creates one context and one command queue with the given properties for every
+ * available device of device_list (sub-devices included). The created handles are
+ * packed at the start of ret_context, ret_cmd_queue and ret_device.
+ */
+extern void clCreateContextPerDevice(cl_device_id     * const device_list,
+                                     cl_int                   device_num,
+                                     cl_command_queue_properties properties,
+                                     cl_context       * const ret_context,
+                                     cl_command_queue * const ret_cmd_queue,
+                                     cl_device_id     * const ret_device,
+                                     cl_int           * const ret_num_context,
+                                     cl_int           * const ret_err);
+
+/* Initial work weight of a device before any throughput was measured. */
+extern double clGetDeviceThroughputPrior(cl_device_id device);
+
+/* Device time in ms from the start of start_event to the end of end_event. */
+extern double clGetEventElapsedMs(cl_event start_event, cl_event end_event);
+
+/* CL_TRUE when the device shares physical memory with the host (CPU devices and
+ * integrated GPUs), buffers wrapping host memory then avoid every copy.
+ */
+extern cl_bool clGetDeviceUnifiedMemory(cl_device_id device);
+
+/* Host memory aligned to CL_HOST_MEMORY_ALIGNMENT with its size rounded up to
+ * CL_HOST_MEMORY_SIZE_MULTIPLE, so CL_MEM_USE_HOST_PTR buffers can use it without a
+ * copy. Release it with free().
+ */
+extern void * clAllocHostMemory(size_t size);
+
+/* CL_TRUE when ptr starts on a CL_HOST_MEMORY_ALIGNMENT boundary. */
+extern cl_bool clIsHostMemoryAligned(const void * const ptr);
+
+/* Splits total work items into num_parts counts proportional to weight. */
+extern void clGetWeightedSplit(const double * const weight,
+                               cl_int               num_parts,
+                               size_t               total,
+                               size_t       * const ret_count);
+
+/* Selects the device of device_list with the fastest calibration. The choice and
+ * the timings are stored under component in CL_DEVICE_SELECT_CACHE_FILE, later
+ * calls with the same devices skip the calibration. Timings are printed by
+ * clPrintAllAvaliableDevicesInfo.
+ */
+extern void clSelectFastestDevice(const char       * const component,
+                                  cl_device_id     * const device_list,
+                                  cl_int                   device_num,
+                                  calibration_fn_t         calibrate,
+                                  cl_device_id     * const ret_device,
+                                  cl_int           * const ret_err);
+
+/* Returns the local work size for kernel on the device of cmd_queue and this global
+ * size, ret_local[0] == 0 means the driver's choice (pass NULL). Keys are size
+ * classes, the global size rounded up to powers of two. The first call for a key
+ * times the driver's choice and every power-of-two size dividing global within
+ * CL_DEVICE_MAX_WORK_GROUP_SIZE, CL_DEVICE_MAX_WORK_ITEM_SIZES and
+ * CL_KERNEL_WORK_GROUP_SIZE, using the arguments already set on kernel after
+ * wait_list completed, and stores the fastest in CL_WORK_GROUP_TUNING_FILE for later
+ * runs. Later sizes of the class get the stored size halved until it divides them.
+ * The kernel must not read its own output. Resolved keys are remembered per queue
+ * and kernel, which stay retained until clCleanEnvironment.
+ */
+extern void clGetTunedWorkGroupSize(cl_command_queue       cmd_queue,
+                                    cl_kernel              kernel,
+                                    cl_uint                work_dim,
+                                    const size_t   * const global,
+                                    cl_uint                num_wait_events,
+                                    const cl_event * const wait_list,
+                                    size_t         * const ret_local);
+
+/* When enabled, clGetTunedWorkGroupSize sweeps every key again once per run and
+ * replaces the stored results (--retune in the demos).
+ */
+extern void clSetWorkGroupRetune(cl_int enable);
+
+/* When enabled before the components are initialised, their command queues are
+ * created with CL_QUEUE_PROFILING_ENABLE and every write, kernel and read is
+ * recorded (--profile in the demos). Off by default, events then cost nothing.
+ */
+extern void clSetProfilingEnable(cl_int enable);
+
+extern cl_int clGetProfilingEnable(void);
+
+/* Takes over the reference of event and records it under component and stage once
+ * it completed. Without profiling, or above CL_PROFILE_MAX_RECORDS records, the
+ * event is only released. event may be NULL.
+ */
+extern void clProfileEvent(const char * const component,
+                           const char * const stage,
+                           cl_event           event,
+                           size_t             bytes,
+                           size_t             items);
+
+/* Waits for the recorded commands and copies up to max_records of them to
+ * ret_records. Returns the number of records available.
+ */
+extern cl_int clGetProfileRecords(profile_record_t * const ret_records,
+                                  cl_int                   max_records);
+
+/* Same for the per-stage summary, stages in the order they were first recorded. */
+extern cl_int clGetProfileStats(profile_stage_stats_t * const ret_stats,
+                                cl_int                        max_stats);
+
+/* Writes the records and the per-stage summary to filename as JSON. */
+extern void clDumpProfileJSON(const char * const filename,
+                              cl_int     * const ret_err);
+
+/* Drops every record, pending events are released. */
+extern void clResetProfile(void);
+
 extern void clPrintAllAvaliableDevicesInfo(cl_device_id * usr_device_list,
                                            cl_uint num_devices);
 
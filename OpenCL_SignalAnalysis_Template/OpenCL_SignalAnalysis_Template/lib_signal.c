@@ -2,9 +2,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <math.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
 
 #include "lib_opencl.h"
 #include "lib_signal.h"
+#include "lib_signal_host.h"
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -15,9 +20,95 @@
 #define ERR_WRITE_BUFFER_NOK            4
 #define ERR_SETTING_ARGUMENTS_NOK       5
 #define ERR_READ_BUFFER_NOK             6
+#define ERR_PLAN_CREATION_NOK           7
+#define ERR_PLAN_DIMS_MISMATCH_NOK      8
+#define ERR_BATCH_SIZE_NOK              9
+#define ERR_MATRIX_DIMS_MISMATCH_NOK    10
+#define ERR_HOST_COMPUTE_NOK            11
+#define ERR_NO_DEVICE_NOK               12
 
 #define INFO_DEVICE_CONTEXT_CREATION_OK (ERR_DEVICE_CONTEXT_CREATION_NOK)
 #define INFO_KERNEL_OBJS_CREATION_NOK   (ERR_KERNEL_OBJS_CREATION_NOK)
+
+/* Plan buffers: 0 is always the input and 1 the output buffer, fast DCT plans add
+ * two complex work buffers and the twiddle tables, separable 2D plans add the
+ * transposed intermediate buffer and a reference on the cached cosine table.
+ */
+#define SIGNAL_PLAN_MAX_BUFFER 6
+#define SIGNAL_PLAN_MAX_STAGE  (SIGNAL_FAST_DCT_MAX_LOG2 + 2)
+
+#define SIGNAL_PLAN_BUFFER_INPUT            0
+#define SIGNAL_PLAN_BUFFER_OUTPUT           1
+#define SIGNAL_PLAN_BUFFER_WORK             2
+#define SIGNAL_PLAN_BUFFER_TWIDDLES         4
+#define SIGNAL_PLAN_BUFFER_QUARTER_TWIDDLES 5
+#define SIGNAL_PLAN_BUFFER_TEMP             2
+#define SIGNAL_PLAN_BUFFER_COS_TABLE        3
+
+#define SIGNAL_FAST_KERNEL_PREPARE_DCT  0
+#define SIGNAL_FAST_KERNEL_FINISH_DCT   1
+#define SIGNAL_FAST_KERNEL_PREPARE_IDCT 2
+#define SIGNAL_FAST_KERNEL_FINISH_IDCT  3
+#define SIGNAL_FAST_KERNEL_FFT_LOCAL    4
+#define SIGNAL_FAST_KERNEL_FFT_STAGE    5
+
+#define SIGNAL_SEPARABLE_KERNEL_DCT_ROWS     0
+#define SIGNAL_SEPARABLE_KERNEL_DCT_COLUMNS  1
+#define SIGNAL_SEPARABLE_KERNEL_IDCT_ROWS    2
+#define SIGNAL_SEPARABLE_KERNEL_IDCT_COLUMNS 3
+
+#define SIGNAL_MATRIX_KERNEL_NAIVE       0
+#define SIGNAL_MATRIX_KERNEL_TILED       1
+#define SIGNAL_MATRIX_KERNEL_TILED_BATCH 2
+
+#define SIGNAL_DISPATCH_DEVICE    0
+#define SIGNAL_DISPATCH_NO_DEVICE 1
+#define SIGNAL_DISPATCH_FORCED    2
+#define SIGNAL_DISPATCH_BUSY      3
+#define SIGNAL_DISPATCH_SMALL     4
+
+typedef struct
+{
+    cl_kernel kernel;
+    cl_uint   problem_dim;
+    size_t    global[2];
+    size_t    local[2];
+    cl_int    use_local;
+}signal_plan_stage_t;
+
+typedef struct
+{
+    int    dim_x;
+    int    table_dim;
+    cl_mem table;
+}signal_cos_table_t;
+
+typedef struct
+{
+    cl_device_id       device;
+    cl_context         context;
+    cl_command_queue   cmd_queue;
+    cl_kernel          batch_kernel_list[SIGNAL_BATCH_KERNEL_PRG_CNT];
+    cl_ulong           local_mem_size;
+    double             throughput_prior;
+    double             signals_per_ms;
+    cl_mem             batch_buffer[2];
+    size_t             batch_buffer_size;
+    signal_cos_table_t cos_table;
+}signal_split_device_t;
+
+struct signal_plan_s
+{
+    int                 signal_operation;
+    int                 input_dims[2];
+    int                 dispatch;       /* SIGNAL_DISPATCH_*, host plans hold no device objects. */
+    size_t              buffer_size;
+    cl_mem_flags        host_flags;     /* Extra flags of the input and output buffers. */
+    cl_int              num_buffer;
+    cl_mem              kernel_buffer[SIGNAL_PLAN_MAX_BUFFER];
+    cl_int              num_stage;
+    signal_plan_stage_t stage[SIGNAL_PLAN_MAX_STAGE];
+};
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 static volatile cl_device_id * dev_list = NULL;
@@ -26,13 +117,104 @@ static cl_int     dev_cnt = 0;
 static cl_context       signal_context;
 static cl_command_queue signal_cmd_queue;
 static cl_kernel        signal_kernel_list[KERNEL_PRG_CNT];
+static cl_program       signal_program = NULL;   /* Kept for the kernels of plans. */
 
 
 static char * kernel_name_list[KERNEL_PRG_CNT] = SIGNAL_KERNEL_LIST_NAMES;
+static char * fast_kernel_name_list[SIGNAL_FAST_KERNEL_PRG_CNT] = SIGNAL_FAST_KERNEL_LIST_NAMES;
+static char * batch_kernel_name_list[SIGNAL_BATCH_KERNEL_PRG_CNT] = SIGNAL_BATCH_KERNEL_LIST_NAMES;
+static char * separable_kernel_name_list[SIGNAL_SEPARABLE_KERNEL_PRG_CNT] = SIGNAL_SEPARABLE_KERNEL_LIST_NAMES;
+static char * matrix_kernel_name_list[SIGNAL_MATRIX_KERNEL_PRG_CNT] = SIGNAL_MATRIX_KERNEL_LIST_NAMES;
+
+static cl_kernel signal_matrix_kernel_list[SIGNAL_MATRIX_KERNEL_PRG_CNT];
+static cl_int    signal_matrix_tiled_support = 0;
+
+static cl_device_id         signal_device;
+static cl_ulong             signal_local_mem_size = 0;
+static cl_kernel            signal_batch_kernel_list[SIGNAL_BATCH_KERNEL_PRG_CNT];
+static signal_batch_stats_t signal_batch_stats;
+
+/* signal_split_device[0] is the component device, it shares signal_context and
+ * signal_batch_kernel_list.
+ */
+static signal_split_device_t signal_split_device[SIGNAL_MAX_DEVICES];
+static int                   signal_num_split_devices = 0;
+
+static cl_int signal_auto_select = 0;
+
+static cl_int       signal_backend          = SIGNAL_BACKEND_AUTO;
+static cl_int       signal_zero_copy_mode   = SIGNAL_ZERO_COPY_AUTO;
+static cl_int       signal_zero_copy        = 0;
+static cl_int       signal_device_ready     = 0;
+static volatile int signal_device_in_flight = 0;   /* 1 while a thread uses the device. */
+static int          signal_dispatch_log[KERNEL_PRG_CNT] = {-1, -1, -1, -1};
+
+static signal_plan_t * signal_plan_cache[SIGNAL_PLAN_CACHE_SIZE];
+static cl_int          signal_plan_cache_next = 0;
+
+static signal_cos_table_t signal_cos_table_cache[SIGNAL_COS_TABLE_CACHE_SIZE];
+static cl_int             signal_cos_table_cache_next = 0;
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 static void printSignalErrorMsg(int err_id);
 static void printSignalInfoMsg(int msg_id);
+static int  signalIsFastDCTSize(int signal_operation, const int input_dims[2]);
+static void signalPlanCreateDirect(signal_plan_t * const plan, cl_int * const ret_err);
+static void signalPlanCreateFastDCT(signal_plan_t * const plan, cl_int * const ret_err);
+static int  signalIsSeparable2DSize(int signal_operation, const int input_dims[2]);
+static void signalPlanCreateSeparable2D(signal_plan_t * const plan, cl_int * const ret_err);
+static cl_float * signalCreateCosineTableHost(int dim_x, int table_dim);
+static cl_mem signalGetCosineTable(int dim_x, int table_dim, cl_int * const ret_err);
+static void   signalMatrixMultiplyRun(signal_matrix_t * const mat_a,
+                                      signal_matrix_t * const mat_b,
+                                      int                     num_matrices,
+                                      int                     shared_b,
+                                      signal_matrix_t * const ret_mat,
+                                      int             * const ret_err);
+static signal_plan_t * signalGetCachedPlan(int         signal_operation,
+                                           const int   input_dims[2],
+                                           int * const ret_err);
+static double signalGetTimeMs(void);
+static double signalCalibrateDevice(cl_context       context,
+                                    cl_command_queue cmd_queue,
+                                    cl_device_id     device);
+static void   signalReserveBatchBuffers(signal_split_device_t * const device,
+                                        size_t                        size,
+                                        cl_int                * const ret_err);
+static cl_mem signalGetDeviceCosineTable(int dev_index, int dim_x, int table_dim, cl_int * const ret_err);
+static void   signalEnqueueBatch(int                   dev_index,
+                                 int                   signal_operation,
+                                 const float   * const input,
+                                 float         * const output,
+                                 const int             input_dims[2],
+                                 size_t                num_signals,
+                                 cl_event      * const ret_write_event,
+                                 cl_event      * const ret_read_event,
+                                 cl_int        * const ret_err);
+static void   signalComputeDevice(int signal_operation,
+                                  signal_matrix_t * const input_signal,
+                                  signal_matrix_t * const ret_signal,
+                                  int             * const ret_err);
+static void   signalComputeBatchDevice(int signal_operation,
+                                       signal_matrix_t * const input_signal,
+                                       const int               input_dims[2],
+                                       int                     num_signals,
+                                       signal_matrix_t * const ret_signal,
+                                       int             * const ret_err);
+static int    signalGetDispatch(int signal_operation, const int input_dims[2], int num_signals);
+static int    signalClaimDevice(int signal_operation, const int input_dims[2], int dispatch);
+static void   signalProfileKernelEvent(const char * const component,
+                                       cl_kernel          kernel,
+                                       cl_event           event,
+                                       size_t             bytes,
+                                       size_t             items);
+static void   signalLogDispatch(int signal_operation, int dispatch);
+static void   signalCopyMapped(cl_mem             buffer,
+                               void       * const host_ptr,
+                               size_t             size,
+                               cl_int             to_buffer,
+                               cl_event   * const ret_event,
+                               cl_int     * const ret_err);
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -70,6 +252,36 @@ static void printSignalErrorMsg(int err_id)
             printf("Error Signal analysis component: Reading from buffer ... NOK.\n");
             break;
         }
+        case ERR_PLAN_CREATION_NOK:
+        {
+            printf("Error Signal analysis component: Create signal plan ... NOK.\n");
+            break;
+        }
+        case ERR_PLAN_DIMS_MISMATCH_NOK:
+        {
+            printf("Error Signal analysis component: Signal dimensions do not match plan ... NOK.\n");
+            break;
+        }
+        case ERR_BATCH_SIZE_NOK:
+        {
+            printf("Error Signal analysis component: Invalid number of signals in batch ... NOK.\n");
+            break;
+        }
+        case ERR_MATRIX_DIMS_MISMATCH_NOK:
+        {
+            printf("Error Signal analysis component: Matrix dimensions do not match for multiplication ... NOK.\n");
+            break;
+        }
+        case ERR_HOST_COMPUTE_NOK:
+        {
+            printf("Error Signal analysis component: Host transform ... NOK.\n");
+            break;
+        }
+        case ERR_NO_DEVICE_NOK:
+        {
+            printf("Error Signal analysis component: Operation needs an initialized device ... NOK.\n");
+            break;
+        }
         default:
             break;
     }
@@ -110,11 +322,29 @@ void signalInit(const cl_device_id * const device_list,
      * return CPU device and print a warning.
      * Then create Context and Command queue for selected devices.
      */
-    clCreateDeviceAndContext((cl_device_id * const )dev_list,
-                             dev_cnt,
-                             &signal_context,
-                             &signal_cmd_queue,
-                             ret_err);
+    {
+        cl_device_id selected_device;
+        cl_int       err = !(CL_SUCCESS);
+        
+        /* In auto-selection mode the fastest device of a short 2D DCT calibration
+         * is used, falling back to the default choice when no device completes it.
+         */
+        if (signal_auto_select != 0)
+        {
+            clSelectFastestDevice("signal",
+                                  (cl_device_id * const)dev_list,
+                                  dev_cnt,
+                                  signalCalibrateDevice,
+                                  &selected_device,
+                                  &err);
+        }
+        
+        clCreateDeviceAndContext((err == CL_SUCCESS) ? &selected_device : (cl_device_id * const)dev_list,
+                                 (err == CL_SUCCESS) ? 1 : dev_cnt,
+                                 &signal_context,
+                                 &signal_cmd_queue,
+                                 ret_err);
+    }
     
     if (*ret_err != CL_SUCCESS)
     {
@@ -126,13 +356,57 @@ void signalInit(const cl_device_id * const device_list,
         printSignalInfoMsg(INFO_DEVICE_CONTEXT_CREATION_OK);
     }
     
-    /* Create program and kernel objects.
+    /* Create the program once, plans create their kernels from it later.
+     */
+    signal_program = clCreateProgramForContext(&signal_context,
+                                               (SIGNAL_KERNEL_FILE_NAME),
+                                               ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        signal_program = NULL;
+        printSignalErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+        return;
+    }
+    
+    /* Create kernel objects.
+     */
+    clCreateKernelObjsFromProgram(signal_program,
+                                  (const char **)kernel_name_list,
+                                  (KERNEL_PRG_CNT),
+                                  signal_kernel_list,
+                                  ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+        return;
+    }
+    
+    /* Create batched kernel objects.
+     */
+    clCreateKernelObjsFromProgram(signal_program,
+                                  (const char **)batch_kernel_name_list,
+                                  (SIGNAL_BATCH_KERNEL_PRG_CNT),
+                                  signal_batch_kernel_list,
+                                  ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+        return;
+    }
+    
+    /* Batched kernels stage one signal in local memory, keep the limit.
+     */
+    clGetCommandQueueInfo(signal_cmd_queue, CL_QUEUE_DEVICE, sizeof(cl_device_id), &signal_device, NULL);
+    clGetDeviceInfo(signal_device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &signal_local_mem_size, NULL);
+    
+    /* Create matrix kernel objects, the tiled kernels are only used when the device
+     * runs their fixed work group size.
      */
     clCreateKernelObjsForContext(&signal_context,
-                                 (SIGNAL_KERNEL_FILE_NAME),
-                                 (const char **)kernel_name_list,
-                                 (KERNEL_PRG_CNT),
-                                 signal_kernel_list,
+                                 (SIGNAL_MATRIX_KERNEL_FILE_NAME),
+                                 (const char **)matrix_kernel_name_list,
+                                 (SIGNAL_MATRIX_KERNEL_PRG_CNT),
+                                 signal_matrix_kernel_list,
                                  ret_err);
     if (*ret_err != CL_SUCCESS)
     {
@@ -140,13 +414,124 @@ void signalInit(const cl_device_id * const device_list,
         return;
     }
     
+    {
+        size_t work_group_size = 0;
+        
+        clGetKernelWorkGroupInfo(signal_matrix_kernel_list[SIGNAL_MATRIX_KERNEL_TILED],
+                                 signal_device,
+                                 CL_KERNEL_WORK_GROUP_SIZE,
+                                 sizeof(size_t),
+                                 &work_group_size,
+                                 NULL);
+        
+        signal_matrix_tiled_support = (work_group_size >= (SIGNAL_MATRIX_TILE_SIZE * SIGNAL_MATRIX_TILE_SIZE
+                                                           / SIGNAL_MATRIX_WORK_PER_ITEM));
+    }
+    
+    /* The component device is the first split device, every other usable device
+     * gets its own context, profiling queue and batch kernels so large batches can
+     * be split across all of them.
+     */
+    {
+        cl_device_id     other_device[SIGNAL_MAX_DEVICES];
+        cl_context       other_context[SIGNAL_MAX_DEVICES];
+        cl_command_queue other_queue[SIGNAL_MAX_DEVICES];
+        cl_int           num_other = 0;
+        cl_int           num_context = 0;
+        cl_int           err;
+        
+        memset(signal_split_device, 0, sizeof(signal_split_device));
+        
+        signal_split_device[0].device           = signal_device;
+        signal_split_device[0].context          = signal_context;
+        signal_split_device[0].cmd_queue        = signal_cmd_queue;
+        signal_split_device[0].local_mem_size   = signal_local_mem_size;
+        signal_split_device[0].throughput_prior = clGetDeviceThroughputPrior(signal_device);
+        memcpy(signal_split_device[0].batch_kernel_list, signal_batch_kernel_list, sizeof(signal_batch_kernel_list));
+        
+        signal_num_split_devices = 1;
+        
+        for (int i = 0; (i < dev_cnt) && (num_other < (SIGNAL_MAX_DEVICES - 1)); i += 1)
+        {
+            if (device_list[i] != signal_device)
+            {
+                other_device[num_other] = device_list[i];
+                num_other              += 1;
+            }
+        }
+        
+        clCreateContextPerDevice(other_device,
+                                 num_other,
+                                 CL_QUEUE_PROFILING_ENABLE,
+                                 other_context,
+                                 other_queue,
+                                 other_device,
+                                 &num_context,
+                                 &err);
+        
+        for (int i = 0; i < num_context; i += 1)
+        {
+            signal_split_device_t *device = &signal_split_device[signal_num_split_devices];
+            
+            clCreateKernelObjsForContext(&other_context[i],
+                                         (SIGNAL_KERNEL_FILE_NAME),
+                                         (const char **)batch_kernel_name_list,
+                                         (SIGNAL_BATCH_KERNEL_PRG_CNT),
+                                         device->batch_kernel_list,
+                                         &err);
+            if (err != CL_SUCCESS)
+            {
+                /* Batches are simply not split onto a device that cannot build the kernels. */
+                printSignalErrorMsg(ERR_KERNEL_OBJS_CREATION_NOK);
+                clReleaseCommandQueue(other_queue[i]);
+                clReleaseContext(other_context[i]);
+                continue;
+            }
+            
+            device->device           = other_device[i];
+            device->context          = other_context[i];
+            device->cmd_queue        = other_queue[i];
+            device->throughput_prior = clGetDeviceThroughputPrior(other_device[i]);
+            clGetDeviceInfo(other_device[i], CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &device->local_mem_size, NULL);
+            
+            signal_num_split_devices += 1;
+        }
+        
+        /* Batch timings need a profiling queue on the component device too. */
+        if (signal_num_split_devices > 1)
+        {
+            signal_split_device[0].cmd_queue = clCreateCommandQueue(signal_context,
+                                                                    signal_device,
+                                                                    CL_QUEUE_PROFILING_ENABLE,
+                                                                    &err);
+            if (err != CL_SUCCESS)
+            {
+                printSignalErrorMsg(ERR_DEVICE_CONTEXT_CREATION_NOK);
+                signal_split_device[0].cmd_queue = signal_cmd_queue;
+                signal_num_split_devices         = 1;
+            }
+        }
+        
+        printf("Info Signal analysis component: Batches split across %d device(s).\n", signal_num_split_devices);
+    }
+    
+    /* Zero-copy is worth it when the device works on host memory directly.
+     */
+    signal_zero_copy = (   (signal_zero_copy_mode == SIGNAL_ZERO_COPY_ON)
+                        || (   (signal_zero_copy_mode == SIGNAL_ZERO_COPY_AUTO)
+                            && (clGetDeviceUnifiedMemory(signal_device) == CL_TRUE)));
+    
+    printf("Info Signal analysis component: Zero-copy host buffers %s.\n", (signal_zero_copy != 0) ? "enabled" : "disabled");
+    
+    signal_device_ready = 1;
+    
     *ret_err = CL_SUCCESS;
 }
 
-void signalCompute(int signal_operation,
-                   signal_matrix_t * const input_signal,
-                   signal_matrix_t * const ret_signal,
-                   int             * const ret_err)
+static void signalComputeDevice(int signal_operation,
+                                signal_matrix_t * const input_signal,
+                                signal_matrix_t * const ret_signal,
+                                int             * const ret_err)
 {
     /* Check the type of operation, based on operation type the following parameters
      * shall be defined:
@@ -162,12 +547,33 @@ void signalCompute(int signal_operation,
     cl_int num_buffer;
     cl_mem * kernel_buffer;
     size_t   global[2];
+    size_t   local[3];
     size_t   buffer_size;
     size_t   num_input_buffer_write;
     size_t   num_arguments;
     size_t   start_output_buffer_index;
     cl_int   problem_dim;
+    cl_int   profile;
+    cl_int   zero_copy;
+    cl_event event;
+    signal_plan_t * plan;
     
+    /*! Power-of-two 1D transforms and larger 2D transforms run through a cached
+     *  fast DCT or separable plan.
+     */
+    if (   signalIsFastDCTSize(signal_operation, input_signal->input_dims)
+        || signalIsSeparable2DSize(signal_operation, input_signal->input_dims))
+    {
+        plan = signalGetCachedPlan(signal_operation, input_signal->input_dims, ret_err);
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            return;
+        }
+        
+        signalPlanExecute(plan, input_signal, ret_signal, ret_err);
+        return;
+    }
     
     switch (signal_operation)
     {
@@ -263,14 +669,22 @@ void signalCompute(int signal_operation,
         }
     }
     
-    /*! Create buffer for kernel.
+    /*! Create buffer for kernel, in zero-copy mode aligned signals are wrapped: the
+     *  input buffers use the input signal and the output buffers the return signal.
+     *  In place calls keep copying, two buffers may not wrap the same memory.
      */
+    zero_copy = (   (signal_zero_copy != 0)
+                 && (input_signal->signal != ret_signal->signal)
+                 && (clIsHostMemoryAligned(input_signal->signal) == CL_TRUE)
+                 && (clIsHostMemoryAligned(ret_signal->signal) == CL_TRUE));
+    
     for (size_t i = 0; i < num_buffer; i += 1)
     {
         kernel_buffer[i] = clCreateBuffer(signal_context,
-                                          CL_MEM_READ_WRITE,
+                                          (zero_copy != 0) ? (CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR) : CL_MEM_READ_WRITE,
                                           (buffer_size * sizeof(float)),
-                                          NULL,
+                                          (zero_copy == 0) ? NULL : (void *)((i < start_output_buffer_index) ? input_signal->signal
+                                                                                                              : ret_signal->signal),
                                           ret_err);
         if (*ret_err != CL_SUCCESS)
         {
@@ -280,10 +694,13 @@ void signalCompute(int signal_operation,
         }
     }
     
-    /*! Write input buffers.
+    /*! Write input buffers, every command is recorded when profiling.
      */
-    for (size_t i = 0; i < num_input_buffer_write; i += 1)
+    profile = clGetProfilingEnable();
+    
+    for (size_t i = 0; (i < num_input_buffer_write) && (zero_copy == 0); i += 1)
     {
+        event    = NULL;
         *ret_err = clEnqueueWriteBuffer(signal_cmd_queue,
                                         kernel_buffer[i],
                                         CL_TRUE,
@@ -292,7 +709,10 @@ void signalCompute(int signal_operation,
                                         (const void *)input_signal->signal,
                                         0,
                                         NULL,
-                                        NULL);
+                                        (profile != 0) ? &event : NULL);
+        
+        clProfileEvent("signal", "write input", event, (buffer_size * sizeof(float)), buffer_size);
+        
         if (*ret_err != CL_SUCCESS)
         {
             free(kernel_buffer);
@@ -343,17 +763,35 @@ void signalCompute(int signal_operation,
         }
     }
     
+    /*! Use the tuned work-group size of this kernel and size.
+     */
+    clGetTunedWorkGroupSize(signal_cmd_queue,
+                            signal_kernel_list[signal_operation],
+                            problem_dim,
+                            global,
+                            0,
+                            NULL,
+                            local);
+    
     /*! Enqueue data task execution.
      */
+    event    = NULL;
     *ret_err = clEnqueueNDRangeKernel(signal_cmd_queue,
                                       signal_kernel_list[signal_operation],
                                       problem_dim,
                                       NULL,
                                       global,
-                                      NULL,
+                                      (local[0] != 0) ? local : NULL,
                                       0,
                                       NULL,
-                                      NULL);
+                                      (profile != 0) ? &event : NULL);
+    
+    signalProfileKernelEvent("signal",
+                             signal_kernel_list[signal_operation],
+                             event,
+                             (num_buffer * buffer_size * sizeof(float)),
+                             buffer_size);
+    
     /*! Wait for command queue to finish.
      */
     clFinish(signal_cmd_queue);
@@ -362,15 +800,46 @@ void signalCompute(int signal_operation,
      */
     for (size_t i = start_output_buffer_index; i < num_buffer; i += 1)
     {
-        *ret_err = clEnqueueReadBuffer(signal_cmd_queue,
-                                       kernel_buffer[i],
-                                       CL_TRUE,
-                                       0,
-                                       (buffer_size * sizeof(float)),
-                                       (void *)ret_signal->signal,
-                                       0,
-                                       NULL,
-                                       NULL);
+        event = NULL;
+        
+        if (zero_copy != 0)
+        {
+            /* Mapping a wrapped output makes the kernel results visible in ret_signal. */
+            void *mapped = clEnqueueMapBuffer(signal_cmd_queue,
+                                              kernel_buffer[i],
+                                              CL_TRUE,
+                                              CL_MAP_READ,
+                                              0,
+                                              (buffer_size * sizeof(float)),
+                                              0,
+                                              NULL,
+                                              (profile != 0) ? &event : NULL,
+                                              ret_err);
+            
+            if (*ret_err == CL_SUCCESS)
+            {
+                *ret_err = clEnqueueUnmapMemObject(signal_cmd_queue, kernel_buffer[i], mapped, 0, NULL, NULL);
+            }
+        }
+        else
+        {
+            *ret_err = clEnqueueReadBuffer(signal_cmd_queue,
+                                           kernel_buffer[i],
+                                           CL_TRUE,
+                                           0,
+                                           (buffer_size * sizeof(float)),
+                                           (void *)ret_signal->signal,
+                                           0,
+                                           NULL,
+                                           (profile != 0) ? &event : NULL);
+        }
+        
+        clProfileEvent("signal",
+                       (zero_copy != 0) ? "map output" : "read output",
+                       event,
+                       (buffer_size * sizeof(float)),
+                       buffer_size);
+        
         if (*ret_err != CL_SUCCESS)
         {
             printSignalErrorMsg(ERR_READ_BUFFER_NOK);
@@ -393,4 +862,1976 @@ void signalCompute(int signal_operation,
     *ret_err = CL_SUCCESS;
     
 }
+
+void signalCompute(int signal_operation,
+                   signal_matrix_t * const input_signal,
+                   signal_matrix_t * const ret_signal,
+                   int             * const ret_err)
+{
+    int input_dims[2];
+    int dispatch;
+    
+    input_dims[0] = input_signal->input_dims[0];
+    input_dims[1] = (input_signal->input_dims[1] == 0) ? 1 : input_signal->input_dims[1];
+    
+    /*! Small signals, a busy or missing device and SIGNAL_BACKEND_HOST run on the
+     *  host, everything else keeps the device paths.
+     */
+    dispatch = signalGetDispatch(signal_operation, input_dims, 1);
+    
+    if ((dispatch == SIGNAL_DISPATCH_DEVICE) && (signal_device_ready == 0))
+    {
+        /* Shapes the host does not take need the device. */
+        printSignalErrorMsg(ERR_HOST_COMPUTE_NOK);
+        *ret_err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    dispatch = signalClaimDevice(signal_operation, input_dims, dispatch);
+    
+    signalLogDispatch(signal_operation, dispatch);
+    
+    if (dispatch != SIGNAL_DISPATCH_DEVICE)
+    {
+        signalHostCompute(signal_operation, input_signal->signal, ret_signal->signal, input_dims, 1, ret_err);
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_HOST_COMPUTE_NOK);
+            return;
+        }
+        
+        ret_signal->input_dims[0] = input_dims[0];
+        ret_signal->input_dims[1] = input_dims[1];
+        return;
+    }
+    
+    signalComputeDevice(signal_operation, input_signal, ret_signal, ret_err);
+    __sync_lock_release(&signal_device_in_flight);
+}
+
+void signalSetBackend(cl_int backend)
+{
+    signal_backend = backend;
+}
+
+void signalSetZeroCopy(cl_int mode)
+{
+    signal_zero_copy_mode = mode;
+}
+
+void signalSetDeviceAutoSelect(cl_int enable)
+{
+    signal_auto_select = enable;
+}
+
+void signalDeinit(cl_int * const ret_err)
+{
+    signalHostDeinit();
+    
+    /* Nothing to release when signalInit did not complete. */
+    if (signal_device_ready == 0)
+    {
+        *ret_err = CL_SUCCESS;
+        return;
+    }
+    
+    signal_device_ready = 0;
+    
+    /* Release cached plans, then kernels, command queue and context.
+     */
+    for (int i = 0; i < SIGNAL_PLAN_CACHE_SIZE; i += 1)
+    {
+        signalPlanDestroy(signal_plan_cache[i]);
+        signal_plan_cache[i] = NULL;
+    }
+    
+    signal_plan_cache_next = 0;
+    
+    /* Release split devices, the first one shares the component context and kernels.
+     */
+    for (int i = 0; i < SIGNAL_MAX_DEVICES; i += 1)
+    {
+        signal_split_device_t *device = &signal_split_device[i];
+        
+        for (int j = 0; j < 2; j += 1)
+        {
+            if (device->batch_buffer[j] != NULL)
+            {
+                clReleaseMemObject(device->batch_buffer[j]);
+                device->batch_buffer[j] = NULL;
+            }
+        }
+        
+        device->batch_buffer_size = 0;
+        
+        if (device->cos_table.table != NULL)
+        {
+            clReleaseMemObject(device->cos_table.table);
+            device->cos_table.table = NULL;
+        }
+        
+        if ((i > 0) && (i < signal_num_split_devices))
+        {
+            clCleanEnvironment(&device->context,
+                               &device->cmd_queue,
+                               device->batch_kernel_list,
+                               SIGNAL_BATCH_KERNEL_PRG_CNT);
+        }
+        else if ((i == 0) && (device->cmd_queue != NULL) && (device->cmd_queue != signal_cmd_queue))
+        {
+            clReleaseCommandQueue(device->cmd_queue);
+        }
+        
+        device->cmd_queue = NULL;
+    }
+    
+    signal_num_split_devices = 0;
+    
+    for (int i = 0; i < SIGNAL_COS_TABLE_CACHE_SIZE; i += 1)
+    {
+        if (signal_cos_table_cache[i].table != NULL)
+        {
+            clReleaseMemObject(signal_cos_table_cache[i].table);
+            signal_cos_table_cache[i].table = NULL;
+        }
+    }
+    
+    signal_cos_table_cache_next = 0;
+    
+    for (int i = 0; i < SIGNAL_BATCH_KERNEL_PRG_CNT; i += 1)
+    {
+        clReleaseKernel(signal_batch_kernel_list[i]);
+    }
+    
+    for (int i = 0; i < SIGNAL_MATRIX_KERNEL_PRG_CNT; i += 1)
+    {
+        clReleaseKernel(signal_matrix_kernel_list[i]);
+    }
+    
+    clReleaseProgram(signal_program);
+    signal_program = NULL;
+    
+    clCleanEnvironment(&signal_context,
+                       &signal_cmd_queue,
+                       signal_kernel_list,
+                       KERNEL_PRG_CNT);
+    
+    *ret_err = CL_SUCCESS;
+}
+
+static int signalIsFastDCTSize(int signal_operation, const int input_dims[2])
+{
+    int n;
+    
+    n = input_dims[0];
+    
+    /* Only 1D transforms with a power-of-two length in the supported range.
+     */
+    return (   ((signal_operation == SIGNAL_1D_DCT) || (signal_operation == SIGNAL_1D_IDCT))
+            && (input_dims[1] <= 1)
+            && (n >= SIGNAL_FAST_DCT_MIN_SIZE)
+            && (n <= (1 << SIGNAL_FAST_DCT_MAX_LOG2))
+            && ((n & (n - 1)) == 0));
+}
+
+static signal_plan_t * signalGetCachedPlan(int         signal_operation,
+                                           const int   input_dims[2],
+                                           int * const ret_err)
+{
+    signal_plan_t *plan;
+    int           input_dim_y;
+    
+    input_dim_y = (input_dims[1] == 0) ? 1 : input_dims[1];
+    
+    for (int i = 0; i < SIGNAL_PLAN_CACHE_SIZE; i += 1)
+    {
+        plan = signal_plan_cache[i];
+        
+        if (   (plan != NULL)
+            && (plan->signal_operation == signal_operation)
+            && (plan->input_dims[0]    == input_dims[0])
+            && (plan->input_dims[1]    == input_dim_y))
+        {
+            *ret_err = CL_SUCCESS;
+            return (plan);
+        }
+    }
+    
+    plan = signalPlanCreate(signal_operation, input_dims, ret_err);
+    
+    if (plan == NULL)
+    {
+        return (NULL);
+    }
+    
+    /* Replace the oldest cached plan.
+     */
+    signalPlanDestroy(signal_plan_cache[signal_plan_cache_next]);
+    signal_plan_cache[signal_plan_cache_next] = plan;
+    signal_plan_cache_next = (signal_plan_cache_next + 1) % SIGNAL_PLAN_CACHE_SIZE;
+    
+    return (plan);
+}
+
+static void signalPlanCreateDirect(signal_plan_t * const plan, cl_int * const ret_err)
+{
+    signal_plan_stage_t *stage;
+    cl_int              err;
+    
+    stage = &plan->stage[0];
+    
+    /*! Set problem dimension and work group global size, same layout as signalCompute.
+     */
+    switch (plan->signal_operation)
+    {
+        case SIGNAL_1D_DCT:
+        case SIGNAL_1D_IDCT:
+        {
+            stage->problem_dim = 1;
+            stage->global[0]   = plan->input_dims[0];
+            stage->global[1]   = 0;
+            break;
+        }
+        case SIGNAL_2D_DCT:
+        case SIGNAL_2D_IDCT:
+        {
+            stage->problem_dim = 2;
+            stage->global[0]   = plan->input_dims[0];
+            stage->global[1]   = plan->input_dims[1];
+            break;
+        }
+        default :
+        {
+            printSignalErrorMsg(ERR_SIGNAL_OPERATION_NOK);
+            *ret_err = !(CL_SUCCESS);
+            return;
+        }
+    }
+    
+    /*! Create a private kernel object, so the plan arguments are never overwritten
+     *  by signalCompute or by other plans.
+     */
+    clCreateKernelObjsFromProgram(signal_program,
+                                  (const char **)&kernel_name_list[plan->signal_operation],
+                                  1,
+                                  &stage->kernel,
+                                  ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        stage->kernel = NULL;
+        printSignalErrorMsg(ERR_PLAN_CREATION_NOK);
+        return;
+    }
+    
+    plan->num_stage = 1;
+    
+    /*! Create input and output buffers.
+     */
+    for (int i = 0; i < 2; i += 1)
+    {
+        plan->kernel_buffer[i] = clCreateBuffer(signal_context,
+                                                (CL_MEM_READ_WRITE | plan->host_flags),
+                                                (plan->buffer_size * sizeof(float)),
+                                                NULL,
+                                                ret_err);
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+            return;
+        }
+        
+        plan->num_buffer += 1;
+    }
+    
+    /*! Set kernel arguments once: buffers followed by the problem dimensions.
+     */
+    err = 0;
+    
+    for (cl_uint i = 0; i < 2; i += 1)
+    {
+        err |= clSetKernelArg(stage->kernel,
+                              i,
+                              (sizeof(cl_mem)),
+                              &plan->kernel_buffer[i]);
+    }
+    
+    for (cl_uint i = 0; i < stage->problem_dim; i += 1)
+    {
+        err |= clSetKernelArg(stage->kernel,
+                              (2 + i),
+                              (sizeof(int)),
+                              &plan->input_dims[i]);
+    }
+    
+    if (err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        *ret_err = err;
+        return;
+    }
+    
+    *ret_err = CL_SUCCESS;
+}
+
+static int signalIsSeparable2DSize(int signal_operation, const int input_dims[2])
+{
+    /* 2D transforms from SIGNAL_SEPARABLE_DCT_MIN_SIZE on, small blocks keep the
+     * single launch of the direct kernel.
+     */
+    return (   ((signal_operation == SIGNAL_2D_DCT) || (signal_operation == SIGNAL_2D_IDCT))
+            && (   (input_dims[0] >= SIGNAL_SEPARABLE_DCT_MIN_SIZE)
+                || (input_dims[1] >= SIGNAL_SEPARABLE_DCT_MIN_SIZE)));
+}
+
+static cl_float * signalCreateCosineTableHost(int dim_x, int table_dim)
+{
+    cl_float *table;
+    
+    /*! Compute c(k) * cos(k*pi*(2n+1)/(2*dim_x)) in double precision, stored as
+     *  table[n * table_dim + k].
+     */
+    table = (cl_float *)malloc(table_dim * table_dim * sizeof(cl_float));
+    
+    if (table == NULL)
+    {
+        return (NULL);
+    }
+    
+    for (int n = 0; n < table_dim; n += 1)
+    {
+        for (int k = 0; k < table_dim; k += 1)
+        {
+            table[n * table_dim + k] = (cl_float)(((k == 0) ? M_SQRT1_2 : 1.0)
+                                                  * cos(M_PI * k * (2 * n + 1) / (2.0 * dim_x)));
+        }
+    }
+    
+    return (table);
+}
+
+static cl_mem signalGetCosineTable(int dim_x, int table_dim, cl_int * const ret_err)
+{
+    signal_cos_table_t *entry;
+    cl_float           *table;
+    size_t             table_size;
+    
+    for (int i = 0; i < SIGNAL_COS_TABLE_CACHE_SIZE; i += 1)
+    {
+        entry = &signal_cos_table_cache[i];
+        
+        if (   (entry->table     != NULL)
+            && (entry->dim_x     == dim_x)
+            && (entry->table_dim == table_dim))
+        {
+            *ret_err = CL_SUCCESS;
+            return (entry->table);
+        }
+    }
+    
+    table_size = table_dim * table_dim * sizeof(cl_float);
+    table      = signalCreateCosineTableHost(dim_x, table_dim);
+    
+    if (table == NULL)
+    {
+        printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+        *ret_err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    /*! Replace the oldest cached table, plans using it keep their own reference.
+     */
+    entry = &signal_cos_table_cache[signal_cos_table_cache_next];
+    
+    if (entry->table != NULL)
+    {
+        clReleaseMemObject(entry->table);
+        entry->table = NULL;
+    }
+    
+    entry->table = clCreateBuffer(signal_context,
+                                  (CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR),
+                                  table_size,
+                                  (void *)table,
+                                  ret_err);
+    free(table);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        entry->table = NULL;
+        printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+        return (NULL);
+    }
+    
+    entry->dim_x                = dim_x;
+    entry->table_dim            = table_dim;
+    signal_cos_table_cache_next = (signal_cos_table_cache_next + 1) % SIGNAL_COS_TABLE_CACHE_SIZE;
+    
+    return (entry->table);
+}
+
+static void signalPlanCreateSeparable2D(signal_plan_t * const plan, cl_int * const ret_err)
+{
+    const char *stage_name_list[2];
+    cl_kernel  stage_kernel_list[2];
+    size_t     buffer_size_list[3];
+    cl_int     dim_x;
+    cl_int     dim_y;
+    cl_int     table_dim;
+    cl_int     is_inverse;
+    cl_int     err;
+    
+    dim_x      = plan->input_dims[0];
+    dim_y      = plan->input_dims[1];
+    table_dim  = (dim_x > dim_y) ? dim_x : dim_y;
+    is_inverse = (plan->signal_operation == SIGNAL_2D_IDCT);
+    
+    stage_name_list[0] = separable_kernel_name_list[(is_inverse) ? SIGNAL_SEPARABLE_KERNEL_IDCT_ROWS
+                                                                 : SIGNAL_SEPARABLE_KERNEL_DCT_ROWS];
+    stage_name_list[1] = separable_kernel_name_list[(is_inverse) ? SIGNAL_SEPARABLE_KERNEL_IDCT_COLUMNS
+                                                                 : SIGNAL_SEPARABLE_KERNEL_DCT_COLUMNS];
+    
+    clCreateKernelObjsFromProgram(signal_program,
+                                  stage_name_list,
+                                  2,
+                                  stage_kernel_list,
+                                  ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_PLAN_CREATION_NOK);
+        return;
+    }
+    
+    plan->num_stage = 2;
+    
+    /*! Work sizes follow the index ranges of computeDCT2D/computeIDCT2D.
+     */
+    for (int i = 0; i < 2; i += 1)
+    {
+        plan->stage[i].kernel      = stage_kernel_list[i];
+        plan->stage[i].problem_dim = 2;
+        plan->stage[i].use_local   = 0;
+    }
+    
+    if (is_inverse)
+    {
+        plan->stage[0].global[0] = dim_y;
+        plan->stage[0].global[1] = dim_y;
+        plan->stage[1].global[0] = dim_x;
+        plan->stage[1].global[1] = dim_y;
+    }
+    else
+    {
+        plan->stage[0].global[0] = dim_x;
+        plan->stage[0].global[1] = dim_y;
+        plan->stage[1].global[0] = dim_y;
+        plan->stage[1].global[1] = dim_x;
+    }
+    
+    /*! Create input, output and transposed intermediate buffers, then take a
+     *  reference on the cached cosine table.
+     */
+    buffer_size_list[SIGNAL_PLAN_BUFFER_INPUT]  = plan->buffer_size * sizeof(float);
+    buffer_size_list[SIGNAL_PLAN_BUFFER_OUTPUT] = plan->buffer_size * sizeof(float);
+    buffer_size_list[SIGNAL_PLAN_BUFFER_TEMP]   = table_dim * table_dim * sizeof(float);
+    
+    for (int i = 0; i < 3; i += 1)
+    {
+        plan->kernel_buffer[i] = clCreateBuffer(signal_context,
+                                                (i <= SIGNAL_PLAN_BUFFER_OUTPUT) ? (CL_MEM_READ_WRITE | plan->host_flags) : CL_MEM_READ_WRITE,
+                                                buffer_size_list[i],
+                                                NULL,
+                                                ret_err);
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+            return;
+        }
+        
+        plan->num_buffer += 1;
+    }
+    
+    plan->kernel_buffer[SIGNAL_PLAN_BUFFER_COS_TABLE] = signalGetCosineTable(dim_x, table_dim, ret_err);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    clRetainMemObject(plan->kernel_buffer[SIGNAL_PLAN_BUFFER_COS_TABLE]);
+    plan->num_buffer += 1;
+    
+    /*! Set arguments once: rows read the input and write the intermediate buffer,
+     *  columns read the intermediate and write the output buffer.
+     */
+    err = 0;
+    
+    for (int i = 0; i < 2; i += 1)
+    {
+        cl_kernel kernel = plan->stage[i].kernel;
+        
+        err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &plan->kernel_buffer[(i == 0) ? SIGNAL_PLAN_BUFFER_INPUT
+                                                                                         : SIGNAL_PLAN_BUFFER_TEMP]);
+        err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &plan->kernel_buffer[(i == 0) ? SIGNAL_PLAN_BUFFER_TEMP
+                                                                                         : SIGNAL_PLAN_BUFFER_OUTPUT]);
+        err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_COS_TABLE]);
+        err |= clSetKernelArg(kernel, 3, sizeof(cl_int), &dim_x);
+        err |= clSetKernelArg(kernel, 4, sizeof(cl_int), &dim_y);
+        err |= clSetKernelArg(kernel, 5, sizeof(cl_int), &table_dim);
+    }
+    
+    if (err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        *ret_err = err;
+        return;
+    }
+    
+    *ret_err = CL_SUCCESS;
+}
+
+static void signalPlanCreateFastDCT(signal_plan_t * const plan, cl_int * const ret_err)
+{
+    const char   *stage_name_list[SIGNAL_PLAN_MAX_STAGE];
+    cl_kernel    stage_kernel_list[SIGNAL_PLAN_MAX_STAGE];
+    size_t       buffer_size_list[SIGNAL_PLAN_MAX_BUFFER];
+    cl_float     *twiddles;
+    cl_float     *quarter_twiddles;
+    size_t       work_group_size;
+    cl_float     direction;
+    cl_int       n;
+    cl_int       num_pass;
+    cl_int       use_local_fft;
+    cl_int       fft_output;
+    cl_int       is_inverse;
+    cl_int       err;
+    
+    n          = plan->input_dims[0];
+    is_inverse = (plan->signal_operation == SIGNAL_1D_IDCT);
+    direction  = (is_inverse) ? -1.0f : 1.0f;
+    
+    for (num_pass = 0; (1 << num_pass) < n; num_pass += 1);
+    
+    /*! Run the whole FFT in one work group when both __local ping-pong arrays fit,
+     *  otherwise run one global kernel per radix-2 pass.
+     */
+    use_local_fft = ((cl_ulong)(2 * n * 2 * sizeof(cl_float)) <= signal_local_mem_size);
+    
+    plan->num_stage = 0;
+    stage_name_list[plan->num_stage++] = fast_kernel_name_list[(is_inverse) ? SIGNAL_FAST_KERNEL_PREPARE_IDCT
+                                                                            : SIGNAL_FAST_KERNEL_PREPARE_DCT];
+    if (use_local_fft)
+    {
+        stage_name_list[plan->num_stage++] = fast_kernel_name_list[SIGNAL_FAST_KERNEL_FFT_LOCAL];
+    }
+    else
+    {
+        for (cl_int i = 0; i < num_pass; i += 1)
+        {
+            stage_name_list[plan->num_stage++] = fast_kernel_name_list[SIGNAL_FAST_KERNEL_FFT_STAGE];
+        }
+    }
+    stage_name_list[plan->num_stage++] = fast_kernel_name_list[(is_inverse) ? SIGNAL_FAST_KERNEL_FINISH_IDCT
+                                                                            : SIGNAL_FAST_KERNEL_FINISH_DCT];
+    
+    /*! Create one kernel object per stage, so every stage keeps its own arguments.
+     */
+    clCreateKernelObjsFromProgram(signal_program,
+                                  stage_name_list,
+                                  plan->num_stage,
+                                  stage_kernel_list,
+                                  ret_err);
+    if (*ret_err != CL_SUCCESS)
+    {
+        plan->num_stage = 0;
+        printSignalErrorMsg(ERR_PLAN_CREATION_NOK);
+        return;
+    }
+    
+    for (cl_int i = 0; i < plan->num_stage; i += 1)
+    {
+        plan->stage[i].kernel      = stage_kernel_list[i];
+        plan->stage[i].problem_dim = 1;
+        plan->stage[i].global[0]   = n;
+        plan->stage[i].global[1]   = 0;
+        plan->stage[i].use_local   = 0;
+    }
+    
+    /*! Create input, output, complex work buffers and twiddle tables.
+     */
+    buffer_size_list[SIGNAL_PLAN_BUFFER_INPUT]            = n * sizeof(cl_float);
+    buffer_size_list[SIGNAL_PLAN_BUFFER_OUTPUT]           = n * sizeof(cl_float);
+    buffer_size_list[SIGNAL_PLAN_BUFFER_WORK]             = n * 2 * sizeof(cl_float);
+    buffer_size_list[SIGNAL_PLAN_BUFFER_WORK + 1]         = n * 2 * sizeof(cl_float);
+    buffer_size_list[SIGNAL_PLAN_BUFFER_TWIDDLES]         = n * sizeof(cl_float);
+    buffer_size_list[SIGNAL_PLAN_BUFFER_QUARTER_TWIDDLES] = n * 2 * sizeof(cl_float);
+    
+    for (int i = 0; i < SIGNAL_PLAN_MAX_BUFFER; i += 1)
+    {
+        plan->kernel_buffer[i] = clCreateBuffer(signal_context,
+                                                (i <= SIGNAL_PLAN_BUFFER_OUTPUT) ? (CL_MEM_READ_WRITE | plan->host_flags) : CL_MEM_READ_WRITE,
+                                                buffer_size_list[i],
+                                                NULL,
+                                                ret_err);
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+            return;
+        }
+        
+        plan->num_buffer += 1;
+    }
+    
+    /*! Precompute twiddle tables in double precision and upload them once.
+     */
+    twiddles         = (cl_float *)malloc(buffer_size_list[SIGNAL_PLAN_BUFFER_TWIDDLES]);
+    quarter_twiddles = (cl_float *)malloc(buffer_size_list[SIGNAL_PLAN_BUFFER_QUARTER_TWIDDLES]);
+    
+    if ((twiddles == NULL) || (quarter_twiddles == NULL))
+    {
+        free(twiddles);
+        free(quarter_twiddles);
+        printSignalErrorMsg(ERR_PLAN_CREATION_NOK);
+        *ret_err = CL_OUT_OF_HOST_MEMORY;
+        return;
+    }
+    
+    for (cl_int j = 0; j < (n >> 1); j += 1)
+    {
+        twiddles[2 * j]     = (cl_float)cos(2.0 * M_PI * j / n);
+        twiddles[2 * j + 1] = (cl_float)-sin(2.0 * M_PI * j / n);
+    }
+    
+    for (cl_int k = 0; k < n; k += 1)
+    {
+        quarter_twiddles[2 * k]     = (cl_float)cos(M_PI * k / (2.0 * n));
+        quarter_twiddles[2 * k + 1] = (cl_float)sin(M_PI * k / (2.0 * n));
+    }
+    
+    *ret_err  = clEnqueueWriteBuffer(signal_cmd_queue,
+                                     plan->kernel_buffer[SIGNAL_PLAN_BUFFER_TWIDDLES],
+                                     CL_TRUE,
+                                     0,
+                                     buffer_size_list[SIGNAL_PLAN_BUFFER_TWIDDLES],
+                                     (const void *)twiddles,
+                                     0,
+                                     NULL,
+                                     NULL);
+    *ret_err |= clEnqueueWriteBuffer(signal_cmd_queue,
+                                     plan->kernel_buffer[SIGNAL_PLAN_BUFFER_QUARTER_TWIDDLES],
+                                     CL_TRUE,
+                                     0,
+                                     buffer_size_list[SIGNAL_PLAN_BUFFER_QUARTER_TWIDDLES],
+                                     (const void *)quarter_twiddles,
+                                     0,
+                                     NULL,
+                                     NULL);
+    free(twiddles);
+    free(quarter_twiddles);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_WRITE_BUFFER_NOK);
+        return;
+    }
+    
+    /*! Set stage arguments once.
+     *  Prepare: input -> work[0].
+     */
+    err = 0;
+    
+    err |= clSetKernelArg(plan->stage[0].kernel, 0, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_INPUT]);
+    err |= clSetKernelArg(plan->stage[0].kernel, 1, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_WORK]);
+    if (is_inverse)
+    {
+        err |= clSetKernelArg(plan->stage[0].kernel, 2, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_QUARTER_TWIDDLES]);
+        err |= clSetKernelArg(plan->stage[0].kernel, 3, sizeof(cl_int), &n);
+    }
+    else
+    {
+        err |= clSetKernelArg(plan->stage[0].kernel, 2, sizeof(cl_int), &n);
+    }
+    
+    /*! FFT: work[0] -> work[1] in local memory, or ping-pong between the work
+     *  buffers one pass per stage.
+     */
+    if (use_local_fft)
+    {
+        signal_plan_stage_t *stage = &plan->stage[1];
+        
+        work_group_size = 1;
+        clGetKernelWorkGroupInfo(stage->kernel,
+                                 signal_device,
+                                 CL_KERNEL_WORK_GROUP_SIZE,
+                                 sizeof(size_t),
+                                 &work_group_size,
+                                 NULL);
+        
+        stage->use_local = 1;
+        stage->global[0] = (work_group_size < (size_t)(n >> 1)) ? work_group_size : (size_t)(n >> 1);
+        stage->local[0]  = stage->global[0];
+        stage->local[1]  = 0;
+        
+        err |= clSetKernelArg(stage->kernel, 0, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_WORK]);
+        err |= clSetKernelArg(stage->kernel, 1, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_WORK + 1]);
+        err |= clSetKernelArg(stage->kernel, 2, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_TWIDDLES]);
+        err |= clSetKernelArg(stage->kernel, 3, sizeof(cl_int), &n);
+        err |= clSetKernelArg(stage->kernel, 4, sizeof(cl_float), &direction);
+        err |= clSetKernelArg(stage->kernel, 5, (2 * n * 2 * sizeof(cl_float)), NULL);
+        
+        fft_output = SIGNAL_PLAN_BUFFER_WORK + 1;
+    }
+    else
+    {
+        for (cl_int i = 0; i < num_pass; i += 1)
+        {
+            signal_plan_stage_t *stage = &plan->stage[1 + i];
+            cl_int              span   = (1 << i);
+            
+            stage->global[0] = (n >> 1);
+            
+            err |= clSetKernelArg(stage->kernel, 0, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_WORK + (i & 1)]);
+            err |= clSetKernelArg(stage->kernel, 1, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_WORK + !(i & 1)]);
+            err |= clSetKernelArg(stage->kernel, 2, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_TWIDDLES]);
+            err |= clSetKernelArg(stage->kernel, 3, sizeof(cl_int), &n);
+            err |= clSetKernelArg(stage->kernel, 4, sizeof(cl_int), &span);
+            err |= clSetKernelArg(stage->kernel, 5, sizeof(cl_float), &direction);
+        }
+        
+        fft_output = SIGNAL_PLAN_BUFFER_WORK + (num_pass & 1);
+    }
+    
+    /*! Finish: FFT output -> output buffer.
+     */
+    {
+        signal_plan_stage_t *stage = &plan->stage[plan->num_stage - 1];
+        
+        err |= clSetKernelArg(stage->kernel, 0, sizeof(cl_mem), &plan->kernel_buffer[fft_output]);
+        err |= clSetKernelArg(stage->kernel, 1, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_OUTPUT]);
+        if (is_inverse)
+        {
+            err |= clSetKernelArg(stage->kernel, 2, sizeof(cl_int), &n);
+        }
+        else
+        {
+            err |= clSetKernelArg(stage->kernel, 2, sizeof(cl_mem), &plan->kernel_buffer[SIGNAL_PLAN_BUFFER_QUARTER_TWIDDLES]);
+            err |= clSetKernelArg(stage->kernel, 3, sizeof(cl_int), &n);
+        }
+    }
+    
+    if (err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        *ret_err = err;
+        return;
+    }
+    
+    *ret_err = CL_SUCCESS;
+}
+
+signal_plan_t * signalPlanCreate(int         signal_operation,
+                                 const int   input_dims[2],
+                                 int * const ret_err)
+{
+    signal_plan_t *plan;
+    
+    plan = (signal_plan_t *)calloc(1, sizeof(signal_plan_t));
+    
+    if (plan == NULL)
+    {
+        printSignalErrorMsg(ERR_PLAN_CREATION_NOK);
+        *ret_err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    plan->signal_operation = signal_operation;
+    plan->input_dims[0]    = input_dims[0];
+    plan->input_dims[1]    = (input_dims[1] == 0) ? 1 : input_dims[1];
+    plan->buffer_size      = plan->input_dims[0] * plan->input_dims[1];
+    plan->host_flags       = (signal_zero_copy != 0) ? CL_MEM_ALLOC_HOST_PTR : 0;
+    
+    /*! Without a device or with SIGNAL_BACKEND_HOST the plan transforms on the host,
+     *  as signalCompute would. A device plan stays on the device for every call.
+     */
+    plan->dispatch = signalGetDispatch(signal_operation, plan->input_dims, 1);
+    
+    if ((plan->dispatch == SIGNAL_DISPATCH_NO_DEVICE) || (plan->dispatch == SIGNAL_DISPATCH_FORCED))
+    {
+        *ret_err = CL_SUCCESS;
+        return (plan);
+    }
+    
+    plan->dispatch = SIGNAL_DISPATCH_DEVICE;
+    
+    if (signal_device_ready == 0)
+    {
+        /* Shapes the host does not take need the device. */
+        printSignalErrorMsg(ERR_NO_DEVICE_NOK);
+        signalPlanDestroy(plan);
+        *ret_err = CL_INVALID_VALUE;
+        return (NULL);
+    }
+    
+    /*! Power-of-two 1D transforms use the fast DCT kernels, larger 2D transforms the
+     *  separable kernels, everything else the direct kernel of the operation.
+     */
+    if (signalIsFastDCTSize(signal_operation, plan->input_dims))
+    {
+        signalPlanCreateFastDCT(plan, ret_err);
+    }
+    else if (signalIsSeparable2DSize(signal_operation, plan->input_dims))
+    {
+        signalPlanCreateSeparable2D(plan, ret_err);
+    }
+    else
+    {
+        signalPlanCreateDirect(plan, ret_err);
+    }
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        signalPlanDestroy(plan);
+        return (NULL);
+    }
+    
+    return (plan);
+}
+
+void signalPlanExecute(signal_plan_t   * const plan,
+                       signal_matrix_t * const input_signal,
+                       signal_matrix_t * const ret_signal,
+                       int             * const ret_err)
+{
+    cl_event event;
+    cl_int   profile;
+    int      input_dim_y;
+    
+    input_dim_y = (input_signal->input_dims[1] == 0) ? 1 : input_signal->input_dims[1];
+    profile     = clGetProfilingEnable();
+    
+    if (   (input_signal->input_dims[0] != plan->input_dims[0])
+        || (input_dim_y                 != plan->input_dims[1]))
+    {
+        printSignalErrorMsg(ERR_PLAN_DIMS_MISMATCH_NOK);
+        *ret_err = !(CL_SUCCESS);
+        return;
+    }
+    
+    if (plan->dispatch != SIGNAL_DISPATCH_DEVICE)
+    {
+        signalLogDispatch(plan->signal_operation, plan->dispatch);
+        signalHostCompute(plan->signal_operation, input_signal->signal, ret_signal->signal, plan->input_dims, 1, ret_err);
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_HOST_COMPUTE_NOK);
+            return;
+        }
+        
+        ret_signal->input_dims[0] = input_signal->input_dims[0];
+        ret_signal->input_dims[1] = input_signal->input_dims[1];
+        return;
+    }
+    
+    /*! Write input buffer, the blocking read below orders it on the in-order queue.
+     *  Host allocated buffers are filled through a map instead.
+     */
+    event = NULL;
+    
+    if (plan->host_flags != 0)
+    {
+        signalCopyMapped(plan->kernel_buffer[SIGNAL_PLAN_BUFFER_INPUT],
+                         input_signal->signal,
+                         (plan->buffer_size * sizeof(float)),
+                         1,
+                         (profile != 0) ? &event : NULL,
+                         ret_err);
+    }
+    else
+    {
+        *ret_err = clEnqueueWriteBuffer(signal_cmd_queue,
+                                        plan->kernel_buffer[SIGNAL_PLAN_BUFFER_INPUT],
+                                        CL_FALSE,
+                                        0,
+                                        (plan->buffer_size * sizeof(float)),
+                                        (const void *)input_signal->signal,
+                                        0,
+                                        NULL,
+                                        (profile != 0) ? &event : NULL);
+    }
+    
+    clProfileEvent("signal plan",
+                   (plan->host_flags != 0) ? "map input" : "write input",
+                   event,
+                   (plan->buffer_size * sizeof(float)),
+                   plan->buffer_size);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_WRITE_BUFFER_NOK);
+        return;
+    }
+    
+    /*! Enqueue the plan stages in order.
+     */
+    for (cl_int i = 0; i < plan->num_stage; i += 1)
+    {
+        event    = NULL;
+        *ret_err = clEnqueueNDRangeKernel(signal_cmd_queue,
+                                          plan->stage[i].kernel,
+                                          plan->stage[i].problem_dim,
+                                          NULL,
+                                          plan->stage[i].global,
+                                          (plan->stage[i].use_local) ? plan->stage[i].local : NULL,
+                                          0,
+                                          NULL,
+                                          (profile != 0) ? &event : NULL);
+        
+        /* Every stage reads and writes one signal sized buffer. */
+        signalProfileKernelEvent("signal plan",
+                                 plan->stage[i].kernel,
+                                 event,
+                                 (2 * plan->buffer_size * sizeof(float)),
+                                 plan->buffer_size);
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_SIGNAL_OPERATION_NOK);
+            return;
+        }
+    }
+    
+    /*! Read kernel output buffer.
+     */
+    event = NULL;
+    
+    if (plan->host_flags != 0)
+    {
+        signalCopyMapped(plan->kernel_buffer[SIGNAL_PLAN_BUFFER_OUTPUT],
+                         ret_signal->signal,
+                         (plan->buffer_size * sizeof(float)),
+                         0,
+                         (profile != 0) ? &event : NULL,
+                         ret_err);
+    }
+    else
+    {
+        *ret_err = clEnqueueReadBuffer(signal_cmd_queue,
+                                       plan->kernel_buffer[SIGNAL_PLAN_BUFFER_OUTPUT],
+                                       CL_TRUE,
+                                       0,
+                                       (plan->buffer_size * sizeof(float)),
+                                       (void *)ret_signal->signal,
+                                       0,
+                                       NULL,
+                                       (profile != 0) ? &event : NULL);
+    }
+    
+    clProfileEvent("signal plan",
+                   (plan->host_flags != 0) ? "map output" : "read output",
+                   event,
+                   (plan->buffer_size * sizeof(float)),
+                   plan->buffer_size);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_READ_BUFFER_NOK);
+        return;
+    }
+    
+    ret_signal->input_dims[0] = input_signal->input_dims[0];
+    ret_signal->input_dims[1] = input_signal->input_dims[1];
+    
+    *ret_err = CL_SUCCESS;
+}
+
+static void signalCopyMapped(cl_mem             buffer,
+                             void       * const host_ptr,
+                             size_t             size,
+                             cl_int             to_buffer,
+                             cl_event   * const ret_event,
+                             cl_int     * const ret_err)
+{
+    void *mapped;
+    
+    /* On unified memory the map returns the buffer storage itself, so the memcpy is
+     * the only copy. The blocking map waits for earlier commands on the queue.
+     */
+    mapped = clEnqueueMapBuffer(signal_cmd_queue,
+                                buffer,
+                                CL_TRUE,
+                                (to_buffer != 0) ? CL_MAP_WRITE_INVALIDATE_REGION : CL_MAP_READ,
+                                0,
+                                size,
+                                0,
+                                NULL,
+                                ret_event,
+                                ret_err);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    if (to_buffer != 0)
+    {
+        memcpy(mapped, host_ptr, size);
+    }
+    else
+    {
+        memcpy(host_ptr, mapped, size);
+    }
+    
+    *ret_err = clEnqueueUnmapMemObject(signal_cmd_queue, buffer, mapped, 0, NULL, NULL);
+}
+
+void signalPlanDestroy(signal_plan_t * const plan)
+{
+    if (plan == NULL)
+    {
+        return;
+    }
+    
+    for (int i = 0; i < plan->num_buffer; i += 1)
+    {
+        if (plan->kernel_buffer[i] != NULL)
+        {
+            clReleaseMemObject(plan->kernel_buffer[i]);
+        }
+    }
+    
+    for (int i = 0; i < plan->num_stage; i += 1)
+    {
+        if (plan->stage[i].kernel != NULL)
+        {
+            clReleaseKernel(plan->stage[i].kernel);
+        }
+    }
+    
+    free(plan);
+}
+
+static double signalGetTimeMs(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0);
+}
+
+static double signalCalibrateDevice(cl_context       context,
+                                    cl_command_queue cmd_queue,
+                                    cl_device_id     device)
+{
+    cl_kernel kernel;
+    cl_mem    buffer[2];
+    cl_int    buffer_err[2];
+    float     *signal;
+    int       dims[2] = {SIGNAL_CALIBRATION_DIM, SIGNAL_CALIBRATION_DIM};
+    size_t    global[2] = {SIGNAL_CALIBRATION_DIM, SIGNAL_CALIBRATION_DIM};
+    size_t    signal_size;
+    double    start_time;
+    double    elapsed_ms;
+    cl_int    err;
+    cl_bool   available = CL_FALSE;
+    cl_bool   compiler  = CL_FALSE;
+    
+    /*! Devices that are offline or cannot compile are skipped before the source is
+     *  loaded, the program of the others comes from the binary cache after the
+     *  first run.
+     */
+    clGetDeviceInfo(device, CL_DEVICE_AVAILABLE, sizeof(cl_bool), &available, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_COMPILER_AVAILABLE, sizeof(cl_bool), &compiler, NULL);
+    
+    if ((available != CL_TRUE) || (compiler != CL_TRUE))
+    {
+        return (-1);
+    }
+    
+    clCreateKernelObjsForContext(&context,
+                                 (SIGNAL_KERNEL_FILE_NAME),
+                                 (const char **)&kernel_name_list[SIGNAL_2D_DCT],
+                                 1,
+                                 &kernel,
+                                 &err);
+    if (err != CL_SUCCESS)
+    {
+        return (-1);
+    }
+    
+    signal_size = SIGNAL_CALIBRATION_DIM * SIGNAL_CALIBRATION_DIM * sizeof(float);
+    signal      = (float *)malloc(signal_size);
+    
+    if (signal == NULL)
+    {
+        clReleaseKernel(kernel);
+        return (-1);
+    }
+    
+    for (int i = 0; i < (SIGNAL_CALIBRATION_DIM * SIGNAL_CALIBRATION_DIM); i += 1)
+    {
+        signal[i] = (float)(i % 17) / 17.0f;
+    }
+    
+    buffer[0] = clCreateBuffer(context, (CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR), signal_size, signal, &buffer_err[0]);
+    buffer[1] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, signal_size, NULL, &buffer_err[1]);
+    
+    err  = buffer_err[0] | buffer_err[1];
+    err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer[0]);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &buffer[1]);
+    err |= clSetKernelArg(kernel, 2, sizeof(int),    &dims[0]);
+    err |= clSetKernelArg(kernel, 3, sizeof(int),    &dims[1]);
+    
+    /*! One warm-up launch, then the timed launches including the download.
+     */
+    elapsed_ms = -1;
+    
+    if (err == CL_SUCCESS)
+    {
+        err = clEnqueueNDRangeKernel(cmd_queue, kernel, 2, NULL, global, NULL, 0, NULL, NULL);
+        clFinish(cmd_queue);
+        
+        start_time = signalGetTimeMs();
+        
+        for (int i = 0; (i < SIGNAL_CALIBRATION_RUNS) && (err == CL_SUCCESS); i += 1)
+        {
+            err  = clEnqueueNDRangeKernel(cmd_queue, kernel, 2, NULL, global, NULL, 0, NULL, NULL);
+            err |= clEnqueueReadBuffer(cmd_queue, buffer[1], CL_TRUE, 0, signal_size, signal, 0, NULL, NULL);
+        }
+        
+        if (err == CL_SUCCESS)
+        {
+            elapsed_ms = (signalGetTimeMs() - start_time) / SIGNAL_CALIBRATION_RUNS;
+        }
+    }
+    
+    for (int i = 0; i < 2; i += 1)
+    {
+        if (buffer_err[i] == CL_SUCCESS)
+        {
+            clReleaseMemObject(buffer[i]);
+        }
+    }
+    
+    clReleaseKernel(kernel);
+    free(signal);
+    
+    return (elapsed_ms);
+}
+
+static void signalReserveBatchBuffers(signal_split_device_t * const device,
+                                      size_t                        size,
+                                      cl_int                * const ret_err)
+{
+    /* Batch buffers are kept between calls and only grow.
+     */
+    if (size <= device->batch_buffer_size)
+    {
+        *ret_err = CL_SUCCESS;
+        return;
+    }
+    
+    for (int i = 0; i < 2; i += 1)
+    {
+        if (device->batch_buffer[i] != NULL)
+        {
+            clReleaseMemObject(device->batch_buffer[i]);
+            device->batch_buffer[i] = NULL;
+        }
+    }
+    
+    device->batch_buffer_size = 0;
+    
+    for (int i = 0; i < 2; i += 1)
+    {
+        device->batch_buffer[i] = clCreateBuffer(device->context,
+                                                 CL_MEM_READ_WRITE,
+                                                 size,
+                                                 NULL,
+                                                 ret_err);
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+            return;
+        }
+    }
+    
+    device->batch_buffer_size = size;
+}
+
+static cl_mem signalGetDeviceCosineTable(int dev_index, int dim_x, int table_dim, cl_int * const ret_err)
+{
+    signal_split_device_t *device;
+    cl_float              *table;
+    
+    /* The component device shares the cosine table cache with the plans, other
+     * split devices keep the last table they used.
+     */
+    if (dev_index == 0)
+    {
+        return (signalGetCosineTable(dim_x, table_dim, ret_err));
+    }
+    
+    device = &signal_split_device[dev_index];
+    
+    if (   (device->cos_table.table     != NULL)
+        && (device->cos_table.dim_x     == dim_x)
+        && (device->cos_table.table_dim == table_dim))
+    {
+        *ret_err = CL_SUCCESS;
+        return (device->cos_table.table);
+    }
+    
+    if (device->cos_table.table != NULL)
+    {
+        clReleaseMemObject(device->cos_table.table);
+        device->cos_table.table = NULL;
+    }
+    
+    table = signalCreateCosineTableHost(dim_x, table_dim);
+    
+    if (table == NULL)
+    {
+        printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+        *ret_err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    device->cos_table.table = clCreateBuffer(device->context,
+                                             (CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR),
+                                             (table_dim * table_dim * sizeof(cl_float)),
+                                             (void *)table,
+                                             ret_err);
+    free(table);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        device->cos_table.table = NULL;
+        printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+        return (NULL);
+    }
+    
+    device->cos_table.dim_x     = dim_x;
+    device->cos_table.table_dim = table_dim;
+    
+    return (device->cos_table.table);
+}
+
+static void signalEnqueueBatch(int                   dev_index,
+                               int                   signal_operation,
+                               const float   * const input,
+                               float         * const output,
+                               const int             input_dims[2],
+                               size_t                num_signals,
+                               cl_event      * const ret_write_event,
+                               cl_event      * const ret_read_event,
+                               cl_int        * const ret_err)
+{
+    signal_split_device_t *device;
+    cl_kernel             kernel;
+    cl_mem                cos_table;
+    int                   table_dim;
+    cl_uint               num_dims_args;
+    size_t                signal_size;
+    size_t                batch_size;
+    size_t                local_mem_size;
+    size_t                local_size;
+    size_t                global_size;
+    size_t                work_group_size;
+    cl_event              kernel_event;
+    cl_int                err;
+    
+    device        = &signal_split_device[dev_index];
+    kernel        = device->batch_kernel_list[signal_operation];
+    num_dims_args = ((signal_operation == SIGNAL_1D_DCT) || (signal_operation == SIGNAL_1D_IDCT)) ? 1 : 2;
+    signal_size   = input_dims[0] * input_dims[1];
+    batch_size    = signal_size * num_signals;
+    table_dim     = (input_dims[0] > input_dims[1]) ? input_dims[0] : input_dims[1];
+    
+    /*! 1D kernels stage the signal, 2D kernels also the transposed row pass.
+     */
+    local_mem_size = signal_size * sizeof(float);
+    
+    if (num_dims_args == 2)
+    {
+        local_mem_size += table_dim * table_dim * sizeof(float);
+    }
+    
+    signalReserveBatchBuffers(device, (batch_size * sizeof(float)), ret_err);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        return;
+    }
+    
+    /*! Single upload of the device's signals, ordered before the kernel by the in-order queue.
+     */
+    *ret_err = clEnqueueWriteBuffer(device->cmd_queue,
+                                    device->batch_buffer[0],
+                                    CL_FALSE,
+                                    0,
+                                    (batch_size * sizeof(float)),
+                                    (const void *)input,
+                                    0,
+                                    NULL,
+                                    ret_write_event);
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_WRITE_BUFFER_NOK);
+        return;
+    }
+    
+    /*! Set kernel arguments: buffers, dimensions of one signal and the local staging area.
+     */
+    err  = clSetKernelArg(kernel, 0, sizeof(cl_mem), &device->batch_buffer[0]);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &device->batch_buffer[1]);
+    
+    for (cl_uint i = 0; i < num_dims_args; i += 1)
+    {
+        err |= clSetKernelArg(kernel, (2 + i), sizeof(int), &input_dims[i]);
+    }
+    
+    err |= clSetKernelArg(kernel, (2 + num_dims_args), local_mem_size, NULL);
+    
+    if (num_dims_args == 2)
+    {
+        cos_table = signalGetDeviceCosineTable(dev_index, input_dims[0], table_dim, ret_err);
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            return;
+        }
+        
+        err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &cos_table);
+        err |= clSetKernelArg(kernel, 6, sizeof(cl_int), &table_dim);
+    }
+    
+    if (err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        *ret_err = err;
+        return;
+    }
+    
+    /*! One work group per signal.
+     */
+    work_group_size = 1;
+    clGetKernelWorkGroupInfo(kernel,
+                             device->device,
+                             CL_KERNEL_WORK_GROUP_SIZE,
+                             sizeof(size_t),
+                             &work_group_size,
+                             NULL);
+    
+    local_size  = (signal_size < SIGNAL_BATCH_MAX_WORK_GROUP_SIZE) ? signal_size : SIGNAL_BATCH_MAX_WORK_GROUP_SIZE;
+    local_size  = (local_size < work_group_size) ? local_size : work_group_size;
+    global_size = local_size * num_signals;
+    
+    kernel_event = NULL;
+    *ret_err     = clEnqueueNDRangeKernel(device->cmd_queue,
+                                          kernel,
+                                          1,
+                                          NULL,
+                                          &global_size,
+                                          &local_size,
+                                          0,
+                                          NULL,
+                                          (clGetProfilingEnable() != 0) ? &kernel_event : NULL);
+    
+    signalProfileKernelEvent("signal batch", kernel, kernel_event, (2 * batch_size * sizeof(float)), batch_size);
+    
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_SIGNAL_OPERATION_NOK);
+        return;
+    }
+    
+    /*! Single download of the device's signals.
+     */
+    *ret_err = clEnqueueReadBuffer(device->cmd_queue,
+                                   device->batch_buffer[1],
+                                   CL_FALSE,
+                                   0,
+                                   (batch_size * sizeof(float)),
+                                   (void *)output,
+                                   0,
+                                   NULL,
+                                   ret_read_event);
+    if (*ret_err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_READ_BUFFER_NOK);
+        return;
+    }
+    
+    clFlush(device->cmd_queue);
+}
+
+void signalComputeBatch(int signal_operation,
+                        signal_matrix_t * const input_signal,
+                        int                     num_signals,
+                        signal_matrix_t * const ret_signal,
+                        int             * const ret_err)
+{
+    int    input_dims[2];
+    int    dispatch;
+    double start_time;
+    
+    if ((signal_operation < 0) || (signal_operation >= SIGNAL_BATCH_KERNEL_PRG_CNT))
+    {
+        printSignalErrorMsg(ERR_SIGNAL_OPERATION_NOK);
+        *ret_err = !(CL_SUCCESS);
+        return;
+    }
+    
+    if (num_signals <= 0)
+    {
+        printSignalErrorMsg(ERR_BATCH_SIZE_NOK);
+        *ret_err = !(CL_SUCCESS);
+        return;
+    }
+    
+    start_time = signalGetTimeMs();
+    
+    /*! input_dims describe one signal, the batch is num_signals contiguous signals.
+     */
+    input_dims[0] = input_signal->input_dims[0];
+    input_dims[1] = (input_signal->input_dims[1] == 0) ? 1 : input_signal->input_dims[1];
+    
+    /*! The whole batch goes to the host or to the devices, see signalCompute.
+     */
+    dispatch = signalGetDispatch(signal_operation, input_dims, num_signals);
+    
+    if ((dispatch == SIGNAL_DISPATCH_DEVICE) && (signal_device_ready == 0))
+    {
+        printSignalErrorMsg(ERR_HOST_COMPUTE_NOK);
+        *ret_err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    dispatch = signalClaimDevice(signal_operation, input_dims, dispatch);
+    
+    signalLogDispatch(signal_operation, dispatch);
+    
+    if (dispatch != SIGNAL_DISPATCH_DEVICE)
+    {
+        signalHostCompute(signal_operation, input_signal->signal, ret_signal->signal, input_dims, num_signals, ret_err);
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_HOST_COMPUTE_NOK);
+            return;
+        }
+    }
+    else
+    {
+        signalComputeBatchDevice(signal_operation, input_signal, input_dims, num_signals, ret_signal, ret_err);
+        __sync_lock_release(&signal_device_in_flight);
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            return;
+        }
+    }
+    
+    ret_signal->input_dims[0] = input_dims[0];
+    ret_signal->input_dims[1] = input_dims[1];
+    
+    /*! Update batch statistics, the time covers upload, kernel and download
+     *  or the host transform.
+     */
+    signal_batch_stats.num_transforms        = (cl_uint)num_signals;
+    signal_batch_stats.elapsed_ms            = signalGetTimeMs() - start_time;
+    signal_batch_stats.transforms_per_second = (signal_batch_stats.elapsed_ms > 0)
+                                             ? (1000.0 * num_signals / signal_batch_stats.elapsed_ms)
+                                             : 0;
+    
+    *ret_err = CL_SUCCESS;
+}
+
+static void signalComputeBatchDevice(int signal_operation,
+                                     signal_matrix_t * const input_signal,
+                                     const int               input_dims[2],
+                                     int                     num_signals,
+                                     signal_matrix_t * const ret_signal,
+                                     int             * const ret_err)
+{
+    cl_event  write_event[SIGNAL_MAX_DEVICES];
+    cl_event  read_event[SIGNAL_MAX_DEVICES];
+    size_t    num_split[SIGNAL_MAX_DEVICES];
+    double    weight[SIGNAL_MAX_DEVICES];
+    int       table_dim;
+    int       num_split_devices;
+    int       num_enqueued;
+    int       all_timed;
+    size_t    signal_size;
+    size_t    local_mem_size;
+    size_t    first_signal;
+    
+    signal_size = input_dims[0] * input_dims[1];
+    table_dim   = (input_dims[0] > input_dims[1]) ? input_dims[0] : input_dims[1];
+    
+    local_mem_size = signal_size * sizeof(float);
+    
+    if ((signal_operation == SIGNAL_2D_DCT) || (signal_operation == SIGNAL_2D_IDCT))
+    {
+        local_mem_size += table_dim * table_dim * sizeof(float);
+    }
+    
+    if ((cl_ulong)local_mem_size > signal_split_device[0].local_mem_size)
+    {
+        /*! A signal that does not fit local memory is transformed one at a time.
+         */
+        for (int i = 0; i < num_signals; i += 1)
+        {
+            signal_matrix_t one_input;
+            signal_matrix_t one_ret;
+            
+            one_input.signal        = input_signal->signal + (i * signal_size);
+            one_input.input_dims[0] = input_dims[0];
+            one_input.input_dims[1] = input_dims[1];
+            one_ret.signal          = ret_signal->signal + (i * signal_size);
+            
+            signalComputeDevice(signal_operation, &one_input, &one_ret, ret_err);
+            
+            if (*ret_err != CL_SUCCESS)
+            {
+                return;
+            }
+        }
+    }
+    else
+    {
+        /*! Split large batches across every device that can stage a signal, weighted
+         *  by measured signals per ms once every device was timed. Each signal is
+         *  transformed by the same kernel, so the split does not change results.
+         */
+        num_split_devices = 1;
+        
+        if (   (signal_num_split_devices > 1)
+            && (num_signals >= (SIGNAL_SPLIT_MIN_SIGNALS * signal_num_split_devices)))
+        {
+            num_split_devices = signal_num_split_devices;
+        }
+        
+        all_timed = 1;
+        
+        for (int i = 0; i < num_split_devices; i += 1)
+        {
+            all_timed &= (signal_split_device[i].signals_per_ms > 0);
+        }
+        
+        for (int i = 0; i < num_split_devices; i += 1)
+        {
+            weight[i] = (all_timed != 0) ? signal_split_device[i].signals_per_ms : signal_split_device[i].throughput_prior;
+            weight[i] = ((cl_ulong)local_mem_size > signal_split_device[i].local_mem_size) ? 0 : weight[i];
+        }
+        
+        clGetWeightedSplit(weight, num_split_devices, (size_t)num_signals, num_split);
+        
+        memset(write_event, 0, sizeof(write_event));
+        memset(read_event, 0, sizeof(read_event));
+        
+        *ret_err     = CL_SUCCESS;
+        num_enqueued = 0;
+        first_signal = 0;
+        
+        for (int i = 0; (i < num_split_devices) && (*ret_err == CL_SUCCESS); i += 1)
+        {
+            if (num_split[i] > 0)
+            {
+                signalEnqueueBatch(i,
+                                   signal_operation,
+                                   input_signal->signal + (first_signal * signal_size),
+                                   ret_signal->signal + (first_signal * signal_size),
+                                   input_dims,
+                                   num_split[i],
+                                   &write_event[i],
+                                   &read_event[i],
+                                   ret_err);
+                
+                num_enqueued = i + 1;
+            }
+            
+            first_signal += num_split[i];
+        }
+        
+        /*! Wait for every device and update its throughput from the device time
+         *  between upload start and download end.
+         */
+        for (int i = 0; i < num_enqueued; i += 1)
+        {
+            clFinish(signal_split_device[i].cmd_queue);
+            
+            if ((*ret_err == CL_SUCCESS) && (num_split_devices > 1) && (read_event[i] != NULL))
+            {
+                double elapsed_ms = clGetEventElapsedMs(write_event[i], read_event[i]);
+                
+                if (elapsed_ms > 0)
+                {
+                    signal_split_device[i].signals_per_ms = (signal_split_device[i].signals_per_ms > 0)
+                                                          ? (0.5 * signal_split_device[i].signals_per_ms + 0.5 * (num_split[i] / elapsed_ms))
+                                                          : (num_split[i] / elapsed_ms);
+                }
+            }
+            
+            clProfileEvent("signal batch",
+                           "write input",
+                           write_event[i],
+                           (num_split[i] * signal_size * sizeof(float)),
+                           (num_split[i] * signal_size));
+            clProfileEvent("signal batch",
+                           "read output",
+                           read_event[i],
+                           (num_split[i] * signal_size * sizeof(float)),
+                           (num_split[i] * signal_size));
+        }
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            return;
+        }
+    }
+    
+    *ret_err = CL_SUCCESS;
+}
+
+static void signalProfileKernelEvent(const char * const component,
+                                     cl_kernel          kernel,
+                                     cl_event           event,
+                                     size_t             bytes,
+                                     size_t             items)
+{
+    char kernel_name[32] = "kernel";
+    
+    /* Kernel commands are recorded under their kernel's name. */
+    if (event != NULL)
+    {
+        clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(kernel_name), kernel_name, NULL);
+    }
+    
+    clProfileEvent(component, kernel_name, event, bytes, items);
+}
+
+static int signalGetDispatch(int signal_operation, const int input_dims[2], int num_signals)
+{
+    size_t num_elements;
+    
+    /* Operations or shapes the host does not take stay on the device paths, which
+     * report their own errors.
+     */
+    if (   (signal_operation < 0)
+        || (signal_operation >= KERNEL_PRG_CNT)
+        || (num_signals <= 0)
+        || (signalHostSupports(signal_operation, input_dims) == 0))
+    {
+        return (SIGNAL_DISPATCH_DEVICE);
+    }
+    
+    if (signal_device_ready == 0)
+    {
+        return (SIGNAL_DISPATCH_NO_DEVICE);
+    }
+    
+    if (signal_backend != SIGNAL_BACKEND_AUTO)
+    {
+        return ((signal_backend == SIGNAL_BACKEND_HOST) ? SIGNAL_DISPATCH_FORCED : SIGNAL_DISPATCH_DEVICE);
+    }
+    
+    num_elements = (size_t)num_signals * input_dims[0];
+    num_elements *= ((signal_operation == SIGNAL_2D_DCT) || (signal_operation == SIGNAL_2D_IDCT)) ? input_dims[1] : 1;
+    
+    return ((num_elements <= SIGNAL_HOST_MAX_ELEMENTS) ? SIGNAL_DISPATCH_SMALL : SIGNAL_DISPATCH_DEVICE);
+}
+
+static int signalClaimDevice(int signal_operation, const int input_dims[2], int dispatch)
+{
+    if (dispatch != SIGNAL_DISPATCH_DEVICE)
+    {
+        return (dispatch);
+    }
+    
+    /* The component's kernels and their arguments are shared, one thread at a time
+     * claims the device. While another thread holds it, automatic dispatch hands
+     * signals the host takes to the host, everything else waits for the device.
+     */
+    while (__sync_bool_compare_and_swap(&signal_device_in_flight, 0, 1) == 0)
+    {
+        if (   (signal_backend == SIGNAL_BACKEND_AUTO)
+            && (signal_operation >= 0)
+            && (signal_operation < KERNEL_PRG_CNT)
+            && (signalHostSupports(signal_operation, input_dims) != 0))
+        {
+            return (SIGNAL_DISPATCH_BUSY);
+        }
+        
+        sched_yield();
+    }
+    
+    return (SIGNAL_DISPATCH_DEVICE);
+}
+
+static void signalLogDispatch(int signal_operation, int dispatch)
+{
+    static const char * operation_name[KERNEL_PRG_CNT] = {"1D DCT", "1D IDCT", "2D DCT", "2D IDCT"};
+    static const char * dispatch_reason[] = {"device", "no device", "host backend", "device busy", "small signal"};
+    
+    /* Only changes of the dispatch decision of an operation are logged. */
+    if (   (signal_operation < 0)
+        || (signal_operation >= KERNEL_PRG_CNT)
+        || (signal_dispatch_log[signal_operation] == dispatch))
+    {
+        return;
+    }
+    
+    signal_dispatch_log[signal_operation] = dispatch;
+    
+    if (dispatch == SIGNAL_DISPATCH_DEVICE)
+    {
+        printf("Info Signal analysis component: %s runs on the device.\n", operation_name[signal_operation]);
+    }
+    else
+    {
+        printf("Info Signal analysis component: %s runs on the host (%s).\n",
+               operation_name[signal_operation],
+               dispatch_reason[dispatch]);
+    }
+}
+
+void signalGetBatchStats(signal_batch_stats_t * const ret_stats)
+{
+    *ret_stats = signal_batch_stats;
+}
+
+static void signalMatrixMultiplyRun(signal_matrix_t * const mat_a,
+                                    signal_matrix_t * const mat_b,
+                                    int                     num_matrices,
+                                    int                     shared_b,
+                                    signal_matrix_t * const ret_mat,
+                                    int             * const ret_err)
+{
+    cl_kernel kernel;
+    cl_mem    kernel_buffer[3];
+    size_t    buffer_size[3];
+    size_t    global[3];
+    size_t    local[3];
+    cl_uint   problem_dim;
+    cl_int    dim_m;
+    cl_int    dim_n;
+    cl_int    dim_k;
+    cl_int    stride_b;
+    cl_int    use_tiled;
+    cl_int    err;
+    cl_event  event;
+    
+    /*! A is dim_m x dim_k, B is dim_k x dim_n and C is dim_m x dim_n.
+     */
+    dim_k = mat_a->input_dims[0];
+    dim_m = (mat_a->input_dims[1] == 0) ? 1 : mat_a->input_dims[1];
+    dim_n = mat_b->input_dims[0];
+    
+    /*! Products have no host path.
+     */
+    if (signal_device_ready == 0)
+    {
+        printSignalErrorMsg(ERR_NO_DEVICE_NOK);
+        *ret_err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    if (dim_k != ((mat_b->input_dims[1] == 0) ? 1 : mat_b->input_dims[1]))
+    {
+        printSignalErrorMsg(ERR_MATRIX_DIMS_MISMATCH_NOK);
+        *ret_err = !(CL_SUCCESS);
+        return;
+    }
+    
+    use_tiled = (   (signal_matrix_tiled_support)
+                 && ((num_matrices > 1) || (   (dim_m >= SIGNAL_MATRIX_TILED_MIN_SIZE)
+                                            && (dim_n >= SIGNAL_MATRIX_TILED_MIN_SIZE)
+                                            && (dim_k >= SIGNAL_MATRIX_TILED_MIN_SIZE))));
+    
+    /*! Without tiled kernel support batches run as single naive products.
+     */
+    if ((num_matrices > 1) && (!use_tiled))
+    {
+        for (int i = 0; i < num_matrices; i += 1)
+        {
+            signal_matrix_t one_a   = *mat_a;
+            signal_matrix_t one_b   = *mat_b;
+            signal_matrix_t one_ret = *ret_mat;
+            
+            one_a.signal   += i * (dim_m * dim_k);
+            one_b.signal   += (shared_b) ? 0 : (i * (dim_k * dim_n));
+            one_ret.signal += i * (dim_m * dim_n);
+            
+            signalMatrixMultiplyRun(&one_a, &one_b, 1, 0, &one_ret, ret_err);
+            
+            if (*ret_err != CL_SUCCESS)
+            {
+                return;
+            }
+        }
+        
+        ret_mat->input_dims[0] = dim_n;
+        ret_mat->input_dims[1] = dim_m;
+        return;
+    }
+    
+    stride_b       = (shared_b) ? 0 : (dim_k * dim_n);
+    buffer_size[0] = num_matrices * dim_m * dim_k * sizeof(float);
+    buffer_size[1] = ((shared_b) ? 1 : num_matrices) * dim_k * dim_n * sizeof(float);
+    buffer_size[2] = num_matrices * dim_m * dim_n * sizeof(float);
+    
+    /*! Create buffers, the operands are copied at creation.
+     */
+    for (int i = 0; i < 3; i += 1)
+    {
+        kernel_buffer[i] = clCreateBuffer(signal_context,
+                                          (i < 2) ? (CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR) : CL_MEM_WRITE_ONLY,
+                                          buffer_size[i],
+                                          (i == 0) ? (void *)mat_a->signal : ((i == 1) ? (void *)mat_b->signal : NULL),
+                                          ret_err);
+        if (*ret_err != CL_SUCCESS)
+        {
+            for (int j = 0; j < i; j += 1)
+            {
+                clReleaseMemObject(kernel_buffer[j]);
+            }
+            printSignalErrorMsg(ERR_BUFFER_CREATION_NOK);
+            return;
+        }
+    }
+    
+    /*! Set kernel arguments and work sizes.
+     */
+    err = 0;
+    
+    if (use_tiled)
+    {
+        kernel = signal_matrix_kernel_list[(num_matrices > 1) ? SIGNAL_MATRIX_KERNEL_TILED_BATCH
+                                                              : SIGNAL_MATRIX_KERNEL_TILED];
+        
+        problem_dim = (num_matrices > 1) ? 3 : 2;
+        local[0]    = SIGNAL_MATRIX_TILE_SIZE;
+        local[1]    = SIGNAL_MATRIX_TILE_SIZE / SIGNAL_MATRIX_WORK_PER_ITEM;
+        local[2]    = 1;
+        global[0]   = ((dim_n + SIGNAL_MATRIX_TILE_SIZE - 1) / SIGNAL_MATRIX_TILE_SIZE) * local[0];
+        global[1]   = ((dim_m + SIGNAL_MATRIX_TILE_SIZE - 1) / SIGNAL_MATRIX_TILE_SIZE) * local[1];
+        global[2]   = num_matrices;
+        
+        err |= clSetKernelArg(kernel, 3, sizeof(cl_int), &dim_m);
+        err |= clSetKernelArg(kernel, 4, sizeof(cl_int), &dim_n);
+        err |= clSetKernelArg(kernel, 5, sizeof(cl_int), &dim_k);
+        
+        if (num_matrices > 1)
+        {
+            err |= clSetKernelArg(kernel, 6, sizeof(cl_int), &stride_b);
+        }
+    }
+    else
+    {
+        kernel = signal_matrix_kernel_list[SIGNAL_MATRIX_KERNEL_NAIVE];
+        
+        problem_dim = 2;
+        global[0]   = dim_n;
+        global[1]   = dim_m;
+        
+        err |= clSetKernelArg(kernel, 3, sizeof(cl_int), &dim_k);
+        err |= clSetKernelArg(kernel, 4, sizeof(cl_int), &dim_n);
+    }
+    
+    for (cl_uint i = 0; i < 3; i += 1)
+    {
+        err |= clSetKernelArg(kernel, i, sizeof(cl_mem), &kernel_buffer[i]);
+    }
+    
+    if (err != CL_SUCCESS)
+    {
+        printSignalErrorMsg(ERR_SETTING_ARGUMENTS_NOK);
+        *ret_err = err;
+    }
+    else
+    {
+        /*! Enqueue the product and read C back. A and B are copied at buffer
+         *  creation, so only these two commands are profiled.
+         */
+        event    = NULL;
+        *ret_err = clEnqueueNDRangeKernel(signal_cmd_queue,
+                                          kernel,
+                                          problem_dim,
+                                          NULL,
+                                          global,
+                                          (use_tiled) ? local : NULL,
+                                          0,
+                                          NULL,
+                                          (clGetProfilingEnable() != 0) ? &event : NULL);
+        
+        signalProfileKernelEvent("signal matrix",
+                                 kernel,
+                                 event,
+                                 (buffer_size[0] + buffer_size[1] + buffer_size[2]),
+                                 (buffer_size[2] / sizeof(float)));
+        
+        if (*ret_err != CL_SUCCESS)
+        {
+            printSignalErrorMsg(ERR_SIGNAL_OPERATION_NOK);
+        }
+        else
+        {
+            event    = NULL;
+            *ret_err = clEnqueueReadBuffer(signal_cmd_queue,
+                                           kernel_buffer[2],
+                                           CL_TRUE,
+                                           0,
+                                           buffer_size[2],
+                                           (void *)ret_mat->signal,
+                                           0,
+                                           NULL,
+                                           (clGetProfilingEnable() != 0) ? &event : NULL);
+            
+            clProfileEvent("signal matrix", "read output", event, buffer_size[2], (buffer_size[2] / sizeof(float)));
+            
+            if (*ret_err != CL_SUCCESS)
+            {
+                printSignalErrorMsg(ERR_READ_BUFFER_NOK);
+            }
+        }
+    }
+    
+    /*! Clean buffers.
+     */
+    for (int i = 0; i < 3; i += 1)
+    {
+        clReleaseMemObject(kernel_buffer[i]);
+    }
+    
+    ret_mat->input_dims[0] = dim_n;
+    ret_mat->input_dims[1] = dim_m;
+}
+
+void signalMatrixMultiply(signal_matrix_t * const mat_a,
+                          signal_matrix_t * const mat_b,
+                          signal_matrix_t * const ret_mat,
+                          int             * const ret_err)
+{
+    signalMatrixMultiplyRun(mat_a, mat_b, 1, 0, ret_mat, ret_err);
+}
+
+void signalMatrixMultiplyBatch(signal_matrix_t * const mat_a,
+                               signal_matrix_t * const mat_b,
+                               int                     num_matrices,
+                               int                     shared_b,
+                               signal_matrix_t * const ret_mat,
+                               int             * const ret_err)
+{
+    if (num_matrices <= 0)
+    {
+        printSignalErrorMsg(ERR_BATCH_SIZE_NOK);
+        *ret_err = !(CL_SUCCESS);
+        return;
+    }
+    
+    signalMatrixMultiplyRun(mat_a, mat_b, num_matrices, shared_b, ret_mat, ret_err);
+}
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1,22 +1,115 @@
 #ifndef _LIB_SIGNAL_H_
 #define _LIB_SIGNAL_H_
 
+#ifdef __APPLE__
 #include <OpenCL/OpenCL.h>
+#else
+#include <CL/cl.h>
+#endif
 #include "lib_signal_cfg.h"
 
+#define SIGNAL_BACKEND_AUTO   0
+#define SIGNAL_BACKEND_DEVICE 1
+#define SIGNAL_BACKEND_HOST   2
+
+#define SIGNAL_ZERO_COPY_AUTO 0
+#define SIGNAL_ZERO_COPY_OFF  1
+#define SIGNAL_ZERO_COPY_ON   2
+
 typedef struct
 {
   float * signal;
   int     input_dims[2];
 }signal_matrix_t;
 
+/* Statistics of the last signalComputeBatch call, the elapsed time covers upload,
+ * kernel execution and download.
+ */
+typedef struct
+{
+  cl_uint num_transforms;
+  double  elapsed_ms;
+  double  transforms_per_second;
+}signal_batch_stats_t;
+
+/* A signal plan keeps the kernel, its arguments and the device buffers of one
+ * operation and size resident, so executing it only writes, launches and reads.
+ */
+typedef struct signal_plan_s signal_plan_t;
+
 extern void signalInit(const cl_device_id * const device_list,
                        cl_int               num_dev,
                        cl_int       * const ret_err);
 
+/* When enabled before signalInit, the component runs on the device with the fastest
+ * 2D DCT calibration instead of the first GPU. The choice is cached on disk, see
+ * clSelectFastestDevice.
+ */
+extern void signalSetDeviceAutoSelect(cl_int enable);
+
+/* SIGNAL_BACKEND_AUTO (default) transforms calls of at most SIGNAL_HOST_MAX_ELEMENTS
+ * elements, calls made while another thread uses the device and every call without
+ * an initialized device on the host (lib_signal_host.h). SIGNAL_BACKEND_DEVICE and
+ * SIGNAL_BACKEND_HOST force one side. Each change of the choice for an operation is
+ * logged.
+ */
+extern void signalSetBackend(cl_int backend);
+
+/* In zero-copy mode, signalCompute wraps aligned input and output signals
+ * (allocated with clAllocHostMemory) with CL_MEM_USE_HOST_PTR and maps the result
+ * instead of reading it, plans keep their input and output in CL_MEM_ALLOC_HOST_PTR
+ * buffers filled and drained through maps. SIGNAL_ZERO_COPY_AUTO (default) enables
+ * it when the device shares memory with the host. Takes effect at signalInit.
+ */
+extern void signalSetZeroCopy(cl_int mode);
+
+extern void signalDeinit(cl_int * const ret_err);
+
 extern void signalCompute(int signal_operation,
                           signal_matrix_t * const input_signal,
                           signal_matrix_t * const ret_signal,
                           int             * const ret_err);
 
+extern void signalComputeBatch(int signal_operation,
+                               signal_matrix_t * const input_signal,
+                               int                     num_signals,
+                               signal_matrix_t * const ret_signal,
+                               int             * const ret_err);
+
+extern void signalGetBatchStats(signal_batch_stats_t * const ret_stats);
+
+/* C = A * B with row major matrices, input_dims[0] is the number of columns and
+ * input_dims[1] the number of rows. Products need an initialized device, without
+ * one they fail with CL_INVALID_VALUE.
+ */
+extern void signalMatrixMultiply(signal_matrix_t * const mat_a,
+                                 signal_matrix_t * const mat_b,
+                                 signal_matrix_t * const ret_mat,
+                                 int             * const ret_err);
+
+/* num_matrices contiguous products C[i] = A[i] * B[i], or A[i] * B when shared_b
+ * is set and mat_b holds a single matrix.
+ */
+extern void signalMatrixMultiplyBatch(signal_matrix_t * const mat_a,
+                                      signal_matrix_t * const mat_b,
+                                      int                     num_matrices,
+                                      int                     shared_b,
+                                      signal_matrix_t * const ret_mat,
+                                      int             * const ret_err);
+
+/* A plan created without an initialized device, or with SIGNAL_BACKEND_HOST, runs
+ * on the host for every execution; otherwise it keeps its kernels and buffers on
+ * the device.
+ */
+extern signal_plan_t * signalPlanCreate(int         signal_operation,
+                                        const int   input_dims[2],
+                                        int * const ret_err);
+
+extern void signalPlanExecute(signal_plan_t   * const plan,
+                              signal_matrix_t * const input_signal,
+                              signal_matrix_t * const ret_signal,
+                              int             * const ret_err);
+
+extern void signalPlanDestroy(signal_plan_t * const plan);
+
 #endif /* _LIB_SIGNAL_H_ */
@@ -6,9 +6,86 @@
 #define SIGNAL_2D_DCT  2
 #define SIGNAL_2D_IDCT 3
 
+/* Matrix product C = A * B, takes two operands and runs through signalMatrixMultiply
+ * and signalMatrixMultiplyBatch.
+ */
+#define SIGNAL_MATRIX_MULTIPLY 4
+
+/* Kernel sources, the CMake build points them at the source tree.
+ */
+#ifndef SIGNAL_KERNEL_FILE_NAME
 #define SIGNAL_KERNEL_FILE_NAME "/Users/marwanfaisal/Documents/Desktop_Developer/OpenCL_SignalAnalysis_Template/OpenCL_SignalAnalysis_Template/Kernel_DCT.cl"
+#endif
+
+#ifndef SIGNAL_MATRIX_KERNEL_FILE_NAME
+#define SIGNAL_MATRIX_KERNEL_FILE_NAME "/Users/marwanfaisal/Documents/Desktop_Developer/OpenCL_SignalAnalysis_Template/OpenCL_SignalAnalysis_Template/Kernel_Matrix.cl"
+#endif
 
 #define KERNEL_PRG_CNT 4
 #define SIGNAL_KERNEL_LIST_NAMES {"computeDCT1D", "computeIDCT1D", "computeDCT2D", "computeIDCT2D"}
 
+/* Fast (FFT based) 1D DCT/IDCT kernels, used by signalCompute and signal plans for
+ * power-of-two sizes from SIGNAL_FAST_DCT_MIN_SIZE on; smaller or other sizes use
+ * the direct kernels.
+ */
+#define SIGNAL_FAST_DCT_MIN_SIZE 256
+#define SIGNAL_FAST_DCT_MAX_LOG2 18
+
+#define SIGNAL_FAST_KERNEL_PRG_CNT 6
+#define SIGNAL_FAST_KERNEL_LIST_NAMES {"prepareFastDCT1D", "finishFastDCT1D", "prepareFastIDCT1D", "finishFastIDCT1D", "computeFFTLocal", "computeFFTStage"}
+
+/* Separable (row/column) 2D DCT/IDCT kernels, used by signalCompute and signal plans
+ * when either dimension is at least SIGNAL_SEPARABLE_DCT_MIN_SIZE. Cosine tables are
+ * computed once per size and cached on the device.
+ */
+#define SIGNAL_SEPARABLE_DCT_MIN_SIZE 16
+
+#define SIGNAL_SEPARABLE_KERNEL_PRG_CNT 4
+#define SIGNAL_SEPARABLE_KERNEL_LIST_NAMES {"computeDCT2DRows", "computeDCT2DColumns", "computeIDCT2DRows", "computeIDCT2DColumns"}
+
+#define SIGNAL_COS_TABLE_CACHE_SIZE 4
+
+/* Batched kernels, one per operation ID, used by signalComputeBatch.
+ */
+#define SIGNAL_BATCH_KERNEL_PRG_CNT 4
+#define SIGNAL_BATCH_KERNEL_LIST_NAMES {"computeDCT1DBatch", "computeIDCT1DBatch", "computeDCT2DBatch", "computeIDCT2DBatch"}
+
+/* Upper bound for the work group size of the batched kernels.
+ */
+#define SIGNAL_BATCH_MAX_WORK_GROUP_SIZE 64
+
+/* signalComputeBatch splits a batch across up to SIGNAL_MAX_DEVICES devices when
+ * every device gets at least SIGNAL_SPLIT_MIN_SIGNALS signals.
+ */
+#define SIGNAL_MAX_DEVICES       8
+#define SIGNAL_SPLIT_MIN_SIGNALS 16
+
+/* Device auto-selection times SIGNAL_CALIBRATION_RUNS launches of the direct 2D DCT
+ * on a SIGNAL_CALIBRATION_DIM square signal.
+ */
+#define SIGNAL_CALIBRATION_DIM  64
+#define SIGNAL_CALIBRATION_RUNS 5
+
+/* signalCompute and signalComputeBatch transform calls of at most
+ * SIGNAL_HOST_MAX_ELEMENTS elements (over all signals) on the host, where the
+ * transfers and launch would cost more than the transform, see lib_signal_host.h.
+ */
+#define SIGNAL_HOST_MAX_ELEMENTS 4096
+
+/* Matrix multiply kernels. The tiled kernels need a work group of
+ * SIGNAL_MATRIX_TILE_SIZE x (SIGNAL_MATRIX_TILE_SIZE / SIGNAL_MATRIX_WORK_PER_ITEM),
+ * keep both values in sync with Kernel_Matrix.cl. Products with a dimension below
+ * SIGNAL_MATRIX_TILED_MIN_SIZE use the naive kernel.
+ */
+#define SIGNAL_MATRIX_KERNEL_PRG_CNT 3
+#define SIGNAL_MATRIX_KERNEL_LIST_NAMES {"multiplyMatrixAB", "multiplyMatrixTiled", "multiplyMatrixTiledBatch"}
+
+#define SIGNAL_MATRIX_TILE_SIZE      16
+#define SIGNAL_MATRIX_WORK_PER_ITEM  4
+#define SIGNAL_MATRIX_TILED_MIN_SIZE 16
+
+/* Number of plans signalCompute keeps resident for the fast transforms.
+ */
+#define SIGNAL_PLAN_CACHE_SIZE 4
+
 #endif /* _LIB_SIGNAL_CFG_H_ */
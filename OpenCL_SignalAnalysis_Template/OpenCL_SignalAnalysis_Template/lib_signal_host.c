@@ -0,0 +1,913 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "lib_signal_host.h"
+
+/* Cosine tables and FFT plans kept between calls, a miss on a full cache builds a
+ * private copy for the call.
+ */
+#define SIGNAL_HOST_CACHE_SIZE 4
+
+/* Above this table dimension the cosines are computed per row instead of tabled. */
+#define SIGNAL_HOST_TABLE_MAX_DIM 1024
+
+/* Multiply-adds per thread below which a band is not worth a thread. */
+#define SIGNAL_HOST_MIN_OPS_PER_THREAD (1 << 16)
+
+#define SIGNAL_HOST_MODE_DIRECT   0
+#define SIGNAL_HOST_MODE_FAST_ROW 1
+#define SIGNAL_HOST_MODE_FAST_COL 2
+
+typedef struct {
+    int   dim_x;
+    int   table_dim;
+    float *n_major; /* c(k) * cos(k*pi*(2n+1)/(2*dim_x)) at [n * table_dim + k]. */
+    float *k_major; /* Same values at [k * table_dim + n]. */
+}signal_host_table_t;
+
+typedef struct {
+    int    size;
+    int    *bit_reverse;
+    double *twiddle;         /* cos, sin of 2*pi*j/size, j < size/2. */
+    double *quarter_twiddle; /* cos, sin of pi*k/(2*size), k < size. */
+}signal_host_fft_plan_t;
+
+typedef struct {
+    int                          signal_operation;
+    int                          mode;
+    int                          dim_x;
+    int                          dim_y;
+    const float                  *input;
+    float                        *output;
+    float                        *temp;
+    const signal_host_table_t    *table;
+    const signal_host_fft_plan_t *plan;
+    size_t                       item_start;
+    size_t                       item_end;
+}signal_host_band_t;
+
+static pthread_mutex_t        signal_host_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static signal_host_table_t    *signal_host_table_cache[SIGNAL_HOST_CACHE_SIZE];
+static signal_host_fft_plan_t *signal_host_plan_cache[SIGNAL_HOST_CACHE_SIZE];
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static float signalHostDot(const float * const a, const float * const b, int count);
+static int   signalHostIsFastSize(int signal_operation, const int input_dims[2]);
+static signal_host_table_t * signalHostCreateTable(int dim_x, int table_dim);
+static void  signalHostFreeTable(signal_host_table_t * const table);
+static signal_host_fft_plan_t * signalHostCreatePlan(int size);
+static void  signalHostFreePlan(signal_host_fft_plan_t * const plan);
+static signal_host_table_t * signalHostGetTable(int dim_x, int table_dim, int * const ret_private);
+static signal_host_fft_plan_t * signalHostGetPlan(int size, int * const ret_private);
+static const float * signalHostGetCosineRow(const signal_host_band_t * const band,
+                                            int                              k_major,
+                                            int                              index,
+                                            int                              count,
+                                            float                    * const scratch);
+static void  signalHostFFT(const signal_host_fft_plan_t * const plan, double * const data);
+static void  signalHostFastDCT(const signal_host_fft_plan_t * const plan,
+                               const float                  * const input,
+                               double                       * const ret_coef,
+                               double                       * const work);
+static void  signalHostFastIDCT(const signal_host_fft_plan_t * const plan,
+                                const float                  * const input,
+                                double                             x0_scale,
+                                double                       * const ret_signal,
+                                double                       * const work);
+static void  signalHostDirectItem(const signal_host_band_t * const band,
+                                  size_t                           item,
+                                  float                    * const scratch);
+static void  signalHostFastItem(const signal_host_band_t * const band,
+                                size_t                           item,
+                                double                   * const scratch);
+static void * signalHostComputeBand(void * arg);
+static int   signalHostGetThreadCount(size_t num_items, double ops_per_item);
+static void  signalHostRun(signal_host_band_t * const band_template,
+                           size_t                     num_items,
+                           double                     ops_per_item,
+                           cl_int             * const err);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static float signalHostDot(const float * const a, const float * const b, int count)
+{
+    float sum;
+    int   i;
+    
+    i   = 0;
+    sum = 0.0f;
+    
+#if defined(__AVX__)
+    {
+        __m256 acc = _mm256_setzero_ps();
+        float  lane[8];
+        
+        for (; (i + 8) <= count; i += 8)
+        {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i])));
+        }
+        
+        _mm256_storeu_ps(lane, acc);
+        sum = ((lane[0] + lane[4]) + (lane[1] + lane[5])) + ((lane[2] + lane[6]) + (lane[3] + lane[7]));
+    }
+#elif defined(__SSE2__)
+    {
+        __m128 acc = _mm_setzero_ps();
+        float  lane[4];
+        
+        for (; (i + 4) <= count; i += 4)
+        {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i])));
+        }
+        
+        _mm_storeu_ps(lane, acc);
+        sum = (lane[0] + lane[2]) + (lane[1] + lane[3]);
+    }
+#endif
+    
+    for (; i < count; i += 1)
+    {
+        sum += a[i] * b[i];
+    }
+    
+    return (sum);
+}
+
+static int signalHostIsFastSize(int signal_operation, const int input_dims[2])
+{
+    int n = input_dims[0];
+    
+    if ((n < SIGNAL_HOST_FAST_DCT_MIN_SIZE) || ((n & (n - 1)) != 0))
+    {
+        return (0);
+    }
+    
+    if ((signal_operation == SIGNAL_2D_DCT) || (signal_operation == SIGNAL_2D_IDCT))
+    {
+        return (input_dims[1] == n);
+    }
+    
+    return (1);
+}
+
+static signal_host_table_t * signalHostCreateTable(int dim_x, int table_dim)
+{
+    signal_host_table_t *table;
+    
+    table = (signal_host_table_t *)calloc(1, sizeof(signal_host_table_t));
+    
+    if (table == NULL)
+    {
+        return (NULL);
+    }
+    
+    table->dim_x     = dim_x;
+    table->table_dim = table_dim;
+    table->n_major   = (float *)malloc(sizeof(float) * table_dim * table_dim);
+    table->k_major   = (float *)malloc(sizeof(float) * table_dim * table_dim);
+    
+    if ((table->n_major == NULL) || (table->k_major == NULL))
+    {
+        signalHostFreeTable(table);
+        return (NULL);
+    }
+    
+    /*! Same values as the device cosine table, computed in double precision. */
+    for (int n = 0; n < table_dim; n += 1)
+    {
+        for (int k = 0; k < table_dim; k += 1)
+        {
+            float value = (float)(((k == 0) ? M_SQRT1_2 : 1.0) * cos(M_PI * k * (2 * n + 1) / (2.0 * dim_x)));
+            
+            table->n_major[n * table_dim + k] = value;
+            table->k_major[k * table_dim + n] = value;
+        }
+    }
+    
+    return (table);
+}
+
+static void signalHostFreeTable(signal_host_table_t * const table)
+{
+    if (table != NULL)
+    {
+        free(table->n_major);
+        free(table->k_major);
+        free(table);
+    }
+}
+
+static signal_host_fft_plan_t * signalHostCreatePlan(int size)
+{
+    signal_host_fft_plan_t *plan;
+    int                    log2_size;
+    
+    plan = (signal_host_fft_plan_t *)calloc(1, sizeof(signal_host_fft_plan_t));
+    
+    if (plan == NULL)
+    {
+        return (NULL);
+    }
+    
+    plan->size            = size;
+    plan->bit_reverse     = (int *)malloc(sizeof(int) * size);
+    plan->twiddle         = (double *)malloc(sizeof(double) * size);
+    plan->quarter_twiddle = (double *)malloc(sizeof(double) * 2 * size);
+    
+    if ((plan->bit_reverse == NULL) || (plan->twiddle == NULL) || (plan->quarter_twiddle == NULL))
+    {
+        signalHostFreePlan(plan);
+        return (NULL);
+    }
+    
+    for (log2_size = 0; (1 << log2_size) < size; log2_size += 1);
+    
+    for (int i = 0; i < size; i += 1)
+    {
+        int reversed = 0;
+        
+        for (int b = 0; b < log2_size; b += 1)
+        {
+            reversed |= ((i >> b) & 1) << (log2_size - 1 - b);
+        }
+        
+        plan->bit_reverse[i] = reversed;
+    }
+    
+    for (int j = 0; j < (size / 2); j += 1)
+    {
+        plan->twiddle[2 * j + 0] = cos((2.0 * M_PI * j) / size);
+        plan->twiddle[2 * j + 1] = sin((2.0 * M_PI * j) / size);
+    }
+    
+    for (int k = 0; k < size; k += 1)
+    {
+        plan->quarter_twiddle[2 * k + 0] = cos((M_PI * k) / (2.0 * size));
+        plan->quarter_twiddle[2 * k + 1] = sin((M_PI * k) / (2.0 * size));
+    }
+    
+    return (plan);
+}
+
+static void signalHostFreePlan(signal_host_fft_plan_t * const plan)
+{
+    if (plan != NULL)
+    {
+        free(plan->bit_reverse);
+        free(plan->twiddle);
+        free(plan->quarter_twiddle);
+        free(plan);
+    }
+}
+
+static signal_host_table_t * signalHostGetTable(int dim_x, int table_dim, int * const ret_private)
+{
+    signal_host_table_t *table = NULL;
+    int                 free_slot = -1;
+    
+    *ret_private = 0;
+    
+    pthread_mutex_lock(&signal_host_cache_lock);
+    
+    for (int i = 0; i < SIGNAL_HOST_CACHE_SIZE; i += 1)
+    {
+        if (   (signal_host_table_cache[i] != NULL)
+            && (signal_host_table_cache[i]->dim_x == dim_x)
+            && (signal_host_table_cache[i]->table_dim == table_dim))
+        {
+            table = signal_host_table_cache[i];
+            break;
+        }
+        
+        if ((signal_host_table_cache[i] == NULL) && (free_slot < 0))
+        {
+            free_slot = i;
+        }
+    }
+    
+    /*! Cached tables are never replaced, a caller may still be using them. */
+    if (table == NULL)
+    {
+        table = signalHostCreateTable(dim_x, table_dim);
+        
+        if ((table != NULL) && (free_slot >= 0))
+        {
+            signal_host_table_cache[free_slot] = table;
+        }
+        else
+        {
+            *ret_private = 1;
+        }
+    }
+    
+    pthread_mutex_unlock(&signal_host_cache_lock);
+    
+    return (table);
+}
+
+static signal_host_fft_plan_t * signalHostGetPlan(int size, int * const ret_private)
+{
+    signal_host_fft_plan_t *plan = NULL;
+    int                    free_slot = -1;
+    
+    *ret_private = 0;
+    
+    pthread_mutex_lock(&signal_host_cache_lock);
+    
+    for (int i = 0; i < SIGNAL_HOST_CACHE_SIZE; i += 1)
+    {
+        if ((signal_host_plan_cache[i] != NULL) && (signal_host_plan_cache[i]->size == size))
+        {
+            plan = signal_host_plan_cache[i];
+            break;
+        }
+        
+        if ((signal_host_plan_cache[i] == NULL) && (free_slot < 0))
+        {
+            free_slot = i;
+        }
+    }
+    
+    if (plan == NULL)
+    {
+        plan = signalHostCreatePlan(size);
+        
+        if ((plan != NULL) && (free_slot >= 0))
+        {
+            signal_host_plan_cache[free_slot] = plan;
+        }
+        else
+        {
+            *ret_private = 1;
+        }
+    }
+    
+    pthread_mutex_unlock(&signal_host_cache_lock);
+    
+    return (plan);
+}
+
+static const float * signalHostGetCosineRow(const signal_host_band_t * const band,
+                                            int                              k_major,
+                                            int                              index,
+                                            int                              count,
+                                            float                    * const scratch)
+{
+    /* A k_major row holds c(index) * cos(index*pi*(2n+1)/(2*dim_x)) over n, an
+     * n_major row c(k) * cos(k*pi*(2*index+1)/(2*dim_x)) over k.
+     */
+    if (band->table != NULL)
+    {
+        const float *table = (k_major != 0) ? band->table->k_major : band->table->n_major;
+        
+        return (&table[index * band->table->table_dim]);
+    }
+    
+    for (int i = 0; i < count; i += 1)
+    {
+        int    k = (k_major != 0) ? index : i;
+        int    n = (k_major != 0) ? i : index;
+        
+        scratch[i] = (float)(((k == 0) ? M_SQRT1_2 : 1.0) * cos(M_PI * k * (2 * n + 1) / (2.0 * band->dim_x)));
+    }
+    
+    return (scratch);
+}
+
+static void signalHostFFT(const signal_host_fft_plan_t * const plan, double * const data)
+{
+    int size = plan->size;
+    
+    /*! In place radix-2 forward FFT of bit reversed interleaved complex data. */
+    for (int len = 2; len <= size; len <<= 1)
+    {
+        int half   = len / 2;
+        int stride = size / len;
+        
+        for (int start = 0; start < size; start += len)
+        {
+            for (int j = 0; j < half; j += 1)
+            {
+                double w_re = plan->twiddle[2 * j * stride + 0];
+                double w_im = -plan->twiddle[2 * j * stride + 1];
+                double *a   = &data[2 * (start + j)];
+                double *b   = &data[2 * (start + j + half)];
+                double t_re = (b[0] * w_re) - (b[1] * w_im);
+                double t_im = (b[0] * w_im) + (b[1] * w_re);
+                
+                b[0] = a[0] - t_re;
+                b[1] = a[1] - t_im;
+                a[0] = a[0] + t_re;
+                a[1] = a[1] + t_im;
+            }
+        }
+    }
+}
+
+static void signalHostFastDCT(const signal_host_fft_plan_t * const plan,
+                              const float                  * const input,
+                              double                       * const ret_coef,
+                              double                       * const work)
+{
+    int size = plan->size;
+    
+    /*! ret_coef[k] = sum(input[n] * cos(pi*k*(2n+1)/(2*size))): even samples in
+     *  order followed by odd samples reversed, FFT, then rotate by -pi*k/(2*size).
+     */
+    for (int n = 0; n < (size / 2); n += 1)
+    {
+        int even = plan->bit_reverse[n];
+        int odd  = plan->bit_reverse[size - 1 - n];
+        
+        work[2 * even + 0] = input[2 * n];
+        work[2 * even + 1] = 0.0;
+        work[2 * odd + 0]  = input[2 * n + 1];
+        work[2 * odd + 1]  = 0.0;
+    }
+    
+    signalHostFFT(plan, work);
+    
+    for (int k = 0; k < size; k += 1)
+    {
+        ret_coef[k] = (work[2 * k + 0] * plan->quarter_twiddle[2 * k + 0])
+                    + (work[2 * k + 1] * plan->quarter_twiddle[2 * k + 1]);
+    }
+}
+
+static void signalHostFastIDCT(const signal_host_fft_plan_t * const plan,
+                               const float                  * const input,
+                               double                             x0_scale,
+                               double                       * const ret_signal,
+                               double                       * const work)
+{
+    int size = plan->size;
+    
+    /*! ret_signal[n] = x0_scale*input[0]/2 + sum(input[k] * cos(pi*k*(2n+1)/(2*size)), k >= 1):
+     *  V[k] = exp(i*pi*k/(2*size)) * (X[k] - i*X[size-k]), inverse FFT as conj(FFT(conj(V))),
+     *  then undo the even/odd reordering.
+     */
+    for (int k = 0; k < size; k += 1)
+    {
+        double x_re = (k == 0) ? (x0_scale * input[0]) : input[k];
+        double x_im = (k == 0) ? 0.0 : -input[size - k];
+        double c    = plan->quarter_twiddle[2 * k + 0];
+        double s    = plan->quarter_twiddle[2 * k + 1];
+        int    dest = plan->bit_reverse[k];
+        
+        work[2 * dest + 0] = (c * x_re) - (s * x_im);
+        work[2 * dest + 1] = -((s * x_re) + (c * x_im));
+    }
+    
+    signalHostFFT(plan, work);
+    
+    for (int n = 0; n < (size / 2); n += 1)
+    {
+        ret_signal[2 * n]     = 0.5 * work[2 * n + 0];
+        ret_signal[2 * n + 1] = 0.5 * work[2 * (size - 1 - n) + 0];
+    }
+}
+
+static void signalHostDirectItem(const signal_host_band_t * const band,
+                                size_t                           item,
+                                float                    * const scratch)
+{
+    int   dim_x     = band->dim_x;
+    int   dim_y     = band->dim_y;
+    int   row_count = (band->signal_operation == SIGNAL_2D_IDCT) ? dim_y : dim_x;
+    int   index     = (int)(item % row_count);
+    float *temp     = scratch;
+    float *cos_row  = &scratch[dim_y];
+    
+    switch (band->signal_operation)
+    {
+        case SIGNAL_1D_DCT:
+        {
+            /*! X[i] = sqrt(2/N) * sum(x[k] * cos(pi*i*(2k+1)/(2N))), the table row
+             *  carries c(i).
+             */
+            const float *input = &band->input[(item / row_count) * dim_x];
+            const float *row   = signalHostGetCosineRow(band, 1, index, dim_x, cos_row);
+            double      scale  = sqrt(2.0 / dim_x) * ((index == 0) ? M_SQRT2 : 1.0);
+            
+            band->output[item] = (float)(scale * signalHostDot(input, row, dim_x));
+            break;
+        }
+        case SIGNAL_1D_IDCT:
+        {
+            const float *input = &band->input[(item / row_count) * dim_x];
+            const float *row   = signalHostGetCosineRow(band, 0, index, dim_x, cos_row);
+            
+            band->output[item] = (float)(sqrt(2.0 / dim_x)
+                                         * ((0.5 * input[0]) + signalHostDot(&input[1], &row[1], dim_x - 1)));
+            break;
+        }
+        case SIGNAL_2D_DCT:
+        {
+            /*! Column v of the output: row pass T[y] = sum(in[x + dim_y*y] * C(x, v)),
+             *  then out[u + dim_y*v] = 0.25 * sum(T[y] * C(y, u)).
+             */
+            const float *input  = &band->input[(item / row_count) * dim_x * dim_y];
+            float       *output = &band->output[(item / row_count) * dim_x * dim_y];
+            const float *row    = signalHostGetCosineRow(band, 1, index, dim_x, cos_row);
+            
+            for (int y = 0; y < dim_y; y += 1)
+            {
+                temp[y] = signalHostDot(&input[dim_y * y], row, dim_x);
+            }
+            
+            for (int u = 0; u < dim_y; u += 1)
+            {
+                row = signalHostGetCosineRow(band, 1, u, dim_y, cos_row);
+                output[u + dim_y * index] = 0.25f * signalHostDot(temp, row, dim_y);
+            }
+            break;
+        }
+        case SIGNAL_2D_IDCT:
+        {
+            /*! Output column x: T[v] = sum(in[u + dim_x*v] * C(x, u)), then
+             *  out[y + dim_y*x] = clamp(0.25 * sum(T[v] * C(y, v)), 0, 255).
+             */
+            const float *input  = &band->input[(item / row_count) * dim_x * dim_y];
+            float       *output = &band->output[(item / row_count) * dim_x * dim_y];
+            const float *row    = signalHostGetCosineRow(band, 0, index, dim_x, cos_row);
+            
+            for (int v = 0; v < dim_y; v += 1)
+            {
+                temp[v] = signalHostDot(&input[dim_x * v], row, dim_x);
+            }
+            
+            for (int y = 0; y < dim_x; y += 1)
+            {
+                float z;
+                
+                row = signalHostGetCosineRow(band, 0, y, dim_y, cos_row);
+                z   = 0.25f * signalHostDot(temp, row, dim_y);
+                
+                output[y + dim_y * index] = (z > 255.0f) ? 255.0f : ((z < 0.0f) ? 0.0f : z);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void signalHostFastItem(const signal_host_band_t * const band,
+                               size_t                           item,
+                               double                   * const scratch)
+{
+    int    size   = band->dim_x;
+    int    index  = (int)(item % size);
+    size_t offset = (item / size) * size * size;
+    double *coef  = scratch;
+    double *work  = &scratch[size];
+    double scale  = sqrt(2.0 / size);
+    
+    switch (band->signal_operation)
+    {
+        case SIGNAL_1D_DCT:
+        {
+            signalHostFastDCT(band->plan, &band->input[item * size], coef, work);
+            
+            for (int k = 0; k < size; k += 1)
+            {
+                band->output[item * size + k] = (float)(scale * coef[k]);
+            }
+            break;
+        }
+        case SIGNAL_1D_IDCT:
+        {
+            signalHostFastIDCT(band->plan, &band->input[item * size], 1.0, coef, work);
+            
+            for (int n = 0; n < size; n += 1)
+            {
+                band->output[item * size + n] = (float)(scale * coef[n]);
+            }
+            break;
+        }
+        case SIGNAL_2D_DCT:
+        {
+            /*! Row pass transforms input row y into temp column y scaled by c(v),
+             *  the column pass transforms temp row v into output row v.
+             */
+            if (band->mode == SIGNAL_HOST_MODE_FAST_ROW)
+            {
+                signalHostFastDCT(band->plan, &band->input[offset + size * index], coef, work);
+                
+                for (int v = 0; v < size; v += 1)
+                {
+                    band->temp[offset + index + size * v] = (float)(((v == 0) ? M_SQRT1_2 : 1.0) * coef[v]);
+                }
+            }
+            else
+            {
+                signalHostFastDCT(band->plan, &band->temp[offset + size * index], coef, work);
+                
+                for (int u = 0; u < size; u += 1)
+                {
+                    band->output[offset + u + size * index] = (float)(0.25 * ((u == 0) ? M_SQRT1_2 : 1.0) * coef[u]);
+                }
+            }
+            break;
+        }
+        case SIGNAL_2D_IDCT:
+        {
+            /*! Scaling X[0] by sqrt(2) turns X[0]/2 into c(0)*X[0]. */
+            if (band->mode == SIGNAL_HOST_MODE_FAST_ROW)
+            {
+                signalHostFastIDCT(band->plan, &band->input[offset + size * index], M_SQRT2, coef, work);
+                
+                for (int x = 0; x < size; x += 1)
+                {
+                    band->temp[offset + index + size * x] = (float)coef[x];
+                }
+            }
+            else
+            {
+                signalHostFastIDCT(band->plan, &band->temp[offset + size * index], M_SQRT2, coef, work);
+                
+                for (int y = 0; y < size; y += 1)
+                {
+                    double z = 0.25 * coef[y];
+                    
+                    band->output[offset + y + size * index] = (float)((z > 255.0) ? 255.0 : ((z < 0.0) ? 0.0 : z));
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void * signalHostComputeBand(void * arg)
+{
+    const signal_host_band_t *band = (const signal_host_band_t *)arg;
+    void                     *scratch;
+    
+    /* Direct items need a row of partial sums and a cosine row, fast items the
+     * coefficients and the complex FFT work area.
+     */
+    if (band->mode == SIGNAL_HOST_MODE_DIRECT)
+    {
+        scratch = malloc(sizeof(float) * (band->dim_y + ((band->dim_x > band->dim_y) ? band->dim_x : band->dim_y)));
+    }
+    else
+    {
+        scratch = malloc(sizeof(double) * 3 * band->dim_x);
+    }
+    
+    if (scratch == NULL)
+    {
+        return (arg);
+    }
+    
+    for (size_t item = band->item_start; item < band->item_end; item += 1)
+    {
+        if (band->mode == SIGNAL_HOST_MODE_DIRECT)
+        {
+            signalHostDirectItem(band, item, (float *)scratch);
+        }
+        else
+        {
+            signalHostFastItem(band, item, (double *)scratch);
+        }
+    }
+    
+    free(scratch);
+    
+    return (NULL);
+}
+
+static int signalHostGetThreadCount(size_t num_items, double ops_per_item)
+{
+    long   num_cpu;
+    double num_thread;
+    
+    num_cpu    = sysconf(_SC_NPROCESSORS_ONLN);
+    num_thread = (num_cpu > 0) ? (double)num_cpu : 1.0;
+    num_thread = (num_thread < SIGNAL_HOST_MAX_THREADS) ? num_thread : SIGNAL_HOST_MAX_THREADS;
+    
+    if (((num_items * ops_per_item) / SIGNAL_HOST_MIN_OPS_PER_THREAD) < num_thread)
+    {
+        num_thread = (num_items * ops_per_item) / SIGNAL_HOST_MIN_OPS_PER_THREAD;
+    }
+    
+    if (num_thread > num_items)
+    {
+        num_thread = (double)num_items;
+    }
+    
+    return ((num_thread >= 1.0) ? (int)num_thread : 1);
+}
+
+static void signalHostRun(signal_host_band_t * const band_template,
+                          size_t                     num_items,
+                          double                     ops_per_item,
+                          cl_int             * const err)
+{
+    signal_host_band_t band[SIGNAL_HOST_MAX_THREADS];
+    pthread_t          thread[SIGNAL_HOST_MAX_THREADS];
+    int                thread_started[SIGNAL_HOST_MAX_THREADS];
+    int                num_thread;
+    int                i;
+    
+    /* Item bands, the first band runs on the calling thread. */
+    num_thread = signalHostGetThreadCount(num_items, ops_per_item);
+    
+    for (i = 0; i < num_thread; i += 1)
+    {
+        band[i]            = *band_template;
+        band[i].item_start = (num_items * i) / num_thread;
+        band[i].item_end   = (num_items * (i + 1)) / num_thread;
+        
+        thread_started[i] = (i > 0) && (pthread_create(&thread[i], NULL, signalHostComputeBand, &band[i]) == 0);
+    }
+    
+    /* A band whose thread could not be started runs here. */
+    for (i = 0; i < num_thread; i += 1)
+    {
+        if ((thread_started[i] == 0) && (signalHostComputeBand(&band[i]) != NULL))
+        {
+            *err = CL_OUT_OF_HOST_MEMORY;
+        }
+    }
+    
+    for (i = 1; i < num_thread; i += 1)
+    {
+        void *thread_ret = NULL;
+        
+        if (thread_started[i] != 0)
+        {
+            pthread_join(thread[i], &thread_ret);
+            
+            if (thread_ret != NULL)
+            {
+                *err = CL_OUT_OF_HOST_MEMORY;
+            }
+        }
+    }
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+int signalHostSupports(int signal_operation, const int input_dims[2])
+{
+    switch (signal_operation)
+    {
+        case SIGNAL_1D_DCT:
+        case SIGNAL_1D_IDCT:
+            return (input_dims[0] > 0);
+        case SIGNAL_2D_DCT:
+            return ((input_dims[0] > 0) && (input_dims[1] > 0) && (input_dims[1] <= input_dims[0]));
+        case SIGNAL_2D_IDCT:
+            return ((input_dims[0] > 0) && (input_dims[1] == input_dims[0]));
+        default:
+            return (0);
+    }
+}
+
+void signalHostCompute(int                signal_operation,
+                       const float        * const input,
+                       float              * const output,
+                       const int          input_dims[2],
+                       int                num_signals,
+                       cl_int             * const err)
+{
+    signal_host_band_t band;
+    int                is_2d;
+    int                is_private = 0;
+    size_t             num_items;
+    
+    *err = CL_SUCCESS;
+    
+    if ((num_signals <= 0) || (signalHostSupports(signal_operation, input_dims) == 0))
+    {
+        *err = CL_INVALID_VALUE;
+        return;
+    }
+    
+    is_2d = (signal_operation == SIGNAL_2D_DCT) || (signal_operation == SIGNAL_2D_IDCT);
+    
+    memset(&band, 0, sizeof(band));
+    band.signal_operation = signal_operation;
+    band.dim_x            = input_dims[0];
+    band.dim_y            = (is_2d != 0) ? input_dims[1] : 1;
+    band.input            = input;
+    band.output           = output;
+    
+    if (signalHostIsFastSize(signal_operation, input_dims))
+    {
+        int    size     = band.dim_x;
+        double fft_cost = 4.0 * size * log2((double)size);
+        
+        band.plan = signalHostGetPlan(size, &is_private);
+        
+        if (band.plan == NULL)
+        {
+            *err = CL_OUT_OF_HOST_MEMORY;
+            return;
+        }
+        
+        if (is_2d == 0)
+        {
+            band.mode = SIGNAL_HOST_MODE_FAST_ROW;
+            signalHostRun(&band, (size_t)num_signals, fft_cost, err);
+        }
+        else
+        {
+            /*! Row pass into a temporary matrix per signal, then the column pass. */
+            num_items = (size_t)num_signals * size;
+            band.temp = (float *)malloc(sizeof(float) * num_items * size);
+            
+            if (band.temp == NULL)
+            {
+                *err = CL_OUT_OF_HOST_MEMORY;
+            }
+            else
+            {
+                band.mode = SIGNAL_HOST_MODE_FAST_ROW;
+                signalHostRun(&band, num_items, fft_cost, err);
+                
+                if (*err == CL_SUCCESS)
+                {
+                    band.mode = SIGNAL_HOST_MODE_FAST_COL;
+                    signalHostRun(&band, num_items, fft_cost, err);
+                }
+                
+                free(band.temp);
+            }
+        }
+        
+        if (is_private != 0)
+        {
+            signalHostFreePlan((signal_host_fft_plan_t *)band.plan);
+        }
+        
+        return;
+    }
+    
+    /*! Direct transforms, one item per output element (1D) or output column (2D). */
+    {
+        int table_dim = (band.dim_x > band.dim_y) ? band.dim_x : band.dim_y;
+        
+        if (table_dim <= SIGNAL_HOST_TABLE_MAX_DIM)
+        {
+            band.table = signalHostGetTable(band.dim_x, table_dim, &is_private);
+            
+            if (band.table == NULL)
+            {
+                *err = CL_OUT_OF_HOST_MEMORY;
+                return;
+            }
+        }
+        
+        band.mode = SIGNAL_HOST_MODE_DIRECT;
+        
+        if (is_2d == 0)
+        {
+            signalHostRun(&band, (size_t)num_signals * band.dim_x, (double)band.dim_x, err);
+        }
+        else
+        {
+            int row_count = (signal_operation == SIGNAL_2D_IDCT) ? band.dim_y : band.dim_x;
+            
+            signalHostRun(&band,
+                          (size_t)num_signals * row_count,
+                          (double)band.dim_y * (band.dim_x + ((signal_operation == SIGNAL_2D_IDCT) ? band.dim_x : band.dim_y)),
+                          err);
+        }
+        
+        if (is_private != 0)
+        {
+            signalHostFreeTable((signal_host_table_t *)band.table);
+        }
+    }
+}
+
+void signalHostDeinit(void)
+{
+    pthread_mutex_lock(&signal_host_cache_lock);
+    
+    for (int i = 0; i < SIGNAL_HOST_CACHE_SIZE; i += 1)
+    {
+        signalHostFreeTable(signal_host_table_cache[i]);
+        signalHostFreePlan(signal_host_plan_cache[i]);
+        
+        signal_host_table_cache[i] = NULL;
+        signal_host_plan_cache[i]  = NULL;
+    }
+    
+    pthread_mutex_unlock(&signal_host_cache_lock);
+}
@@ -0,0 +1,43 @@
+#ifndef _LIB_SIGNAL_HOST_H_
+#define _LIB_SIGNAL_HOST_H_
+
+#include "lib_signal.h"
+
+/* Host implementation of the DCT kernels: same definitions, output layout, 0.25
+ * scale and IDCT clamp. Cosine tables are computed in double precision and cached,
+ * dot products are vectorised with AVX or SSE when the compiler targets them.
+ * Power-of-two 1D signals and square power-of-two 2D signals from
+ * SIGNAL_HOST_FAST_DCT_MIN_SIZE on use an FFT based DCT. Work is split over
+ * SIGNAL_HOST_MAX_THREADS threads.
+ *
+ * Results match the device kernels within SIGNAL_HOST_TOLERANCE times the largest
+ * output magnitude for signals of up to 4096 elements; the direct kernels evaluate
+ * their angles in single precision, so the difference grows with the size.
+ */
+#ifndef SIGNAL_HOST_MAX_THREADS
+#define SIGNAL_HOST_MAX_THREADS 16
+#endif
+
+#define SIGNAL_HOST_FAST_DCT_MIN_SIZE 16
+#define SIGNAL_HOST_TOLERANCE         1e-4
+
+/* The 2D kernels index a dims[0] x dims[1] matrix with both dimensions: the DCT
+ * stays inside it for dims[1] <= dims[0], the IDCT writes every output exactly once
+ * only for square signals. The host refuses the other shapes.
+ */
+extern int signalHostSupports(int signal_operation, const int input_dims[2]);
+
+/* Transforms num_signals contiguous signals of input_dims[0] (1D) or
+ * input_dims[0] x input_dims[1] (2D) elements.
+ */
+extern void signalHostCompute(int                signal_operation,
+                              const float        * const input,
+                              float              * const output,
+                              const int          input_dims[2],
+                              int                num_signals,
+                              cl_int             * const err);
+
+/* Releases the cached cosine tables and FFT plans. */
+extern void signalHostDeinit(void);
+
+#endif /* _LIB_SIGNAL_HOST_H_ */
@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "lib_opencl.h"
+#include "lib_signal_stream.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct signal_stream_s
+{
+  signal_stream_cfg_t   cfg;
+  float                 *window;
+  float                 *samples;          /* Samples from the next frame start on.       */
+  size_t                sample_capacity;   /* One batch of frames: length + hop * (n - 1). */
+  size_t                num_samples;
+  size_t                num_covered;       /* Leading samples already in an earlier frame. */
+  int                   source_done;
+  float                 *frames[2];
+  float                 *coefficients[2];
+  signal_stream_stats_t stats;
+};
+
+/* One batch transformed on the worker thread. */
+typedef struct
+{
+  signal_stream_t *stream;
+  int             buffer;
+  int             num_frames;
+  int             err;
+}signal_stream_job_t;
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static double signalStreamGetTimeMs(void);
+static int    signalStreamFillBatch(signal_stream_t        * const stream,
+                                    signal_stream_source_t         source,
+                                    void                   * const source_data,
+                                    float                  * const frames);
+static void * signalStreamTransformBatch(void * const arg);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static double signalStreamGetTimeMs(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0);
+}
+
+static int signalStreamFillBatch(signal_stream_t        * const stream,
+                                 signal_stream_source_t         source,
+                                 void                   * const source_data,
+                                 float                  * const frames)
+{
+    const int frame_length = stream->cfg.frame_length;
+    const int hop          = stream->cfg.hop;
+    size_t    start;
+    size_t    shift;
+    int       num_frames = 0;
+    
+    /* Top the sample buffer up to a whole batch of frames. */
+    while ((stream->source_done == 0) && (stream->num_samples < stream->sample_capacity))
+    {
+        size_t count = source(source_data,
+                              stream->samples + stream->num_samples,
+                              stream->sample_capacity - stream->num_samples);
+        
+        if (count == 0)
+        {
+            stream->source_done = 1;
+        }
+        
+        stream->num_samples       += count;
+        stream->stats.num_samples += count;
+    }
+    
+    /* Complete frames, then at the end of the stream one zero padded frame for
+     * each start that still has uncovered samples.
+     */
+    for (start = 0; num_frames < stream->cfg.frames_per_batch; start += hop)
+    {
+        float  *frame = frames + (size_t)num_frames * frame_length;
+        size_t count;
+        
+        if ((start + frame_length) <= stream->num_samples)
+        {
+            count = frame_length;
+        }
+        else if (   (stream->source_done != 0)
+                 && (start < stream->num_samples)
+                 && (stream->num_covered < stream->num_samples))
+        {
+            count = stream->num_samples - start;
+        }
+        else
+        {
+            break;
+        }
+        
+        for (size_t i = 0; i < count; i += 1)
+        {
+            frame[i] = stream->window[i] * stream->samples[start + i];
+        }
+        
+        memset(frame + count, 0, (frame_length - count) * sizeof(float));
+        
+        stream->num_covered = start + frame_length;
+        num_frames         += 1;
+    }
+    
+    /* Drop the samples before the next frame start. */
+    shift = (start < stream->num_samples) ? start : stream->num_samples;
+    
+    memmove(stream->samples, stream->samples + shift, (stream->num_samples - shift) * sizeof(float));
+    
+    stream->num_samples -= shift;
+    stream->num_covered  = (stream->num_covered > start) ? (stream->num_covered - start) : 0;
+    
+    return (num_frames);
+}
+
+static void * signalStreamTransformBatch(void * const arg)
+{
+    signal_stream_job_t *job    = (signal_stream_job_t *)arg;
+    signal_stream_t     *stream = job->stream;
+    signal_matrix_t     input_signal;
+    signal_matrix_t     ret_signal;
+    
+    input_signal.signal        = stream->frames[job->buffer];
+    input_signal.input_dims[0] = stream->cfg.frame_length;
+    input_signal.input_dims[1] = 0;
+    ret_signal.signal          = stream->coefficients[job->buffer];
+    
+    signalComputeBatch(SIGNAL_1D_DCT, &input_signal, job->num_frames, &ret_signal, &job->err);
+    
+    return (NULL);
+}
+//////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+signal_stream_t * signalStreamCreate(const signal_stream_cfg_t * const cfg,
+                                     cl_int                    * const ret_err)
+{
+    signal_stream_t *stream;
+    size_t          batch_size;
+    
+    if (   (cfg->frame_length <= 0)
+        || (cfg->hop <= 0)
+        || (cfg->hop > cfg->frame_length)
+        || (cfg->frames_per_batch < 0)
+        || (cfg->window < SIGNAL_WINDOW_RECTANGULAR)
+        || (cfg->window > SIGNAL_WINDOW_HAMMING))
+    {
+        printf("Error Signal analysis component: Invalid stream configuration ... NOK.\n");
+        *ret_err = CL_INVALID_VALUE;
+        return (NULL);
+    }
+    
+    stream = (signal_stream_t *)calloc(1, sizeof(signal_stream_t));
+    
+    if (stream == NULL)
+    {
+        *ret_err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    stream->cfg = *cfg;
+    
+    if (stream->cfg.frames_per_batch == 0)
+    {
+        stream->cfg.frames_per_batch = SIGNAL_STREAM_FRAMES_PER_BATCH;
+    }
+    
+    /* Frames and coefficients are double buffered, the batches use aligned host
+     * memory so zero-copy devices can work on them in place.
+     */
+    batch_size              = (size_t)stream->cfg.frames_per_batch * stream->cfg.frame_length;
+    stream->sample_capacity = (size_t)stream->cfg.frame_length + (size_t)stream->cfg.hop * (stream->cfg.frames_per_batch - 1);
+    stream->window          = (float *)malloc(stream->cfg.frame_length * sizeof(float));
+    stream->samples         = (float *)malloc(stream->sample_capacity * sizeof(float));
+    
+    for (int i = 0; i < 2; i += 1)
+    {
+        stream->frames[i]       = (float *)clAllocHostMemory(batch_size * sizeof(float));
+        stream->coefficients[i] = (float *)clAllocHostMemory(batch_size * sizeof(float));
+    }
+    
+    if (   (stream->window == NULL)
+        || (stream->samples == NULL)
+        || (stream->frames[0] == NULL)
+        || (stream->frames[1] == NULL)
+        || (stream->coefficients[0] == NULL)
+        || (stream->coefficients[1] == NULL))
+    {
+        signalStreamDestroy(stream);
+        *ret_err = CL_OUT_OF_HOST_MEMORY;
+        return (NULL);
+    }
+    
+    /* Periodic windows, so frames overlapping by half a Hann window sum to a constant. */
+    for (int i = 0; i < stream->cfg.frame_length; i += 1)
+    {
+        double phase = (2.0 * M_PI * i) / stream->cfg.frame_length;
+        
+        switch (stream->cfg.window)
+        {
+            case SIGNAL_WINDOW_HANN:
+            {
+                stream->window[i] = (float)(0.5 - 0.5 * cos(phase));
+                break;
+            }
+            case SIGNAL_WINDOW_HAMMING:
+            {
+                stream->window[i] = (float)(0.54 - 0.46 * cos(phase));
+                break;
+            }
+            default:
+            {
+                stream->window[i] = 1.0f;
+                break;
+            }
+        }
+    }
+    
+    *ret_err = CL_SUCCESS;
+    
+    return (stream);
+}
+
+void signalStreamRun(signal_stream_t        * const stream,
+                     signal_stream_source_t         source,
+                     void                   * const source_data,
+                     signal_stream_sink_t           sink,
+                     void                   * const sink_data,
+                     cl_int                 * const ret_err)
+{
+    signal_stream_job_t job;
+    unsigned long long  first_frame = 0;
+    double              start_time;
+    int                 num_frames[2];
+    int                 current = 0;
+    
+    memset(&stream->stats, 0, sizeof(stream->stats));
+    stream->num_samples = 0;
+    stream->num_covered = 0;
+    stream->source_done = 0;
+    
+    start_time = signalStreamGetTimeMs();
+    
+    num_frames[current] = signalStreamFillBatch(stream, source, source_data, stream->frames[current]);
+    
+    *ret_err = CL_SUCCESS;
+    
+    /* The worker transforms the current batch while this thread reads and frames the
+     * next one, the sink gets each batch once its transform is joined.
+     */
+    while (num_frames[current] > 0)
+    {
+        pthread_t thread;
+        int       thread_started;
+        
+        job.stream     = stream;
+        job.buffer     = current;
+        job.num_frames = num_frames[current];
+        job.err        = CL_SUCCESS;
+        
+        thread_started = (pthread_create(&thread, NULL, signalStreamTransformBatch, &job) == 0);
+        
+        if (thread_started == 0)
+        {
+            signalStreamTransformBatch(&job);
+        }
+        
+        num_frames[1 - current] = signalStreamFillBatch(stream, source, source_data, stream->frames[1 - current]);
+        
+        if (thread_started != 0)
+        {
+            pthread_join(thread, NULL);
+        }
+        
+        if (job.err != CL_SUCCESS)
+        {
+            *ret_err = job.err;
+            break;
+        }
+        
+        sink(sink_data, stream->coefficients[current], stream->cfg.frame_length, num_frames[current], first_frame);
+        
+        first_frame             += num_frames[current];
+        stream->stats.num_frames = first_frame;
+        current                  = 1 - current;
+    }
+    
+    stream->stats.elapsed_ms = signalStreamGetTimeMs() - start_time;
+    
+    if (stream->stats.elapsed_ms > 0)
+    {
+        stream->stats.samples_per_second = (1000.0 * stream->stats.num_samples) / stream->stats.elapsed_ms;
+        stream->stats.frames_per_second  = (1000.0 * stream->stats.num_frames) / stream->stats.elapsed_ms;
+    }
+}
+
+void signalStreamGetStats(const signal_stream_t * const stream,
+                          signal_stream_stats_t * const ret_stats)
+{
+    *ret_stats = stream->stats;
+}
+
+void signalStreamDestroy(signal_stream_t * const stream)
+{
+    if (stream == NULL)
+    {
+        return;
+    }
+    
+    for (int i = 0; i < 2; i += 1)
+    {
+        free(stream->frames[i]);
+        free(stream->coefficients[i]);
+    }
+    
+    free(stream->window);
+    free(stream->samples);
+    free(stream);
+}
+
+size_t signalStreamFileSource(void * const user_data, float * const samples, size_t max_samples)
+{
+    return (fread(samples, sizeof(float), max_samples, (FILE *)user_data));
+}
@@ -0,0 +1,74 @@
+#ifndef _LIB_SIGNAL_STREAM_H_
+#define _LIB_SIGNAL_STREAM_H_
+
+#include <stdio.h>
+#include "lib_signal.h"
+
+/* Short-time DCT of signals too long to hold in memory. Samples are pulled from a
+ * source in chunks and sliced into frames of frame_length samples every hop
+ * samples, each frame is multiplied by the window and frames_per_batch frames at a
+ * time go through signalComputeBatch. While one batch is transformed on a worker
+ * thread the next one is read and framed, so the source, the upload and the
+ * transform overlap. The last frame is zero padded past the end of the stream.
+ */
+#define SIGNAL_WINDOW_RECTANGULAR 0
+#define SIGNAL_WINDOW_HANN        1
+#define SIGNAL_WINDOW_HAMMING     2
+
+#define SIGNAL_STREAM_FRAMES_PER_BATCH 256
+
+typedef struct
+{
+  int frame_length;       /* Samples per frame and DCT size.                    */
+  int hop;                /* Samples between frame starts, 1..frame_length.    */
+  int window;             /* SIGNAL_WINDOW_*, periodic Hann and Hamming.        */
+  int frames_per_batch;   /* Frames per signalComputeBatch call, 0 for default. */
+}signal_stream_cfg_t;
+
+typedef struct
+{
+  unsigned long long num_samples;
+  unsigned long long num_frames;
+  double             elapsed_ms;
+  double             samples_per_second;
+  double             frames_per_second;
+}signal_stream_stats_t;
+
+/* Fills samples with up to max_samples samples and returns how many it wrote, 0 at
+ * the end of the stream.
+ */
+typedef size_t (*signal_stream_source_t)(void * const user_data, float * const samples, size_t max_samples);
+
+/* Receives num_frames consecutive coefficient frames of frame_length values each,
+ * starting with frame first_frame. The coefficients are only valid during the call.
+ */
+typedef void (*signal_stream_sink_t)(void              * const user_data,
+                                     const float       * const coefficients,
+                                     int                       frame_length,
+                                     int                       num_frames,
+                                     unsigned long long        first_frame);
+
+typedef struct signal_stream_s signal_stream_t;
+
+extern signal_stream_t * signalStreamCreate(const signal_stream_cfg_t * const cfg,
+                                            cl_int                    * const ret_err);
+
+/* Transforms the whole stream of source, the sink is called in frame order from the
+ * calling thread.
+ */
+extern void signalStreamRun(signal_stream_t        * const stream,
+                            signal_stream_source_t         source,
+                            void                   * const source_data,
+                            signal_stream_sink_t           sink,
+                            void                   * const sink_data,
+                            cl_int                 * const ret_err);
+
+extern void signalStreamGetStats(const signal_stream_t * const stream,
+                                 signal_stream_stats_t * const ret_stats);
+
+extern void signalStreamDestroy(signal_stream_t * const stream);
+
+/* Source reading native-endian 32-bit float samples from the FILE * in user_data. */
+extern size_t signalStreamFileSource(void * const user_data, float * const samples, size_t max_samples);
+
+#endif /* _LIB_SIGNAL_STREAM_H_ */
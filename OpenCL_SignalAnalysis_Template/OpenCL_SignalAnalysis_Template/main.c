@@ -1,6 +1,88 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
 #include "lib_opencl.h"
 #include "lib_signal.h"
+#include "lib_signal_host.h"
+#include "lib_signal_stream.h"
+
+#define PROFILE_OUTPUT_FILENAME "profile_signal.json"
+
+/* Sample rate of the synthetic stream of the short-time DCT test. */
+#define STREAM_SAMPLE_RATE 48000
+
+typedef struct
+{
+    unsigned long long next_sample;
+    unsigned long long num_samples;
+}stream_source_t;
+
+typedef struct
+{
+    unsigned long long num_frames;
+    int                peak_bin;
+    float              peak_value;
+    int                out_of_order;   /* A batch did not start at the next frame. */
+}stream_sink_t;
+
+static double getWallTimeMs(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return ((double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0);
+}
+
+/* A 1 kHz tone with a little noise, handed out in chunks of at most 1000 samples. */
+static size_t readStreamSamples(void * const user_data, float * const samples, size_t max_samples)
+{
+    stream_source_t *source = (stream_source_t *)user_data;
+    size_t          count   = 0;
+    
+    max_samples = (max_samples < 1000) ? max_samples : 1000;
+    
+    while ((count < max_samples) && (source->next_sample < source->num_samples))
+    {
+        double t = (double)source->next_sample / STREAM_SAMPLE_RATE;
+        
+        samples[count]       = (float)(sin(2.0 * M_PI * 1000.0 * t) + 0.01 * (((source->next_sample * 37) % 101) / 50.0 - 1.0));
+        count               += 1;
+        source->next_sample += 1;
+    }
+    
+    return (count);
+}
+
+/* Keeps the strongest coefficient over all frames and checks that the batches
+ * arrive in frame order.
+ */
+static void writeStreamFrames(void               * const user_data,
+                              const float        * const coefficients,
+                              int                        frame_length,
+                              int                        num_frames,
+                              unsigned long long         first_frame)
+{
+    stream_sink_t *sink = (stream_sink_t *)user_data;
+    
+    if (first_frame != sink->num_frames)
+    {
+        sink->out_of_order = 1;
+    }
+    
+    for (int i = 0; i < (num_frames * frame_length); i += 1)
+    {
+        if (fabsf(coefficients[i]) > sink->peak_value)
+        {
+            sink->peak_value = fabsf(coefficients[i]);
+            sink->peak_bin   = i % frame_length;
+        }
+    }
+    
+    sink->num_frames += num_frames;
+}
 
 int main(int argc, const char * argv[])
 {
@@ -8,25 +90,69 @@ int main(int argc, const char * argv[])
     cl_device_id my_device_list[10];
     cl_uint      num_dev;
     cl_int       err;
+    cl_int       device_ready;
     
-    /* Get and Print device information.
+    /* Parse options, --retune sweeps the work-group sizes again instead of using
+     * the stored ones, --profile times every device command.
      */
     {
-        clGetDeviceIDs(NULL, CL_DEVICE_TYPE_ALL, 10, my_device_list, &num_dev);
-        clPrintAllAvaliableDevicesInfo(my_device_list, num_dev);
+        for (int i = 1; i < argc; i += 1)
+        {
+            if (strcmp(argv[i], "--retune") == 0)
+            {
+                clSetWorkGroupRetune(CL_TRUE);
+            }
+            else if (strcmp(argv[i], "--profile") == 0)
+            {
+                clSetProfilingEnable(CL_TRUE);
+            }
+        }
+    }
+    
+    /* Get device information.
+     */
+    {
+        clGetAllDeviceIDs(CL_DEVICE_TYPE_ALL, 10, my_device_list, &num_dev);
     }
     
     /* Initialize signal analysis component.
+     * The component runs on the device with the fastest calibration.
      */
     {
+        signalSetDeviceAutoSelect(CL_TRUE);
         signalInit(my_device_list, num_dev, &err);
+        
+        /* Without a device the transforms run on the host, device only tests are
+         * skipped.
+         */
+        device_ready = (err == CL_SUCCESS);
+        err          = CL_SUCCESS;
     }
-
+    
+    /* Print device information with the calibration timings.
+     */
+    {
+        clPrintAllAvaliableDevicesInfo(my_device_list, num_dev);
+    }
+    
+    /* Print program binary cache statistics.
+     */
+    {
+        program_cache_stats_t cache_stats;
+        
+        clGetProgramCacheStats(&cache_stats);
+        printf("Info: Program cache hits: %u, misses: %u, build time: %.2f ms, saved: %.2f ms.\n",
+               cache_stats.hit_count,
+               cache_stats.miss_count,
+               cache_stats.build_time_ms,
+               cache_stats.saved_time_ms);
+    }
+    
     /* Test 1D DCT
      */
     {
         const int matrix_size  = 10;
-        float  input_matrix[matrix_size] = {0.218418, 0.956318, 0.829509, 0.561695,
+        float  input_matrix[] = {0.218418, 0.956318, 0.829509, 0.561695,
             0.415307, 0.066119, 0.257578, 0.109957,
             0.043829, 0.633966};
         float  output_matrix[matrix_size];
@@ -94,6 +220,625 @@ int main(int argc, const char * argv[])
         }
     }
     
+    /* Test 1D DCT plan: execute the same transform repeatedly and compare it with
+     * signalCompute.
+     */
+    {
+        const int num_iterations = 1000;
+        int       plan_dims[2]   = {256, 0};
+        float     input_matrix[256];
+        float     output_matrix[256];
+        float     plan_matrix[256];
+        float     max_diff;
+        signal_matrix_t signal_input;
+        signal_matrix_t signal_dct;
+        signal_matrix_t signal_plan;
+        signal_plan_t   *plan;
+        
+        for (int i = 0; i < plan_dims[0]; i += 1)
+        {
+            input_matrix[i] = (float)((i * 37) % 101) / 101.0f;
+        }
+        
+        signal_input.input_dims[0] = plan_dims[0];
+        signal_input.input_dims[1] = 0;
+        signal_input.signal        = input_matrix;
+        
+        signal_dct.input_dims[0] = plan_dims[0];
+        signal_dct.input_dims[1] = 0;
+        signal_dct.signal        = output_matrix;
+        
+        signal_plan.input_dims[0] = plan_dims[0];
+        signal_plan.input_dims[1] = 0;
+        signal_plan.signal        = plan_matrix;
+        
+        signalCompute(SIGNAL_1D_DCT, &signal_input, &signal_dct, &err);
+        
+        plan = signalPlanCreate(SIGNAL_1D_DCT, plan_dims, &err);
+        
+        for (int i = 0; (i < num_iterations) && (err == CL_SUCCESS); i += 1)
+        {
+            signalPlanExecute(plan, &signal_input, &signal_plan, &err);
+        }
+        
+        signalPlanDestroy(plan);
+        
+        if (err != CL_SUCCESS)
+        {
+            printf("Signal Error: %d.\n", err);
+            return 1;
+        }
+        
+        max_diff = 0;
+        for (int i = 0; i < plan_dims[0]; i += 1)
+        {
+            float diff = output_matrix[i] - plan_matrix[i];
+            
+            max_diff = (diff > max_diff) ? diff : ((-diff > max_diff) ? -diff : max_diff);
+        }
+        
+        printf("\nPlan Results:\n\t%d executions, max difference to signalCompute: %f\n",
+               num_iterations,
+               max_diff);
+    }
+    
+    /* Test fast 1D DCT: power-of-two sizes are routed to the FFT based kernels,
+     * compare with a host reference and check the DCT/IDCT round trip. 4096 points
+     * would go to the host in auto mode, the device backend keeps the kernels covered.
+     */
+    {
+        const int num_iterations = 100;
+        const int matrix_size    = 4096;
+        float     *input_matrix;
+        float     *output_matrix;
+        float     *inverse_matrix;
+        double    max_dct_diff;
+        double    max_idct_diff;
+        double    elapsed_ms;
+        clock_t   start_time;
+        signal_matrix_t signal_input;
+        signal_matrix_t signal_dct;
+        signal_matrix_t signal_idct;
+        
+        input_matrix   = (float *)clAllocHostMemory(matrix_size * sizeof(float));
+        output_matrix  = (float *)clAllocHostMemory(matrix_size * sizeof(float));
+        inverse_matrix = (float *)clAllocHostMemory(matrix_size * sizeof(float));
+        
+        for (int i = 0; i < matrix_size; i += 1)
+        {
+            input_matrix[i] = (float)sin(i * 0.37) + (float)((i * 37) % 101) / 1010.0f;
+        }
+        
+        signal_input.input_dims[0] = matrix_size;
+        signal_input.input_dims[1] = 0;
+        signal_input.signal        = input_matrix;
+        
+        signal_dct.input_dims[0] = matrix_size;
+        signal_dct.input_dims[1] = 0;
+        signal_dct.signal        = output_matrix;
+        
+        signal_idct.input_dims[0] = matrix_size;
+        signal_idct.input_dims[1] = 0;
+        signal_idct.signal        = inverse_matrix;
+        
+        signalSetBackend((device_ready != 0) ? SIGNAL_BACKEND_DEVICE : SIGNAL_BACKEND_AUTO);
+        
+        start_time = clock();
+        for (int i = 0; (i < num_iterations) && (err == CL_SUCCESS); i += 1)
+        {
+            signalCompute(SIGNAL_1D_DCT, &signal_input, &signal_dct, &err);
+        }
+        elapsed_ms = 1000.0 * (double)(clock() - start_time) / CLOCKS_PER_SEC;
+        
+        if (err == CL_SUCCESS)
+        {
+            signalCompute(SIGNAL_1D_IDCT, &signal_dct, &signal_idct, &err);
+        }
+        
+        signalSetBackend(SIGNAL_BACKEND_AUTO);
+        
+        if (err != CL_SUCCESS)
+        {
+            printf("Signal Error: %d.\n", err);
+            return 1;
+        }
+        
+        max_dct_diff  = 0;
+        max_idct_diff = 0;
+        for (int k = 0; k < matrix_size; k += 1)
+        {
+            double c = 0;
+            
+            for (int i = 0; i < matrix_size; i += 1)
+            {
+                c += cos(M_PI * k * (2 * i + 1) / (2.0 * matrix_size)) * input_matrix[i];
+            }
+            c *= sqrt(2.0 / matrix_size);
+            
+            max_dct_diff  = fmax(max_dct_diff, fabs(c - output_matrix[k]));
+            max_idct_diff = fmax(max_idct_diff, fabs(input_matrix[k] - inverse_matrix[k]));
+        }
+        
+        printf("\nFast DCT Results:\n\t%d points on the %s, %.3f ms per DCT, max difference to reference: %f, round trip: %f\n",
+               matrix_size,
+               (device_ready != 0) ? "device" : "host",
+               elapsed_ms / num_iterations,
+               max_dct_diff,
+               max_idct_diff);
+        
+        free(input_matrix);
+        free(output_matrix);
+        free(inverse_matrix);
+    }
+    
+    /* Test batched DCT: many short 1D vectors and 8x8 blocks in one launch each,
+     * compare the first signal with signalCompute.
+     */
+    {
+        const int num_vectors = 4096;
+        const int vector_size = 32;
+        const int num_blocks  = 1024;
+        const int block_size  = 8;
+        float     *batch_input;
+        float     *batch_output;
+        float     reference[64];
+        float     max_diff;
+        signal_matrix_t      signal_input;
+        signal_matrix_t      signal_output;
+        signal_matrix_t      signal_reference;
+        signal_batch_stats_t batch_stats;
+        
+        batch_input  = (float *)malloc(num_vectors * vector_size * sizeof(float));
+        batch_output = (float *)malloc(num_vectors * vector_size * sizeof(float));
+        
+        for (int i = 0; i < (num_vectors * vector_size); i += 1)
+        {
+            batch_input[i] = (float)((i * 37) % 256);
+        }
+        
+        /* 1D vectors.
+         */
+        signal_input.input_dims[0] = vector_size;
+        signal_input.input_dims[1] = 0;
+        signal_input.signal        = batch_input;
+        signal_output.signal       = batch_output;
+        signal_reference.signal    = reference;
+        
+        signalComputeBatch(SIGNAL_1D_DCT, &signal_input, num_vectors, &signal_output, &err);
+        signalGetBatchStats(&batch_stats);
+        
+        if (err == CL_SUCCESS)
+        {
+            signalCompute(SIGNAL_1D_DCT, &signal_input, &signal_reference, &err);
+        }
+        
+        if (err != CL_SUCCESS)
+        {
+            printf("Signal Error: %d.\n", err);
+            return 1;
+        }
+        
+        max_diff = 0;
+        for (int i = 0; i < vector_size; i += 1)
+        {
+            max_diff = fmaxf(max_diff, fabsf(reference[i] - batch_output[i]));
+        }
+        
+        printf("\nBatch Results:\n\t%u x %d-point DCT in %.3f ms, %.0f transforms/s, max difference: %f\n",
+               batch_stats.num_transforms,
+               vector_size,
+               batch_stats.elapsed_ms,
+               batch_stats.transforms_per_second,
+               max_diff);
+        
+        /* 8x8 blocks.
+         */
+        signal_input.input_dims[0] = block_size;
+        signal_input.input_dims[1] = block_size;
+        
+        signalComputeBatch(SIGNAL_2D_DCT, &signal_input, num_blocks, &signal_output, &err);
+        signalGetBatchStats(&batch_stats);
+        
+        if (err == CL_SUCCESS)
+        {
+            signalCompute(SIGNAL_2D_DCT, &signal_input, &signal_reference, &err);
+        }
+        
+        if (err != CL_SUCCESS)
+        {
+            printf("Signal Error: %d.\n", err);
+            return 1;
+        }
+        
+        max_diff = 0;
+        for (int i = 0; i < (block_size * block_size); i += 1)
+        {
+            max_diff = fmaxf(max_diff, fabsf(reference[i] - batch_output[i]));
+        }
+        
+        printf("\t%u x %dx%d 2D DCT in %.3f ms, %.0f transforms/s, max difference: %f\n",
+               batch_stats.num_transforms,
+               block_size,
+               block_size,
+               batch_stats.elapsed_ms,
+               batch_stats.transforms_per_second,
+               max_diff);
+        
+        free(batch_input);
+        free(batch_output);
+    }
+    
+    /* Test short-time DCT: 10 seconds of a 48 kHz stream in Hann windowed frames of
+     * 512 samples with a 256 sample hop. A 1 kHz tone peaks in DCT bin 2 * 512 * 1000 / 48000.
+     */
+    {
+        signal_stream_cfg_t   stream_cfg = {512, 256, SIGNAL_WINDOW_HANN, 0};
+        stream_source_t       source     = {0, 10 * STREAM_SAMPLE_RATE};
+        stream_sink_t         sink       = {0, 0, 0, 0};
+        signal_stream_stats_t stream_stats;
+        signal_stream_t       *stream;
+        
+        stream = signalStreamCreate(&stream_cfg, &err);
+        
+        if (stream != NULL)
+        {
+            signalStreamRun(stream, readStreamSamples, &source, writeStreamFrames, &sink, &err);
+            signalStreamGetStats(stream, &stream_stats);
+            signalStreamDestroy(stream);
+        }
+        
+        if (err != CL_SUCCESS)
+        {
+            printf("Signal Error: %d.\n", err);
+            return 1;
+        }
+        
+        printf("\nStream Results:\n\t%llu frames of %d samples in %.3f ms, %.0f frames/s, %.1fx real time, peak bin %d (expected %d), frames %s\n",
+               stream_stats.num_frames,
+               stream_cfg.frame_length,
+               stream_stats.elapsed_ms,
+               stream_stats.frames_per_second,
+               stream_stats.samples_per_second / STREAM_SAMPLE_RATE,
+               sink.peak_bin,
+               (int)((2.0 * stream_cfg.frame_length * 1000.0) / STREAM_SAMPLE_RATE + 0.5),
+               (sink.out_of_order == 0) ? "in order" : "OUT OF ORDER");
+    }
+    
+    /* Test separable 2D DCT: 256x256 input, compared with a double precision host
+     * reference of the computeDCT2D formula.
+     */
+    {
+        const int num_iterations = 10;
+        const int matrix_size    = 256;
+        float     *input_matrix;
+        float     *output_matrix;
+        double    *cos_table;
+        double    *row_pass;
+        double    max_diff;
+        double    max_value;
+        double    elapsed_ms;
+        clock_t   start_time;
+        signal_matrix_t signal_input;
+        signal_matrix_t signal_dct;
+        
+        input_matrix  = (float *)clAllocHostMemory(matrix_size * matrix_size * sizeof(float));
+        output_matrix = (float *)clAllocHostMemory(matrix_size * matrix_size * sizeof(float));
+        cos_table     = (double *)malloc(matrix_size * matrix_size * sizeof(double));
+        row_pass      = (double *)malloc(matrix_size * matrix_size * sizeof(double));
+        
+        for (int i = 0; i < (matrix_size * matrix_size); i += 1)
+        {
+            input_matrix[i] = (float)((i * 37) % 256);
+        }
+        
+        signal_input.input_dims[0] = matrix_size;
+        signal_input.input_dims[1] = matrix_size;
+        signal_input.signal        = input_matrix;
+        
+        signal_dct.input_dims[0] = matrix_size;
+        signal_dct.input_dims[1] = matrix_size;
+        signal_dct.signal        = output_matrix;
+        
+        start_time = clock();
+        for (int i = 0; (i < num_iterations) && (err == CL_SUCCESS); i += 1)
+        {
+            signalCompute(SIGNAL_2D_DCT, &signal_input, &signal_dct, &err);
+        }
+        elapsed_ms = 1000.0 * (double)(clock() - start_time) / CLOCKS_PER_SEC;
+        
+        if (err != CL_SUCCESS)
+        {
+            printf("Signal Error: %d.\n", err);
+            return 1;
+        }
+        
+        /* Reference: out[u + N*v] = 0.25*c(u)*c(v)*sum_y sum_x in[x + N*y]*cos_v(x)*cos_u(y).
+         */
+        for (int n = 0; n < matrix_size; n += 1)
+        {
+            for (int k = 0; k < matrix_size; k += 1)
+            {
+                cos_table[n * matrix_size + k] = ((k == 0) ? M_SQRT1_2 : 1.0)
+                                               * cos(M_PI * k * (2 * n + 1) / (2.0 * matrix_size));
+            }
+        }
+        
+        for (int y = 0; y < matrix_size; y += 1)
+        {
+            for (int v = 0; v < matrix_size; v += 1)
+            {
+                double z = 0;
+                
+                for (int x = 0; x < matrix_size; x += 1)
+                {
+                    z += input_matrix[x + matrix_size * y] * cos_table[x * matrix_size + v];
+                }
+                row_pass[y + matrix_size * v] = z;
+            }
+        }
+        
+        max_diff  = 0;
+        max_value = 0;
+        for (int v = 0; v < matrix_size; v += 1)
+        {
+            for (int u = 0; u < matrix_size; u += 1)
+            {
+                double z = 0;
+                
+                for (int y = 0; y < matrix_size; y += 1)
+                {
+                    z += row_pass[y + matrix_size * v] * cos_table[y * matrix_size + u];
+                }
+                z *= 0.25;
+                
+                max_diff  = fmax(max_diff, fabs(z - output_matrix[u + matrix_size * v]));
+                max_value = fmax(max_value, fabs(z));
+            }
+        }
+        
+        printf("\nSeparable 2D DCT Results:\n\t%dx%d on the %s, %.3f ms per DCT, max relative difference to reference: %e\n",
+               matrix_size,
+               matrix_size,
+               (device_ready != 0) ? "device" : "host",
+               elapsed_ms / num_iterations,
+               max_diff / max_value);
+        
+        free(input_matrix);
+        free(output_matrix);
+        free(cos_table);
+        free(row_pass);
+    }
+    
+    /* Test host backend: the same transforms forced to the device and to the host,
+     * compared with the documented tolerance.
+     */
+    if (device_ready == 0)
+    {
+        printf("\nHost Backend Results:\n\tSkipped, no device to compare with.\n");
+    }
+    else
+    {
+        const int  num_iterations = 10;
+        const int  test_dims[2][2] = {{1024, 0}, {64, 64}};
+        const int  test_operation[2] = {SIGNAL_1D_DCT, SIGNAL_2D_DCT};
+        const int  backend[2] = {SIGNAL_BACKEND_DEVICE, SIGNAL_BACKEND_HOST};
+        float      *input_matrix;
+        float      *output_matrix[2];
+        double     elapsed_ms[2];
+        double     max_diff;
+        double     max_value;
+        double     start_time;
+        signal_matrix_t signal_input;
+        signal_matrix_t signal_output;
+        
+        input_matrix     = (float *)malloc(64 * 64 * sizeof(float));
+        output_matrix[0] = (float *)malloc(64 * 64 * sizeof(float));
+        output_matrix[1] = (float *)malloc(64 * 64 * sizeof(float));
+        
+        for (int i = 0; i < (64 * 64); i += 1)
+        {
+            input_matrix[i] = (float)((i * 37) % 256);
+        }
+        
+        printf("\nHost Backend Results:\n");
+        
+        for (int t = 0; t < 2; t += 1)
+        {
+            int num_elements = test_dims[t][0] * ((test_dims[t][1] == 0) ? 1 : test_dims[t][1]);
+            
+            for (int b = 0; b < 2; b += 1)
+            {
+                signal_input.input_dims[0] = test_dims[t][0];
+                signal_input.input_dims[1] = test_dims[t][1];
+                signal_input.signal        = input_matrix;
+                signal_output.signal       = output_matrix[b];
+                
+                signalSetBackend(backend[b]);
+                
+                start_time = getWallTimeMs();
+                for (int i = 0; (i < num_iterations) && (err == CL_SUCCESS); i += 1)
+                {
+                    signalCompute(test_operation[t], &signal_input, &signal_output, &err);
+                }
+                elapsed_ms[b] = (getWallTimeMs() - start_time) / num_iterations;
+            }
+            
+            signalSetBackend(SIGNAL_BACKEND_AUTO);
+            
+            if (err != CL_SUCCESS)
+            {
+                printf("Signal Error: %d.\n", err);
+                return 1;
+            }
+            
+            max_diff  = 0;
+            max_value = 0;
+            for (int i = 0; i < num_elements; i += 1)
+            {
+                max_diff  = fmax(max_diff, fabs(output_matrix[0][i] - output_matrix[1][i]));
+                max_value = fmax(max_value, fabs(output_matrix[0][i]));
+            }
+            
+            printf("\t%s %d elements: device %.3f ms, host %.3f ms, max relative difference: %e (tolerance %e)\n",
+                   (test_operation[t] == SIGNAL_1D_DCT) ? "1D DCT" : "2D DCT",
+                   num_elements,
+                   elapsed_ms[0],
+                   elapsed_ms[1],
+                   (max_value > 0) ? (max_diff / max_value) : 0,
+                   SIGNAL_HOST_TOLERANCE);
+        }
+        
+        free(input_matrix);
+        free(output_matrix[0]);
+        free(output_matrix[1]);
+    }
+    
+    /* Test matrix multiply: 512x512 product and a batch of 32x32 products sharing B,
+     * GFLOP/s compared with a naive CPU loop.
+     */
+    if (device_ready == 0)
+    {
+        printf("\nMatrix Multiply Results:\n\tSkipped, products need a device.\n");
+    }
+    else
+    {
+        const int matrix_size = 512;
+        const int block_size  = 32;
+        const int num_blocks  = 1024;
+        float     *mat_a;
+        float     *mat_b;
+        float     *mat_c;
+        float     *mat_ref;
+        double    max_diff;
+        double    start_time;
+        double    device_ms;
+        double    cpu_ms;
+        double    flops;
+        signal_matrix_t signal_a;
+        signal_matrix_t signal_b;
+        signal_matrix_t signal_c;
+        
+        mat_a   = (float *)malloc(num_blocks * block_size * block_size * sizeof(float));
+        mat_b   = (float *)malloc(matrix_size * matrix_size * sizeof(float));
+        mat_c   = (float *)malloc(num_blocks * block_size * block_size * sizeof(float));
+        mat_ref = (float *)malloc(num_blocks * block_size * block_size * sizeof(float));
+        
+        for (int i = 0; i < (num_blocks * block_size * block_size); i += 1)
+        {
+            mat_a[i] = (float)((i * 37) % 101) / 101.0f;
+        }
+        for (int i = 0; i < (matrix_size * matrix_size); i += 1)
+        {
+            mat_b[i] = (float)((i * 53) % 97) / 97.0f;
+        }
+        
+        /* Single 512x512 product.
+         */
+        signal_a.input_dims[0] = matrix_size;
+        signal_a.input_dims[1] = matrix_size;
+        signal_a.signal        = mat_a;
+        signal_b.input_dims[0] = matrix_size;
+        signal_b.input_dims[1] = matrix_size;
+        signal_b.signal        = mat_b;
+        signal_c.signal        = mat_c;
+        
+        start_time = getWallTimeMs();
+        signalMatrixMultiply(&signal_a, &signal_b, &signal_c, &err);
+        device_ms  = getWallTimeMs() - start_time;
+        
+        if (err != CL_SUCCESS)
+        {
+            printf("Signal Error: %d.\n", err);
+            return 1;
+        }
+        
+        start_time = getWallTimeMs();
+        for (int i = 0; i < matrix_size; i += 1)
+        {
+            for (int j = 0; j < matrix_size; j += 1)
+            {
+                float value = 0;
+                
+                for (int k = 0; k < matrix_size; k += 1)
+                {
+                    value += mat_a[i * matrix_size + k] * mat_b[k * matrix_size + j];
+                }
+                mat_ref[i * matrix_size + j] = value;
+            }
+        }
+        cpu_ms = getWallTimeMs() - start_time;
+        
+        max_diff = 0;
+        for (int i = 0; i < (matrix_size * matrix_size); i += 1)
+        {
+            max_diff = fmax(max_diff, fabs(mat_ref[i] - mat_c[i]));
+        }
+        
+        flops = 2.0 * matrix_size * matrix_size * matrix_size;
+        printf("\nMatrix Multiply Results:\n\t%dx%d: device %.2f GFLOP/s, naive CPU %.2f GFLOP/s, max difference: %f\n",
+               matrix_size,
+               matrix_size,
+               flops / (device_ms * 1.0e6),
+               flops / (cpu_ms * 1.0e6),
+               max_diff);
+        
+        /* Batch of 32x32 products with a shared B, as used for DCT as a matrix product.
+         */
+        signal_a.input_dims[0] = block_size;
+        signal_a.input_dims[1] = block_size;
+        signal_b.input_dims[0] = block_size;
+        signal_b.input_dims[1] = block_size;
+        
+        start_time = getWallTimeMs();
+        signalMatrixMultiplyBatch(&signal_a, &signal_b, num_blocks, 1, &signal_c, &err);
+        device_ms  = getWallTimeMs() - start_time;
+        
+        if (err != CL_SUCCESS)
+        {
+            printf("Signal Error: %d.\n", err);
+            return 1;
+        }
+        
+        start_time = getWallTimeMs();
+        for (int n = 0; n < num_blocks; n += 1)
+        {
+            for (int i = 0; i < block_size; i += 1)
+            {
+                for (int j = 0; j < block_size; j += 1)
+                {
+                    float value = 0;
+                    
+                    for (int k = 0; k < block_size; k += 1)
+                    {
+                        value += mat_a[(n * block_size + i) * block_size + k] * mat_b[k * block_size + j];
+                    }
+                    mat_ref[(n * block_size + i) * block_size + j] = value;
+                }
+            }
+        }
+        cpu_ms = getWallTimeMs() - start_time;
+        
+        max_diff = 0;
+        for (int i = 0; i < (num_blocks * block_size * block_size); i += 1)
+        {
+            max_diff = fmax(max_diff, fabs(mat_ref[i] - mat_c[i]));
+        }
+        
+        flops = 2.0 * num_blocks * block_size * block_size * block_size;
+        printf("\t%d x %dx%d batch: device %.2f GFLOP/s, naive CPU %.2f GFLOP/s, max difference: %f\n",
+               num_blocks,
+               block_size,
+               block_size,
+               flops / (device_ms * 1.0e6),
+               flops / (cpu_ms * 1.0e6),
+               max_diff);
+        
+        free(mat_a);
+        free(mat_b);
+        free(mat_c);
+        free(mat_ref);
+    }
+    
     /* Test 2D DCT
      */
     {
@@ -185,6 +930,35 @@ int main(int argc, const char * argv[])
             }
         }
     }
-
+    
+    signalDeinit(&err);
+    
+    /* Print the per-stage profile and write every recorded command to a JSON file.
+     */
+    if (clGetProfilingEnable() != 0)
+    {
+        profile_stage_stats_t stats[64];
+        cl_int                num_stats;
+        
+        num_stats = clGetProfileStats(stats, 64);
+        
+        printf("\nProfile:\n");
+        
+        for (int i = 0; i < num_stats; i += 1)
+        {
+            printf("\t%-14s %-22s x%-5u queued %8.3f ms, submit %8.3f ms, run %8.3f ms, %7.2f GB/s, %12.0f items/s\n",
+                   stats[i].component,
+                   stats[i].stage,
+                   stats[i].count,
+                   stats[i].queued_ms,
+                   stats[i].submit_ms,
+                   stats[i].run_ms,
+                   stats[i].gb_per_s,
+                   stats[i].items_per_s);
+        }
+        
+        clDumpProfileJSON(PROFILE_OUTPUT_FILENAME, &err);
+    }
+    
     return 0;
 }